@@ -109,10 +109,8 @@ public:
         {
             return;
         }
-        auto arr = ep->getChildren(tg);
-        for (size_t i = 0; i < arr.count(); i++)
+        for (EntityType e : ep->getChildren(tg))
         {
-            auto e = arr.get(i);
             emitEntity(c, e);
         }
     }
@@ -127,10 +125,16 @@ public:
         if (arr.count() > 0)
         {
             c.emit("<", false);
+            PlDiscern dc;
             for (size_t i = 0; i < arr.count(); i++)
             {
+                if (i > 0)
+                {
+                    c.emit(", ", false);
+                }
+                // Value types are boxed, each argument on its own
                 std::string tempclass = arr.get(i)->getStr();
-                if (ep->hasAttrib(EAttribFlags::a_boxed))
+                if (dc.isValueType(tempclass))
                 {
                     if (base::streql(tempclass, "string"))
                     {
@@ -147,23 +151,156 @@ public:
         }
     }
 
+    // A term that is a string literal, $, or a string or slice variable or
+    // call, going by the type it was resolved to
+    static bool isStrTerm(EntityType e)
+    {
+        DataType dt = DataType::d_none;
+        switch (e->mKind)
+        {
+            case EKind::DollarExpr:
+                dt = DataType::d_string;
+                break;
+            case EKind::Literal:
+                dt = e->mDT;
+                break;
+            case EKind::VarEval:
+            case EKind::FuncCall:
+                dt = e->mResolvedRef ? e->mResolvedRef->mDT : DataType::d_none;
+                break;
+            default:
+                break;
+        }
+        return dt == DataType::d_string || dt == DataType::d_strview;
+    }
+
+    // A chain of + where every term is known to be a string or slice is
+    // joined in one pass into a string allocated once, instead of a
+    // temporary for each +.  A term of more than one entity, or of a type
+    // not known here, leaves the chain as it is.
+    //   a + "b" + $c   =>   strconcat({a, primal::string("b", 1), _D(c)})
+    static bool isStrConcat(EntityType ep)
+    {
+        if (ep->mKind != EKind::Expr || sCppProp.getStr(CppPropType::strconcat).empty())
+        {
+            return false;
+        }
+        size_t ops = 0;
+        size_t termlen = 0;
+        for (EntityType e : ep->getChildren(ETag::Primary))
+        {
+            if (e->mKind == EKind::Operator)
+            {
+                if (!base::streql(e->getStr(), "+") || termlen != 1)
+                {
+                    return false;
+                }
+                ops++;
+                termlen = 0;
+            }
+            else if (++termlen > 1 || !isStrTerm(e))
+            {
+                return false;
+            }
+        }
+        return ops > 0 && termlen == 1;
+    }
+
+    // Expressions nest as deep as the source does, so the Expr, ParanExpr
+    // and DollarExpr wrappers are unwound on an explicit stack rather than
+    // by recursing through emitEntity
+    void emitNestedExpr(Code& c, EntityType ep, const char* open, const char* close)
+    {
+        struct Frame
+        {
+            EntityType mEn;
+            size_t mIdx;
+            const char* mClose;
+            bool mConcat;
+        };
+
+        if (ep == nullptr)
+        {
+            return;
+        }
+        if (open)
+        {
+            c.emit(open);
+        }
+        std::vector<Frame> stack;
+        auto pushExpr = [&](EntityType e, const char* cl)
+        {
+            bool concat = isStrConcat(e);
+            if (concat)
+            {
+                c.emit(sCppProp.getStr(CppPropType::strconcat));
+                c.emit("({", false);
+            }
+            stack.push_back({ e, 0, cl, concat });
+        };
+        pushExpr(ep, close);
+        while (!stack.empty())
+        {
+            Frame& f = stack.back();
+            auto subs = f.mEn->getChildren(ETag::Primary);
+            if (f.mIdx >= subs.count())
+            {
+                if (f.mConcat)
+                {
+                    c.emit("})", false);
+                }
+                if (f.mClose)
+                {
+                    c.emit(f.mClose);
+                }
+                stack.pop_back();
+                continue;
+            }
+
+            EntityType e = subs.get(f.mIdx++);
+            switch (e->mKind)
+            {
+                case EKind::Expr:
+                    pushExpr(e, nullptr);
+                    break;
+                case EKind::ParanExpr:
+                    c.emit("(");
+                    stack.push_back({ e, 0, ")", false });
+                    break;
+                case EKind::DollarExpr:
+                    c.emit("_D(");
+                    stack.push_back({ e, 0, ")", false });
+                    break;
+                case EKind::Operator:
+                    if (f.mConcat)
+                    {
+                        c.emit(", ", false);
+                    }
+                    else
+                    {
+                        emitEntity(c, e);
+                    }
+                    break;
+                default:
+                    emitEntity(c, e);
+                    break;
+            }
+        }
+    }
+
     void emitExpr(Code& c, EntityType ep)
     {
-        emitSubEntities(c, ep, ETag::Primary);
+        emitNestedExpr(c, ep, nullptr, nullptr);
     }
 
     void emitParanExpr(Code& c, EntityType ep)
     {
-        c.emit("(");
-        emitSubEntities(c, ep, ETag::Primary);
-        c.emit(")");
+        emitNestedExpr(c, ep, "(", ")");
     }
 
     void emitDollarExpr(Code& c, EntityType ep)
     {
-        c.emit("_D(");
-        emitSubEntities(c, ep, ETag::Primary);
-        c.emit(")");
+        emitNestedExpr(c, ep, "_D(", ")");
     }
 
     void emitReturnStmt(Code& c, EntityType ep)
@@ -217,13 +354,151 @@ public:
         }
     }
 
+    bool isLiteralExpr(EntityType ep)
+    {
+        return ep->getChildren().count() == 1 && ep->getChild(EKind::Literal) != nullptr;
+    }
+
+    // A parallel for's body becomes a lambda over part of the range, and the
+    // runtime splits the range across the task pool.  Each sum variable is
+    // shadowed by a local in the lambda, which is added to the variable when
+    // the part is done.
+    //   {
+    //       auto* _for_9_sum = &sum;
+    //       auto _for_9_body = [&](auto _for_9_beg, auto _for_9_end)
+    //       {
+    //           decltype(sum) sum = 0;
+    //           for (auto i = _for_9_beg; i < _for_9_end; i++) {...}
+    //           reduceadd(_for_9_sum, sum);
+    //       };
+    //       parallelfor(fromval, toval, _for_9_body);
+    //   }
+    void emitParallelFor(Code& c, EntityType ep, EntityType range)
+    {
+        std::string forvar = ep->getIdentStr(ETag::ForVar);
+        std::string scname = ep->getStr();
+        auto reducevars = range->getChildren(ETag::ReduceVar);
+
+        c.braceOpen();
+        c.indentInc();
+
+        for (EntityType rv : reducevars)
+        {
+            c.emit("auto*");
+            c.emit(scname + "_" + rv->getStr());
+            c.emit("= &", true);
+            c.emit(rv->getStr(), false);
+            c.semiln();
+        }
+
+        c.emit(CppKeyword::cpp_auto);
+        c.emit(scname + "_body");
+        c.emit("= [&](");
+        c.emit(CppKeyword::cpp_auto);
+        c.emit(scname + "_beg", false);
+        c.emit(", ", false);
+        c.emit(CppKeyword::cpp_auto);
+        c.emit(scname + "_end", false);
+        c.emit(")", false);
+        c.nl();
+        c.braceOpen();
+        c.indentInc();
+
+        for (EntityType rv : reducevars)
+        {
+            c.emit("decltype(" + rv->getStr() + ")");
+            c.emit(rv->getStr());
+            c.emit("= 0");
+            c.semiln();
+        }
+
+        c.emit(CppKeyword::cpp_for);
+        c.emit("(");
+        c.emit(CppKeyword::cpp_auto);
+        c.emit(forvar);
+        c.emit("= ");
+        c.emit(scname + "_beg");
+        c.emit("; ");
+        c.emit(forvar);
+        c.emit("<");
+        c.emit(scname + "_end");
+        c.emit("; ");
+        c.emit(forvar);
+        c.emit("++)", false);
+        c.nl();
+        emitStmtBlock(c, ep->getChild(EKind::StmtBlock));
+
+        for (EntityType rv : reducevars)
+        {
+            c.emit(sCppProp.getStr(CppPropType::reduceadd));
+            c.emit("(", false);
+            c.emit(scname + "_" + rv->getStr());
+            c.emit(", ", false);
+            c.emit(rv->getStr());
+            c.emit(")", false);
+            c.semiln();
+        }
+
+        c.indentDec();
+        c.braceClose(false);
+        c.semiln();
+
+        c.emit(sCppProp.getStr(CppPropType::parallelfor));
+        c.emit("(", false);
+        emitExpr(c, range->getChild(ETag::RangeFromVal));
+        c.emit(", ", false);
+        emitExpr(c, range->getChild(ETag::RangeToVal));
+        if (range->hasAttrib(EAttribFlags::a_inclusive))
+        {
+            c.emit(" + 1");
+        }
+        c.emit(", ", false);
+        c.emit(scname + "_body");
+        c.emit(")", false);
+        c.semiln();
+
+        c.indentDec();
+        c.braceClose(true);
+    }
+
     void emitForStmt(Code& c, EntityType ep)
     {
+        std::string forvar = ep->getIdentStr(ETag::ForVar);
+
+        // The range bound tested each iteration is evaluated once, before the
+        // loop, into a const in a block around it.  Literals are left as is.
+        //   { const auto _for_9_end = toval; for (auto i = fromval; i < _for_9_end; i++) }
+        EntityType range = ep->getChild(EKind::Range);
+        if (range && range->hasAttrib(EAttribFlags::a_parallel))
+        {
+            emitParallelFor(c, ep, range);
+            return;
+        }
+
+        std::string boundvar;
+        if (range)
+        {
+            bool rev = range->hasAttrib(EAttribFlags::a_reverse);
+            EntityType boundexp = range->getChild(rev ? ETag::RangeFromVal : ETag::RangeToVal);
+            if (boundexp && !isLiteralExpr(boundexp))
+            {
+                boundvar = ep->getStr() + "_end";
+
+                c.braceOpen();
+                c.indentInc();
+                c.emit(CppKeyword::cpp_const);
+                c.emit(CppKeyword::cpp_auto);
+                c.emit(boundvar);
+                c.emit("= ");
+                emitExpr(c, boundexp);
+                c.semiln();
+            }
+        }
+
         c.emit(CppKeyword::cpp_for);
 
         c.emit("(");
 
-        EntityType range = ep->getChild(EKind::Range);
         if (range)
         {
             // Range for
@@ -233,7 +508,6 @@ public:
             EntityType toexp = range->getChild(ETag::RangeToVal);
 
             c.emit(CppKeyword::cpp_auto);
-            std::string forvar = ep->getIdentStr(ETag::ForVar);
             c.emit(forvar);
             c.emit("= ");
 
@@ -272,7 +546,7 @@ public:
                     // fwd exc
                     c.emit("<");
                 }
-                emitExpr(c, toexp);
+                emitBound(c, toexp, boundvar);
                 c.emit("; ");
 
                 c.emit(forvar, false);
@@ -282,7 +556,7 @@ public:
             {
                 // rev
                 c.emit("-- >", false);
-                emitExpr(c, fromexp);
+                emitBound(c, fromexp, boundvar);
                 c.emit("; ");
             }
         }
@@ -291,33 +565,28 @@ public:
             EntityType iter = ep->getChild(EKind::Iter);
             if (iter)
             {
-                // for (auto i = arr->iterFwd(); arr->iterFwdLoop(i); )
-                // for (auto i = arr->iterRev(); arr->iterRevLoop(i); )
+                // for (auto i : arr->indexFwd())
+                // for (auto i : arr->indexRev())
 
-                // Obj iter for
+                // Obj iter for, a range-based for that indexes the object's
+                // storage.  The loop var is by value, a borrowed pointer for
+                // vectors, so the body can change the object or assign to
+                // the var without either going stale.
                 bool rev = iter->hasAttrib(EAttribFlags::a_reverse);
                 EntityType iterval = iter->getChild(ETag::IterVal);
-                std::string forvar = ep->getIdentStr(ETag::ForVar);
                 if (!iterval)
                 {
                     pushErr(c, "'for' statement missing iter class");
                     return;
                 }
 
-                c.emit(CppKeyword::cpp_auto);
+                c.emit("auto");
                 c.emit(forvar);
-                c.emit("= ");
+                c.emit(" : ", false);
                 emitExpr(c, iterval);
                 c.emit("->", false);
-                c.emit(rev ? "iterRev" : "iterFwd", false);
-                c.emit("(); ");
-
-                emitExpr(c, iterval);
-                c.emit("->", false);
-                c.emit(rev ? "iterRevLoop" : "iterFwdLoop", false);
-                c.emit("(", false);
-                c.emit(forvar);
-                c.emit("); ", false);
+                c.emit(rev ? "indexRev" : "indexFwd", false);
+                c.emit("()", false);
             }
         }
 
@@ -327,6 +596,24 @@ public:
 
         // Emit the stmt block. A null stmtblock will emit a {}
         emitStmtBlock(c, ep->getChild(EKind::StmtBlock));
+
+        if (!boundvar.empty())
+        {
+            c.indentDec();
+            c.braceClose(true);
+        }
+    }
+
+    void emitBound(Code& c, EntityType boundexp, const std::string& boundvar)
+    {
+        if (boundvar.empty())
+        {
+            emitExpr(c, boundexp);
+        }
+        else
+        {
+            c.emit(boundvar);
+        }
     }
 
     void emitLoopStmt(Code& c, EntityType ep)
@@ -422,22 +709,18 @@ public:
         c.indentInc();
 
         // case parts
-        auto arr = ep->getChildren(EKind::Case, ETag::Primary);
-        for (size_t i = 0; i < arr.count(); i++)
+        for (EntityType cen : ep->getChildren(EKind::Case, ETag::Primary))
         {
-            auto cen = arr.get(i);
-
-            auto valarr = cen->getChildren(EKind::Literal, ETag::CaseVal);
-            for (size_t vi = 0; vi < valarr.count(); vi++)
+            for (EntityType valen : cen->getChildren(EKind::Literal, ETag::CaseVal))
             {
-                if (valarr.get(vi)->hasAttrib(EAttribFlags::a_ellipses))
+                if (valen->hasAttrib(EAttribFlags::a_ellipses))
                 {
                     c.emit("default");
                 }
                 else
                 {
                     c.emit(CppKeyword::cpp_case);
-                    c.emit(valarr.get(vi)->getStr());
+                    c.emit(valen->getStr());
                 }
                 c.emitln(":");
             }
@@ -611,6 +894,7 @@ public:
             switch (prevk)
             {
                 case EKind::VarDecl:
+                case EKind::ObjectFld:
                 case EKind::ForStmt:
                 case EKind::FuncParam:
                 {
@@ -692,10 +976,14 @@ public:
         c.emit("(");
         if (ep)
         {
-            auto params = ep->getChildren(EKind::FuncParam);
-            for (size_t i = 0; i < params.count(); i++)
+            bool first = true;
+            for (EntityType p : ep->getChildren(EKind::FuncParam))
             {
-                auto p = params.get(i);
+                if (!first)
+                {
+                    c.emit(",");
+                }
+                first = false;
 
                 if (p->hasAttrib(EAttribFlags::a_ellipses))
                 {
@@ -715,11 +1003,6 @@ public:
                     c.emit("&", false);
                 }
                 c.emit(p->getIdentStr(ETag::ParamName));
-
-                if ((i + 1) < params.count())
-                {
-                    c.emit(",");
-                }
             }
         }
         c.emit(")");
@@ -827,17 +1110,16 @@ public:
 
             c.emit("(");
 
-            auto params = ep->getChildren(EKind::FuncParam);
-            for (size_t i = 0; i < params.count(); i++)
+            bool first = true;
+            for (EntityType p : ep->getChildren(EKind::FuncParam))
             {
-                auto p = params.get(i);
-
-                c.emit(p->getIdentStr(ETag::ParamName));
-
-                if ((i + 1) < params.count())
+                if (!first)
                 {
                     c.emit(",");
                 }
+                first = false;
+
+                c.emit(p->getIdentStr(ETag::ParamName));
             }
             c.emit(")");
         }
@@ -866,9 +1148,9 @@ public:
         auto resols = ep->getChildren(EKind::Resol);
 
         // Emit any inheritted interfaces
-        for (size_t r = 0; r < resols.count(); r++)
+        for (EntityType r : resols)
         {
-            EntityType resen = resols.get(r)->mResolvedRef;
+            EntityType resen = r->mResolvedRef;
             if (resen && resen->mKind == EKind::Impl)
             {
                 std::string intfname = resen->getSimpIdentStr(ETag::InterfName);
@@ -890,11 +1172,8 @@ public:
         c.indentInc();
 
         // Emit member variables
-        auto flds = ep->getChildren(EKind::ObjectFld);
-        for (size_t i = 0; i < flds.count(); i++)
+        for (EntityType f : ep->getChildren(EKind::ObjectFld))
         {
-            auto f = flds.get(i);
-
             emitVarType(c, f, ETag::VarType);
 
             c.emit(f->getIdentStr(ETag::VarName));
@@ -908,9 +1187,9 @@ public:
         c.emit(":");
 
         c.indentInc();
-        for (size_t r = 0; r < resols.count(); r++)
+        for (EntityType r : resols)
         {
-            EntityType resen = resols.get(r)->mResolvedRef;
+            EntityType resen = r->mResolvedRef;
             if (resen && resen->mKind == EKind::Impl)
             {
                 c.nl();
@@ -967,10 +1246,9 @@ public:
         // Emit methods
 
         c.indentInc();
-        auto fns = ep->getChildren(EKind::FuncDef);
-        for (size_t r = 0; r < fns.count(); r++)
+        for (EntityType fn : ep->getChildren(EKind::FuncDef))
         {
-            emitFuncDef(c, fns.get(r), true);
+            emitFuncDef(c, fn, true);
         }
 
         c.indentDec();
@@ -1197,13 +1475,8 @@ public:
         dbgerr("Codegen failure: %s\n", errmsg.c_str());
     }
 
-    bool generate(EntityType root, Code& c)
+    void emitPrologue(Code& c)
     {
-        if (!root)
-        {
-            return false;
-        }
-
         // Include unitwide header
         if (!mPubMode)
         {
@@ -1215,6 +1488,16 @@ public:
         }
 
         emitNsOpen(c);
+    }
+
+    bool generate(EntityType root, Code& c)
+    {
+        if (!root)
+        {
+            return false;
+        }
+
+        emitPrologue(c);
 
         // Emit the entitites
         emitEntity(c, root);
@@ -1223,6 +1506,40 @@ public:
 
         return true;
     }
+
+    bool generate(EntityType root, Code& cpp, Code& hdr, PlAstWriter* astwr)
+    {
+        // Walks the root's declarations once, emitting each into the cpp and
+        // the private header before handing it to the AST writer
+        if (!root)
+        {
+            return false;
+        }
+
+        mPubMode = false;
+        hdr.emitln("#pragma once");
+        emitPrologue(hdr);
+        emitPrologue(cpp);
+
+        auto decls = (root->mKind == EKind::FileRoot) ? root->getChildren(ETag::Primary) : PlSpan<EntityType>(&root, 1);
+        for (EntityType e : decls)
+        {
+            mHeaderMode = true;
+            emitEntity(hdr, e);
+            mHeaderMode = false;
+            emitEntity(cpp, e);
+
+            if (astwr)
+            {
+                astwr->saveDecl(e);
+            }
+        }
+
+        emitNsClose(hdr);
+        emitNsClose(cpp);
+
+        return true;
+    }
 };
 
 
@@ -1271,6 +1588,24 @@ bool plGenerate(PlUnit* unit, EntityType root, OutputFmt fmt, base::Buffer& buf)
 }
 
 
+bool plGenerate(PlUnit* unit, EntityType root, Code& cpp, Code& hdr, PlAstWriter* astwr)
+{
+    CppCode genout;
+    if (!root)
+    {
+        return false;
+    }
+
+    if (unit->mType == UnitType::lib)
+    {
+        genout.mNamespace = unit->cppNamespace();
+    }
+    genout.mUnit = unit;
+
+    return genout.generate(root, cpp, hdr, astwr);
+}
+
+
 // Code::
 void Code::braceOpen()
 {
@@ -1298,7 +1633,7 @@ void Code::braceClose(bool autonl)
     }
 }
 
-void Code::emit(std::string_view txt, bool autosp)
+void Code::emitSep(std::string_view txt, bool autosp)
 {
     constDef NoSpFirst = "(:;\"), ";
     constDef NoSpLast = "(:;\"{} ";
@@ -1316,9 +1651,20 @@ void Code::emit(std::string_view txt, bool autosp)
             appendc(' ');
         }
     }
+}
+
+void Code::emit(std::string_view txt, bool autosp)
+{
+    emitSep(txt, autosp);
     append(txt);
 }
 
+void Code::emitRef(std::string_view txt, bool autosp)
+{
+    emitSep(txt, autosp);
+    appendRef(txt);
+}
+
 void Code::emitFmt(const char* fmt, ...)
 {
     va_list va;
@@ -46,7 +46,7 @@ void PlCompState::addDep(PlUnit* pu)
     // Create an entity to represent the dep unit and add it to symbol table
     PlToken tok;
     tok.setStr(pu->mName.c_str());
-    fi->mDepEn = PlEntity::newEntity(nullptr, EKind::FileRoot, tok);
+    fi->mDepEn = PlEntity::newRoot(fi->arena(), EKind::FileRoot, tok);
 
     std::string sc;
     std::string ns = pu->mNS;
@@ -94,6 +94,7 @@ bool PlCompState::compileSrc()
 bool PlCompState::loadUnits()
 {
     assert(mUnit);
+    PlProfScope ps(ProfPhase::loadUnits, mUnit);
     bool ret = true;
 
     // Load representations from dependant units
@@ -108,7 +109,8 @@ bool PlCompState::loadUnits()
         {
             mSymTable.pushScope(fi->containingUnit()->mNS.c_str());
         }
-        if (!fi->loadPrecomp(fi->fname()))
+        // Only names are registered up front, declarations load on lookup
+        if (!fi->loadPrecomp(fi->fname(), true))
         {
             ret = false;
         }
@@ -140,7 +142,10 @@ void PlCompState::resolveSrcEntitites()
         {
             base::Path fn = mUnit->srcFn(fi->fname());
             mUnit->mErrCol.begCtx(fn);
-            mResolver.fixupAll(fi->enRoot());
+            {
+                PlProfScope ps(ProfPhase::fixupAll, mUnit, &fn);
+                mResolver.fixupAll(fi->enRoot());
+            }
             size_t ec = mUnit->mErrCol.endCtx();
             if (ec > 0)
             {
@@ -156,8 +161,10 @@ void PlCompState::resolveSrcEntitites()
         {
             base::Path fn = mUnit->srcFn(fi->fname());
             mUnit->mErrCol.begCtx(fn);
-
-            mResolver.validateAll(fi->enRoot(), ETag::Primary);
+            {
+                PlProfScope ps(ProfPhase::validateAll, mUnit, &fn);
+                mResolver.validateAll(fi->enRoot(), ETag::Primary);
+            }
             size_t ec = mUnit->mErrCol.endCtx();
             if (ec > 0)
             {
@@ -170,14 +177,13 @@ void PlCompState::resolveSrcEntitites()
 bool PlCompState::gatherAllPubs()
 {
     assert(mUnit);
-    if (mPubsRoot)
-    {
-        delete mPubsRoot;
-    }
+    PlProfScope ps(ProfPhase::gatherAllPubs, mUnit);
+    mPubsRoot = nullptr;
+    mPubsArena.release();
 
     PlToken tok;
     tok.setStr("Unit Publics");
-    mPubsRoot = PlEntity::newEntity(nullptr, EKind::FileRoot, tok);
+    mPubsRoot = PlEntity::newRoot(&mPubsArena, EKind::FileRoot, tok);
 
     for (base::Iter<PlFileState> fi; mSrcFiles.forEach(fi); )
     {
@@ -190,21 +196,42 @@ bool PlCompState::gatherAllPubs()
     // Resolve dep unit files
     for (base::Iter<PlFileState> fi; mDepUnits.forEach(fi); )
     {
-        if (fi->enRoot())
+        if (fi->enRoot() && !fi->isIndexed())
         {
             mResolver.fixupAll(fi->enRoot());
         }
     }
+    fixupDepDecls();
 
     // Resolve public entity root
     if (mPubsRoot)
     {
         mResolver.fixupAll(mPubsRoot);
+        fixupDepDecls();
     }
 
     return true;
 }
 
+void PlCompState::fixupDepDecls()
+{
+    // Only the declarations of dep units that have been loaded need
+    // resolving, and resolving them can load more
+    std::vector<EntityType> ens;
+    for (bool more = true; more; )
+    {
+        more = false;
+        for (base::Iter<PlFileState> fi; mDepUnits.forEach(fi); )
+        {
+            if (fi->takeLoaded(ens))
+            {
+                mResolver.fixupAll(ens);
+                more = true;
+            }
+        }
+    }
+}
+
 bool PlCompState::generateFile(OutputFmt fmt, const base::Path& filename, base::Buffer* outbuf)
 {
     bool ret = false;
@@ -223,7 +250,7 @@ bool PlCompState::generateFile(OutputFmt fmt, const base::Path& filename, base::
 
             case OutputFmt::entity:
             {
-                base::PersistWr pwr(L_ENTITYFILESIG);
+                base::PackWr pwr(L_ENTITYFILESIG, C_ENTFILEVER);
                 mPubsRoot->saveEntity(pwr);
                 pwr.moveToBuffer(buf);
             }
@@ -251,13 +278,13 @@ bool PlCompState::generateFile(OutputFmt fmt, const base::Path& filename, base::
 
 // PlFileState::
 
-PlArr<EntityType> PlFileState::getRootChildren(EKind ek, ETag tg)
+PlEnRange PlFileState::getRootChildren(EKind ek, ETag tg)
 {
     if (enRoot())
     {
         return enRoot()->getChildren(ek, tg);
     }
-    return PlArr<EntityType>(0);
+    return PlEnRange(PlSpan<EntityType>(), ek);
 }
 
 void PlFileState::readCppDirec(EntityType ce)
@@ -280,24 +307,18 @@ void PlFileState::readCfg(bool multiroot)
 
     if (multiroot)
     {
-        PlArr<EntityType> fr = getRootChildren(EKind::FileRoot);
-        for (size_t f = 0; f < fr.count(); f++)
+        for (EntityType fre : getRootChildren(EKind::FileRoot))
         {
-            EntityType fre = fr.get(f);
-            PlArr<EntityType> rootch = fre->getChildren(EKind::CppDirec);
-            for (size_t i = 0; i < rootch.count(); i++)
+            for (EntityType ce : fre->getChildren(EKind::CppDirec))
             {
-                EntityType ce = rootch.get(i);
                 readCppDirec(ce);
             }
         }
     }
     else
     {
-        PlArr<EntityType> rootch = getRootChildren(EKind::CppDirec);
-        for (size_t i = 0; i < rootch.count(); i++)
+        for (EntityType ce : getRootChildren(EKind::CppDirec))
         {
-            EntityType ce = rootch.get(i);
             readCppDirec(ce);
         }
     }
@@ -310,9 +331,9 @@ bool PlFileState::compileSrc(const base::Path& sourcefn)
 
     dbglog("compileSrc '%s' (%s)\n", sourcefn.c_str(), mContainingUnit->mName.c_str());
 
-    mEnRoot = new PlEntity();
-    mEnRoot->mKind = EKind::FileRoot;
-    mEnRoot->mToken.setStr(sourcefn.c_str());
+    PlToken tok;
+    tok.setStr(sourcefn.c_str());
+    mEnRoot = PlEntity::newRoot(&mArena, EKind::FileRoot, tok);
     mEnRoot->addAttrib(EAttribFlags::a_public);
 
     if (!plParseFile(sourcefn, symTable(), containingUnit(), mEnRoot, (mDiag ? &mTokDiag : nullptr)))
@@ -325,15 +346,36 @@ bool PlFileState::compileSrc(const base::Path& sourcefn)
     return true;
 }
 
-bool PlFileState::loadPrecomp(const base::Path& entfn)
+bool PlFileState::loadPrecomp(const base::Path& entfn, bool lazy)
 {
     assert(mContainingUnit);
     dbglog("loadPrecomp '%s' (%s)\n", entfn.c_str(), mContainingUnit->mName.c_str());
 
-    base::PersistRd prd(L_ENTITYFILESIG);
-    if (prd.load(entfn))
+    bool loaded = mAst.load(entfn, &mArena);
+    if (loaded)
+    {
+        mEnRoot = mAst.root();
+        mIndexed = true;
+        if (lazy)
+        {
+            mAst.addSymbols(symTable(), containingUnit());
+            mState = State::AstLoaded;
+            return true;
+        }
+        mAst.loadAll();
+    }
+    else if (mAst.isLegacy())
+    {
+        // Files written before the packed format
+        base::PersistRd legacyrd(L_ENTITYFILESIG);
+        loaded = legacyrd.load(entfn);
+        if (loaded)
+        {
+            mEnRoot = PlEntity::loadEntity(legacyrd, &mArena);
+        }
+    }
+    if (loaded)
     {
-        mEnRoot = loadEntity(nullptr, prd);
         if (!mEnRoot)
         {
             mState = State::Error;
@@ -341,7 +383,10 @@ bool PlFileState::loadPrecomp(const base::Path& entfn)
         }
 
         mEnRoot->updateSymTbl(ETag::Primary, symTable(), containingUnit());
-
+    }
+    else
+    {
+        return false;
     }
     mState = State::AstLoaded;
     return true;
@@ -378,44 +423,6 @@ PlSymbolTable* PlFileState::symTable()
 }
 
 
-EntityType PlFileState::loadEntity(EntityType parent, base::PersistRd& prd, ETag etag)
-{
-    // IMPORTANT: Must match PlEntity::saveEntity
-    EntityType en = nullptr;
-
-    en = PlEntity::read(parent, prd, etag);
-    if (!en)
-    {
-        dbgerr("loadEntity() failed to create and read entity\n");
-        return nullptr;
-    }
-
-    auto subentarrlen = prd.rdArr();
-    for (uint32 i = 0; i < subentarrlen; i++)
-    {
-        if (prd.inErr())
-        {
-            return nullptr;
-        }
-
-        ETag tag = (ETag)prd.rdUInt32();
-        auto entarrlen = prd.rdArr();
-        for (uint32 i = 0; i < entarrlen; i++)
-        {
-            EntityType ret = loadEntity(en, prd, tag);
-            if (!ret)
-            {
-                return nullptr;
-            }
-            prd.endElem();
-        }
-
-        prd.endElem();
-    }
-
-    return en;
-}
-
 bool PlFileState::generateFile(OutputFmt fmt, const base::Path& filename, base::Buffer* outbuf)
 {
     bool ret = false;
@@ -438,7 +445,7 @@ bool PlFileState::generateFile(OutputFmt fmt, const base::Path& filename, base::
 
         case OutputFmt::entity:
         {
-            base::PersistWr pwr(L_ENTITYFILESIG);
+            base::PackWr pwr(L_ENTITYFILESIG, C_ENTFILEVER);
             mEnRoot->saveEntity(pwr);
             pwr.moveToBuffer(buf);
         }
@@ -468,3 +475,36 @@ bool PlFileState::generateFile(OutputFmt fmt, const base::Path& filename, base::
 
     return ret;
 }
+
+bool PlFileState::generateAll(const base::Path& cppfn, const base::Path& hdrfn, const base::Path& astfn)
+{
+    if (!mEnRoot)
+    {
+        dbgerr("Cannot generate file because obj not init\n");
+        return false;
+    }
+
+    // One walk produces all three, the cpp and header are only rewritten when
+    // they change so ninja leaves their dependents alone.  The AST is always
+    // written, its time stamp is what marks the source as compiled.
+    Code cpp;
+    Code hdr;
+    base::PackWr pwr(L_ENTITYFILESIG, C_ENTFILEVER);
+    PlAstWriter astwr(mEnRoot, pwr);
+    {
+        base::Path fn = fname();
+        PlProfScope ps(ProfPhase::generate, mContainingUnit, &fn);
+        if (!plGenerate(mContainingUnit, mEnRoot, cpp, hdr, &astwr))
+        {
+            return false;
+        }
+        astwr.finish();
+    }
+
+    (void)plWrite(sOutputFmtMap.toString(OutputFmt::cpp), cpp, cppfn, true);
+    (void)plWrite(sOutputFmtMap.toString(OutputFmt::header), hdr, hdrfn, true);
+
+    base::Buffer buf;
+    pwr.moveToBuffer(buf);
+    return plWrite(sOutputFmtMap.toString(OutputFmt::entity), buf, astfn);
+}
@@ -6,7 +6,9 @@
     _en_(templatedir)         \
     _en_(ninjaconfig)         \
     _en_(unityamlfn)          \
-    _en_(cmaketemplate)       
+    _en_(ninja)               \
+    _en_(cxx)                 \
+    _en_(ar)                  
 enummapdef(ConfigEnumList, Config, sConfigMap, 0);
 
 
@@ -53,7 +55,10 @@ private:
 // Config default values
 constexpr PlConfig::Default sCfgDefaultMap[] = 
 {
-    {Config::ninjaconfig, "Ninja Multi-Config"}
+    {Config::ninjaconfig, "Ninja Multi-Config"},
+    {Config::ninja, "ninja"},
+    {Config::cxx, "c++"},
+    {Config::ar, "ar"}
 };
 
 extern PlConfig sConfig;
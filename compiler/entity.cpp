@@ -1,60 +1,95 @@
 #include "primalc.h"
+#include <algorithm>
 
 // PlEntity::
 
+EntityType PlEntity::newRoot(PlArena* arena, EKind ekind, const PlToken& tok)
+{
+    assert(arena);
+    EntityType en = arena->allocEntity();
+    en->mArena = arena;
+    en->mKind = ekind;
+    en->mToken = tok;
+    return en;
+}
+
 EntityType PlEntity::newEntity(EntityType parent, EKind ekind, const PlToken& tok, ETag tg)
 {
     //dbglog("add type=%s group=%s tok=%s\n", sEKindMap.toString(ekind), sETagMap.toString(tg), tok.toString().c_str());
-    EntityType en = nullptr;
+    if (!parent || !parent->mArena)
+    {
+        dbgerr("Failed to create entity\n");
+        return nullptr;
+    }
+
+    EntityType en = newRoot(parent->mArena, ekind, tok);
+    parent->appendChild(en, tg);
+    return en;
+}
 
-    if (parent)
+PlEntity::SubEntity* PlEntity::findSub(ETag tg)
+{
+    for (uint32 i = 0; i < mSubCount; i++)
     {
-        for (SubEntity& sub : parent->mSubEntities)
+        if (mSubs[i].mTag == tg)
         {
-            if (sub.mTag == tg)
-            {
-                // Add to existing tag
-                en = &sub.mEntities.emplace_back();
-            }
-        }
-        if (!en)
-        {
-            // Add to a new tag
-            SubEntity& sub = parent->mSubEntities.emplace_back();
-            sub.mTag = tg;
-
-            en = &sub.mEntities.emplace_back();
+            return &mSubs[i];
         }
     }
-    else
-    {
-        en = new PlEntity();
-    }
-    if (en)
+    return nullptr;
+}
+
+void PlEntity::appendChild(EntityType en, ETag tg)
+{
+    SubEntity* sub = findSub(tg);
+    if (!sub)
     {
-        en->mKind = ekind;
-        en->mToken = tok;
+        // Add a new tag
+        if (mSubCount == mSubCap)
+        {
+            uint32 cap = mSubCap ? mSubCap * 2 : 2;
+            SubEntity* subs = (SubEntity*)mArena->alloc(cap * sizeof(SubEntity));
+            if (mSubCount)
+            {
+                memcpy(subs, mSubs, mSubCount * sizeof(SubEntity));
+            }
+            mSubs = subs;
+            mSubCap = cap;
+        }
+        sub = &mSubs[mSubCount++];
+        sub->mTag = tg;
+        sub->mCount = 0;
+        sub->mCap = 0;
+        sub->mEnts = nullptr;
     }
-    else
+
+    if (sub->mCount == sub->mCap)
     {
-        dbgerr("Failed to create entity\n");
+        // Grow the span, the old one is left behind in the arena
+        uint32 cap = sub->mCap ? sub->mCap * 2 : 4;
+        EntityType* ents = (EntityType*)mArena->alloc(cap * sizeof(EntityType));
+        if (sub->mCount)
+        {
+            memcpy(ents, sub->mEnts, sub->mCount * sizeof(EntityType));
+        }
+        sub->mEnts = ents;
+        sub->mCap = cap;
     }
-    return en;
+    sub->mEnts[sub->mCount++] = en;
 }
 
 EntityType PlEntity::newOrFindEntity(EntityType parent, const char* tokstr, EKind ekind, ETag etag)
 {
-    auto arr = parent->getChildren(ekind, etag);
-    for (size_t i = 0; i < arr.count(); i++)
+    PlToken tok;
+    tok.setStr(tokstr);
+    for (EntityType e : parent->getChildren(ekind, etag))
     {
-        if (arr.get(i)->mToken.equals(tokstr))
+        if (e->mToken.equals(tok))
         {
-            return arr.get(i);
+            return e;
         }
     }
-    EntityType en = PlEntity::newEntity(parent, ekind, PlToken::sNilTok, etag);
-    en->setTokStr(tokstr);
-    return en;
+    return PlEntity::newEntity(parent, ekind, tok, etag);
 }
 
 std::string PlEntity::getCppDirecStr(CppDirecType cdtype, size_t index)
@@ -76,8 +111,7 @@ std::string PlEntity::getCppDirecStr(CppDirecType cdtype, size_t index)
         }
         else
         {
-            PlArr<EntityType> arr = getChildren(EKind::Literal);
-            EntityType valen = arr.get(index);
+            EntityType valen = getChildren(EKind::Literal).get(index);
             if (valen)
             {
                 s = valen->mToken.strNoQuotes(true);
@@ -91,85 +125,28 @@ EntityType PlEntity::getChild(ETag tg)
 {
     // Gets only a single child... don't use if multiple children
     // are expected.
-    for (auto& sub : mSubEntities)
-    {
-        if (sub.mTag == tg)
-        {
-            return &sub.mEntities.front();
-        }
-    }
-    return nullptr;
+    SubEntity* sub = findSub(tg);
+    return (sub && sub->mCount > 0) ? sub->mEnts[0] : nullptr;
 }
 
 EntityType PlEntity::getChild(EKind ek, ETag tg)
 {
     // Gets only a single child... don't use if multiple children
     // are expected.
-    for (auto& sub : mSubEntities)
-    {
-        if (sub.mTag == tg)
-        {
-            for (auto& e : sub.mEntities)
-            {
-                if (e.mKind == ek)
-                {
-                    return &e;
-                }
-            }
-        }
-    }
-    return nullptr;
+    return getChildren(ek, tg).first();
 }
 
-PlArr<EntityType> PlEntity::getChildren(ETag tg)
+PlSpan<EntityType> PlEntity::getChildren(ETag tg)
 {
-    for (auto& sub : mSubEntities)
-    {
-        if (sub.mTag == tg || tg == ETag::Any)
-        {
-            PlArr<EntityType> arr(sub.mEntities.size());
-            size_t i = 0;
-            for (auto& e : sub.mEntities)
-            {
-                arr.set(i++, &e);
-            }
-            return arr;
-        }
-    }
-    return PlArr<EntityType>(0);
+    // Returns a view of the tag's span, no copy is made.  Children appended
+    // later are not seen by an existing view.
+    SubEntity* sub = (tg == ETag::Any) ? (mSubCount ? &mSubs[0] : nullptr) : findSub(tg);
+    return sub ? sub->entities() : PlSpan<EntityType>();
 }
 
-PlArr<EntityType> PlEntity::getChildren(EKind ek, ETag tg)
+PlEnRange PlEntity::getChildren(EKind ek, ETag tg)
 {
-    for (auto& sub : mSubEntities)
-    {
-        if (sub.mTag == tg || tg == ETag::Any)
-        {
-            size_t cnt = 0;
-            for (auto& e : sub.mEntities)
-            {
-                if (e.mKind == ek)
-                {
-                    cnt++;
-                }
-            }
-            if (cnt == 0)
-            {
-                break;
-            }
-            PlArr<EntityType> arr(cnt);
-            size_t i = 0;
-            for (auto& e : sub.mEntities)
-            {
-                if (e.mKind == ek)
-                {
-                    arr.set(i++, &e);
-                }
-            }
-            return arr;
-        }
-    }
-    return PlArr<EntityType>(0);
+    return PlEnRange(getChildren(tg), ek);
 }
 
 std::string PlEntity::getStrings(EKind ekind, ETag tg, std::string sep, size_t max)
@@ -178,13 +155,13 @@ std::string PlEntity::getStrings(EKind ekind, ETag tg, std::string sep, size_t m
     // will return a concated value with seperator sep. Ex: "math.sign"
     std::string ret;
     size_t cnt = 0;
-    for (auto& sub : mSubEntities)
+    for (auto& sub : subEntities())
     {
         if (sub.mTag == tg)
         {
-            for (auto& e : sub.mEntities)
+            for (EntityType e : sub.entities())
             {
-                if (e.mKind != ekind)
+                if (e->mKind != ekind)
                 {
                     continue;
                 }
@@ -193,7 +170,7 @@ std::string PlEntity::getStrings(EKind ekind, ETag tg, std::string sep, size_t m
                     ret += sep;
                 }
 
-                ret += e.getStr();
+                ret += e->getStr();
 
                 cnt++;
                 if (cnt >= max)
@@ -211,17 +188,17 @@ void PlEntity::getChildrenStr(EKind ekind, ETag tg, std::vector<std::string>& st
     // Strip quotes
     std::string ret;
     size_t cnt = 0;
-    for (auto& sub : mSubEntities)
+    for (auto& sub : subEntities())
     {
         if (sub.mTag == tg)
         {
-            for (auto& e : sub.mEntities)
+            for (EntityType e : sub.entities())
             {
-                if (e.mKind != ekind)
+                if (e->mKind != ekind)
                 {
                     continue;
                 }
-                strs.push_back(e.mToken.strNoQuotes(true));
+                strs.push_back(e->mToken.strNoQuotes(true));
             }
         }
     }
@@ -234,12 +211,12 @@ void PlEntity::dbgDump(const char* label)
     bld.append(label);
     dumpEn(this, ETag::Primary, bld);
     bld.append("\n");
-    for (auto& sub : mSubEntities)
+    for (auto& sub : subEntities())
     {
-        for (auto& e : sub.mEntities)
+        for (EntityType e : sub.entities())
         {
             bld.append("   ");
-            dumpEn(&e, sub.mTag, bld);
+            dumpEn(e, sub.mTag, bld);
             bld.append("\n");
         }
     }
@@ -255,17 +232,23 @@ void PlEntity::dbgDump(const char* label)
 
 void PlEntity::dump(const std::string& sp, ETag tg, base::StrBld& bld)
 {
-    bld.append(sp);
-    bld.append("_.");
-    dumpEn(this, tg, bld);
-    bld.appendc('\n');
-
-    for (auto& sub : mSubEntities)
+    for (PlEnWalk w(this, tg); w.next(); )
     {
-        for (auto& e : sub.mEntities)
+        // Past the cap the depth is printed instead, keeping very deep
+        // trees from producing quadratically sized dumps
+        bld.append(sp);
+        size_t depth = w.depth();
+        for (size_t i = 0; i < std::min<size_t>(depth, C_MAXDUMPINDENT); i++)
         {
-            e.dump(sp + " |", sub.mTag, bld);
+            bld.append(" |");
         }
+        if (depth > C_MAXDUMPINDENT)
+        {
+            bld.appendFmt("[%zu]", depth);
+        }
+        bld.append("_.");
+        dumpEn(w.cur(), w.tag(), bld);
+        bld.appendc('\n');
     }
 }
 
@@ -292,7 +275,7 @@ void PlEntity::dumpEn(EntityType en, ETag tg, base::StrBld& bld)
     if (en->mResolvedRef)
     {
         bld.appendFmt(" => {%s '%s' %llx}", sEKindMap.toString(en->mResolvedRef->mKind),
-            en->mResolvedRef->mToken.toString().c_str(),en-> mResolvedRef);
+            en->mResolvedRef->mToken.cstr(),en-> mResolvedRef);
     }
     en->dumpAttrib(bld);
 }
@@ -320,11 +303,11 @@ void PlEntity::toVar(base::Variant& var, bool pubonly)
 
     // Count subentities
     size_t subcnt = 0;
-    for (auto& sub : mSubEntities)
+    for (auto& sub : subEntities())
     {
-        for (auto& e : sub.mEntities)
+        for (EntityType e : sub.entities())
         {
-            if (pubonly && !e.isPublic())
+            if (pubonly && !e->isPublic())
             {
                 continue;
             }
@@ -354,19 +337,19 @@ void PlEntity::toVar(base::Variant& var, bool pubonly)
         base::Variant subentarr;
         subentarr.createArray();
         var.setProp(L_SUB, subentarr);
-        for (auto& sub : mSubEntities)
+        for (auto& sub : subEntities())
         {
             base::Variant subent;
             subent.createObject(L_ENTSINIT);
             subent.setProp(L_TAG, sETagMap.toString(sub.mTag));
-            for (auto& e : sub.mEntities)
+            for (EntityType e : sub.entities())
             {
-                if (pubonly && !e.isPublic())
+                if (pubonly && !e->isPublic())
                 {
                     continue;
                 }
                 base::Variant ent;
-                e.toVar(ent, false);
+                e->toVar(ent, false);
                 subent[L_ENTS].push(ent);
             }
             var[L_SUB].push(subent);
@@ -374,19 +357,77 @@ void PlEntity::toVar(base::Variant& var, bool pubonly)
     }
 }
 
+void PlEntity::write(base::PackWr& pwr, std::vector<uint32>& atomstrs)
+{
+    // IMPORTANT: Must match read()
+    pwr.wrUInt((uint32)mKind);
+    pwr.wrUInt((uint32)mDT);
+    pwr.wrUInt(mAttribFlags.value());
+
+    // Each token atom is added to the string table once per file
+    uint32 atom = mToken.atom();
+    if (atom >= atomstrs.size())
+    {
+        atomstrs.resize(PlToken::atoms().count(), PlAtoms::NOATOM);
+    }
+    if (atomstrs[atom] == PlAtoms::NOATOM)
+    {
+        atomstrs[atom] = pwr.addStr(strparam(mToken.cstr(), mToken.length()));
+    }
+    pwr.wrStrId(atomstrs[atom]);
+    pwr.wrUInt((uint32)mToken.mFlags);
+    pwr.wrUInt((uint32)mToken.mBegLine);
+    pwr.wrUInt((uint32)mToken.mBegColumn);
+}
+
+bool PlEntity::readHeader(base::PackRd& prd, std::vector<uint32>& stratoms)
+{
+    // IMPORTANT: Must match write()
+    mKind = (EKind)prd.rdUInt();
+    mDT = (DataType)prd.rdUInt();
+    mAttribFlags.setValue(prd.rdUInt());
+
+    // Each string table entry is interned once per file
+    uint32 sid = prd.rdStrId();
+    if (stratoms[sid] == PlAtoms::NOATOM)
+    {
+        stratoms[sid] = PlToken::atoms().intern(prd.str(sid));
+    }
+    mToken.setAtom(stratoms[sid]);
+    mToken.mFlags = (int32_t)prd.rdUInt();
+    mToken.mBegLine = (int32_t)prd.rdUInt();
+    mToken.mBegColumn = (int32_t)prd.rdUInt();
+    return !prd.inErr();
+}
+
+EntityType PlEntity::read(EntityType parent, base::PackRd& prd, ETag etag, PlArena* arena, std::vector<uint32>& stratoms)
+{
+    EntityType en = nullptr;
+
+    PlEntity hdr;
+    if (hdr.readHeader(prd, stratoms))
+    {
+        en = parent ? PlEntity::newEntity(parent, hdr.mKind, hdr.mToken, etag) : PlEntity::newRoot(arena, hdr.mKind, hdr.mToken);
+        en->mAttribFlags = hdr.mAttribFlags;
+        en->mDT = hdr.mDT;
+    }
+
+    return en;
+}
+
 void PlEntity::write(base::PersistWr& pwr)
 {
     // IMPORTANT: Must match read()
     pwr.wrUInt32((uint32)mKind);
     pwr.wrUInt32((uint32)mDT);
     pwr.wrUInt64(mAttribFlags.value());
-    pwr.wrStr(mToken.toString().c_str());
+    pwr.wrStr(mToken.cstr());
     pwr.wrUInt32((uint32)mToken.mFlags);
     pwr.wrUInt32((uint32)mToken.mBegLine);
     pwr.wrUInt32((uint32)mToken.mBegColumn);
 }
 
-EntityType PlEntity::read(EntityType parent, base::PersistRd& prd, ETag etag)
+EntityType PlEntity::read(EntityType parent, base::PersistRd& prd, ETag etag, PlArena* arena)
 {
     EntityType en = nullptr;
 
@@ -403,8 +444,8 @@ EntityType PlEntity::read(EntityType parent, base::PersistRd& prd, ETag etag)
 
     if (!prd.inErr())
     {
-        // Create the entity
-        en = PlEntity::newEntity(parent, kind, tok, etag);
+        // Create the entity, a root needs the arena to allocate from
+        en = parent ? PlEntity::newEntity(parent, kind, tok, etag) : PlEntity::newRoot(arena, kind, tok);
         en->mAttribFlags = attrib;
         en->mDT = dt;
     }
@@ -412,25 +453,181 @@ EntityType PlEntity::read(EntityType parent, base::PersistRd& prd, ETag etag)
     return en;
 }
 
+void PlEntity::saveEntity(base::PackWr& pwr)
+{
+    PlAstWriter astwr(this, pwr);
+    astwr.finish();
+}
+
+void PlEntity::saveSpine(base::PackWr& pwr, std::vector<uint32>& atomstrs, std::vector<std::pair<EntityType, size_t>>& decls)
+{
+    // IMPORTANT: Must match PlLazyAst::readSpine
+    // File roots are written in full, anything else gets an entry pointing at
+    // where it is written
+    write(pwr, atomstrs);
+
+    pwr.wrUInt(mSubCount);
+    for (auto& sub : subEntities())
+    {
+        pwr.wrUInt((uint)sub.mTag);
+        pwr.wrUInt(sub.mCount);
+        for (EntityType e : sub.entities())
+        {
+            bool spine = (e->mKind == EKind::FileRoot);
+            pwr.wrBool(spine);
+            if (spine)
+            {
+                e->saveSpine(pwr, atomstrs, decls);
+            }
+            else
+            {
+                pwr.wrUInt((uint)e->mKind);
+                pwr.wrUInt(e->nodeCount());
+                decls.emplace_back(e, pwr.wrFixed32(0));
+            }
+        }
+    }
+}
+
+uint32 PlEntity::nodeCount()
+{
+    uint32 cnt = 0;
+    for (PlEnWalk w(this); w.next(); )
+    {
+        cnt++;
+    }
+    return cnt;
+}
+
+void PlEntity::savePacked(base::PackWr& pwr, std::vector<uint32>& atomstrs)
+{
+    // IMPORTANT: Must match PlLazyAst::loadNode
+    for (PlEnWalk w(this); w.next(); )
+    {
+        // A tag and its count go ahead of its first child, appendChild()
+        // never leaves a tag without children
+        if (w.depth() > 0 && w.childIndex() == 0)
+        {
+            const SubEntity& sub = w.parent()->subEntities()[w.subIndex()];
+            pwr.wrUInt((uint)sub.mTag);
+            pwr.wrUInt(sub.mCount);
+        }
+        w.cur()->write(pwr, atomstrs);
+        pwr.wrUInt(w.cur()->mSubCount);
+    }
+}
+
 void PlEntity::saveEntity(base::PersistWr& pwr)
 {
-    // IMPORTANT: Must match PlFileState::loadEntity
-    // Persist the entity
+    // IMPORTANT: Must match PlEntity::loadEntity(PersistRd)
+    // Each entity is followed by an array of tags, each with an array of
+    // entities.  The stack holds the open arrays of the entities being saved.
+    struct Frame
+    {
+        EntityType mEn;
+        uint32 mSub;
+        uint32 mChild;
+        size_t mSubArr;
+        size_t mEntArr;
+    };
+    std::vector<Frame> stack;
+
     write(pwr);
+    stack.push_back(Frame{this, 0, 0, pwr.wrArr(), 0});
+    while (!stack.empty())
+    {
+        Frame& f = stack.back();
+        if (f.mSub == f.mEn->mSubCount)
+        {
+            stack.pop_back();
+            if (!stack.empty())
+            {
+                pwr.endElem(stack.back().mEntArr);
+            }
+            continue;
+        }
+
+        SubEntity& sub = f.mEn->mSubs[f.mSub];
+        if (f.mChild == 0)
+        {
+            pwr.wrUInt32((uint)sub.mTag);
+            f.mEntArr = pwr.wrArr();
+        }
+        if (f.mChild < sub.mCount)
+        {
+            EntityType e = sub.mEnts[f.mChild++];
+            e->write(pwr);
+            stack.push_back(Frame{e, 0, 0, pwr.wrArr(), 0});
+            continue;
+        }
+        pwr.endElem(f.mSubArr);
+        f.mSub++;
+        f.mChild = 0;
+    }
+}
+
+EntityType PlEntity::loadEntity(base::PersistRd& prd, PlArena* arena, EntityType parent, ETag etag)
+{
+    // IMPORTANT: Must match PlEntity::saveEntity(PersistWr)
+    struct Frame
+    {
+        EntityType mEn;
+        uint32 mSubs;
+        uint32 mLeft;
+        ETag mTag;
+        bool mInSub;
+    };
+    std::vector<Frame> stack;
 
-    auto subentarr = pwr.wrArr();
-    for (auto& sub : mSubEntities)
+    EntityType en = PlEntity::read(parent, prd, etag, arena);
+    if (!en)
+    {
+        dbgerr("loadEntity() failed to create and read entity\n");
+        return nullptr;
+    }
+    stack.push_back(Frame{en, prd.rdArr(), 0, ETag::Primary, false});
+    while (!stack.empty())
     {
-        pwr.wrUInt32((uint)sub.mTag);
+        Frame& f = stack.back();
+        if (!f.mInSub)
+        {
+            if (f.mSubs == 0)
+            {
+                // Done with this entity, and with its element in the parent
+                stack.pop_back();
+                if (!stack.empty())
+                {
+                    prd.endElem();
+                }
+                continue;
+            }
+            if (prd.inErr())
+            {
+                return nullptr;
+            }
+            f.mSubs--;
+            f.mTag = (ETag)prd.rdUInt32();
+            f.mLeft = prd.rdArr();
+            f.mInSub = true;
+        }
+        if (f.mLeft == 0)
+        {
+            prd.endElem();
+            f.mInSub = false;
+            continue;
+        }
 
-        auto entarr = pwr.wrArr();
-        for (auto& e : sub.mEntities)
+        f.mLeft--;
+        EntityType e = PlEntity::read(f.mEn, prd, f.mTag, arena);
+        if (!e)
         {
-            e.saveEntity(pwr);
-            pwr.endElem(entarr);
+            dbgerr("loadEntity() failed to create and read entity\n");
+            return nullptr;
         }
-        pwr.endElem(subentarr);
+        stack.push_back(Frame{e, prd.rdArr(), 0, ETag::Primary, false});
     }
+
+    return en;
 }
 
 EntityType PlEntity::cloneEntity(EntityType fromen, EntityType parent, ETag tg)
@@ -443,11 +640,11 @@ EntityType PlEntity::cloneEntity(EntityType fromen, EntityType parent, ETag tg)
     en->mResolvedRef = fromen->mResolvedRef;
 
     // Clone subentities
-    for (auto& sub : fromen->mSubEntities)
+    for (auto& sub : fromen->subEntities())
     {
-        for (auto& e : sub.mEntities)
+        for (EntityType e : sub.entities())
         {
-            cloneEntity(&e, en, sub.mTag);
+            cloneEntity(e, en, sub.mTag);
         }
     }
 
@@ -465,9 +662,9 @@ void PlEntity::gatherPubs(EntityType parent, ETag tg, bool nonpub, PlErrs& errs)
     en->mAttribFlags = mAttribFlags;
     en->mDT = mDT;
 
-    for (auto& sub : mSubEntities)
+    for (auto& sub : subEntities())
     {
-        for (auto& e : sub.mEntities)
+        for (EntityType e : sub.entities())
         {
             bool neednonpub = nonpub ||
                 (mKind == EKind::FuncMapping) ||
@@ -475,19 +672,18 @@ void PlEntity::gatherPubs(EntityType parent, ETag tg, bool nonpub, PlErrs& errs)
                 (mKind == EKind::Interf) ||
                 (mKind == EKind::CppDirec);
 
-            e.gatherPubs(en, sub.mTag, neednonpub, errs);
+            e->gatherPubs(en, sub.mTag, neednonpub, errs);
         }
     }
 }
 
 EntityType PlEntity::createResol(EntityType resolref, const char* tokstr, ETag tg)
 {
-    auto arr = getChildren(EKind::Resol, tg);
-    for (size_t i = 0; i < arr.count(); i++)
+    for (EntityType e : getChildren(EKind::Resol, tg))
     {
-        if (arr.get(i)->mResolvedRef == resolref)
+        if (e->mResolvedRef == resolref)
         {
-            return arr.get(i);
+            return e;
         }
     }
 
@@ -503,20 +699,525 @@ EntityType PlEntity::createResol(EntityType resolref, const char* tokstr, ETag t
 
 void PlEntity::updateSymTbl(ETag tg, PlSymbolTable* symtable, PlUnit* unit)
 {
-    PlSymbolAg symag(false, symtable, unit);
-
+    // One scope per entity on the path from here, popped as subtrees finish
+    std::deque<PlSymbolAg> scopes;
     std::string ss;
-    if (hasAttrib(EAttribFlags::a_symbol))
+    for (PlEnWalk w(this, tg); w.next(); )
     {
-        ss = PlSymbolAg::getSymName(this);
+        while (scopes.size() > w.depth())
+        {
+            scopes.pop_back();
+        }
+
+        EntityType en = w.cur();
+        ss.clear();
+        if (symtable->isSymbol(en))
+        {
+            ss = PlSymbolAg::getSymName(en);
+        }
+        scopes.emplace_back(false, symtable, unit).process(en, ss.c_str());
+    }
+    while (!scopes.empty())
+    {
+        scopes.pop_back();
     }
-    symag.process(this, ss.c_str());
-    for (auto& sub : mSubEntities)
+}
+
+
+// PlEnWalk::
+
+bool PlEnWalk::next()
+{
+    if (!mStarted)
     {
-        for (auto& e : sub.mEntities)
+        mStarted = true;
+        if (mRoot)
         {
-            e.updateSymTbl(sub.mTag, symtable, unit);
+            mStack.push_back(Frame{mRoot, 0, 0, nullptr});
         }
+        return mRoot != nullptr;
     }
+
+    // Go down to the first unvisited child, walking up as subtrees finish
+    while (!mStack.empty())
+    {
+        Frame& f = mStack.back();
+        PlSpan<PlEntity::SubEntity> subs = f.mEn->subEntities();
+        while (f.mSub < subs.count() && f.mChild == subs[f.mSub].mCount)
+        {
+            f.mSub++;
+            f.mChild = 0;
+        }
+        if (f.mSub < subs.count())
+        {
+            const PlEntity::SubEntity& sub = subs[f.mSub];
+            EntityType en = sub.mEnts[f.mChild];
+            mTag = sub.mTag;
+            mPrev = f.mLast;
+            mSub = f.mSub;
+            mChild = f.mChild;
+            f.mLast = en;
+            f.mChild++;
+            mStack.push_back(Frame{en, 0, 0, nullptr});
+            return true;
+        }
+        mStack.pop_back();
+    }
+    return false;
 }
 
+// PlAstWriter::
+
+PlAstWriter::PlAstWriter(EntityType root, base::PackWr& pwr) :
+    mRoot(root),
+    mWr(pwr),
+    mNext(0),
+    mAtomStrs(PlToken::atoms().count(), PlAtoms::NOATOM)
+{
+    // IMPORTANT: Must match PlLazyAst::readIndex
+    // Layout: position of the symbol log, the file roots with an entry per
+    // declaration under them, the declarations, and the symbol log
+    mLogSlot = mWr.wrFixed32(0);
+    mRoot->saveSpine(mWr, mAtomStrs, mDecls);
+}
+
+void PlAstWriter::saveDecl(EntityType en)
+{
+    // Declarations go out in spine order, so writing one also writes any
+    // skipped ahead of it.  Anything not in the spine is left to finish()
+    for (size_t i = mNext; i < mDecls.size(); i++)
+    {
+        if (mDecls[i].first != en)
+        {
+            continue;
+        }
+        for (; mNext <= i; mNext++)
+        {
+            auto& d = mDecls[mNext];
+            mWr.patchFixed32(d.second, (uint32)mWr.length());
+            d.first->savePacked(mWr, mAtomStrs);
+        }
+        break;
+    }
+}
+
+void PlAstWriter::finish()
+{
+    if (mNext < mDecls.size())
+    {
+        saveDecl(mDecls.back().first);
+    }
+
+    // Record what registering this AST does to a symbol table, with entities
+    // written as their preorder index in the file
+    PlSymLog log;
+    PlSymbolTable rec;
+    rec.setRecord(&log);
+    mRoot->updateSymTbl(ETag::Primary, &rec, nullptr);
+
+    std::unordered_map<EntityType, uint32> preidx;
+    for (PlEnWalk w(mRoot); w.next(); )
+    {
+        preidx.emplace(w.cur(), (uint32)preidx.size());
+    }
+
+    mWr.patchFixed32(mLogSlot, (uint32)mWr.length());
+    mWr.wrUInt(log.mEvents.size());
+    for (auto& ev : log.mEvents)
+    {
+        mWr.wrUInt((uint)ev.mOp);
+        switch (ev.mOp)
+        {
+            case PlSymLog::Op::Push:
+                mWr.wrStr(ev.mName);
+                break;
+
+            case PlSymLog::Op::Add:
+                mWr.wrStr(ev.mName);
+                mWr.wrUInt(preidx[ev.mEn]);
+                mWr.wrUInt((uint)ev.mEn->mKind);
+                break;
+
+            case PlSymLog::Op::SymScope:
+                mWr.wrUInt(preidx[ev.mEn]);
+                mWr.wrStr(ev.mName);
+                break;
+
+            default:
+                break;
+        }
+    }
+}
+
+
+// PlLazyAst::
+
+bool PlLazyAst::load(const base::Path& fn, PlArena* arena)
+{
+    mArena = arena;
+    return mRd.load(fn) && readIndex();
+}
+
+bool PlLazyAst::load(base::Buffer& buf, PlArena* arena)
+{
+    mArena = arena;
+    return mRd.load(buf) && readIndex();
+}
+
+bool PlLazyAst::readIndex()
+{
+    // IMPORTANT: Must match PlAstWriter
+    mStrAtoms.assign(mRd.strCount(), PlAtoms::NOATOM);
+    mLogPos = mRd.rdFixed32();
+
+    uint32 idx = 0;
+    mRoot = readSpine(nullptr, ETag::Primary, idx);
+    if (!mRoot || mRd.inErr())
+    {
+        dbgerr("Invalid AST index\n");
+        mRoot = nullptr;
+        return false;
+    }
+    return true;
+}
+
+EntityType PlLazyAst::readSpine(EntityType parent, ETag tg, uint32& idx)
+{
+    EntityType en = PlEntity::read(parent, mRd, tg, mArena, mStrAtoms);
+    if (!en)
+    {
+        return nullptr;
+    }
+    mNodes.emplace(idx++, en);
+
+    uint64 subcnt = mRd.rdUInt();
+    for (uint64 i = 0; i < subcnt; i++)
+    {
+        ETag tag = (ETag)mRd.rdUInt();
+        uint64 cnt = mRd.rdUInt();
+        for (uint64 j = 0; j < cnt && !mRd.inErr(); j++)
+        {
+            if (mRd.rdBool())
+            {
+                if (!readSpine(en, tag, idx))
+                {
+                    return nullptr;
+                }
+                continue;
+            }
+
+            // Declarations start out as stubs, only the kind is known
+            EKind kind = (EKind)mRd.rdUInt();
+            Decl& d = mDecls.emplace_back();
+            d.mFirst = idx;
+            d.mCount = (uint32)mRd.rdUInt();
+            d.mPos = mRd.rdFixed32();
+            d.mLoaded = false;
+            d.mHasSym = false;
+
+            EntityType stub = PlEntity::newEntity(en, kind, PlToken::sNilTok, tag);
+            stub->addAttrib(EAttribFlags::a_lazy);
+            d.mStubs.emplace_back(idx, stub);
+            mNodes.emplace(idx, stub);
+            idx += d.mCount;
+        }
+    }
+    return mRd.inErr() ? nullptr : en;
+}
+
+PlLazyAst::Decl* PlLazyAst::declOf(uint32 idx)
+{
+    // Declarations are in preorder, find the last one starting at or before idx
+    auto it = std::upper_bound(mDecls.begin(), mDecls.end(), idx, [](uint32 i, const Decl& d)
+    {
+        return i < d.mFirst;
+    });
+    if (it == mDecls.begin())
+    {
+        return nullptr;
+    }
+    --it;
+    return (idx < it->mFirst + it->mCount) ? &*it : nullptr;
+}
+
+EntityType PlLazyAst::stubAt(uint32 idx, EKind kind)
+{
+    auto it = mNodes.find(idx);
+    if (it != mNodes.end())
+    {
+        return it->second;
+    }
+
+    // Entities inside a declaration stay detached until it is loaded
+    Decl* d = declOf(idx);
+    if (!d || d->mLoaded)
+    {
+        return nullptr;
+    }
+    EntityType stub = PlEntity::newRoot(mArena, kind, PlToken::sNilTok);
+    stub->addAttrib(EAttribFlags::a_lazy);
+    d->mStubs.emplace_back(idx, stub);
+    mNodes.emplace(idx, stub);
+    return stub;
+}
+
+void PlLazyAst::addSymbols(PlSymbolTable* symtable, PlUnit* unit)
+{
+    // Replay the symbol log, this registers the same names, scopes and
+    // entities, in the same order, as updateSymTbl() on the loaded tree
+    if (!mRoot || !mRd.seek(mLogPos))
+    {
+        return;
+    }
+
+    uint64 cnt = mRd.rdUInt();
+    std::string name;
+    for (uint64 i = 0; i < cnt && !mRd.inErr(); i++)
+    {
+        switch ((PlSymLog::Op)mRd.rdUInt())
+        {
+            case PlSymLog::Op::Push:
+                name = mRd.rdStr();
+                symtable->pushScope(name.c_str());
+                break;
+
+            case PlSymLog::Op::Pop:
+                symtable->popScope();
+                break;
+
+            case PlSymLog::Op::Add:
+            {
+                name = mRd.rdStr();
+                uint32 idx = (uint32)mRd.rdUInt();
+                EntityType en = stubAt(idx, (EKind)mRd.rdUInt());
+                if (!en)
+                {
+                    mRd.setErr("Invalid symbol entity");
+                    break;
+                }
+                Decl* d = declOf(idx);
+                if (d)
+                {
+                    d->mHasSym = true;
+                }
+                symtable->addSymbol(name.c_str(), en, unit);
+            }
+            break;
+
+            case PlSymLog::Op::SymScope:
+            {
+                uint32 idx = (uint32)mRd.rdUInt();
+                name = mRd.rdStr();
+                Decl* d = declOf(idx);
+                auto it = mNodes.find(idx);
+                if (it == mNodes.end())
+                {
+                    mRd.setErr("Invalid symbol scope entity");
+                    break;
+                }
+                if (d)
+                {
+                    d->mSymScopes.emplace_back(it->second, name);
+                }
+                else
+                {
+                    it->second->createResol(nullptr, name.c_str(), ETag::SymScope);
+                }
+            }
+            break;
+        }
+    }
+
+    // Declarations nothing can look up, such as cpp directives, are loaded
+    // now, the rest when a lookup returns one of their stubs
+    for (uint32 i = 0; i < mDecls.size(); i++)
+    {
+        if (!mDecls[i].mHasSym)
+        {
+            loadDecl(i);
+            continue;
+        }
+        for (auto& st : mDecls[i].mStubs)
+        {
+            symtable->addLazy(st.second, this, i);
+        }
+    }
+}
+
+void PlLazyAst::loadAll()
+{
+    for (uint32 i = 0; i < mDecls.size(); i++)
+    {
+        loadDecl(i);
+    }
+}
+
+void PlLazyAst::loadDecl(uint32 decl)
+{
+    Decl& d = mDecls[decl];
+    if (d.mLoaded)
+    {
+        return;
+    }
+    d.mLoaded = true;
+
+    std::sort(d.mStubs.begin(), d.mStubs.end());
+    uint32 idx = d.mFirst;
+    size_t stub = 0;
+    if (!mRd.seek(d.mPos) || !loadNode(nullptr, ETag::Primary, d, idx, stub))
+    {
+        dbgerr("Failed to load AST declaration\n");
+        return;
+    }
+
+    // Symbol scopes are created after the children, as updateSymTbl() does
+    for (auto& ss : d.mSymScopes)
+    {
+        ss.first->createResol(nullptr, ss.second.c_str(), ETag::SymScope);
+    }
+    mLoaded.push_back(d.mStubs[0].second);
+}
+
+EntityType PlLazyAst::loadNode(EntityType parent, ETag tg, Decl& decl, uint32& idx, size_t& stub)
+{
+    // IMPORTANT: Must match PlEntity::savePacked
+    struct Frame
+    {
+        EntityType mEn;
+        uint64 mSubs;
+        uint64 mLeft;
+        ETag mTag;
+    };
+    std::vector<Frame> stack;
+
+    EntityType top = readNode(parent, tg, decl, idx, stub);
+    if (!top)
+    {
+        return nullptr;
+    }
+    stack.push_back(Frame{top, mRd.rdUInt(), 0, ETag::Primary});
+    while (!stack.empty())
+    {
+        Frame& f = stack.back();
+        if (f.mLeft == 0)
+        {
+            if (f.mSubs == 0)
+            {
+                stack.pop_back();
+                continue;
+            }
+            f.mSubs--;
+            f.mTag = (ETag)mRd.rdUInt();
+            f.mLeft = mRd.rdUInt();
+            if (mRd.inErr())
+            {
+                return nullptr;
+            }
+            continue;
+        }
+
+        f.mLeft--;
+        EntityType en = readNode(f.mEn, f.mTag, decl, idx, stub);
+        if (!en)
+        {
+            return nullptr;
+        }
+        stack.push_back(Frame{en, mRd.rdUInt(), 0, ETag::Primary});
+    }
+    return top;
+}
+
+EntityType PlLazyAst::readNode(EntityType parent, ETag tg, Decl& decl, uint32& idx, size_t& stub)
+{
+    EntityType en = nullptr;
+    if (stub < decl.mStubs.size() && decl.mStubs[stub].first == idx)
+    {
+        // Fill in the stub, keeping what the symbol table set on it
+        en = decl.mStubs[stub++].second;
+        uint64 keep = en->mAttribFlags.value() & EAttribFlags::a_symbol;
+        if (!en->readHeader(mRd, mStrAtoms))
+        {
+            return nullptr;
+        }
+        en->mAttribFlags.setValue(en->mAttribFlags.value() | keep);
+        if (parent)
+        {
+            parent->appendChild(en, tg);
+        }
+    }
+    else
+    {
+        en = PlEntity::read(parent, mRd, tg, mArena, mStrAtoms);
+        if (!en)
+        {
+            return nullptr;
+        }
+    }
+    idx++;
+    return en;
+}
+
+bool PlLazyAst::takeLoaded(std::vector<EntityType>& ens)
+{
+    ens.clear();
+    ens.swap(mLoaded);
+    return !ens.empty();
+}
+
+
+// PlArena::
+
+EntityType PlArena::allocEntity()
+{
+    if (!mSlabs || mSlabs->mUsed == SLABENTS)
+    {
+        Slab* slab = (Slab*)malloc(sizeof(Slab));
+        slab->mNext = mSlabs;
+        slab->mUsed = 0;
+        mSlabs = slab;
+    }
+    void* p = mSlabs->mEnts + (mSlabs->mUsed++ * sizeof(PlEntity));
+    return new (p) PlEntity();
+}
+
+void* PlArena::alloc(size_t size)
+{
+    size = (size + 7) & ~(size_t)7;
+    if (!mBlocks || mBlockUsed + size > mBlockSize)
+    {
+        // Oversized requests get a block of their own
+        size_t bsize = size > BLOCKSIZE / 4 ? size : BLOCKSIZE;
+        Block* block = (Block*)malloc(sizeof(Block) + bsize);
+        block->mNext = mBlocks;
+        mBlocks = block;
+        mBlockUsed = 0;
+        mBlockSize = bsize;
+    }
+    void* p = (char*)(mBlocks + 1) + mBlockUsed;
+    mBlockUsed += size;
+    return p;
+}
+
+void PlArena::release()
+{
+    while (mSlabs)
+    {
+        // Tokens may own heap storage, so entities still need their destructor
+        Slab* next = mSlabs->mNext;
+        PlEntity* ents = (PlEntity*)mSlabs->mEnts;
+        for (size_t i = 0; i < mSlabs->mUsed; i++)
+        {
+            ents[i].~PlEntity();
+        }
+        free(mSlabs);
+        mSlabs = next;
+    }
+    while (mBlocks)
+    {
+        Block* next = mBlocks->mNext;
+        free(mBlocks);
+        mBlocks = next;
+    }
+    mBlockUsed = 0;
+    mBlockSize = 0;
+}
@@ -44,6 +44,9 @@ constDef L_UNITEXT = "ext";
 constDef L_UNITEXTPATH = "path";
 constDef L_UNITEXTINCPATH = "includedir";
 constDef L_UNITEXTLIB = "lib";
+constDef L_UNITBUILD = "build";
+constDef L_UNITUNITY = "unity";
+constDef L_UNITPCH = "pch";
 constDef L_DEPNAMESPACE = "namespace";
 constDef L_GLOBALNAMESPACE = "global";
 
@@ -57,10 +60,15 @@ constDef L_DIAGDIR = "diag";
 constDef L_BUILDDIR = "build";
 constDef L_OUTDIR = "out";
 constDef L_ASTDIR = "ast";
+constDef L_OBJDIR = "obj";
+constDef L_LIBDIR = "lib";
+constDef L_NINJAFN = "build.ninja";
+constDef L_PROFILEFN = "profile.json";
 constDef L_UNITWIDESCOPE = "unitwide";
 constDef L_UNITDEPSSCOPE = "deps";
 constDef L_ENTITYFILESIG = "AST";
 constDef L_ENTFILEEXT = "ast";
+constDef C_ENTFILEVER = 3;
 constDef L_PRIMALEXT = "pc";
 constDef L_DIAFILEEXT = "log";
 constDef L_CPPEXT = "cpp";
@@ -79,4 +87,5 @@ constDef L_TOK = "tok";
 constDef L_MAIN = "main";
 
 constDef C_INDENT = 4;
-constDef C_MAXIDENTSCOPE = 8;
\ No newline at end of file
+constDef C_MAXIDENTSCOPE = 8;
+constDef C_MAXDUMPINDENT = 128;
\ No newline at end of file
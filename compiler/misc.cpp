@@ -5,57 +5,68 @@ PlConfig sConfig;
 PlCppProp sCppProp;
 bool sVerbose = false;
 
-int plLogShell(const std::string& cmd, base::Buffer& log, base::Buffer& errlog)
+// Picks the error and warning lines out of a process's output as they
+// arrive, along with the lines that follow them
+class PlErrFilter
 {
-    constDef EXTRALINES = 2;
-    int ret = 0;
+public:
+    constMemb EXTRALINES = 2;
 
-    base::Path tempfn;
-    base::getTempFilename(tempfn);
+    base::StrBld mErrs;
 
-    ret = base::shellCmd(cmd, false, &tempfn);
-
-    // read the log buffer from temp file
-    base::Buffer buf;
-    if (buf.readFile(tempfn, false))
+    static void onLine(void* ctx, const char* line, size_t len)
     {
-        // Parse out error messages from log buffer
-        base::StrBld errs;
-        base::Splitter sp(buf, '\n');
-        sp.ignore('\r');
-        while (!sp.eof())
+        PlErrFilter* f = (PlErrFilter*)ctx;
+        std::string_view sv(line, len);
+        if (sv.find("error:") != std::string_view::npos || sv.find("warning:") != std::string_view::npos)
         {
-            size_t l;
-            const char* s = sp.get(&l);
-            if (strstr(s, "error:") || strstr(s, "warning:"))
-            {
-                errs.append(s, l);
-                errs.appendc('\n');
-                for (int i = 0; i < EXTRALINES; i++)
-                {
-                    if (!sp.eof())
-                    {
-                        s = sp.get(&l);
-                        errs.append(s, l);
-                        errs.appendc('\n');
-                    }
-                }
-            }
+            f->mExtra = EXTRALINES;
+        }
+        else if (f->mExtra > 0)
+        {
+            f->mExtra--;
         }
+        else
+        {
+            return;
+        }
+        fprintf(stderr, "%s%.*s\n%s", ESC_RED, (int)len, line, ESC_DEFAULT);
+        f->mErrs.append(line, len);
+        f->mErrs.appendc('\n');
+    }
 
-        // Print the error strings
-        fprintf(stderr, "%s%s%s", ESC_RED, errs.c_str(), ESC_DEFAULT);
+private:
+    int mExtra = 0;
+};
 
-        // Append the full log to the log buffer for accumulation
-        log.appendFrom(buf);
+bool plLogRun(const std::vector<PlCmd>& cmds, base::Buffer& log, base::Buffer& errlog)
+{
+    // Runs them all at once, printing errors as they come
+    std::vector<base::Process> procs(cmds.size());
+    std::vector<base::Process*> procptrs;
+    std::vector<PlErrFilter> filters(cmds.size());
+    for (size_t i = 0; i < cmds.size(); i++)
+    {
+        procs[i].setLineFunc(PlErrFilter::onLine, &filters[i]);
+        if (!procs[i].start(cmds[i].args, cmds[i].dir.empty() ? nullptr : &cmds[i].dir))
+        {
+            filters[i].mErrs.appendFmt("Failed to run '%s'\n", cmds[i].args[0].c_str());
+        }
+        procptrs.push_back(&procs[i]);
+    }
+    bool ret = base::waitProcesses(procptrs.data(), procptrs.size());
 
-        // Append the found errors strings to the error log
-        errs.moveToBuffer(buf);
+    // Each one's full output is appended to the log, the found errors to the
+    // error log
+    base::Buffer buf;
+    for (size_t i = 0; i < cmds.size(); i++)
+    {
+        procs[i].output().moveToBuffer(buf);
+        log.appendFrom(buf);
+        filters[i].mErrs.moveToBuffer(buf);
         errlog.appendFrom(buf);
     }
 
-    base::deleteFile(tempfn);
-
     return ret;
 }
 
@@ -144,6 +155,31 @@ bool plWrite(const char* content, const base::Buffer& buf, const base::Path fn,
     return ret;
 }
 
+bool plWrite(const char* content, const base::StrRope& rope, const base::Path fn, bool onlywhendiff)
+{
+    // Same as the Buffer version, but the rope is compared and written a
+    // segment at a time, it is never flattened
+    bool shouldwr = !(onlywhendiff && rope.equalsFile(fn));
+
+    if (isFlagSet(base::sBaseGFlags, base::GFLAG_VERBOSE_FILESYS))
+    {
+        if (shouldwr)
+        {
+            dbglog("Writing '%s' to file %s\n", content, fn.c_str());
+        }
+        else
+        {
+            dbglog("'%s' hasn't changed. Not updating file %s\n", content, fn.c_str());
+        }
+    }
+    bool ret = shouldwr;
+    if (shouldwr)
+    {
+        ret = rope.writeFile(fn);
+    }
+    return ret;
+}
+
 bool plRead(const char* content, base::Buffer& buf, const base::Path fn, bool nullterm)
 {
     if (isFlagSet(base::sBaseGFlags, base::GFLAG_VERBOSE_FILESYS))
@@ -154,7 +190,7 @@ bool plRead(const char* content, base::Buffer& buf, const base::Path fn, bool nu
 }
 
 
-bool plIsIdent(strparam str)
+static bool isIdentChars(strparam str)
 {
     const char* s = str.data();
     size_t len = str.length();
@@ -176,8 +212,13 @@ bool plIsIdent(strparam str)
         }
     }
     // TODO: disallow __ if it becomes reserved
+    return true;
+}
+
+bool plIsIdent(strparam str)
+{
     // Check it is not a language keyword
-    return !sKeywordMap.exists(str);
+    return isIdentChars(str) && !PlToken::isKeywordAtom(PlToken::atoms().find(str));
 }
 
 
@@ -188,6 +229,8 @@ PlCppProp::PlCppProp()
 
     // Set defaults
     setStr(CppPropType::unitwidehdrfn, "unitwide.h");
+    setStr(CppPropType::unitpchhdrfn, "unitpch.h");
+    setStr(CppPropType::unityprefix, "unity_");
 }
 
 std::string PlCppProp::getStr(CppPropType keyenum)
@@ -481,11 +524,26 @@ bool PlDiscern::isCompoundIdent(strparam str)
     return ret;
 }
 
+bool PlDiscern::isKeyword(strparam str)
+{
+    return PlToken::isKeywordAtom(PlToken::atoms().find(str));
+}
+
+bool PlDiscern::isKeyword(const PlToken& tok)
+{
+    return tok.isKeyword();
+}
+
 bool PlDiscern::isSimpleIdent(strparam str)
 {
     return plIsIdent(str);
 }
 
+bool PlDiscern::isSimpleIdent(const PlToken& tok)
+{
+    return !tok.isKeyword() && isIdentChars(strparam(tok.cstr(), tok.length()));
+}
+
 bool PlDiscern::isNumPart(const std::string& s)
 {
     // Allows _, E, e u, i, f, and hex digits inside number parts
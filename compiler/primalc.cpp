@@ -17,6 +17,7 @@ int main(int argc, char **argv)
             {' ', "relwithdeb"},
             {' ', "savetemps"},
             {' ', "nogit"},
+            {' ', "profile"},
             {'?', "help"}
         });
 
@@ -47,6 +48,7 @@ int main(int argc, char **argv)
             "    --checkdeps\n"
             "    --diagfiles\n"
             "    --savetemps\n"
+            "    --profile\n"
             "    --config <configfile>\n"
             "    -?, --help\n");
         return 1;
@@ -88,6 +90,7 @@ int main(int argc, char **argv)
         opts.cleanfirst = cmd.hasOption("cleanfirst");
         opts.cleanhard = cmd.hasOption("hard");
         opts.savetemps = cmd.hasOption("savetemps");
+        opts.profile = cmd.hasOption("profile");
 
         if (unitpath.empty())
         {
@@ -1,7 +1,10 @@
 #pragma once
 
 #include <list>
+#include <deque>
+#include <vector>
 #include <unordered_map>
+#include <unordered_set>
 #include <limits.h>
 #include "var.h"
 #include "cmdline.h"
@@ -14,7 +17,12 @@
 
 class PlUnit;
 class PlEntity;
+class PlToken;
+class PlEnRange;
+class PlArena;
 class PlSymbolTable;
+class PlLazyAst;
+class PlAstWriter;
 class PlCompState;
 class PlTypeInfo;
 
@@ -56,15 +64,46 @@ private:
 };
 
 
-class PlDiscern
+// Interns strings for the lifetime of a compilation.  Each distinct string
+// gets a dense, stable id and its storage never moves.
+class PlAtoms
 {
 public:
-    // isXXX functions
-    bool isKeyword(strparam str)
+    constMemb_(uint32) NOATOM = UINT32_MAX;
+
+    PlAtoms();
+    ~PlAtoms() = default;
+    NOCOPY(PlAtoms)
+
+    uint32 intern(strparam str);
+    uint32 find(strparam str) const;
+    strparam str(uint32 atom) const
     {
-        return sKeywordMap.exists(str);
+        return mStrs[atom];
     }
+    const char* cstr(uint32 atom) const
+    {
+        return mStrs[atom].c_str();
+    }
+    size_t count() const
+    {
+        return mStrs.size();
+    }
+
+private:
+    std::deque<std::string> mStrs;
+    std::unordered_map<strparam, uint32> mIds;
+};
+
+
+class PlDiscern
+{
+public:
+    // isXXX functions
+    bool isKeyword(strparam str);
+    bool isKeyword(const PlToken& tok);
     bool isSimpleIdent(strparam str);
+    bool isSimpleIdent(const PlToken& tok);
     bool isCompoundIdent(strparam str);
     bool isDigit(char c)
     {
@@ -109,6 +148,20 @@ class PlToken
 public:
     static PlToken sNilTok;
 
+    // Token strings are interned once per compilation.  Atom 0 is the empty
+    // string and atoms 1..KWCOUNT are the language keywords in Keyword order.
+    static PlAtoms& atoms();
+    constMemb_(uint32) KWFIRST = 1;
+    static uint32 kwAtom(Keyword kw)
+    {
+        return KWFIRST + (uint32)kw;
+    }
+    static bool isKeywordAtom(uint32 atom)
+    {
+        // NOATOM wraps to a large value and fails the range check too
+        return atom - KWFIRST < sKeywordMap.count();
+    }
+
     PlToken()
     {
         zero();
@@ -119,39 +172,60 @@ public:
     }
     void setStr(const char* str, size_t len)
     {
-        mStr.set(str, len);
+        setAtom(atoms().intern(strparam(str, len)));
     }
     void setStr(const char* str)
     {
-        mStr.set(str);
+        setStr(str, strlen(str));
+    }
+    void setAtom(uint32 atom)
+    {
+        strparam str = atoms().str(atom);
+        mStr = str.data();
+        mAtom = atom;
+        mLen = (uint32)str.length();
+    }
+    uint32 atom() const
+    {
+        return mAtom;
     }
     const size_t length() const
     {
-        return strlen(mStr.get());
+        return mLen;
     }
     const char* cstr() const
     {
-        return mStr.get();
+        return mStr;
     }
     std::string toString() const
     {
-        return std::string(mStr.get());
+        return std::string(mStr, mLen);
     }
     std::string strNoQuotes(bool allowsingle) const;
     bool isEmpty() const
     {
-        const char* s = mStr.get();
-        return s[0] == '\0';
+        return mLen == 0;
+    }
+    bool isKeyword() const
+    {
+        return isKeywordAtom(mAtom);
+    }
+    bool is(Keyword kw) const
+    {
+        return mAtom == kwAtom(kw);
+    }
+    bool equals(const PlToken& that) const
+    {
+        return mAtom == that.mAtom;
     }
     bool equals(const char* s) const
     {
         //dbglog("PrToken-Equals: %s %s\n", toString().c_str(), s);
-        return strcmp(s, mStr.get()) == 0;
+        return s[0] == mStr[0] && strcmp(s, mStr) == 0;
     }
     bool equals(char c) const
     {
-        const char* s = mStr.get();
-        return s[0] == c && s[1] == '\0';
+        return mLen == 1 && mStr[0] == c;
     }
     bool isComment() const
     {
@@ -172,13 +246,16 @@ public:
     int32_t mBegColumn;
 
 private:
-    typedef base::FixedStr<16> TokStr;
-
-    TokStr mStr;
+    // mStr points into the interner, so copying a token never allocates
+    const char* mStr;
+    uint32 mAtom;
+    uint32 mLen;
 
     void zero()
     {
-        mStr.clear();
+        mStr = "";
+        mAtom = 0;
+        mLen = 0;
         mFlags = 0;
         mBegLine = 0;
         mBegColumn = 0;
@@ -241,6 +318,10 @@ public:
         //dbglog("is %s %s?\n", token().toString().c_str(), tokstr);
         return token().equals(tokstr);
     }
+    bool is(Keyword kw)
+    {
+        return token().is(kw);
+    }
     bool isAtEOL()
     {
         return isFlagSet(token().mFlags, PlToken::FLAG_EOL);
@@ -258,6 +339,7 @@ public:
     void expectNL();
     // Matches the current token, if matches advances. Else error.
     bool advance(const char* tokstr);
+    bool advance(Keyword kw);
 
     // Entity
     EntityType createEn(EntityType parent, EKind ekind, ETag etag = ETag::Primary);
@@ -351,7 +433,7 @@ private:
 };
 
 
-class Code : public base::StrBld
+class Code : public base::StrRope
 {
 public:
     Code() :
@@ -360,6 +442,8 @@ public:
     {
     }
     void emit(std::string_view txt, bool autosp = true);
+    // For text that outlives the Code, the rope may keep a reference to it
+    void emitRef(std::string_view txt, bool autosp = true);
     void emitln(std::string_view txt)
     {
         emit(txt, false);
@@ -368,12 +452,13 @@ public:
     void emitFmt(const char* fmt, ...);
     void emit(CppKeyword kw)
     {
-        emit(sCppKeywordMap.toString(kw));
+        emitRef(sCppKeywordMap.toString(kw));
         sp();
     }
+    // Moves the contents of code over, leaving it empty
     void emit(Code& code)
     {
-        append(code);
+        splice(code);
     }
     void semiln()
     {
@@ -400,6 +485,8 @@ public:
     void braceClose(bool autonl);
 
 private:
+    void emitSep(std::string_view txt, bool autosp);
+
     bool mAtNL;
     size_t mIndent;
 };
@@ -463,6 +550,52 @@ private:
 };
 
 
+template <class T>
+class PlSpan
+{
+public:
+    // Non-owning view over contiguous storage, iterating never allocates
+    PlSpan() :
+        mPtr(nullptr),
+        mCount(0)
+    {
+    }
+    PlSpan(T* ptr, size_t count) :
+        mPtr(ptr),
+        mCount(count)
+    {
+    }
+    size_t count() const
+    {
+        return mCount;
+    }
+    bool empty() const
+    {
+        return mCount == 0;
+    }
+    T& operator[](size_t index) const
+    {
+        return mPtr[index];
+    }
+    T get(size_t index) const
+    {
+        return index < mCount ? mPtr[index] : T{0};
+    }
+    T* begin() const
+    {
+        return mPtr;
+    }
+    T* end() const
+    {
+        return mPtr + mCount;
+    }
+
+private:
+    T* mPtr;
+    size_t mCount;
+};
+
+
 class PlEntity
 {
 public:
@@ -478,12 +611,17 @@ public:
         mResolvedRef(nullptr),
         mUnit(nullptr),
         mKind(EKind::None),
-        mDT(DataType::d_none)
+        mDT(DataType::d_none),
+        mArena(nullptr),
+        mSubs(nullptr),
+        mSubCount(0),
+        mSubCap(0)
     {
     }
     ~PlEntity() = default;
     NOCOPY(PlEntity)
 
+    static EntityType newRoot(PlArena* arena, EKind ekind, const PlToken& tok);
     static EntityType newEntity(EntityType parent, EKind ekind, const PlToken& tok, ETag tg = ETag::Primary);
     static EntityType newOrFindEntity(EntityType parent, const char* tokstr, EKind ekind, ETag tg = ETag::Primary);
     static EntityType cloneEntity(EntityType fromen, EntityType parent, ETag tg = ETag::Primary);
@@ -524,8 +662,8 @@ public:
 
     EntityType getChild(ETag tg = ETag::Primary);
     EntityType getChild(EKind ek, ETag tg = ETag::Primary);
-    PlArr<EntityType> getChildren(ETag tg = ETag::Primary);
-    PlArr<EntityType> getChildren(EKind ek, ETag tg = ETag::Primary);
+    PlSpan<EntityType> getChildren(ETag tg = ETag::Primary);
+    PlEnRange getChildren(EKind ek, ETag tg = ETag::Primary);
     std::string getStrings(EKind ekind, ETag tg, std::string sep, size_t max = UINT_MAX);
 
     void addAttrib(EAttribFlags::etype attr)
@@ -540,10 +678,13 @@ public:
     {
         return hasAttrib(EAttribFlags::a_public);
     }
+    void saveEntity(base::PackWr& pwr);
     void saveEntity(base::PersistWr& pwr);
+    static EntityType loadEntity(base::PersistRd& prd, PlArena* arena, EntityType parent = nullptr, ETag etag = ETag::Primary);
     void gatherPubs(EntityType parent, ETag tg, bool nonpub, PlErrs& errs);
     EntityType createResol(EntityType resolref, const char* tokstr, ETag tg = ETag::Primary);
     void updateSymTbl(ETag tg, PlSymbolTable* symtable, PlUnit* unit);
+    uint32 nodeCount();
 
     void toVar(base::Variant& var, bool pubonly);
     void dump(const std::string& sp, ETag tg, base::StrBld& bld);
@@ -552,18 +693,255 @@ public:
 private:
 friend class PlFileState;
 friend class PlResolver;
+friend class PlLazyAst;
+friend class PlAstWriter;
+friend class PlEnWalk;
 
     void dumpAttrib(base::StrBld& bld);
+    void write(base::PackWr& pwr, std::vector<uint32>& atomstrs);
     void write(base::PersistWr& pwr);
-    static EntityType read(EntityType parent, base::PersistRd& prd, ETag etag);
+    bool readHeader(base::PackRd& prd, std::vector<uint32>& stratoms);
+    static EntityType read(EntityType parent, base::PackRd& prd, ETag etag, PlArena* arena, std::vector<uint32>& stratoms);
+    static EntityType read(EntityType parent, base::PersistRd& prd, ETag etag, PlArena* arena = nullptr);
+    void savePacked(base::PackWr& pwr, std::vector<uint32>& atomstrs);
+    void saveSpine(base::PackWr& pwr, std::vector<uint32>& atomstrs, std::vector<std::pair<EntityType, size_t>>& decls);
     static void dumpEn(EntityType en, ETag tg, base::StrBld& bld);
 
+    // Children are kept per tag in contiguous arrays carved from the arena
     struct SubEntity
     {
         ETag mTag;
-        std::list<PlEntity> mEntities;
+        uint32 mCount;
+        uint32 mCap;
+        EntityType* mEnts;
+
+        PlSpan<EntityType> entities() const
+        {
+            return PlSpan<EntityType>(mEnts, mCount);
+        }
+    };
+    PlSpan<SubEntity> subEntities() const
+    {
+        return PlSpan<SubEntity>(mSubs, mSubCount);
+    }
+    SubEntity* findSub(ETag tg);
+    void appendChild(EntityType en, ETag tg);
+
+    PlArena* mArena;
+    SubEntity* mSubs;
+    uint32 mSubCount;
+    uint32 mSubCap;
+};
+
+
+// Lazily filtered view of one tag's children by kind.  Nothing is copied, so
+// walking it never allocates.
+class PlEnRange
+{
+public:
+    class Iter
+    {
+    public:
+        Iter(EntityType* cur, EntityType* end, EKind ek) :
+            mCur(cur),
+            mEnd(end),
+            mKind(ek)
+        {
+            skip();
+        }
+        EntityType operator*() const
+        {
+            return *mCur;
+        }
+        Iter& operator++()
+        {
+            mCur++;
+            skip();
+            return *this;
+        }
+        bool operator!=(const Iter& that) const
+        {
+            return mCur != that.mCur;
+        }
+
+    private:
+        EntityType* mCur;
+        EntityType* mEnd;
+        EKind mKind;
+
+        void skip()
+        {
+            while (mCur != mEnd && (*mCur)->mKind != mKind)
+            {
+                mCur++;
+            }
+        }
+    };
+
+    PlEnRange(PlSpan<EntityType> span, EKind ek) :
+        mSpan(span),
+        mKind(ek)
+    {
+    }
+    Iter begin() const
+    {
+        return Iter(mSpan.begin(), mSpan.end(), mKind);
+    }
+    Iter end() const
+    {
+        return Iter(mSpan.end(), mSpan.end(), mKind);
+    }
+    bool empty() const
+    {
+        return !(begin() != end());
+    }
+    EntityType first() const
+    {
+        Iter it = begin();
+        return (it != end()) ? *it : nullptr;
+    }
+    EntityType get(size_t index) const
+    {
+        // Linear, use iteration when walking all of them
+        for (EntityType e : *this)
+        {
+            if (index-- == 0)
+            {
+                return e;
+            }
+        }
+        return nullptr;
+    }
+    size_t count() const
+    {
+        size_t cnt = 0;
+        for (Iter it = begin(); it != end(); ++it)
+        {
+            cnt++;
+        }
+        return cnt;
+    }
+
+private:
+    PlSpan<EntityType> mSpan;
+    EKind mKind;
+};
+
+
+// Preorder walk over an entity and everything under it, using an explicit
+// stack so deeply nested trees can't overflow the call stack.  Children are
+// read as the walk reaches them, so ones appended to an entity before its
+// children are visited are included.
+class PlEnWalk
+{
+public:
+    PlEnWalk(EntityType root, ETag tg = ETag::Primary) :
+        mRoot(root),
+        mTag(tg),
+        mPrev(nullptr),
+        mSub(0),
+        mChild(0),
+        mStarted(false)
+    {
+    }
+    NOCOPY(PlEnWalk)
+
+    // Moves to the next entity, false once all have been visited
+    bool next();
+
+    EntityType cur() const
+    {
+        return mStack.back().mEn;
+    }
+    EntityType parent() const
+    {
+        return mStack.size() > 1 ? mStack[mStack.size() - 2].mEn : nullptr;
+    }
+    ETag tag() const
+    {
+        return mTag;
+    }
+    // The sibling visited before this one under the same parent, any tag
+    EntityType prev() const
+    {
+        return mPrev;
+    }
+    // Root is at depth 0, subtrees deeper than the current entity are done
+    size_t depth() const
+    {
+        return mStack.size() - 1;
+    }
+    // Position of the current entity in its parent
+    uint32 subIndex() const
+    {
+        return mSub;
+    }
+    uint32 childIndex() const
+    {
+        return mChild;
+    }
+
+private:
+    struct Frame
+    {
+        EntityType mEn;
+        uint32 mSub;
+        uint32 mChild;
+        EntityType mLast;
+    };
+
+    EntityType mRoot;
+    ETag mTag;
+    EntityType mPrev;
+    uint32 mSub;
+    uint32 mChild;
+    bool mStarted;
+    std::vector<Frame> mStack;
+};
+
+
+// Per-file arena that owns an entity tree.  Entities are carved from fixed
+// slabs, child arrays from raw blocks, and the whole tree is freed by a single
+// release() rather than a recursive delete.
+class PlArena
+{
+public:
+    PlArena() :
+        mSlabs(nullptr),
+        mBlocks(nullptr),
+        mBlockUsed(0),
+        mBlockSize(0)
+    {
+    }
+    ~PlArena()
+    {
+        release();
+    }
+    NOCOPY(PlArena)
+
+    EntityType allocEntity();
+    void* alloc(size_t size);
+    void release();
+
+private:
+    constMemb_(size_t) SLABENTS = 256;
+    constMemb_(size_t) BLOCKSIZE = 64 * 1024;
+
+    struct Slab
+    {
+        Slab* mNext;
+        size_t mUsed;
+        alignas(PlEntity) char mEnts[SLABENTS * sizeof(PlEntity)];
+    };
+    struct Block
+    {
+        Block* mNext;
     };
-    std::list<SubEntity> mSubEntities;
+
+    Slab* mSlabs;
+    Block* mBlocks;
+    size_t mBlockUsed;
+    size_t mBlockSize;
 };
 
 
@@ -581,6 +959,7 @@ public:
         mUnit = unit;
     }
     void fixupAll(EntityType rentity);
+    void fixupAll(const std::vector<EntityType>& ens);
     void validateAll(EntityType rentity, ETag tg);
     void pushErr(EntityType en, const char* fmt, ...);
     PlTypeInfo getType(EntityType rentity);
@@ -599,8 +978,10 @@ friend class PlTypeInfo;
     void resoVarAssign(EntityType rentity, ETag tg, EntityType prev);
     void resoVarEval(EntityType rentity, ETag tg, EntityType prev);
 
-    void fixupPhase0(EntityType rentity, ETag tg, EntityType prev);
-    void fixupPhase1(EntityType rentity, ETag tg, EntityType prev);
+    void fixupPhase0(EntityType rentity, ETag tg);
+    void fixupPhase1(EntityType rentity, ETag tg);
+    void fixupEn1(EntityType rentity, ETag tg, EntityType prev);
+    void validateEn(EntityType rentity, ETag tg);
 
     void deterTemplArgs(EntityType templtypeen, std::string& typestr);
     EntityType deterIdent(EntityType symen, ETag tg, std::string& typectx, PlArr<EntityType>* allmatches = nullptr);
@@ -622,6 +1003,7 @@ public:
     std::string mName;
     DataType mDT;
     EntityType mTypeEn;
+    // The first template argument, the element type for an iter for
     std::string mTemplArg;
     bool mBoxed;
 
@@ -637,6 +1019,7 @@ public:
     bool fromSigCh(EntityType rentity);
     bool fromExpr(EntityType rentity);
     bool isCompat(const PlTypeInfo& that);
+    bool isNum();
     const char* name();
     void dump(base::StrBld& bld);
     void dbgDump(const char* label);
@@ -651,11 +1034,38 @@ private:
 };
 
 
+// Symbol table calls made while registering an AST.  Recorded when the AST
+// is saved, so a dependant unit can replay them without loading the entities.
+class PlSymLog
+{
+public:
+    enum class Op
+    {
+        Push,
+        Pop,
+        Add,
+        SymScope
+    };
+    struct Event
+    {
+        Op mOp;
+        std::string mName;
+        EntityType mEn;
+    };
+
+    std::vector<Event> mEvents;
+    // Stands in for a_symbol, the entities being recorded aren't modified
+    std::unordered_set<EntityType> mAdded;
+};
+
+
 class PlSymbolTable
 {
 public:
     PlSymbolTable() :
-        mSpew(false)
+        mSpew(false),
+        mScopeId(ScTable::NOSCOPE),
+        mLog(nullptr)
     {
     }
     ~PlSymbolTable() = default;
@@ -666,18 +1076,30 @@ public:
     void popScope();
     EntityType findSymbol(const char* symbol);
     EntityType findSymbol(const char* symbol, std::string* retsc, size_t* count);
-    EntityType findSymbolSc(std::string sc, const char* symbol, size_t* count);
-    PlArr<EntityType> findAll(std::string sc, const char* symol);
-    bool addSymbolSc(std::string sc, const char* symbol, EntityType entity, PlUnit* unit = nullptr);
+    EntityType findSymbolSc(strparam sc, const char* symbol, size_t* count);
+    PlArr<EntityType> findAll(strparam sc, const char* symol);
+    bool addSymbolSc(strparam sc, const char* symbol, EntityType entity, PlUnit* unit = nullptr);
     bool addSymbol(const char* symbol, EntityType entity, PlUnit* unit = nullptr);
+    void addSymScope(EntityType en, const std::string& sc);
+    bool isSymbol(EntityType en);
     void dumpSymbols(base::StrBld& bld);
+
+    // While recording, calls are logged and neither the table nor the
+    // entities are changed
+    void setRecord(PlSymLog* log)
+    {
+        mLog = log;
+    }
+    // Stubs of a lazily loaded AST, their declaration is loaded the first
+    // time a lookup returns one of them
+    void addLazy(EntityType en, PlLazyAst* ast, uint32 decl);
     void dbgDump();
     std::string scCur()
     {
         return mScope;
     }
 
-    static std::string scParent(std::string scope, std::string* child = nullptr);
+    static std::string scParent(strparam scope, std::string* child = nullptr);
     static void scAdd(std::string& scope, strparam child);
     static std::string scAtUnitwide(strparam id)
     {
@@ -691,22 +1113,76 @@ public:
     bool mSpew;
 
 private:
+    // Scopes form a tree of ids, and symbols are keyed by (scope id, symbol
+    // atom), so lookups and parent walks never build or compare strings.
     class ScTable
     {
     public:
-        bool createScopeSc(const std::string& sc);
-        bool createSymbolSc(std::string sc, const char* sym, EntityType en);
-        PlArr<EntityType> getAll(std::string sc, const char* sym);
-        EntityType getOne(std::string sc, const char* sym);
-        size_t count(std::string sc, const char* sym);
+        constMemb_(uint32) NOSCOPE = UINT32_MAX;
+
+        uint32 scopeId(strparam sc) const;
+        uint32 createScopeSc(strparam sc);
+        uint32 parentOf(uint32 scid) const
+        {
+            return mScopes[scid].mParent;
+        }
+        strparam scopeStr(uint32 scid) const
+        {
+            return mAtoms.str(mScopes[scid].mPath);
+        }
+        uint32 symId(strparam sym) const
+        {
+            return mAtoms.find(sym);
+        }
+        void createSymbolSc(uint32 scid, strparam sym, EntityType en);
+        PlArr<EntityType> getAll(uint32 scid, uint32 symid);
+        EntityType getOne(uint32 scid, uint32 symid, size_t* count);
         void dump(base::StrBld& bld);
 
     private:
-        std::multimap<std::string, EntityType> mTbl;
+        struct Scope
+        {
+            uint32 mPath;
+            uint32 mParent;
+        };
+        struct SymRow
+        {
+            EntityType mEn;
+            uint32 mNext;
+        };
+        struct SymHead
+        {
+            uint32 mFirst;
+            uint32 mLast;
+            uint32 mCount;
+        };
+        static uint64 symKey(uint32 scid, uint32 symid)
+        {
+            return ((uint64)scid << 32) | symid;
+        }
+
+        PlAtoms mAtoms;
+        std::vector<Scope> mScopes;
+        std::unordered_map<uint32, uint32> mScopeIds;
+        std::unordered_map<uint64, SymHead> mSyms;
+        std::vector<SymRow> mRows;
+    };
+
+    struct LazyRef
+    {
+        PlLazyAst* mAst;
+        uint32 mDecl;
     };
 
+    EntityType findSymbolId(uint32 scid, uint32 symid, const char* symbol, size_t* count);
+    bool addSymbolId(uint32 scid, const char* symbol, EntityType entity, PlUnit* unit);
+    void loadLazy(EntityType en);
+
     ScTable mTbl;
     std::string mScope;
+    uint32 mScopeId;
+    PlSymLog* mLog;
+    std::unordered_map<EntityType, LazyRef> mLazy;
 };
 
 
@@ -734,6 +1210,99 @@ private:
 };
 
 
+// Writes an AST in the format PlLazyAst reads.  The file roots go out when
+// constructed, after which the declarations under them can be written one at
+// a time as a caller walks them, finish() writes any that are left and the
+// symbol log.
+class PlAstWriter
+{
+public:
+    PlAstWriter(EntityType root, base::PackWr& pwr);
+    NOCOPY(PlAstWriter)
+
+    void saveDecl(EntityType en);
+    void finish();
+
+private:
+    EntityType mRoot;
+    base::PackWr& mWr;
+    size_t mLogSlot;
+    size_t mNext;
+    std::vector<uint32> mAtomStrs;
+    std::vector<std::pair<EntityType, size_t>> mDecls;
+};
+
+
+// Reads ASTs written by PlAstWriter.  The file roots come first with an
+// entry per declaration under them, so loading reads only those and leaves a
+// stub for each declaration.  Stubs carry a_lazy until their declaration is
+// loaded, either all at once by loadAll(), or on demand after addSymbols()
+// has replayed the symbol log into a symbol table.
+class PlLazyAst
+{
+public:
+    PlLazyAst() :
+        mRd(L_ENTITYFILESIG, C_ENTFILEVER),
+        mArena(nullptr),
+        mRoot(nullptr),
+        mLogPos(0)
+    {
+    }
+    ~PlLazyAst() = default;
+    NOCOPY(PlLazyAst)
+
+    bool load(const base::Path& fn, PlArena* arena);
+    bool load(base::Buffer& buf, PlArena* arena);
+    bool isLegacy() const
+    {
+        return mRd.isLegacy();
+    }
+    EntityType root()
+    {
+        return mRoot;
+    }
+    void addSymbols(PlSymbolTable* symtable, PlUnit* unit);
+    void loadAll();
+    void loadDecl(uint32 decl);
+    // Declarations loaded since the last call, in load order
+    bool takeLoaded(std::vector<EntityType>& ens);
+    size_t declCount() const
+    {
+        return mDecls.size();
+    }
+
+private:
+    struct Decl
+    {
+        uint32 mFirst;
+        uint32 mCount;
+        uint32 mPos;
+        bool mLoaded;
+        bool mHasSym;
+        // Stubs by preorder index within the file, the first one is the
+        // declaration itself
+        std::vector<std::pair<uint32, EntityType>> mStubs;
+        std::vector<std::pair<EntityType, std::string>> mSymScopes;
+    };
+
+    bool readIndex();
+    EntityType readSpine(EntityType parent, ETag tg, uint32& idx);
+    EntityType loadNode(EntityType parent, ETag tg, Decl& decl, uint32& idx, size_t& stub);
+    EntityType readNode(EntityType parent, ETag tg, Decl& decl, uint32& idx, size_t& stub);
+    EntityType stubAt(uint32 idx, EKind kind);
+    Decl* declOf(uint32 idx);
+
+    base::PackRd mRd;
+    PlArena* mArena;
+    EntityType mRoot;
+    size_t mLogPos;
+    std::vector<uint32> mStrAtoms;
+    std::vector<Decl> mDecls;
+    std::unordered_map<uint32, EntityType> mNodes;
+    std::vector<EntityType> mLoaded;
+};
+
+
 class PlFileState
 {
 public:
@@ -743,15 +1312,16 @@ public:
         mContainingUnit(nullptr),
         mEnRoot(nullptr),
         mDiag(false),
+        mIndexed(false),
         mDepEn(nullptr)
     {
     }
     NOCOPY(PlFileState)
     ~PlFileState()
     {
-        delete mEnRoot;
-        delete mDepEn;
+        // Entities are owned by mArena
         mEnRoot = nullptr;
+        mDepEn = nullptr;
     }
     void init(PlCompState* compstate, PlUnit* unit, base::Path srcname, bool diag)
     {
@@ -764,12 +1334,13 @@ public:
     }
 
     bool compileSrc(const base::Path& sourcefn);
-    bool loadPrecomp(const base::Path& entfn);
+    bool loadPrecomp(const base::Path& entfn, bool lazy = false);
 
     bool generateFile(OutputFmt fmt, const base::Path& filename, base::Buffer* outbuf = nullptr);
+    bool generateAll(const base::Path& cppfn, const base::Path& hdrfn, const base::Path& astfn);
     void genDiagInfo(base::StrBld& bld);
 
-    PlArr<EntityType> getRootChildren(EKind ek, ETag tg = ETag::Primary);
+    PlEnRange getRootChildren(EKind ek, ETag tg = ETag::Primary);
 
     PlSymbolTable* symTable();
     EntityType enRoot()
@@ -785,6 +1356,15 @@ public:
         return mSrcName;
     }
     void readCfg(bool multiroot = false);
+    // Loaded from an indexed AST, its declarations are resolved as they load
+    bool isIndexed()
+    {
+        return mIndexed;
+    }
+    bool takeLoaded(std::vector<EntityType>& ens)
+    {
+        return mAst.takeLoaded(ens);
+    }
     bool isMod()
     {
         return mState == State::NeedCompile;
@@ -818,12 +1398,19 @@ private:
     EntityType mEnRoot;
     base::StrBld mTokDiag;
     bool mDiag;
+    bool mIndexed;
+    PlArena mArena;
+    PlLazyAst mAst;
 
-    EntityType loadEntity(EntityType parent, base::PersistRd& prd, ETag etag = ETag::Primary);
     void readCppDirec(EntityType ce);
 
 public:
     EntityType mDepEn;
+
+    PlArena* arena()
+    {
+        return &mArena;
+    }
 };
 
 
@@ -836,16 +1423,12 @@ public:
         mDepsRoot(nullptr)
     {
     }
-    ~PlCompState()
-    {
-        delete mPubsRoot;
-        delete mDepsRoot;
-    }
+    ~PlCompState() = default;
     void init(PlUnit* unit)
     {
         mUnit = unit;
         mSymTable.init();
-        mDepsRoot = PlEntity::newEntity(nullptr, EKind::FileRoot, PlToken::sNilTok);
+        mDepsRoot = PlEntity::newRoot(&mDepsArena, EKind::FileRoot, PlToken::sNilTok);
         mResolver.init(symTable(), mUnit);
     }
     void addSrc(base::Path srcname);
@@ -864,14 +1447,17 @@ public:
 public:
     base::List<PlFileState> mSrcFiles;
     base::List<PlFileState> mDepUnits;
-    base::List<base::Path> mExtIncDirs;
     EntityType mPubsRoot;
     EntityType mDepsRoot;
 
 private:
+    void fixupDepDecls();
+
     PlSymbolTable mSymTable;
     PlUnit* mUnit;
     PlResolver mResolver;
+    PlArena mPubsArena;
+    PlArena mDepsArena;
 };
 
 
@@ -907,12 +1493,22 @@ private:
 extern PlCppProp sCppProp;
 
 
+// A program to run with plLogRun(), and the directory to run it in
+struct PlCmd
+{
+    std::vector<std::string> args;
+    base::Path dir;
+};
+
+
 class PlUnit
 {
 public:
     PlUnit() :
         mInit(false),
         mType(UnitType::none),
+        mUnitySize(0),
+        mPch(false),
         mBldDiagFiles(false),
         mBldTempFiles(false)
     {
@@ -956,9 +1552,13 @@ public:
     {
         return base::Path(mPath, sConfig.getStr(Config::unityamlfn));
     }
-    base::Path cmakeFn()
+    base::Path objDir()
     {
-        return base::Path(targetDir(), "CMakeLists.txt");
+        return base::Path(buildDir(), L_OBJDIR);
+    }
+    base::Path ninjaFn()
+    {
+        return base::Path(buildDir(), L_NINJAFN);
     }
     base::Path srcFn(const base::Path& fn)
     {
@@ -1019,6 +1619,16 @@ public:
     {
         return base::Path(targetDir(), sCppProp.getStr(CppPropType::unitwidehdrfn));
     }
+    base::Path pchHdrFn()
+    {
+        return base::Path(targetDir(), sCppProp.getStr(CppPropType::unitpchhdrfn));
+    }
+    base::Path unityNameFn(size_t index)
+    {
+        base::Path p(base::formatr("%s%zu", sCppProp.getStr(CppPropType::unityprefix).c_str(), index));
+        p.modifyExt(L_CPPEXT);
+        return p;
+    }
     base::Path pubHdrFn()
     {
         base::Path pub("pub_");
@@ -1065,6 +1675,9 @@ public:
     std::string mNS;
     UnitType mType;
     std::string mVer;
+    // Sources per unity translation unit, zero builds each source on its own
+    size_t mUnitySize;
+    bool mPch;
     base::Variant mMeta;
     PlCompState mCompState;
     base::Path mPath;
@@ -1079,34 +1692,87 @@ private:
 
     bool getSrcFiles(bool& srcisnew);
     bool writeUnitWideHdr();
+    bool writeUnityFiles();
+    size_t unityCount();
 
-    bool writeCmake(bool& cmakeupdated);
-    bool getCmakeLibs(PlUnit* depunit, std::string& addlib, std::string& libnames);
-    bool makeCmakeLibStr(PlUnit* depunit, base::StrBld& cm, const char* dir, const char* proj, const char* libname, base::Path eincdir);
+    bool writeNinja(bool& ninjaupdated);
+    void getLinkLibs(BuildConfig bldcfg, std::vector<base::Path>& libs, std::vector<base::Path>* incdirs);
+    void getExtLibs(PlUnit* unit, BuildConfig bldcfg, std::vector<base::Path>& libs, std::vector<base::Path>* incdirs);
+    bool isCurrent(BuildConfig bldcfg);
+    bool runNinja(BuildConfig bldcfg);
 
     bool moveTemps();
 
-    bool existNinjaFiles(base::Path dir);
-    bool writeNinjaFiles(base::Path dir);
-    bool buildNinja(base::Path dir, BuildConfig bldcfg);
-    bool cleanNinja(base::Path dir);
+    bool existExtBuild(base::Path dir);
+    PlCmd configExtCmd(base::Path dir);
+    PlCmd buildExtCmd(base::Path dir, BuildConfig bldcfg);
+    bool cleanExtDir(base::Path dir);
+};
+
 
-    class DirPush
+// Wall time and heap allocations of each build phase, per source file and
+// per unit.  Only recorded when enabled by 'pc build --profile'.
+class PlProfiler
+{
+public:
+    PlProfiler() :
+        mEnabled(false),
+        mStartUs(0)
     {
-    public:
-        DirPush() = delete;
-        DirPush(const base::Path& dir)
-        {
-            currentDirectory(mPrev);
-            changeDirectory(dir);
-        }
-        ~DirPush()
-        {
-            changeDirectory(mPrev);
-        }
-    private:
-        base::Path mPrev;
+    }
+    NOCOPY(PlProfiler)
+
+    void enable();
+    bool enabled() const
+    {
+        return mEnabled;
+    }
+    void add(ProfPhase phase, std::string& ctx, bool unit, uint64 begus, uint64 allocs, uint64 bytes);
+
+    // Prints per file and per unit tables of the phases
+    void report();
+    // Chrome trace event format, loads in chrome://tracing or Perfetto
+    bool writeTrace(const base::Path& fn);
+
+    static uint64 nowUs();
+    static uint64 allocCount();
+    static uint64 allocBytes();
+
+private:
+    struct Event
+    {
+        ProfPhase phase;
+        bool unit;
+        std::string ctx;
+        uint64 begus;
+        uint64 durus;
+        uint64 allocs;
+        uint64 bytes;
     };
+
+    bool mEnabled;
+    uint64 mStartUs;
+    std::vector<Event> mEvents;
+};
+
+extern PlProfiler sProfiler;
+
+// Records a phase for as long as it is in scope.  Without a file name, the
+// phase is for the whole unit.
+class PlProfScope
+{
+public:
+    PlProfScope(ProfPhase phase, PlUnit* unit, const base::Path* fn = nullptr);
+    ~PlProfScope();
+    NOCOPY(PlProfScope)
+
+private:
+    ProfPhase mPhase;
+    bool mUnit;
+    std::string mCtx;
+    uint64 mBegUs;
+    uint64 mAllocs;
+    uint64 mBytes;
 };
 
 
@@ -1121,6 +1787,7 @@ public:
         bool diagfiles = false;
         bool checkdeps = false;
         bool savetemps = false;
+        bool profile = false;
     };
 
     bool cleanUnit(base::Path unitpath, bool hard);
@@ -1134,12 +1801,14 @@ private:
 
 bool plParseFile(const base::Path& sourcefn, PlSymbolTable* symtable, PlUnit* containingunit, EntityType root, base::StrBld* diag);
 bool plGenerate(PlUnit* unit, EntityType root, OutputFmt fmt, base::Buffer& buf);
+bool plGenerate(PlUnit* unit, EntityType root, Code& cpp, Code& hdr, PlAstWriter* astwr);
 
 bool plReadYaml(const char* content, const base::Path fn, base::Variant& var);
 bool plReadJson(const char* content, const base::Path fn, base::Variant& var);
 bool plWrite(const char* content, const base::Buffer& buf, const base::Path fn, bool onlywhendiff = false);
+bool plWrite(const char* content, const base::StrRope& rope, const base::Path fn, bool onlywhendiff = false);
 bool plRead(const char* content, base::Buffer& buf, const base::Path fn, bool nullterm);
-int plLogShell(const std::string& cmd, base::Buffer& log, base::Buffer& errlog);
+bool plLogRun(const std::vector<PlCmd>& cmds, base::Buffer& log, base::Buffer& errlog);
 bool plIsIdent(strparam str);
 void plPrintErr(strparam str);
 
@@ -0,0 +1,212 @@
+#include "primalc.h"
+#include <chrono>
+
+PlProfiler sProfiler;
+
+// Heap allocations through new are counted all the time, a phase's count is
+// the difference across it.  Buffers and arenas that malloc directly are not
+// counted, only the blocks behind them.
+static uint64 sAllocCount = 0;
+static uint64 sAllocBytes = 0;
+
+void* operator new(size_t size)
+{
+    sAllocCount++;
+    sAllocBytes += size;
+    void* p = malloc(size ? size : 1);
+    if (!p)
+    {
+        abort();
+    }
+    return p;
+}
+
+void* operator new[](size_t size)
+{
+    return operator new(size);
+}
+
+void operator delete(void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p) noexcept
+{
+    free(p);
+}
+
+void operator delete(void* p, size_t) noexcept
+{
+    free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept
+{
+    free(p);
+}
+
+
+// PlProfiler::
+void PlProfiler::enable()
+{
+    mEnabled = true;
+    mStartUs = nowUs();
+}
+
+uint64 PlProfiler::nowUs()
+{
+    auto t = std::chrono::steady_clock::now().time_since_epoch();
+    return (uint64)std::chrono::duration_cast<std::chrono::microseconds>(t).count();
+}
+
+uint64 PlProfiler::allocCount()
+{
+    return sAllocCount;
+}
+
+uint64 PlProfiler::allocBytes()
+{
+    return sAllocBytes;
+}
+
+void PlProfiler::add(ProfPhase phase, std::string& ctx, bool unit, uint64 begus, uint64 allocs, uint64 bytes)
+{
+    Event& e = mEvents.emplace_back();
+    e.phase = phase;
+    e.unit = unit;
+    e.ctx.swap(ctx);
+    e.begus = begus;
+    e.durus = nowUs() - begus;
+    e.allocs = allocs;
+    e.bytes = bytes;
+}
+
+void PlProfiler::report()
+{
+    // Rows are grouped by file or unit, in the order they were first seen.
+    // A phase can run more than once for the same one, such as configuring
+    // each ext project, those are summed into one row.
+    std::vector<Event> rows;
+    for (auto& e : mEvents)
+    {
+        size_t pos = rows.size();
+        bool found = false;
+        for (size_t i = 0; i < rows.size(); i++)
+        {
+            Event& r = rows[i];
+            if (r.unit == e.unit && r.ctx == e.ctx)
+            {
+                if (r.phase == e.phase)
+                {
+                    r.durus += e.durus;
+                    r.allocs += e.allocs;
+                    r.bytes += e.bytes;
+                    found = true;
+                    break;
+                }
+                pos = i + 1;
+            }
+        }
+        if (!found)
+        {
+            rows.insert(rows.begin() + pos, e);
+        }
+    }
+
+    for (int unit = 0; unit < 2; unit++)
+    {
+        printf("\n%-32s %-14s %10s %10s %10s\n", unit ? "Unit" : "File", "Phase", "ms", "allocs", "KB");
+        const std::string* prev = nullptr;
+        for (auto& r : rows)
+        {
+            if (r.unit == (unit != 0))
+            {
+                bool same = prev && (*prev == r.ctx);
+                printf("%-32s %-14s %10.2f %10llu %10.1f\n",
+                    same ? "" : r.ctx.c_str(),
+                    sProfPhaseMap.toString(r.phase),
+                    r.durus / 1000.0,
+                    r.allocs,
+                    r.bytes / 1024.0);
+                prev = &r.ctx;
+            }
+        }
+    }
+    printf("\nTotal %.2f ms, %llu allocs\n", (nowUs() - mStartUs) / 1000.0, sAllocCount);
+}
+
+bool PlProfiler::writeTrace(const base::Path& fn)
+{
+    base::Variant events;
+    events.createArray();
+    for (auto& e : mEvents)
+    {
+        base::Variant args;
+        args.createObject();
+        args.setProp(e.unit ? "unit" : "file", e.ctx.c_str());
+        args.setProp("allocs", base::Variant((int64_t)e.allocs));
+        args.setProp("bytes", base::Variant((int64_t)e.bytes));
+
+        // Complete events, timestamps in microseconds from the start
+        base::Variant ev;
+        ev.createObject();
+        ev.setProp("name", sProfPhaseMap.toString(e.phase));
+        ev.setProp("cat", e.unit ? "unit" : "file");
+        ev.setProp("ph", "X");
+        ev.setProp("ts", base::Variant((int64_t)(e.begus - mStartUs)));
+        ev.setProp("dur", base::Variant((int64_t)e.durus));
+        ev.setProp("pid", base::Variant(1));
+        ev.setProp("tid", base::Variant(1));
+        ev.setProp("args", args);
+        events.push(ev);
+    }
+
+    base::Variant trace;
+    trace.createObject();
+    trace.setProp("traceEvents", events);
+    trace.setProp("displayTimeUnit", "ms");
+
+    base::Buffer buf;
+    trace.getJson(buf);
+    return plWrite("Profile trace", buf, fn);
+}
+
+
+// PlProfScope::
+PlProfScope::PlProfScope(ProfPhase phase, PlUnit* unit, const base::Path* fn) :
+    mPhase(phase),
+    mUnit(fn == nullptr),
+    mBegUs(0),
+    mAllocs(0),
+    mBytes(0)
+{
+    if (sProfiler.enabled())
+    {
+        if (unit)
+        {
+            mCtx = unit->mName;
+        }
+        if (fn)
+        {
+            if (!mCtx.empty())
+            {
+                mCtx += '/';
+            }
+            mCtx += fn->namePart();
+        }
+
+        // Taken last, so building the name above isn't counted
+        mAllocs = sAllocCount;
+        mBytes = sAllocBytes;
+        mBegUs = PlProfiler::nowUs();
+    }
+}
+
+PlProfScope::~PlProfScope()
+{
+    if (sProfiler.enabled() && mBegUs != 0)
+    {
+        sProfiler.add(mPhase, mCtx, mUnit, mBegUs, sAllocCount - mAllocs, sAllocBytes - mBytes);
+    }
+}
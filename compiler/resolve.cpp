@@ -199,8 +199,8 @@ void PlResolver::deterType(EntityType rentity, ETag tg)
 
             if (rentity->mResolvedRef)
             {
-                // Since string is a built-in value type
-                if (rentity->mDT != DataType::d_string)
+                // Since string and strview are built-in value types
+                if (rentity->mDT != DataType::d_string && rentity->mDT != DataType::d_strview)
                 {
                     rentity->mDT = rentity->mResolvedRef->mDT;
                 }
@@ -234,14 +234,16 @@ void PlResolver::deterTemplArgs(EntityType templtypeen, std::string& typestr)
         return;
     }
 
-    for (size_t i = 0; i < toarr.count(); i++)
+    auto to = toarr.begin();
+    for (EntityType from : fromarr)
     {
-        if (base::streql(typestr, fromarr.get(i)->getStr() ))
+        if (base::streql(typestr, from->getStr()))
         {
-            //dbglog("Template argument <%s> replaced with '%s'\n", fromarr.get(i)->getStr().c_str(), toarr.get(i)->getStr().c_str());
-            typestr.assign(toarr.get(i)->getStr());
+            //dbglog("Template argument <%s> replaced with '%s'\n", from->getStr().c_str(), (*to)->getStr().c_str());
+            typestr.assign((*to)->getStr());
             return;
         }
+        ++to;
     }
 }
 
@@ -300,6 +302,27 @@ void PlResolver::resoForStmt(EntityType rentity, ETag tg, EntityType prev)
         if (rngen)
         {
             ty = getType(rngen->getChild(EKind::Expr, ETag::RangeFromVal));
+
+            // A parallel for's sums are vars from outside the loop that
+            // each part adds to, so they must exist and be numbers
+            for (EntityType rv : rngen->getChildren(ETag::ReduceVar))
+            {
+                std::string id = rv->getStr();
+                EntityType ven = mSymTable->findSymbol(id.c_str());
+                if (!ven || (ven->mKind != EKind::VarDecl && ven->mKind != EKind::FuncParam))
+                {
+                    pushErr(rv, "Undefined sum variable '%s'", id.c_str());
+                    continue;
+                }
+                rv->mResolvedRef = ven;
+
+                PlTypeInfo vty(this);
+                vty.mDT = ven->mDT;
+                if (!vty.isNum())
+                {
+                    pushErr(rv, "Sum variable '%s' must be a number", id.c_str());
+                }
+            }
         }
         else
         {
@@ -429,38 +452,61 @@ void PlResolver::resoVarEval(EntityType rentity, ETag tg, EntityType prev)
     }
 }
 
-void PlResolver::fixupPhase0(EntityType rentity, ETag tg, EntityType prev)
+void PlResolver::fixupPhase0(EntityType rentity, ETag tg)
 {
-    //dbgDump("Resolve ");
-    if (!rentity->mResolvedRef)
+    // Scopes of the entities on the path to the current one
+    std::deque<PlSymbolAg> scopes;
+    for (PlEnWalk w(rentity, tg); w.next(); )
     {
-        switch (rentity->mKind)
+        while (scopes.size() > w.depth())
         {
-            case EKind::TypeDef:
-                deterType(rentity, ETag::VarType);
-                break;
+            scopes.pop_back();
+        }
 
-            default:
-                break;
+        EntityType en = w.cur();
+        if (!en->mResolvedRef)
+        {
+            switch (en->mKind)
+            {
+                case EKind::TypeDef:
+                    deterType(en, ETag::VarType);
+                    break;
+
+                default:
+                    break;
+            }
         }
-    }
 
-    // Scope the symbol table
-    PlSymbolAg symag(true, mSymTable, mUnit);
-    symag.process(rentity, nullptr);
+        // Scope the symbol table
+        scopes.emplace_back(true, mSymTable, mUnit).process(en, nullptr);
+    }
+    while (!scopes.empty())
+    {
+        scopes.pop_back();
+    }
+}
 
-    EntityType prevpeer = nullptr;
-    for (auto& sub : rentity->mSubEntities)
+void PlResolver::fixupPhase1(EntityType rentity, ETag tg)
+{
+    std::deque<PlSymbolAg> scopes;
+    for (PlEnWalk w(rentity, tg); w.next(); )
     {
-        for (auto& e : sub.mEntities)
+        while (scopes.size() > w.depth())
         {
-            fixupPhase0(&e, sub.mTag, prevpeer);
-            prevpeer = &e;
+            scopes.pop_back();
         }
+        fixupEn1(w.cur(), w.tag(), w.prev());
+
+        // Scope the symbol table
+        scopes.emplace_back(true, mSymTable, mUnit).process(w.cur(), nullptr);
+    }
+    while (!scopes.empty())
+    {
+        scopes.pop_back();
     }
 }
 
-void PlResolver::fixupPhase1(EntityType rentity, ETag tg, EntityType prev)
+void PlResolver::fixupEn1(EntityType rentity, ETag tg, EntityType prev)
 {
     //dbgDump("Resolve ");
     if (!rentity->mResolvedRef)
@@ -514,29 +560,35 @@ void PlResolver::fixupPhase1(EntityType rentity, ETag tg, EntityType prev)
                 break;
         }
     }
+}
 
-    // Scope the symbol table
-    PlSymbolAg symag(true, mSymTable, mUnit);
-    symag.process(rentity, nullptr);
+void PlResolver::fixupAll(EntityType rentity)
+{
+    fixupPhase0(rentity, ETag::Primary);
+    fixupPhase1(rentity, ETag::Primary);
+}
 
-    EntityType prevpeer = nullptr;
-    for (auto& sub : rentity->mSubEntities)
+void PlResolver::fixupAll(const std::vector<EntityType>& ens)
+{
+    for (EntityType en : ens)
     {
-        for (auto& e : sub.mEntities)
-        {
-            fixupPhase1(&e, sub.mTag, prevpeer);
-            prevpeer = &e;
-        }
+        fixupPhase0(en, ETag::Primary);
+    }
+    for (EntityType en : ens)
+    {
+        fixupPhase1(en, ETag::Primary);
     }
 }
 
-void PlResolver::fixupAll(EntityType rentity)
+void PlResolver::validateAll(EntityType rentity, ETag tg)
 {
-    fixupPhase0(rentity, ETag::Primary, nullptr);
-    fixupPhase1(rentity, ETag::Primary, nullptr);
+    for (PlEnWalk w(rentity, tg); w.next(); )
+    {
+        validateEn(w.cur(), w.tag());
+    }
 }
 
-void PlResolver::validateAll(EntityType rentity, ETag tg)
+void PlResolver::validateEn(EntityType rentity, ETag tg)
 {
     switch (rentity->mKind)
     {
@@ -610,14 +662,6 @@ void PlResolver::validateAll(EntityType rentity, ETag tg)
         default:
         break;
     }
-
-    for (auto& sub : rentity->mSubEntities)
-    {
-        for (auto& e : sub.mEntities)
-        {
-            validateAll(&e, sub.mTag);
-        }
-    }
 }
 
 void PlResolver::checkReso(EntityType rentity, ETag tg, EKind k1, EKind k2, EKind k3)
@@ -686,17 +730,13 @@ void PlResolver::checkFuncCall(EntityType rentity)
     auto darr = rentity->mResolvedRef->getChildren(EKind::FuncParam);
 
     size_t ci = 0;
-    size_t di = 0;
+    auto cit = carr.begin();
+    auto dit = darr.begin();
 
-    for (;;)
+    for (; cit != carr.end() && dit != darr.end(); ++cit)
     {
-        EntityType c = carr.get(ci);
-        EntityType d = darr.get(di);
-
-        if (c == nullptr || d == nullptr)
-        {
-            break;
-        }
+        EntityType c = *cit;
+        EntityType d = *dit;
 
         PlTypeInfo cty = getType(c);
         PlTypeInfo dty = getType(d);
@@ -717,10 +757,9 @@ void PlResolver::checkFuncCall(EntityType rentity)
 
         if (!d->hasAttrib(EAttribFlags::a_ellipses))
         {
-            di++;
+            ++dit;
         }
         ci++;
-
     }
 }
 
@@ -729,17 +768,13 @@ bool PlResolver::paramsCompat(EntityType cal, EntityType def)
     auto carr = cal->getChildren(EKind::Expr, ETag::FuncArgVal);
     auto darr = def->getChildren(EKind::FuncParam);
 
-    size_t ci = 0;
-    size_t di = 0;
+    auto cit = carr.begin();
+    auto dit = darr.begin();
 
-    for (;;)
+    for (; cit != carr.end() && dit != darr.end(); ++cit)
     {
-        EntityType c = carr.get(ci);
-        EntityType d = darr.get(di);
-        if (c == nullptr || d == nullptr)
-        {
-            break;
-        }
+        EntityType c = *cit;
+        EntityType d = *dit;
 
         PlTypeInfo cty = getType(c);
         PlTypeInfo dty = getType(d);
@@ -756,9 +791,8 @@ bool PlResolver::paramsCompat(EntityType cal, EntityType def)
         }
         if (!d->hasAttrib(EAttribFlags::a_ellipses))
         {
-            di++;
+            ++dit;
         }
-        ci++;
     }
     return true;
 }
@@ -820,7 +854,7 @@ bool PlTypeInfo::fromSigCh(EntityType rentity)
             ETag tg = sigTag(mTypeEn);
             mName = mTypeEn->getIdentStr(tg);
             mDT = mTypeEn->mDT;
-            mTemplArg = mTypeEn->getIdentStr(ETag::TemplArg);
+            mTemplArg = mTypeEn->getSimpIdentStr(ETag::TemplArg);
             mBoxed = mTypeEn->hasAttrib(EAttribFlags::a_boxed);
         }
     }
@@ -859,6 +893,10 @@ bool PlTypeInfo::fromSigCh(EntityType rentity)
     {
         mDT = DataType::d_string;
     }
+    else if (base::streql(mName, "strview"))
+    {
+        mDT = DataType::d_strview;
+    }
 
     return mDT != DataType::d_none;
 }
@@ -957,6 +995,11 @@ bool PlTypeInfo::isCompat(const PlTypeInfo& that)
     return false;
 }
 
+bool PlTypeInfo::isNum()
+{
+    return isInt(mDT) || isFloat(mDT);
+}
+
 bool PlTypeInfo::isInt(DataType dt)
 {
     switch (dt)
@@ -998,6 +1041,7 @@ bool PlTypeInfo::isStr(DataType dt)
     {
         case DataType::d_string:
         case DataType::d_czstr:
+        case DataType::d_strview:
             return true;
 
         default:
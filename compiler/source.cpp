@@ -10,6 +10,7 @@ public:
         mUnit(unit),
         mRoot(nullptr),
         mLoopDepth(0),
+        mParallelLoop(0),
         mStmtBlockDepth(0)
     {
     }
@@ -39,13 +40,13 @@ private:
         size_t lin = curLine();
         while (availForLine(lin))
         {
-            std::string s = token().toString();
-            if (!isSimpleIdent(s))
+            const PlToken& tok = token();
+            if (!isSimpleIdent(tok))
             {
                 ret.clear();
                 break;
             }
-            ret += s;
+            ret.append(tok.cstr(), tok.length());
             advance();
             d++;
             if (d < C_MAXIDENTSCOPE)
@@ -78,7 +79,7 @@ private:
             while (availForLine(lin))
             {
                 std::string s = token().toString();
-                if (!isSimpleIdent(s))
+                if (!isSimpleIdent(token()))
                 {
                     if (item.empty())
                     {
@@ -126,7 +127,7 @@ private:
         size_t lin = curLine();
         while (availForLine(lin))
         {
-            if (!isSimpleIdent(token().toString()))
+            if (!isSimpleIdent(token()))
             {
                 pushErr("Invalid identifier");
                 break;
@@ -148,7 +149,7 @@ private:
 
     EntityType parseSimpleIdent(EntityType parent, ETag etag, bool pub)
     {
-        if (!isSimpleIdent(token().toString()))
+        if (!isSimpleIdent(token()))
         {
             pushErr("Invalid identifier");
             return nullptr;
@@ -160,19 +161,25 @@ private:
 
     void parseTemplArg(EntityType parent, bool pub)
     {
-        // Template argument
-        // TODO: add arbitary number and complexity of template arg
+        // Template arguments, a list of type names
+        // TODO: add complexity of template arg, like nested templates
         if (is("<"))
         {
             advance();
             parseIdent(parent, ETag::TemplArg, pub);
+            while (is(","))
+            {
+                advance();
+                parseIdent(parent, ETag::TemplArg, pub);
+            }
             advance(">");
 
             // Mark this type is templated
             parent->addAttrib(EAttribFlags::a_templtype);
 
+            // Boxed is about the first argument, the element type of an iter for
             PlDiscern dc;
-            if (dc.isValueType(parent->getIdentStr(ETag::TemplArg)))
+            if (dc.isValueType(parent->getSimpIdentStr(ETag::TemplArg)))
             {
                 parent->addAttrib(EAttribFlags::a_boxed);
             }
@@ -194,9 +201,9 @@ private:
 
         if (is1ident && isVal(item2, "<"))
         {
-            // Create a temorary entity
-            EntityType temp = new PlEntity();
-            temp->mKind = EKind::FileRoot;
+            // Create a temorary entity, freed along with its arena
+            PlArena temparena;
+            EntityType temp = PlEntity::newRoot(&temparena, EKind::FileRoot, PlToken::sNilTok);
 
             // Parse elements into a temporary entity
             EntityType ten = createNilPubEn(temp, EKind::TypeDef, ETag::Primary, pub);
@@ -208,28 +215,26 @@ private:
             base::StrBld nm;
 
             // Build a hashed name that contains type and template info
-            auto id = ten->getChildren(EKind::Ident, etag);
-            for (size_t i = 0; i < id.count(); i++)
+            for (EntityType id : ten->getChildren(EKind::Ident, etag))
             {
-                nm.append(id.get(i)->getStr());
+                nm.append(id->getStr());
                 nm.appendc('_');
 
-                genname.assign(id.get(i)->getStr());
+                genname.assign(id->getStr());
             }
 
             // Read template args, and also copy them into parent as they
             // are expected by code generation
-            auto tid = ten->getChildren(EKind::Ident, ETag::TemplArg);
-            for (size_t i = 0; i < tid.count(); i++)
+            for (EntityType tid : ten->getChildren(EKind::Ident, ETag::TemplArg))
             {
-                std::string s = tid.get(i)->getStr();
+                std::string s = tid->getStr();
                 if (nm.last() != '_')
                 {
                     nm.appendc('_');
                 }
                 nm.appendFmt("%d", base::strHash(s));
 
-                PlEntity::cloneEntity(tid.get(i), parent, ETag::TemplArg);
+                PlEntity::cloneEntity(tid, parent, ETag::TemplArg);
             }
             std::string hname = nm.toString();
 
@@ -240,13 +245,12 @@ private:
             ten->setTokStr(hname);
 
             // Look for the element in root and if not found, add it by cloning the temp
-            auto arr = mRoot->getChildren(EKind::TypeDef, ETag::Primary);
             EntityType found = nullptr;
-            for (size_t i = 0; i < arr.count(); i++)
+            for (EntityType td : mRoot->getChildren(EKind::TypeDef, ETag::Primary))
             {
-                if (arr.get(i)->mToken.equals(hname.c_str()))
+                if (td->mToken.equals(hname.c_str()))
                 {
-                    found = arr.get(i);
+                    found = td;
                     break;
                 }
             }
@@ -255,10 +259,12 @@ private:
             {
                 ten = PlEntity::cloneEntity(ten, mRoot);
 
-                // Add to symbol
-                mSymTable->addSymbol(hname.c_str(), ten, mUnit);
+                // Add to symbol.  The typedef is at root level, so it goes in
+                // the unitwide scope, where uses in any other scope find it.
+                std::string sc;
+                PlSymbolTable::scAdd(sc, L_UNITWIDESCOPE);
+                mSymTable->addSymbolSc(sc, hname.c_str(), ten, mUnit);
             }
-            delete temp;
 
             // Set type as the hashed name
             EntityType t = createNilPubEn(parent, EKind::Ident, etag, pub);
@@ -278,7 +284,7 @@ private:
 
     EntityType parseCppDirec(EntityType parent, CppDirecType mustbecdtype, bool pub)
     {
-        advance(L_CPPDIREC);
+        advance(Keyword::kw_cpp);
 
         EntityType en = createNilPubEn(parent, EKind::CppDirec, ETag::Primary, pub);
         advance(".");
@@ -324,7 +330,7 @@ private:
 
     void parseObject(EntityType parent, bool pub)
     {
-        advance(L_OBJECT);
+        advance(Keyword::kw_object);
 
         EntityType en = createNilPubEn(parent, EKind::Object, ETag::Primary, pub);
         en->addAttrib(EAttribFlags::a_methods);
@@ -373,7 +379,7 @@ private:
 
     void parseImpl(EntityType parent, bool pub)
     {
-        advance(L_IMPL);
+        advance(Keyword::kw_impl);
 
         EntityType en = createNilPubEn(parent, EKind::Impl, ETag::Primary, pub);
 
@@ -389,7 +395,7 @@ private:
         if (is1ident && isVal(item2, L_FOR))
         {
             parseIdent(en, ETag::InterfName, pub);
-            advance(L_FOR);
+            advance(Keyword::kw_for);
         }
         parseIdent(en, ETag::ClassName, pub);
         std::string name = en->getIdentStr(ETag::ClassName);
@@ -412,7 +418,7 @@ private:
                     break;
                 }
 
-                if (is(L_FUNC))
+                if (is(Keyword::kw_func))
                 {
                     parseFunc(en, false);
                 }
@@ -427,7 +433,7 @@ private:
 
     void parseIntf(EntityType parent, bool pub)
     {
-        advance(L_INTERF);
+        advance(Keyword::kw_interf);
         EntityType en = createNilPubEn(parent, EKind::Interf, ETag::Primary, pub);
         en->addAttrib(EAttribFlags::a_methods);
         en->mDT = DataType::d_object;
@@ -457,7 +463,7 @@ private:
                     break;
                 }
 
-                if (is(L_FUNC))
+                if (is(Keyword::kw_func))
                 {
                     // Parse function definition
                     parseFunc(en, false, true);
@@ -473,7 +479,7 @@ private:
 
     void parseFunc(EntityType parent, bool pub, bool defonly = false)
     {
-        advance(L_FUNC);
+        advance(Keyword::kw_func);
 
         // Assume it is a function defintion, update to body or mapping later
         EntityType en = createNilPubEn(parent, defonly ? EKind::FuncDef : EKind::FuncBody, ETag::Primary, pub);
@@ -573,7 +579,9 @@ private:
 
         // for i : range(0, count)
         // for b : rev rangeinc(0, n)
-        advance(L_FOR);
+        // for i : parallel range(0, count)
+        // for i : parallel(sum, count) range(0, n)
+        advance(Keyword::kw_for);
 
         EntityType en = createNilEn(parent, EKind::ForStmt);
 
@@ -594,16 +602,49 @@ private:
 
         advance(":");
 
+        // The iterations of a parallel for are split across the task pool.
+        // Variables listed after it are sums, each part adds to its own copy
+        // and the copies are added to the variables at the end.  Only a
+        // range can follow the ':', so parallel is a marker here and not a
+        // keyword, and stays usable as a name elsewhere.
+        bool parallel = false;
+        std::vector<PlToken> reducevars;
+        if (is("parallel"))
+        {
+            parallel = true;
+            advance();
+            if (is("("))
+            {
+                advance();
+                for (;;)
+                {
+                    if (!isSimpleIdent(token()))
+                    {
+                        pushErr("Invalid identifier");
+                        return;
+                    }
+                    reducevars.push_back(token());
+                    advance();
+                    if (!is(L_COMMA))
+                    {
+                        break;
+                    }
+                    advance();
+                }
+                advance(")");
+            }
+        }
+
         bool rev = false;
-        if (is(L_REV))
+        if (is(Keyword::kw_rev))
         {
             rev = true;
             advance();
         }
 
-        if (is(L_RANGE) || is(L_RANGEINC))
+        if (is(Keyword::kw_range) || is(Keyword::kw_rangeinc))
         {
-            bool inc = is(L_RANGEINC);
+            bool inc = is(Keyword::kw_rangeinc);
             EntityType rangeen = createNilEn(en, EKind::Range);
             advance();
             if (rev)
@@ -614,6 +655,19 @@ private:
             {
                 rangeen->addAttrib(EAttribFlags::a_inclusive);
             }
+            if (parallel)
+            {
+                if (rev)
+                {
+                    pushErr("A parallel 'for' can't be reversed");
+                    return;
+                }
+                rangeen->addAttrib(EAttribFlags::a_parallel);
+                for (auto& tok : reducevars)
+                {
+                    PlEntity::newEntity(rangeen, EKind::Ident, tok, ETag::ReduceVar);
+                }
+            }
 
             advance("(");
             parseExpr(rangeen, ETag::RangeFromVal);
@@ -621,8 +675,13 @@ private:
             parseExpr(rangeen, ETag::RangeToVal);
             advance(")");
         }
-        else if (is(L_ITER))
+        else if (is(Keyword::kw_iter))
         {
+            if (parallel)
+            {
+                pushErr("A parallel 'for' needs a range");
+                return;
+            }
             EntityType iteren = createNilEn(en, EKind::Iter);
             advance();
             if (rev)
@@ -642,13 +701,19 @@ private:
         //en->dbgDump("FOR ");
         expectNL();
         mLoopDepth++;
+        int parallelloop = mParallelLoop;
+        if (parallel)
+        {
+            mParallelLoop = mLoopDepth;
+        }
         parseStmtBlock(en, false);
+        mParallelLoop = parallelloop;
         mLoopDepth--;
     }
 
     void parseLoopStmt(EntityType parent)
     {
-        advance(L_LOOP);
+        advance(Keyword::kw_loop);
         EntityType en = createNilEn(parent, EKind::LoopStmt);
         expectNL();
         mLoopDepth++;
@@ -673,7 +738,7 @@ private:
 
     void parseWhileStmt(EntityType parent)
     {
-        advance(L_WHILE);
+        advance(Keyword::kw_while);
         EntityType en = createNilEn(parent, EKind::WhileStmt);
         parseExpr(en, ETag::CondVal);
         expectNL();
@@ -686,11 +751,11 @@ private:
     {
         if (mLoopDepth > 0)
         {
-            advance(L_CONTINUE);
+            advance(Keyword::kw_continue);
             EntityType en = createNilEn(parent, EKind::ContinStmt);
-            if (is(L_IF))
+            if (is(Keyword::kw_if))
             {
-                advance(L_IF);
+                advance(Keyword::kw_if);
                 parseExpr(en, ETag::CondVal);
             }
         }
@@ -702,13 +767,18 @@ private:
 
     void parseBreakStmt(EntityType parent)
     {
-        if (mLoopDepth > 0)
+        if (mLoopDepth > 0 && mLoopDepth == mParallelLoop)
         {
-            advance(L_BREAK);
+            // The other parts keep running
+            pushErr("'break' not allowed in a parallel 'for'");
+        }
+        else if (mLoopDepth > 0)
+        {
+            advance(Keyword::kw_break);
             EntityType en = createNilEn(parent, EKind::BreakStmt);
-            if (is(L_IF))
+            if (is(Keyword::kw_if))
             {
-                advance(L_IF);
+                advance(Keyword::kw_if);
                 parseExpr(en, ETag::CondVal);
             }
         }
@@ -792,7 +862,7 @@ private:
 
     void parseIfStmt(EntityType parent)
     {
-        advance(L_IF);
+        advance(Keyword::kw_if);
         EntityType en = createNilEn(parent, EKind::IfStmt);
         parseExpr(en, ETag::CondVal);
         expectNL();
@@ -800,13 +870,13 @@ private:
         expectNL();
         for (;;)
         {
-            if (is(L_ELSE))
+            if (is(Keyword::kw_else))
             {
-                advance(L_ELSE);
+                advance(Keyword::kw_else);
                 EntityType elen = nullptr;
-                if (is(L_IF))
+                if (is(Keyword::kw_if))
                 {
-                    advance(L_IF);
+                    advance(Keyword::kw_if);
                     elen = createNilEn(en, EKind::ElseIf);
 
                     parseExpr(elen, ETag::CondVal);
@@ -855,19 +925,19 @@ private:
 
     void parseStmt(EntityType parent)
     {
-        if (is(L_RETURN))
+        if (is(Keyword::kw_return))
         {
             parseReturnStmt(parent);
         }
-        else if (is(L_FOR))
+        else if (is(Keyword::kw_for))
         {
             parseForStmt(parent);
         }
-        else if (is(L_WHILE))
+        else if (is(Keyword::kw_while))
         {
             parseWhileStmt(parent);
         }
-        else if (is(L_LOOP))
+        else if (is(Keyword::kw_loop))
         {
             parseLoopStmt(parent);
         }
@@ -875,15 +945,15 @@ private:
         {
             parseDeferStmt(parent);
         }
-        else if (is(L_IF))
+        else if (is(Keyword::kw_if))
         {
             parseIfStmt(parent);
         }
-        else if (is(L_CONTINUE))
+        else if (is(Keyword::kw_continue))
         {
             parseContinStmt(parent);
         }
-        else if (is(L_BREAK))
+        else if (is(Keyword::kw_break))
         {
             parseBreakStmt(parent);
         }
@@ -891,7 +961,7 @@ private:
         {
             parseSwitchStmt(parent);
         }
-        else if (is(L_VAR))
+        else if (is(Keyword::kw_var))
         {
             parseVarDecl(parent);
         }
@@ -942,9 +1012,34 @@ private:
         }
     }
 
+    // Adds the template arguments of a cpp type from the interface it maps,
+    // declared earlier in the unit, or a single T
+    void addCppTemplArgs(EntityType en, strparam cppintf, bool pub)
+    {
+        for (EntityType intf : mRoot->getChildren(EKind::Interf, ETag::Primary))
+        {
+            if (base::streql(intf->getIdentStr(ETag::InterfName), cppintf))
+            {
+                auto arr = intf->getChildren(EKind::Ident, ETag::TemplArg);
+                if (arr.count() > 0)
+                {
+                    for (EntityType ta : arr)
+                    {
+                        EntityType t = createNilPubEn(en, EKind::Ident, ETag::TemplArg, pub);
+                        t->setTokStr(ta->getStr());
+                    }
+                    return;
+                }
+                break;
+            }
+        }
+        EntityType t = createNilPubEn(en, EKind::Ident, ETag::TemplArg, pub);
+        t->setTokStr("T");
+    }
+
     void parseTypeDef(EntityType parent, bool pub)
     {
-        advance(L_TYPEDEF);
+        advance(Keyword::kw_type);
 
         EntityType en = createNilPubEn(parent, EKind::TypeDef, ETag::Primary, pub);
 
@@ -961,7 +1056,7 @@ private:
             // Type def mapping
             advance(L_MAPSTO);
 
-            if (is(L_CPPDIREC))
+            if (is(Keyword::kw_cpp))
             {
                 // Typedef points to a CPP type
                 EntityType cppdirec = parseCppDirec(en, CppDirecType::type, false);
@@ -994,9 +1089,9 @@ private:
                             {
                                 //en->addAttrib(EAttribFlags::a_templated);
 
-                                // TODO: Finish template support. For now only a single argument T is allowed
-                                EntityType t = createNilPubEn(en, EKind::Ident, ETag::TemplArg, pub);
-                                t->setTokStr("T");
+                                // The arguments are named as in the interface, so its
+                                // methods' types can be mapped to the arguments
+                                addCppTemplArgs(en, cppintf, pub);
                             }
                             else if (base::strieql(f, "cppobject"))
                             {
@@ -1021,7 +1116,12 @@ private:
 
     void parseReturnStmt(EntityType parent)
     {
-        advance(L_RETURN);
+        if (mParallelLoop > 0)
+        {
+            pushErr("'return' not allowed in a parallel 'for'");
+            return;
+        }
+        advance(Keyword::kw_return);
         EntityType en = createNilEn(parent, EKind::ReturnStmt);
 
         parseExprOrNew(en, ETag::ReturnVal);
@@ -1134,7 +1234,7 @@ private:
 
     void parseVarDecl(EntityType parent)
     {
-        advance(L_VAR);
+        advance(Keyword::kw_var);
 
         EntityType en = createNilEn(parent, EKind::VarDecl);
 
@@ -1208,7 +1308,7 @@ private:
     EntityType parseExprOrNew(EntityType parent, ETag etag)
     {
         EntityType en = nullptr;
-        if (is(L_NEW))
+        if (is(Keyword::kw_new))
         {
             en = createNilEn(parent, EKind::Expr, etag);
             EntityType newen = createNilEn(en, EKind::New);
@@ -1224,35 +1324,65 @@ private:
 
     EntityType parseExpr(EntityType parent, ETag etag)
     {
-        EntityType en = createNilEn(parent, EKind::Expr, etag);
+        // Bracketed sub expressions are parsed in this same loop, with the
+        // enclosing expression saved on a stack, so that deeply nested code
+        // doesn't recurse
+        struct Nested
+        {
+            EntityType mParent;
+            EntityType mEn;
+            DataType mExDT;
+            size_t mLine;
+            const char* mClose;
+        };
+        std::vector<Nested> nest;
+
+        EntityType top = createNilEn(parent, EKind::Expr, etag);
+        EntityType en = top;
 
         DataType exdt = DataType::d_none;
         size_t lin = curLine();
-        while (availForLine(lin))
+        auto open = [&](EntityType paren, const char* close)
+        {
+            advance();
+            nest.push_back(Nested{parent, en, exdt, lin, close});
+            parent = paren;
+            en = createNilEn(paren, EKind::Expr, ETag::Primary);
+            exdt = DataType::d_none;
+            lin = curLine();
+        };
+
+        while (true)
         {
             // We stop parsing the expression upon hitting a , or a )
-            if (is(L_COMMA) || (is(")")))
+            if (!availForLine(lin) || is(L_COMMA) || is(")"))
             {
-                break;
+                if (nest.empty())
+                {
+                    break;
+                }
+
+                // End of a bracketed expression, back to the enclosing one
+                Nested& n = nest.back();
+                parent->mDT = exdt;
+                parent = n.mParent;
+                en = n.mEn;
+                exdt = n.mExDT;
+                lin = n.mLine;
+                advance(n.mClose);
+                nest.pop_back();
+                continue;
             }
 
             if (is("("))
             {
-                EntityType paren = createNilEn(en, EKind::ParanExpr);
-                advance();
-                parseExpr(paren, ETag::Primary);
-                advance(")");
-
+                open(createNilEn(en, EKind::ParanExpr), ")");
                 continue;
             }
 
             if (is("["))
             {
-                EntityType paren = createNilEn(en, EKind::SquareExpr);
-                advance();
-                parseExpr(paren, ETag::Primary);
-                advance("]");
-
+                open(createNilEn(en, EKind::SquareExpr), "]");
                 continue;
             }
 
@@ -1290,10 +1420,7 @@ private:
                 EntityType unaren = createNilEn(en, EKind::DollarExpr);
                 if (isVal(item2, "("))
                 {
-                    advance();
-                    parseExpr(unaren, ETag::Primary);
-                    advance(")");
-
+                    open(unaren, ")");
                     continue;
                 }
 
@@ -1387,7 +1514,7 @@ private:
         // TODO: If on same line, check for .method calls
         //dbgTok("@end parseExpr");
 
-        return en;
+        return top;
     }
 
 public:
@@ -1400,55 +1527,55 @@ public:
             {
                 advance();
             }
-            else if (is(L_FUNC))
+            else if (is(Keyword::kw_func))
             {
                 parseFunc(parent, false);
             }
-            else if (is(L_TYPEDEF))
+            else if (is(Keyword::kw_type))
             {
                 parseTypeDef(parent, false);
             }
-            else if (is(L_CPPDIREC))
+            else if (is(Keyword::kw_cpp))
             {
                 parseCppDirec(parent, CppDirecType::none, false);
             }
-            else if (is(L_OBJECT))
+            else if (is(Keyword::kw_object))
             {
                 parseObject(parent, false);
             }
-            else if (is(L_IMPL))
+            else if (is(Keyword::kw_impl))
             {
                 parseImpl(parent, false);
             }
-            else if (is(L_INTERF))
+            else if (is(Keyword::kw_interf))
             {
                 parseIntf(parent, false);
             }
-            else if (is(L_PUB))
+            else if (is(Keyword::kw_pub))
             {
                 // Pub
-                advance(L_PUB);
-                if (is(L_FUNC))
+                advance(Keyword::kw_pub);
+                if (is(Keyword::kw_func))
                 {
                     parseFunc(parent, true);
                 }
-                else if (is(L_TYPEDEF))
+                else if (is(Keyword::kw_type))
                 {
                     parseTypeDef(parent, true);
                 }
-                else if (is(L_CPPDIREC))
+                else if (is(Keyword::kw_cpp))
                 {
                     parseCppDirec(parent, CppDirecType::none, true);
                 }
-                else if (is(L_OBJECT))
+                else if (is(Keyword::kw_object))
                 {
                     parseObject(parent, false);
                 }
-                else if (is(L_IMPL))
+                else if (is(Keyword::kw_impl))
                 {
                     parseImpl(parent, false);
                 }
-                else if (is(L_INTERF))
+                else if (is(Keyword::kw_interf))
                 {
                     parseIntf(parent, true);
                 }
@@ -1458,7 +1585,7 @@ public:
                     break;
                 }
             }
-            else if (is(L_VAR))
+            else if (is(Keyword::kw_var))
             {
                 parseVarDecl(parent);
             }
@@ -1474,6 +1601,7 @@ private:
     PlUnit* mUnit;
     EntityType mRoot;
     int mLoopDepth;
+    int mParallelLoop;
     int mStmtBlockDepth;
 
 }; // PlSourceParser class
@@ -1482,9 +1610,12 @@ private:
 bool plParseFile(const base::Path& sourcefn, PlSymbolTable* symtable, PlUnit* containingunit, EntityType root, base::StrBld* diag)
 {
     PlSourceParser ep(symtable, containingunit);
-    if (!ep.tokenize(sourcefn))
     {
-        return false;
+        PlProfScope ps(ProfPhase::tokenize, containingunit, &sourcefn);
+        if (!ep.tokenize(sourcefn))
+        {
+            return false;
+        }
     }
 
     if (diag)
@@ -1492,7 +1623,10 @@ bool plParseFile(const base::Path& sourcefn, PlSymbolTable* symtable, PlUnit* co
         ep.dumpTokens(*diag);
     }
 
-    ep.parseRoot(root);
+    {
+        PlProfScope ps(ProfPhase::parse, containingunit, &sourcefn);
+        ep.parseRoot(root);
+    }
 
     return !ep.inErr();
 }
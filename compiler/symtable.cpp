@@ -1,92 +1,152 @@
 #include "primalc.h"
+#include <algorithm>
 
-EntityType PlSymbolTable::ScTable::getOne(std::string sc, const char* sym)
+// PlAtoms::
+
+PlAtoms::PlAtoms()
 {
-    // If more than one entries exist, returns the first one
-    sc += ".";
-    sc += sym;
-    auto range = mTbl.equal_range(sc);
-    if (range.first != range.second)
+    // Atom 0 is always the empty string
+    intern("");
+}
+
+uint32 PlAtoms::intern(strparam str)
+{
+    auto it = mIds.find(str);
+    if (it != mIds.end())
     {
-        return range.first->second;
+        return it->second;
     }
-    return nullptr;
+
+    // The deque never relocates its elements, so views into them stay valid
+    uint32 atom = (uint32)mStrs.size();
+    const std::string& s = mStrs.emplace_back(str);
+    mIds.emplace(strparam(s), atom);
+    return atom;
+}
+
+uint32 PlAtoms::find(strparam str) const
+{
+    auto it = mIds.find(str);
+    return it != mIds.end() ? it->second : NOATOM;
 }
 
-size_t PlSymbolTable::ScTable::count(std::string sc, const char* sym)
+
+// PlSymbolTable::ScTable::
+
+uint32 PlSymbolTable::ScTable::scopeId(strparam sc) const
 {
-    sc += ".";
-    sc += sym;
-    size_t ret = 0;
-    auto range = mTbl.equal_range(sc);
-    for (auto i = range.first; i != range.second; i++)
+    uint32 path = mAtoms.find(sc);
+    if (path == PlAtoms::NOATOM)
     {
-        ret++;
+        return NOSCOPE;
     }
-    return ret;
+    auto it = mScopeIds.find(path);
+    return it != mScopeIds.end() ? it->second : NOSCOPE;
 }
 
-bool PlSymbolTable::ScTable::createScopeSc(const std::string& sc)
+uint32 PlSymbolTable::ScTable::createScopeSc(strparam sc)
 {
-    if (mTbl.find(sc) != mTbl.end())
+    uint32 path = mAtoms.intern(sc);
+    auto it = mScopeIds.find(path);
+    if (it != mScopeIds.end())
     {
-        //dbglog("Cannot add dup scope '%s'\n", sc.c_str());
-        return false;
+        return it->second;
     }
-    mTbl.insert(std::make_pair(sc, (EntityType)0));
-    return true;
+
+    // Create the parent chain first, so walking up never needs the string
+    uint32 parent = NOSCOPE;
+    size_t pos = sc.find_last_of('.');
+    if (pos != strparam::npos)
+    {
+        parent = createScopeSc(sc.substr(0, pos));
+    }
+
+    uint32 scid = (uint32)mScopes.size();
+    mScopes.push_back(Scope{path, parent});
+    mScopeIds.emplace(path, scid);
+    return scid;
 }
 
-bool PlSymbolTable::ScTable::createSymbolSc(std::string sc, const char* sym, EntityType en)
+void PlSymbolTable::ScTable::createSymbolSc(uint32 scid, strparam sym, EntityType en)
 {
-    sc += ".";
-    sc += sym;
-    mTbl.insert(std::make_pair(sc, en));
-    return true;
+    uint32 row = (uint32)mRows.size();
+    mRows.push_back(SymRow{en, NOSCOPE});
+
+    // Dups are chained in insertion order, so the first one added is found first
+    auto res = mSyms.try_emplace(symKey(scid, mAtoms.intern(sym)), SymHead{row, row, 0});
+    SymHead& head = res.first->second;
+    if (!res.second)
+    {
+        mRows[head.mLast].mNext = row;
+        head.mLast = row;
+    }
+    head.mCount++;
 }
 
-PlArr<EntityType> PlSymbolTable::ScTable::getAll(std::string sc, const char* sym)
+PlArr<EntityType> PlSymbolTable::ScTable::getAll(uint32 scid, uint32 symid)
 {
-    sc += ".";
-    sc += sym;
     PlArr<EntityType> ret;
-    auto range = mTbl.equal_range(sc);
-    for (auto i = range.first; i != range.second; i++)
+    auto it = mSyms.find(symKey(scid, symid));
+    if (it != mSyms.end())
     {
-        ret.append(i->second);
+        for (uint32 row = it->second.mFirst; row != NOSCOPE; row = mRows[row].mNext)
+        {
+            ret.append(mRows[row].mEn);
+        }
     }
     return ret;
 }
 
-void PlSymbolTable::ScTable::dump(base::StrBld& bld)
+EntityType PlSymbolTable::ScTable::getOne(uint32 scid, uint32 symid, size_t* count)
 {
-    for (auto it : mTbl)
+    // If more than one entries exist, returns the first one
+    auto it = mSyms.find(symKey(scid, symid));
+    if (it == mSyms.end())
     {
-        std::string scope = it.first;
-        if (scope.back() == '>')
+        if (count)
         {
-            size_t cnt = 0;
-            for (auto jt : mTbl)
-            {
-                std::string key = jt.first;
-                std::string s;
-                auto pos = key.find_last_of('.');
-                if (pos != key.npos && key.back() != '>')
-                {
-                    s = key.substr(pos + 1);
-                    key = key.substr(0, pos);
-                    if (key == scope)
-                    {
-                        if (cnt == 0)
-                        {
-                            bld.appendFmt("'%s'\n", scope.c_str());
-                        }
-                        bld.appendFmt("    '%s': %llx\n", s.c_str(), (void*)(jt.second));
-                        cnt++;
-                    }
-                }
-            }
+            *count = 0;
+        }
+        return nullptr;
+    }
+    if (count)
+    {
+        *count = it->second.mCount;
+    }
+    return mRows[it->second.mFirst].mEn;
+}
 
+void PlSymbolTable::ScTable::dump(base::StrBld& bld)
+{
+    // Sort by scope, then symbol name to keep the output stable
+    struct Ent
+    {
+        strparam sc;
+        strparam sym;
+        uint32 first;
+    };
+    std::vector<Ent> ents;
+    ents.reserve(mSyms.size());
+    for (auto& it : mSyms)
+    {
+        ents.push_back(Ent{scopeStr((uint32)(it.first >> 32)), mAtoms.str((uint32)it.first), it.second.mFirst});
+    }
+    std::sort(ents.begin(), ents.end(), [](const Ent& a, const Ent& b)
+    {
+        return a.sc != b.sc ? a.sc < b.sc : a.sym < b.sym;
+    });
+
+    strparam cursc;
+    for (size_t i = 0; i < ents.size(); i++)
+    {
+        if (i == 0 || ents[i].sc != cursc)
+        {
+            cursc = ents[i].sc;
+            bld.appendFmt("'%.*s'\n", (int)cursc.size(), cursc.data());
+        }
+        for (uint32 row = ents[i].first; row != NOSCOPE; row = mRows[row].mNext)
+        {
+            bld.appendFmt("    '%.*s': %llx\n", (int)ents[i].sym.size(), ents[i].sym.data(), (uint64)mRows[row].mEn);
         }
     }
 }
@@ -103,40 +163,73 @@ void PlSymbolTable::init()
 
 void PlSymbolTable::pushScope(const char* name)
 {
+    if (mLog)
+    {
+        mLog->mEvents.push_back(PlSymLog::Event{PlSymLog::Op::Push, name, nullptr});
+    }
     scAdd(mScope, name);
-    mTbl.createScopeSc(mScope);
+    mScopeId = mTbl.createScopeSc(mScope);
     //dbglog("SymbolTable push scope, current: %s\n", mScope.c_str());
 }
 
 void PlSymbolTable::popScope()
 {
-    std::string child;
-    mScope = scParent(mScope, &child);
+    if (mLog)
+    {
+        mLog->mEvents.push_back(PlSymLog::Event{PlSymLog::Op::Pop, std::string(), nullptr});
+    }
+    size_t pos = mScope.find_last_of('.');
+    mScope.resize(pos == std::string::npos ? 0 : pos);
+    mScopeId = (mScopeId != ScTable::NOSCOPE) ? mTbl.parentOf(mScopeId) : ScTable::NOSCOPE;
     //dbglog("SymbolTable pop scope, current: %s\n", mScope.c_str());
 }
 
-PlArr<EntityType> PlSymbolTable::findAll(std::string sc, const char* symbol)
+PlArr<EntityType> PlSymbolTable::findAll(strparam sc, const char* symbol)
 {
-    return mTbl.getAll(sc, symbol);
+    uint32 scid = mTbl.scopeId(sc);
+    uint32 symid = mTbl.symId(symbol);
+    if (scid == ScTable::NOSCOPE || symid == PlAtoms::NOATOM)
+    {
+        return PlArr<EntityType>();
+    }
+    PlArr<EntityType> ret = mTbl.getAll(scid, symid);
+    if (!mLazy.empty())
+    {
+        for (size_t i = 0; i < ret.count(); i++)
+        {
+            loadLazy(ret.get(i));
+        }
+    }
+    return ret;
 }
 
-EntityType PlSymbolTable::findSymbolSc(std::string sc, const char* symbol, size_t* count)
+EntityType PlSymbolTable::findSymbolId(uint32 scid, uint32 symid, const char* symbol, size_t* count)
 {
-    EntityType ret = mTbl.getOne(sc, symbol);
+    EntityType ret = nullptr;
+    size_t cn = 0;
+    if (scid != ScTable::NOSCOPE && symid != PlAtoms::NOATOM)
+    {
+        ret = mTbl.getOne(scid, symid, &cn);
+        if (ret && !mLazy.empty())
+        {
+            loadLazy(ret);
+        }
+    }
 
     if (count)
     {
-        size_t cn = mTbl.count(sc, symbol);
         *count = cn;
         if (mSpew && cn > 1)
         {
-            dbglog("%zu dups for symbol '%s' found at sc=%s --returning 1\n", cn, sc.c_str(), symbol);
+            dbglog("%zu dups for symbol '%s' found at sc=%s --returning 1\n", cn, symbol,
+                scid != ScTable::NOSCOPE ? mTbl.scopeStr(scid).data() : "");
         }
     }
 
     if (mSpew)
     {
-        dbglog("findSymbol '%s' in scope '%s': %s\n", symbol, sc.c_str(), ret == nullptr ? "NOT FOUND" : "FOUND ->");
+        dbglog("findSymbol '%s' in scope '%s': %s\n", symbol, scid != ScTable::NOSCOPE ? mTbl.scopeStr(scid).data() : "",
+            ret == nullptr ? "NOT FOUND" : "FOUND ->");
         if (ret != nullptr)
         {
             ret->dbgDump("");
@@ -145,6 +238,11 @@ EntityType PlSymbolTable::findSymbolSc(std::string sc, const char* symbol, size_
     return ret;
 }
 
+EntityType PlSymbolTable::findSymbolSc(strparam sc, const char* symbol, size_t* count)
+{
+    return findSymbolId(mTbl.scopeId(sc), mTbl.symId(symbol), symbol, count);
+}
+
 EntityType PlSymbolTable::findSymbol(const char* symbol)
 {
     return findSymbol(symbol, nullptr, nullptr);
@@ -152,19 +250,19 @@ EntityType PlSymbolTable::findSymbol(const char* symbol)
 
 EntityType PlSymbolTable::findSymbol(const char* symbol, std::string* retsc, size_t* count)
 {
-    std::string sc = mScope;
-    while (!sc.empty())
+    // Walk from the current scope up through its parents
+    uint32 symid = mTbl.symId(symbol);
+    for (uint32 sc = mScopeId; sc != ScTable::NOSCOPE; sc = mTbl.parentOf(sc))
     {
-        EntityType en = findSymbolSc(sc, symbol, count);
+        EntityType en = findSymbolId(sc, symid, symbol, count);
         if (en)
         {
             if (retsc)
             {
-                *retsc = sc;
+                retsc->assign(mTbl.scopeStr(sc));
             }
             return en;
         }
-        sc = scParent(sc);
     }
     return nullptr;
 }
@@ -172,31 +270,50 @@ EntityType PlSymbolTable::findSymbol(const char* symbol, std::string* retsc, siz
 
 bool PlSymbolTable::addSymbol(const char* symbol, EntityType en, PlUnit* unit)
 {
-    return addSymbolSc(mScope, symbol, en, unit);
+    uint32 scid = (mScopeId != ScTable::NOSCOPE) ? mScopeId : mTbl.createScopeSc(mScope);
+    return addSymbolId(scid, symbol, en, unit);
 }
 
-bool PlSymbolTable::addSymbolSc(std::string sc, const char* symbol, EntityType en, PlUnit* unit)
+bool PlSymbolTable::addSymbolSc(strparam sc, const char* symbol, EntityType en, PlUnit* unit)
+{
+    return addSymbolId(mTbl.createScopeSc(sc), symbol, en, unit);
+}
+
+bool PlSymbolTable::addSymbolId(uint32 scid, const char* symbol, EntityType en, PlUnit* unit)
 {
     if (mSpew)
     {
-        dbglog("addSymbol '%s' in scope '%s' %llx\n", symbol, sc.c_str(), (uint64)en);
+        strparam sc = mTbl.scopeStr(scid);
+        dbglog("addSymbol '%s' in scope '%.*s' %llx\n", symbol, (int)sc.size(), sc.data(), (uint64)en);
+    }
+
+    if (mLog)
+    {
+        mLog->mEvents.push_back(PlSymLog::Event{PlSymLog::Op::Add, symbol, en});
+        mLog->mAdded.insert(en);
+        return true;
     }
 
     // TODO: properly implement duplicate names if parameter types are different
     // Currently, we are allowing dups without checking for everything except typedefs
     // check for duplicate at this scopes, and error out if already exists
 
-    auto arr = mTbl.getAll(sc, symbol);
-    if (arr.count() > 0 && en->mKind == EKind::TypeDef)
+    size_t cn = 0;
+    EntityType preven = nullptr;
+    uint32 symid = mTbl.symId(symbol);
+    if (symid != PlAtoms::NOATOM)
+    {
+        preven = mTbl.getOne(scid, symid, &cn);
+    }
+    if (cn > 0 && en->mKind == EKind::TypeDef)
     {
-        EntityType preven = arr.get(0);
-        std::string prevunit = (preven->mUnit != nullptr) ? preven->mUnit->mName : "";
+        std::string prevunit = (preven && preven->mUnit != nullptr) ? preven->mUnit->mName : "";
         unit->mErrCol.add(preven, "Duplicate symbol '%s' from unit '%s' previously added from unit '%s'",
             symbol, unit->mName.c_str(), prevunit.c_str());
         return false;
     }
 
-    mTbl.createSymbolSc(sc, symbol, en);
+    mTbl.createSymbolSc(scid, symbol, en);
 
     if (en)
     {
@@ -207,6 +324,38 @@ bool PlSymbolTable::addSymbolSc(std::string sc, const char* symbol, EntityType e
     return true;
 }
 
+void PlSymbolTable::addSymScope(EntityType en, const std::string& sc)
+{
+    if (mLog)
+    {
+        mLog->mEvents.push_back(PlSymLog::Event{PlSymLog::Op::SymScope, sc, en});
+        return;
+    }
+    en->createResol(nullptr, sc.c_str(), ETag::SymScope);
+}
+
+bool PlSymbolTable::isSymbol(EntityType en)
+{
+    return en->hasAttrib(EAttribFlags::a_symbol) || (mLog && mLog->mAdded.count(en));
+}
+
+void PlSymbolTable::addLazy(EntityType en, PlLazyAst* ast, uint32 decl)
+{
+    mLazy[en] = LazyRef{ast, decl};
+}
+
+void PlSymbolTable::loadLazy(EntityType en)
+{
+    if (en && en->hasAttrib(EAttribFlags::a_lazy))
+    {
+        auto it = mLazy.find(en);
+        if (it != mLazy.end())
+        {
+            it->second.mAst->loadDecl(it->second.mDecl);
+        }
+    }
+}
+
 void PlSymbolTable::dumpSymbols(base::StrBld& bld)
 {
     mTbl.dump(bld);
@@ -221,18 +370,18 @@ void PlSymbolTable::dbgDump()
 #endif
 }
 
-std::string PlSymbolTable::scParent(std::string scope, std::string* child)
+std::string PlSymbolTable::scParent(strparam scope, std::string* child)
 {
     size_t pos = scope.find_last_of('.');
-    if (pos == std::string::npos)
+    if (pos == strparam::npos)
     {
         return std::string();
     }
     if (child)
     {
-        *child = scope.substr(pos + 1);
+        child->assign(scope.substr(pos + 1));
     }
-    return scope.substr(0, pos);
+    return std::string(scope.substr(0, pos));
 }
 
 void PlSymbolTable::scAdd(std::string& scope, strparam child)
@@ -284,7 +433,7 @@ void PlSymbolAg::process(EntityType en, const char* name)
                 mSymTable->scAdd(sc, name);
 
                 // Create a symscope for this scope
-                en->createResol(nullptr, sc.c_str(), ETag::SymScope);
+                mSymTable->addSymScope(en, sc);
             }
         }
         mSymTable->pushScope(name);
@@ -296,7 +445,7 @@ void PlSymbolAg::process(EntityType en, const char* name)
             for (int i = 0; i < arr.count(); i++)
             {
                 EntityType e = arr.get(i);
-                mSymTable->addSymbol(e->getStr().c_str(), e, mUnit);
+                mSymTable->addSymbol(e->mToken.cstr(), e, mUnit);
             }
         }
 
@@ -75,7 +75,8 @@ enummapdef(EKindEnumList, EKind, sEKindMap, 0);
     _en_(CondVal)              \
     _en_(SwitchVal)            \
     _en_(CaseVal)              \
-    _en_(TemplArg)
+    _en_(TemplArg)             \
+    _en_(ReduceVar)
 enummapdef(ETagEnumList, ETag, sETagMap, 0);
 
 // Entity attrib flags
@@ -91,7 +92,9 @@ enummapdef(ETagEnumList, ETag, sETagMap, 0);
     _en_(a_noderef, 8)         \
     _en_(a_cppobject, 9)       \
     _en_(a_templtype, 10)      \
-    _en_(a_boxed, 11)
+    _en_(a_boxed, 11)          \
+    _en_(a_lazy, 12)           \
+    _en_(a_parallel, 13)
 flagsdef64(AttribFlagList, EAttribFlags);
 
 // Entity attrib flag strings
@@ -108,7 +111,9 @@ inline const char* entityattrib_Strings[] =
     "noderef",
     "cppobject",
     "templtype",
-    "boxed"
+    "boxed",
+    "lazy",
+    "parallel"
 };
 strmapdef(entityattrib_Strings, sEntityAttribMap);
 
@@ -140,7 +145,7 @@ strmapdef(entityattrib_Strings, sEntityAttribMap);
     _en_(kw_loop)             \
     _en_(kw_break)            \
     _en_(kw_continue)
-enummapdef(KeywordEnumList, Keyword, sKeywordMap, 3);
+enumhashmapdef(KeywordEnumList, Keyword, sKeywordMap, 3);
 
 // Data types
 // NOTE: We need to have d_ prefix because reserved words cannot be enum
@@ -163,11 +168,12 @@ enummapdef(KeywordEnumList, Keyword, sKeywordMap, 3);
     _en_(d_bool)              \
     _en_(d_string)            \
     _en_(d_czstr)             \
-    _en_(d_array)
-enummapdef(DataTypeEnumList, DataType, sDataTypeMap, 2);
+    _en_(d_array)             \
+    _en_(d_strview)
+enumhashmapdef(DataTypeEnumList, DataType, sDataTypeMap, 2);
 
 // Expression operators
-inline const char* exprops_Strings[] =
+inline constexpr const char* exprops_Strings[] =
 {
     "+",
     "-",
@@ -187,10 +193,10 @@ inline const char* exprops_Strings[] =
     ">>",
     "<<"
 };
-strmapdef(exprops_Strings, sExprOpsMap);
+strhashmapdef(exprops_Strings, sExprOpsMap);
 
 // Assignment operators
-inline const char* assignops_Strings[] =
+inline constexpr const char* assignops_Strings[] =
 {
     "=",
     "*=",
@@ -199,7 +205,7 @@ inline const char* assignops_Strings[] =
     "+=",
     "-="
 };
-strmapdef(assignops_Strings, sAssignOpsMap);
+strhashmapdef(assignops_Strings, sAssignOpsMap);
 
 // C++ keywords
 #define CppKeywordEnumList(_en_) \
@@ -295,6 +301,19 @@ enummapdef(UnitTypeList, UnitType, sUnitTypeMap, 0);
     _en_(RelWithDebInfo)
 enummapdef(BuildConfigList, BuildConfig, sBuildConfigMap, 0);
 
+// Build phases timed by --profile
+#define ProfPhaseList(_en_) \
+    _en_(tokenize)          \
+    _en_(parse)             \
+    _en_(loadUnits)         \
+    _en_(fixupAll)          \
+    _en_(validateAll)       \
+    _en_(gatherAllPubs)     \
+    _en_(generate)          \
+    _en_(configure)         \
+    _en_(build)
+enummapdef(ProfPhaseList, ProfPhase, sProfPhaseMap, 0);
+
 // Output formats that the codegen can output
 #define OutputFmtList(_en_) \
     _en_(cpp)               \
@@ -322,9 +341,14 @@ enummapdef(CppDirecTypeList, CppDirecType, sCppDirecTypeMap, 0);
     _en_(interfreftype)   \
     _en_(createmethod)    \
     _en_(unitwidehdrfn)   \
+    _en_(unitpchhdrfn)    \
+    _en_(unityprefix)     \
     _en_(strlitctor)      \
     _en_(strtype   )      \
     _en_(boxclass)        \
-    _en_(boxdatafld)
+    _en_(boxdatafld)      \
+    _en_(parallelfor)     \
+    _en_(reduceadd)       \
+    _en_(strconcat)
 
 enummapdef(CppPropList, CppPropType, sCppPropTypeMap, 0);
\ No newline at end of file
@@ -0,0 +1,671 @@
+#include "primalc.h"
+
+#include "tests.h"
+
+void testSymScope()
+{
+    PlUnit unit;
+    PlSymbolTable st;
+    st.init();
+
+    PlToken tok;
+    tok.setStr("Root");
+    PlArena arena;
+    EntityType root = PlEntity::newRoot(&arena, EKind::FileRoot, tok);
+    EntityType en1 = PlEntity::newEntity(root, EKind::VarDecl, tok);
+    EntityType en2 = PlEntity::newEntity(root, EKind::VarDecl, tok);
+    EntityType en3 = PlEntity::newEntity(root, EKind::FuncBody, tok);
+
+    st.addSymbol("x", en1, &unit);
+    st.pushScope("Foo");
+    st.addSymbol("y", en2, &unit);
+    st.addSymbol("y", en3, &unit);
+    st.pushScope("bar");
+
+    std::string sc;
+    size_t cnt = 0;
+    TESTEXP("findSymbol outer scope", st.findSymbol("x", &sc, &cnt) == en1 && sc == "unitwide>" && cnt == 1);
+    TESTEXP("findSymbol dups returns first", st.findSymbol("y", &sc, &cnt) == en2 && sc == "unitwide>.Foo>" && cnt == 2);
+    TESTEXP("findSymbol missing", st.findSymbol("nosuchsym") == nullptr);
+    TESTEXP("findSymbolSc", st.findSymbolSc("unitwide>.Foo>", "y", nullptr) == en2);
+    TESTEXP("findSymbolSc no walk", st.findSymbolSc("unitwide>.Foo>.bar>", "x", nullptr) == nullptr);
+    TESTEXP("findSymbolSc unknown scope", st.findSymbolSc("unitwide>.Nope>", "y", nullptr) == nullptr);
+
+    PlArr<EntityType> all = st.findAll("unitwide>.Foo>", "y");
+    TESTEXP("findAll", all.count() == 2 && all.get(0) == en2 && all.get(1) == en3);
+
+    st.popScope();
+    st.popScope();
+    TESTEXP("popScope", st.scCur() == "unitwide>" && st.findSymbol("y") == nullptr);
+
+    // Adding into a scope by string creates the parent chain
+    st.addSymbolSc("unitwide>.Baz>.qux>", "z", en1, &unit);
+    st.pushScope("Baz");
+    st.pushScope("qux");
+    TESTEXP("addSymbolSc new scope", st.findSymbol("z") == en1 && st.findSymbol("x") == en1);
+    st.popScope();
+    st.popScope();
+
+    std::string child;
+    TESTEXP("scParent", PlSymbolTable::scParent("unitwide>.Foo>", &child) == "unitwide>" && child == "Foo>");
+
+    // Scopes come out in table order, so just look for each of them
+    base::StrBld bld;
+    st.dumpSymbols(bld);
+    std::string dump = bld.c_str();
+    TESTEXP("dumpSymbols", dump.find("'unitwide>'\n    'x': ") != std::string::npos &&
+                           dump.find("'unitwide>.Foo>'\n    'y': ") != std::string::npos &&
+                           dump.find("'unitwide>.Baz>.qux>'\n    'z': ") != std::string::npos &&
+                           dump.find("'y'", dump.find("'y'") + 1) != std::string::npos);
+}
+
+void testEnRange()
+{
+    PlArena arena;
+    EntityType root = PlEntity::newRoot(&arena, EKind::FileRoot, PlToken::sNilTok);
+    EntityType v1 = PlEntity::newEntity(root, EKind::VarDecl, PlToken::sNilTok);
+    PlEntity::newEntity(root, EKind::FuncBody, PlToken::sNilTok);
+    EntityType v2 = PlEntity::newEntity(root, EKind::VarDecl, PlToken::sNilTok);
+    EntityType v3 = PlEntity::newEntity(root, EKind::VarDecl, PlToken::sNilTok, ETag::VarType);
+
+    size_t cnt = 0;
+    for (EntityType e : root->getChildren(EKind::VarDecl))
+    {
+        cnt += (e == v1 || e == v2);
+    }
+    TESTEXP("range filters kind", cnt == 2 && root->getChildren(EKind::VarDecl).count() == 2);
+    TESTEXP("range first/get", root->getChild(EKind::VarDecl) == v1 && root->getChildren(EKind::VarDecl).get(1) == v2);
+    TESTEXP("range get past end", root->getChildren(EKind::VarDecl).get(2) == nullptr);
+    TESTEXP("range by tag", root->getChildren(EKind::VarDecl, ETag::VarType).first() == v3);
+    TESTEXP("range empty", root->getChildren(EKind::Literal).empty() && root->getChildren(EKind::VarDecl, ETag::AssignVal).empty());
+}
+
+void testTokAtoms()
+{
+    PlToken t1, t2, t3;
+    t1.setStr("averyveryverylongidentifier");
+    t2.setStr("averyveryverylongidentifier_x", 27);
+    t3.setStr("while");
+    TESTEXP("same string same atom", t1.equals(t2) && t1.atom() == t2.atom() && t1.length() == 27);
+    TESTEXP("token string", t2.equals("averyveryverylongidentifier") && t2.toString() == t1.cstr());
+    TESTEXP("keyword atom", t3.isKeyword() && t3.is(Keyword::kw_while) && !t3.is(Keyword::kw_for));
+    TESTEXP("ident not keyword", !t1.isKeyword() && !PlToken::sNilTok.isKeyword() && PlToken::sNilTok.isEmpty());
+
+    PlDiscern di;
+    TESTEXP("isSimpleIdent", di.isSimpleIdent(t1) && !di.isSimpleIdent(t3) && !di.isSimpleIdent("continue") && di.isSimpleIdent("continue2"));
+}
+
+// Synthetic unit with objcnt objects of fldcnt fields each, every object has
+// an impl whose method assigns fields, so resolution walks method -> impl -> unit scopes.
+static bool writeSynthUnit(const base::Path& fn, int objcnt, int fldcnt)
+{
+    base::StrBld src;
+    for (int i = 0; i < objcnt; i++)
+    {
+        src.appendFmt("object Obj%d\n{\n", i);
+        for (int j = 0; j < fldcnt; j++)
+        {
+            src.appendFmt("    int32 f%d\n", j);
+        }
+        src.appendFmt("}\n\nimpl Obj%d\n{\n    func touch%d()\n    {\n", i, i);
+        for (int j = 0; j < fldcnt; j += 7)
+        {
+            src.appendFmt("        f%d = %d\n", j, j);
+        }
+        src.append("    }\n}\n\n");
+    }
+
+    base::Buffer buf;
+    src.moveToBuffer(buf);
+    return plWrite("Synthetic unit", buf, fn);
+}
+
+// A source file parsed for a test, with the unit and symbol table it was
+// parsed into.  The tree lives as long as this does.
+struct ParsedSrc
+{
+    PlUnit mUnit;
+    PlSymbolTable mSymTable;
+    PlArena mArena;
+};
+
+// Writes txt to the file, parses it and deletes the file, then resolves
+// and checks the tree if asked to, with any errors in the unit's list.
+// The root of the tree, or nullptr if it didn't parse.
+static EntityType parseSrc(ParsedSrc& ps, const char* filename, const char* txt, bool resolve = false)
+{
+    base::Path fn(filename);
+    base::Buffer buf;
+    buf.alloc(strlen(txt));
+    memcpy(buf.ptr(), txt, strlen(txt));
+    if (!plWrite(filename, buf, fn))
+    {
+        return nullptr;
+    }
+
+    ps.mSymTable.init();
+    EntityType root = PlEntity::newRoot(&ps.mArena, EKind::FileRoot, PlToken::sNilTok);
+    bool parsed = plParseFile(fn, &ps.mSymTable, &ps.mUnit, root, nullptr);
+    base::deleteFile(fn);
+    if (!parsed)
+    {
+        return nullptr;
+    }
+
+    if (resolve)
+    {
+        PlResolver reso;
+        reso.init(&ps.mSymTable, &ps.mUnit);
+        reso.fixupAll(root);
+        reso.validateAll(root, ETag::Primary);
+    }
+    return root;
+}
+
+// Sets cpp properties for a test, and puts back what they were when it
+// goes out of scope, however the test ends
+class CppPropScope
+{
+public:
+    ~CppPropScope()
+    {
+        for (auto it = mSaved.rbegin(); it != mSaved.rend(); ++it)
+        {
+            sCppProp.setStr(it->first, it->second);
+        }
+    }
+    void set(CppPropType prop, const char* value)
+    {
+        mSaved.push_back({ prop, sCppProp.getStr(prop) });
+        sCppProp.setStr(prop, value);
+    }
+
+private:
+    std::vector<std::pair<CppPropType, std::string>> mSaved;
+};
+
+static EntityType findFirst(EntityType root, EKind kind)
+{
+    if (root)
+    {
+        for (PlEnWalk w(root); w.next(); )
+        {
+            if (w.cur()->mKind == kind)
+            {
+                return w.cur();
+            }
+        }
+    }
+    return nullptr;
+}
+
+void testSymBench()
+{
+    constexpr int objcnt = 1000;
+    constexpr int fldcnt = 100;
+
+    base::Path fn("pctest_syms.pc");
+    TESTEXP("Write synthetic unit", writeSynthUnit(fn, objcnt, fldcnt));
+
+    PlUnit unit;
+    PlSymbolTable st;
+    st.init();
+
+    PlArena arena;
+    EntityType root = PlEntity::newRoot(&arena, EKind::FileRoot, PlToken::sNilTok);
+
+    bool parsed = false;
+    TIME("parse 100k symbols")
+    parsed = plParseFile(fn, &st, &unit, root, nullptr);
+    TIMEEND()
+    TESTEXP("plParseFile", parsed);
+
+    PlResolver reso;
+    reso.init(&st, &unit);
+    TIME("fixupAll 100k symbols")
+    reso.fixupAll(root);
+    TIMEEND()
+
+    // Direct lookups the way the resolver does them: nearest scope first, then
+    // walking up, plus lookups by explicit scope string.
+    size_t found = 0;
+    TIME("findSymbol 1M lookups")
+    for (int i = 0; i < 1000000; i++)
+    {
+        std::string ob = base::formatr("Obj%d", i % objcnt);
+        found += st.findSymbol(ob.c_str()) != nullptr;
+    }
+    TIMEEND()
+    TESTEXP("findSymbol hits", found == 1000000);
+
+    found = 0;
+    TIME("findSymbolSc 1M lookups")
+    for (int i = 0; i < 1000000; i++)
+    {
+        std::string sc = PlSymbolTable::scAtUnitwide(base::formatr("Obj%d", i % objcnt));
+        std::string fld = base::formatr("f%d", i % fldcnt);
+        found += st.findSymbolSc(sc, fld.c_str(), nullptr) != nullptr;
+    }
+    TIMEEND()
+    TESTEXP("findSymbolSc hits", found == 1000000);
+
+    base::deleteFile(fn);
+}
+
+void testAstPersist()
+{
+    base::Path fn("pctest_ast.pc");
+    base::Path fn1("pctest_ast1.ast");
+    base::Path fn2("pctest_ast2.ast");
+    TESTEXP("Write synthetic unit", writeSynthUnit(fn, 1000, 100));
+
+    PlUnit unit;
+    PlSymbolTable st;
+    st.init();
+    PlArena arena;
+    EntityType root = PlEntity::newRoot(&arena, EKind::FileRoot, PlToken::sNilTok);
+    TESTEXP("plParseFile", plParseFile(fn, &st, &unit, root, nullptr));
+
+    // Old tagged format against the packed one
+    TIME("PersistWr save")
+    base::PersistWr pwr(L_ENTITYFILESIG);
+    root->saveEntity(pwr);
+    pwr.save(fn1);
+    TIMEEND()
+    TIME("PackWr save")
+    base::PackWr pkw(L_ENTITYFILESIG, C_ENTFILEVER);
+    root->saveEntity(pkw);
+    pkw.save(fn2);
+    TIMEEND()
+
+    base::Buffer b1, b2;
+    b1.readFile(fn1, false);
+    b2.readFile(fn2, false);
+    printf("PersistWr %zu bytes, PackWr %zu bytes\n", b1.size(), b2.size());
+    TESTEXP("Packed is smaller", b2.size() * 2 < b1.size());
+
+    PlArena arena1, arena2;
+    EntityType root1 = nullptr;
+    EntityType root2 = nullptr;
+    TIME("PersistRd load")
+    base::PersistRd prd(L_ENTITYFILESIG);
+    if (prd.load(fn1))
+    {
+        root1 = PlEntity::loadEntity(prd, &arena1);
+    }
+    TIMEEND()
+    TIME("PackRd load")
+    PlLazyAst ast;
+    if (ast.load(fn2, &arena2))
+    {
+        ast.loadAll();
+        root2 = ast.root();
+    }
+    TIMEEND()
+
+    // Both trees must write back byte for byte what the original wrote
+    auto samebytes = [&b2](EntityType en)
+    {
+        base::Buffer b;
+        base::PackWr wr(L_ENTITYFILESIG, C_ENTFILEVER);
+        en->saveEntity(wr);
+        wr.moveToBuffer(b);
+        return b.size() == b2.size() && memcmp(b.cptr(), b2.cptr(), b.size()) == 0;
+    };
+    TESTEXP("Loaded trees match", root1 && root2 && samebytes(root1) && samebytes(root2));
+
+    PlLazyAst legacy;
+    TESTEXP("Old format detected", !legacy.load(b1, &arena1) && legacy.isLegacy());
+
+    base::deleteFile(fn);
+    base::deleteFile(fn1);
+    base::deleteFile(fn2);
+}
+
+void testAstLazy()
+{
+    base::Path fn("pctest_lazy.pc");
+    base::Path astfn("pctest_lazy.ast");
+    TESTEXP("Write synthetic unit", writeSynthUnit(fn, 2000, 100));
+
+    {
+        PlUnit unit;
+        PlSymbolTable st;
+        st.init();
+        PlArena arena;
+        EntityType root = PlEntity::newRoot(&arena, EKind::FileRoot, PlToken::sNilTok);
+        TESTEXP("plParseFile", plParseFile(fn, &st, &unit, root, nullptr));
+        base::PackWr pwr(L_ENTITYFILESIG, C_ENTFILEVER);
+        root->saveEntity(pwr);
+        TESTEXP("Save AST", pwr.save(astfn));
+    }
+
+    // Everything registered from the loaded tree
+    PlUnit unit;
+    PlSymbolTable st1;
+    st1.init();
+    PlArena arena1;
+    PlLazyAst ast1;
+    TIME("Eager load and register")
+    if (ast1.load(astfn, &arena1))
+    {
+        ast1.loadAll();
+        ast1.root()->updateSymTbl(ETag::Primary, &st1, &unit);
+    }
+    TIMEEND()
+
+    // Names only, then a few lookups the way a dependant unit would
+    PlSymbolTable st2;
+    st2.init();
+    PlArena arena2;
+    PlLazyAst ast2;
+    std::vector<EntityType> loaded;
+    TIME("Lazy load, register and 10 lookups")
+    if (ast2.load(astfn, &arena2))
+    {
+        ast2.addSymbols(&st2, &unit);
+        for (int i = 0; i < 10; i++)
+        {
+            std::string ob = base::formatr("Obj%d", i * 97);
+            st2.findSymbol(ob.c_str());
+        }
+    }
+    TIMEEND()
+    TESTEXP("Lazy has stubs", ast2.root() && ast2.declCount() == 4000 && ast2.takeLoaded(loaded) && loaded.size() == 10);
+
+    EntityType ob = st2.findSymbol("Obj194");
+    TESTEXP("Lookup loads declaration", ob && !ob->hasAttrib(EAttribFlags::a_lazy) && ob->hasAttrib(EAttribFlags::a_symbol) &&
+        ob->getChildren(EKind::ObjectFld).count() == 100 && ob->getChildren(EKind::Resol, ETag::SymScope).count() == 1);
+    EntityType fld = st2.findSymbolSc(PlSymbolTable::scAtUnitwide("Obj1999"), "f42", nullptr);
+    TESTEXP("Lookup of nested stub", fld && fld->mKind == EKind::ObjectFld && !fld->hasAttrib(EAttribFlags::a_lazy) &&
+        st2.findSymbol("Obj1999")->getChildren(EKind::ObjectFld).get(42) == fld);
+
+    // Once everything is loaded, both trees are the same
+    ast2.loadAll();
+    auto savebytes = [](EntityType en, base::Buffer& b)
+    {
+        base::PackWr wr(L_ENTITYFILESIG, C_ENTFILEVER);
+        en->saveEntity(wr);
+        wr.moveToBuffer(b);
+    };
+    base::Buffer b1, b2;
+    savebytes(ast1.root(), b1);
+    savebytes(ast2.root(), b2);
+    TESTEXP("Lazy tree matches eager", b1.size() == b2.size() && memcmp(b1.cptr(), b2.cptr(), b1.size()) == 0);
+
+    base::deleteFile(fn);
+    base::deleteFile(astfn);
+}
+
+void testDeepExpr()
+{
+    // Each bracket level is a ParanExpr holding an Expr
+    constexpr int depth = 25000;
+    base::Path fn("pctest_deep.pc");
+    base::Path astfn("pctest_deep.ast");
+
+    base::StrBld src;
+    src.append("func deep() -> int32\n{\n    return ");
+    for (int i = 0; i < depth; i++)
+    {
+        src.append("(");
+    }
+    src.append("1");
+    for (int i = 0; i < depth; i++)
+    {
+        src.append(" + 1)");
+    }
+    src.append("\n}\n");
+    base::Buffer buf;
+    src.moveToBuffer(buf);
+    TESTEXP("Write deep expression", plWrite("Deep expression", buf, fn));
+
+    PlUnit unit;
+    PlSymbolTable st;
+    st.init();
+    PlArena arena;
+    EntityType root = PlEntity::newRoot(&arena, EKind::FileRoot, PlToken::sNilTok);
+    bool parsed = false;
+    TIME("parse deep expression")
+    parsed = plParseFile(fn, &st, &unit, root, nullptr);
+    TIMEEND()
+
+    uint32 nodes = 0;
+    size_t maxdepth = 0;
+    for (PlEnWalk w(root); w.next(); )
+    {
+        nodes++;
+        maxdepth = std::max(maxdepth, w.depth());
+    }
+    printf("%u nodes, %zu deep\n", nodes, maxdepth);
+    TESTEXP("Parsed nesting", parsed && maxdepth > depth * 2 && root->nodeCount() == nodes);
+
+    PlResolver reso;
+    reso.init(&st, &unit);
+    TIME("fixupAll deep expression")
+    reso.fixupAll(root);
+    TIMEEND()
+
+    base::PackWr pwr(L_ENTITYFILESIG, C_ENTFILEVER);
+    TIME("save deep expression")
+    root->saveEntity(pwr);
+    TESTEXP("Save AST", pwr.save(astfn));
+    TIMEEND()
+
+    PlArena arena2;
+    PlLazyAst ast;
+    TIME("load deep expression")
+    if (ast.load(astfn, &arena2))
+    {
+        ast.loadAll();
+    }
+    TIMEEND()
+    TESTEXP("Loaded nesting", ast.root() && ast.root()->nodeCount() == nodes);
+
+    base::PersistWr legacywr(L_ENTITYFILESIG);
+    root->saveEntity(legacywr);
+    PlArena arena3;
+    base::PersistRd legacyrd(L_ENTITYFILESIG);
+    EntityType root3 = nullptr;
+    if (legacywr.save(astfn) && legacyrd.load(astfn))
+    {
+        root3 = PlEntity::loadEntity(legacyrd, &arena3);
+    }
+    TESTEXP("Legacy round trip", root3 && root3->nodeCount() == nodes);
+
+    base::deleteFile(fn);
+    base::deleteFile(astfn);
+}
+
+void testParallelFor()
+{
+    {
+        ParsedSrc ps;
+        EntityType range = findFirst(parseSrc(ps, "pctest_par.pc",
+            "func f(usize n) -> int64\n{\n"
+            "    var int64 sum = 0\n    var int64 cnt = 0\n"
+            "    for i : parallel(sum, cnt) range(0, n)\n    {\n"
+            "        continue if i % 3 == 0\n"
+            "        for j : range(0, 4)\n        {\n            break if j == i\n        }\n"
+            "        sum += i\n        cnt += 1\n    }\n"
+            "    return sum\n}\n"), EKind::Range);
+        PlSpan<EntityType> reducevars = range ? range->getChildren(ETag::ReduceVar) : PlSpan<EntityType>();
+        TESTEXP("Parse parallel for", range && range->hasAttrib(EAttribFlags::a_parallel));
+        TESTEXP("Sum variables", reducevars.count() == 2 && reducevars.get(0)->getStr() == "sum" && reducevars.get(1)->getStr() == "cnt");
+    }
+    {
+        ParsedSrc ps;
+        EntityType range = findFirst(parseSrc(ps, "pctest_par.pc", "func f()\n{\n    for i : parallel range(0, 10)\n    {\n    }\n}\n"), EKind::Range);
+        TESTEXP("Parallel without sums", range && range->hasAttrib(EAttribFlags::a_parallel) && range->getChildren(ETag::ReduceVar).empty());
+    }
+    {
+        // Only a marker after the ':', so it can still name a var
+        ParsedSrc ps;
+        EntityType range = findFirst(parseSrc(ps, "pctest_par.pc",
+            "func f()\n{\n    var int64 parallel = 3\n"
+            "    for i : parallel(parallel) range(0, parallel)\n    {\n        parallel += i\n    }\n}\n"), EKind::Range);
+        PlSpan<EntityType> reducevars = range ? range->getChildren(ETag::ReduceVar) : PlSpan<EntityType>();
+        TESTEXP("Parallel as a name", range && range->hasAttrib(EAttribFlags::a_parallel) &&
+            reducevars.count() == 1 && reducevars.get(0)->getStr() == "parallel");
+    }
+
+    // Sums are looked up when resolving, the same loop with different ones
+    auto sumsSrc = [](const char* sums)
+    {
+        return base::formatr(
+            "interf CppString\n{\n}\n"
+            "type string ::= cpp.type(\"primal::string\", CppString)\n"
+            "func f(float64 scale)\n{\n"
+            "    var int64 sum = 0\n    var string s = \"\"\n    var x = 0\n"
+            "    for i : parallel(%s) range(0, 100)\n    {\n    }\n}\n", sums);
+    };
+    {
+        ParsedSrc ps;
+        EntityType range = findFirst(parseSrc(ps, "pctest_par.pc", sumsSrc("sum, scale, x").c_str(), true), EKind::Range);
+        PlSpan<EntityType> reducevars = range ? range->getChildren(ETag::ReduceVar) : PlSpan<EntityType>();
+        TESTEXP("Sums resolved", range && !ps.mUnit.mErrCol.hasErrs() && reducevars.count() == 3 &&
+            reducevars.get(0)->mResolvedRef && reducevars.get(0)->mResolvedRef->mKind == EKind::VarDecl &&
+            reducevars.get(1)->mResolvedRef && reducevars.get(1)->mResolvedRef->mKind == EKind::FuncParam &&
+            reducevars.get(2)->mResolvedRef && reducevars.get(2)->mResolvedRef->mKind == EKind::VarDecl);
+    }
+    {
+        ParsedSrc ps;
+        EntityType root = parseSrc(ps, "pctest_par.pc", sumsSrc("sum, nosuch").c_str(), true);
+        TESTEXP("Undefined sum", root && ps.mUnit.mErrCol.hasErrs());
+    }
+    {
+        ParsedSrc ps;
+        EntityType root = parseSrc(ps, "pctest_par.pc", sumsSrc("s").c_str(), true);
+        TESTEXP("Sum that isn't a number", root && ps.mUnit.mErrCol.hasErrs());
+    }
+
+    ParsedSrc brk;
+    ParsedSrc ret;
+    ParsedSrc rev;
+    TESTEXP("No break out of a parallel for",
+        !parseSrc(brk, "pctest_par.pc", "func f()\n{\n    for i : parallel range(0, 10)\n    {\n        break\n    }\n}\n"));
+    TESTEXP("No return from a parallel for",
+        !parseSrc(ret, "pctest_par.pc", "func f()\n{\n    for i : parallel range(0, 10)\n    {\n        for j : range(0, 2)\n        {\n            return\n        }\n    }\n}\n"));
+    TESTEXP("No reversed parallel for",
+        !parseSrc(rev, "pctest_par.pc", "func f()\n{\n    for i : parallel rev range(0, 10)\n    {\n    }\n}\n"));
+}
+
+void testTemplTypeScope()
+{
+    // A template type first used in an object field is found from a function
+    ParsedSrc ps;
+    EntityType root = parseSrc(ps, "pctest_templ.pc",
+        "object Holder\n{\n    Vector<Item> items\n}\n"
+        "func f()\n{\n    var Vector<Item> v = new Vector<Item>\n}\n");
+    TESTEXP("Parse template unit", root);
+
+    EntityType td = root ? root->getChildren(EKind::TypeDef).first() : nullptr;
+    std::string tdname = td ? td->getStr() : "";
+    TESTEXP("One typedef for both uses", td && root->getChildren(EKind::TypeDef).count() == 1);
+    TESTEXP("Typedef is unitwide", td && ps.mSymTable.findSymbolSc("unitwide>", tdname.c_str(), nullptr) == td);
+}
+
+void testTemplArgList()
+{
+    // A cpp type takes its template arguments from the interface it maps
+    ParsedSrc ps;
+    EntityType root = parseSrc(ps, "pctest_templargs.pc",
+        "interf CppPair<K, V>\n{\n    func get(K key) -> V\n}\n"
+        "type Pair ::= cpp.type(\"Pair\", CppPair, \"template\")\n"
+        "func f()\n{\n    var Pair<string, Item> p = new Pair<string, Item>\n}\n");
+    TESTEXP("Parse template unit", root);
+    if (!root)
+    {
+        return;
+    }
+
+    EntityType intf = root->getChild(EKind::Interf);
+    TESTEXP("Interface arguments", intf && intf->getChildren(EKind::Ident, ETag::TemplArg).count() == 2);
+
+    std::string pairargs;
+    std::string useargs;
+    bool boxed = false;
+    for (EntityType td : root->getChildren(EKind::TypeDef))
+    {
+        if (td->getIdentStr(ETag::TypeName) == "Pair")
+        {
+            for (EntityType ta : td->getChildren(EKind::Ident, ETag::TemplArg))
+            {
+                pairargs += ta->getStr() + " ";
+            }
+        }
+        else if (td->hasAttrib(EAttribFlags::a_templtype))
+        {
+            for (EntityType ta : td->getChildren(EKind::Ident, ETag::TemplArg))
+            {
+                useargs += ta->getStr() + " ";
+            }
+            boxed = td->hasAttrib(EAttribFlags::a_boxed);
+        }
+    }
+    TESTEXP("Cpp type arguments named as in the interface", pairargs == "K V ");
+    TESTEXP("Arguments of a use", useargs == "string Item " && boxed);
+}
+
+void testStrViewType()
+{
+    // Slices are a built-in value type, passed where strings are and back
+    ParsedSrc ps;
+    EntityType root = parseSrc(ps, "pctest_strview.pc",
+        "interf CppString\n{\n    func view() -> strview\n}\n"
+        "type string ::= cpp.type(\"primal::string\", CppString)\n"
+        "interf CppStrView\n{\n    func trim() -> strview\n}\n"
+        "type strview ::= cpp.type(\"primal::strview\", CppStrView)\n"
+        "func show(strview v)\n{\n}\n"
+        "func f()\n{\n    var string s = \" a \"\n    var strview v = s.view()\n"
+        "    show(\"lit\")\n    show(s)\n    show(v.trim())\n}\n", true);
+    TESTEXP("Calls checked", root && !ps.mUnit.mErrCol.hasErrs());
+
+    DataType vdt = DataType::d_none;
+    for (PlEnWalk w(root); root && w.next(); )
+    {
+        if (w.cur()->mKind == EKind::VarDecl && w.cur()->getIdentStr(ETag::VarName) == "v")
+        {
+            vdt = w.cur()->mDT;
+        }
+    }
+    TESTEXP("Slice var type", vdt == DataType::d_strview);
+}
+
+void testStrConcat()
+{
+    // A + chain of strings is joined in one call, other + chains are left
+    ParsedSrc ps;
+    EntityType root = parseSrc(ps, "pctest_strcat.pc",
+        "func count(string s) -> usize\n{\n    return 0\n}\n"
+        "func f(string name, int64 n) -> string\n{\n"
+        "    var int64 m = n + 4 * (n + 1)\n"
+        "    var string s = \"a\" + name + $m\n"
+        "    var string t = \"c\" + count(name)\n"
+        "    return s + (\"b\" + name)\n}\n", true);
+    TESTEXP("Parse concat unit", root && !ps.mUnit.mErrCol.hasErrs());
+
+    std::string cpp;
+    bool gen = false;
+    {
+        CppPropScope props;
+        props.set(CppPropType::strconcat, "concat");
+        props.set(CppPropType::strlitctor, "str");
+        base::Buffer out;
+        gen = root && plGenerate(&ps.mUnit, root, OutputFmt::cpp, out);
+        cpp.assign((const char*)out.cptr(), out.size());
+    }
+
+    TESTEXP("Generated", gen);
+    TESTEXP("Numbers added", cpp.find("n + 4") != std::string::npos && cpp.find("concat({n") == std::string::npos);
+    TESTEXP("Strings joined", cpp.find("concat({str(\"a\", 1), name, _D(m)})") != std::string::npos);
+    TESTEXP("Not a string term", cpp.find("concat({str(\"c\"") == std::string::npos);
+    // The bracket's type isn't known, so only the chain inside it is joined
+    TESTEXP("Nested chain", cpp.find("s +(concat({str(\"b\", 1), name}))") != std::string::npos);
+    TESTEXP("Props put back", sCppProp.getStr(CppPropType::strconcat).empty());
+}
+
+int main(int argc, char **argv)
+{
+    return RUNTESTS(argc, argv);
+}
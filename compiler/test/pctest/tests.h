@@ -0,0 +1,19 @@
+#pragma once
+
+#include "ytest.h"
+
+#define TESTLIST(TS) \
+    TS(testSymScope) \
+    TS(testEnRange) \
+    TS(testTokAtoms) \
+    TS(testSymBench) \
+    TS(testAstPersist) \
+    TS(testAstLazy) \
+    TS(testDeepExpr) \
+    TS(testParallelFor) \
+    TS(testTemplTypeScope) \
+    TS(testTemplArgList) \
+    TS(testStrViewType) \
+    TS(testStrConcat)
+
+DECLTESTS()
@@ -4,11 +4,25 @@
 
 PlToken PlToken::sNilTok;
 
+PlAtoms& PlToken::atoms()
+{
+    static PlAtoms sAtoms;
+    if (sAtoms.count() == KWFIRST)
+    {
+        // Keywords get the first atoms so a keyword test is a range check
+        for (uint i = 0; i < sKeywordMap.count(); i++)
+        {
+            sAtoms.intern(sKeywordMap.toStringI(i));
+        }
+    }
+    return sAtoms;
+}
+
 std::string PlToken::strNoQuotes(bool allowsingle) const
 {
     std::string s;
     const char* buf = cstr();
-    size_t len = strlen(buf);
+    size_t len = length();
     if (len >= 2)
     {
         char c1 = buf[0];
@@ -109,6 +123,22 @@ bool PlTokenParser::advance(const char* tokstr)
     return false;
 }
 
+bool PlTokenParser::advance(Keyword kw)
+{
+    if (!mParser.failed())
+    {
+        if (token().is(kw))
+        {
+            return advance();
+        }
+        else
+        {
+            pushErr("Expecting token [%s] but found", sKeywordMap.toString(kw));
+        }
+    }
+    return false;
+}
+
 void PlTokenParser::pushErr(const char* fmt, ...)
 {
     base::StrBld str;
@@ -25,6 +25,12 @@ bool PlUnit::init(const base::Path unitpath)
         return false;
     }
 
+    // Optional C++ build settings
+    const base::Variant& bld = mMeta[L_UNITBUILD];
+    int64_t unity = bld[L_UNITUNITY];
+    mUnitySize = (unity > 0) ? (size_t)unity : 0;
+    mPch = bld[L_UNITPCH];
+
     // Init compiler state
     mCompState.init(this);
 
@@ -86,7 +92,11 @@ bool PlUnit::getSrcFiles(bool& srcisnew)
     for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
     {
         base::Path fn(fi->fname());
-        if (newerFile(srcFn(fn), cppFn(fn)))
+        // Generated cpp files are only rewritten when they change, so the AST
+        // written alongside them is what dates the last compile.  A changed
+        // unit.yaml can change what every source generates.
+        base::Path astfn = srcAstFn(fn);
+        if (newerFile(srcFn(fn), astfn) || newerFile(metaFn(), astfn) || !base::existFile(cppFn(fn)))
         {
             srcisnew = true;
             fi->setMod();
@@ -112,7 +122,7 @@ base::Path PlUnit::target(BuildConfig bldcfg)
     }
     else
     {
-        targ.set(buildDir(), "lib");
+        targ.set(buildDir(), L_LIBDIR);
         targ.add(cfg);
         targ.add(mkLibFn(mName));
     }
@@ -161,9 +171,7 @@ bool PlUnit::build(BuildConfig bldcfg)
                 base::Path fn(fi->fname());
                 if (!fi->isErr())
                 {
-                    fi->generateFile(OutputFmt::cpp, cppFn(fn));
-                    fi->generateFile(OutputFmt::header, privHdrFn(fn));
-                    fi->generateFile(OutputFmt::entity, srcAstFn(fn));
+                    fi->generateAll(cppFn(fn), privHdrFn(fn), srcAstFn(fn));
                 }
                 if (mBldDiagFiles)
                 {
@@ -173,36 +181,32 @@ bool PlUnit::build(BuildConfig bldcfg)
         }
 
         // Generate the unit wide header file
-        if (!writeUnitWideHdr())
+        if (!writeUnitWideHdr() || !writeUnityFiles())
         {
             return false;
         }
     }
 
-    // Generate CMake file, if it meta file is newer
-    bool cmakeupdated = false;
-    if (!writeCmake(cmakeupdated))
-    {
-        return false;
-    }
-
-    // Generate Ninja files using CMake
-    if (cmakeupdated)
+    // Generate the ninja build file
+    bool ninjaupdated = false;
     {
-        if (!writeNinjaFiles(targetDir()))
+        PlProfScope ps(ProfPhase::configure, this);
+        if (!writeNinja(ninjaupdated))
         {
             return false;
         }
-        //base::createDirectory(astDir());
     }
 
-    if (srcisnew || cmakeupdated)
+    if (srcisnew || ninjaupdated)
     {
        // Gather public entities for this unit
         mCompState.gatherAllPubs();
 
-        mCompState.generateFile(OutputFmt::pubheader, pubHdrFn());
-        mCompState.generateFile(OutputFmt::entity, unitAstFn());
+        {
+            PlProfScope ps(ProfPhase::generate, this);
+            mCompState.generateFile(OutputFmt::pubheader, pubHdrFn());
+            mCompState.generateFile(OutputFmt::entity, unitAstFn());
+        }
 
         if (mBldDiagFiles)
         {
@@ -215,13 +219,17 @@ bool PlUnit::build(BuildConfig bldcfg)
         return false;
     }
 
-    // Build ninja
-    if (!buildNinja(targetDir(), bldcfg))
+    // Build with ninja, unless there is nothing for it to do
+    if (!isCurrent(bldcfg))
     {
-        return false;
+        PlProfScope ps(ProfPhase::build, this);
+        if (!runNinja(bldcfg))
+        {
+            return false;
+        }
     }
 
-    if (mBldTempFiles && (srcisnew || cmakeupdated))
+    if (mBldTempFiles && (srcisnew || ninjaupdated))
     {
         moveTemps();
     }
@@ -229,69 +237,60 @@ bool PlUnit::build(BuildConfig bldcfg)
     return true;
 }
 
-bool PlUnit::buildNinja(base::Path dir, BuildConfig bldcfg)
+// Ext projects bring their own CMakeLists, and are still configured and
+// built through CMake
+PlCmd PlUnit::buildExtCmd(base::Path dir, BuildConfig bldcfg)
 {
-    bool ret = false;
-    DirPush d(dir);
-
-    // Build ninja
-    // TODO: do we want to use ninja verbose flag only when global verbose flag is turned on
-    std::string bldcmd = base::formatr(
-        "cmake --build ./%s --config %s -- --verbose",
-        L_BUILDDIR,
-        sBuildConfigMap.toString(bldcfg));
-
-    ret = plLogShell(bldcmd, mLog, mErrLog) == 0;
-
-    return ret;
+    // Build ninja, with the full commands in the log only when verbose
+    PlCmd cmd = {{"cmake", "--build", L_BUILDDIR, "--config", sBuildConfigMap.toString(bldcfg)}, dir};
+    if (sVerbose)
+    {
+        cmd.args.insert(cmd.args.end(), {"--", "--verbose"});
+    }
+    return cmd;
 }
 
-bool PlUnit::cleanNinja(base::Path dir)
+bool PlUnit::cleanExtDir(base::Path dir)
 {
-    bool ret = false;
-    DirPush d(dir);
-
     // Clean ninja
-    std::string bldcmd = "cmake --build ./ --target clean";
-    ret = plLogShell(bldcmd, mLog, mErrLog) == 0;
-
-    return ret;
+    return plLogRun({{{"cmake", "--build", ".", "--target", "clean"}, dir}}, mLog, mErrLog);
 }
 
-bool PlUnit::existNinjaFiles(base::Path dir)
+bool PlUnit::existExtBuild(base::Path dir)
 {
     // Do ninja build files exists in subdir Config::ninjabuilddir under given dir
     base::Path checkfn(dir, L_BUILDDIR);
-    checkfn.add("build.ninja");
+    checkfn.add(L_NINJAFN);
     return base::existFile(checkfn);
 }
 
-bool PlUnit::writeNinjaFiles(base::Path dir)
+PlCmd PlUnit::configExtCmd(base::Path dir)
 {
-    bool ret = false;
-    base::Path prevdir;
-    DirPush d(dir);
-
     // Generate Ninja files using CMake
-    std::string cmakecmd = base::formatr("cmake -S ./ -B ./%s -G \"%s\"",
-        L_BUILDDIR,
-        sConfig.getStr(Config::ninjaconfig).c_str());
-    ret = plLogShell(cmakecmd, mLog, mErrLog) == 0;
-
-    return ret;
+    return {{"cmake", "-S", ".", "-B", L_BUILDDIR, "-G", sConfig.getStr(Config::ninjaconfig)}, dir};
 }
 
 bool PlUnit::writeUnitWideHdr()
 {
+    // With a precompiled header, everything up to this unit's own headers
+    // goes in it.  Those change with every edit, and would invalidate it.
     base::StrBld cm;
+    if (mPch)
+    {
+        // A guard rather than #pragma once, as it is also force included
+        // when compiled, and would otherwise be seen twice
+        cm.append("#ifndef PL_UNITPCH_H\n#define PL_UNITPCH_H\n");
+    }
+    else
+    {
+        cm.append("#pragma once\n");
+    }
 
     // Include Cpp Direc specified headers for each source file
     for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
     {
-        PlArr<EntityType> ea = fi->getRootChildren(EKind::CppDirec);
-        for (size_t i = 0; i < ea.count(); i++)
+        for (EntityType ce : fi->getRootChildren(EKind::CppDirec))
         {
-            EntityType ce = ea.get(i);
             std::string inc = ce->getCppDirecStr(CppDirecType::include);
             if (!inc.empty())
             {
@@ -319,23 +318,37 @@ bool PlUnit::writeUnitWideHdr()
         cm.append("\"\n");
     }
 
-    // Headers corresponding to every source file
-    for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+    if (mPch)
     {
-        cm.append("#include \"");
-        cm.append(privHdrFn(fi->fname()).namePart());
+        cm.append("#endif\n");
+        base::Buffer pchbuf;
+        cm.moveToBuffer(pchbuf);
+        (void)plWrite("Unit precompiled header", pchbuf, pchHdrFn(), true);
+
+        cm.append("#pragma once\n#include \"");
+        cm.append(pchHdrFn().namePart());
         cm.append("\"\n");
     }
 
-    // Use namespaces for units imported into global namespace
+    // Use namespaces for units imported into global namespace.  Ahead of the
+    // source headers, which can name their types, such as an interface that
+    // an object implements.
     for (base::Iter<PlFileState> fi; mCompState.mDepUnits.forEach(fi); )
     {
         if (base::streql(fi->containingUnit()->mNS, L_GLOBALNAMESPACE))
         {
-            cm.appendFmt("using namespace %s;", fi->containingUnit()->cppNamespace().c_str());
+            cm.appendFmt("using namespace %s;\n", fi->containingUnit()->cppNamespace().c_str());
         }
     }
 
+    // Headers corresponding to every source file
+    for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+    {
+        cm.append("#include \"");
+        cm.append(privHdrFn(fi->fname()).namePart());
+        cm.append("\"\n");
+    }
+
     // Write out the file... only if has changed from whats in the file
     base::Buffer buf;
     cm.moveToBuffer(buf);
@@ -343,46 +356,59 @@ bool PlUnit::writeUnitWideHdr()
     return true;
 }
 
-bool PlUnit::makeCmakeLibStr(PlUnit* depunit, base::StrBld& cm, const char* dir, const char* proj, const char* libname, base::Path eincdir)
+size_t PlUnit::unityCount()
 {
-    eincdir.makeRelTo(targetDir());
-    cm.appendFmt("add_library(%s STATIC IMPORTED)\nset_target_properties(%s PROPERTIES\n",
-        libname, libname);
-    cm.append("    INTERFACE_INCLUDE_DIRECTORIES \"");
-    if (!eincdir.isAbs())
+    size_t cnt = 0;
+    if (mUnitySize > 0)
     {
-        cm.append("${CMAKE_CURRENT_SOURCE_DIR}/");
+        for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+        {
+            cnt++;
+        }
+        cnt = (cnt + mUnitySize - 1) / mUnitySize;
     }
-    cm.append(eincdir.withFwdSlash());
-    cm.append("\"\n");
+    return cnt;
+}
 
-    for (size_t bc = 0; bc < sBuildConfigMap.count(); bc++)
+bool PlUnit::writeUnityFiles()
+{
+    // Batch the generated cpp files, mUnitySize to a translation unit, so
+    // the headers are compiled once per batch instead of once per source
+    if (mUnitySize == 0)
     {
-        std::string cfg = sBuildConfigMap.toStringI(bc);
-        std::string cfgu(cfg);
-        base::upperCase(cfgu);
+        return true;
+    }
 
-        base::Path lib = base::Path(depunit->mPath, dir);
-        lib.add(L_BUILDDIR);
-        lib.add("lib");
-        lib.add(cfg);
-        lib.add(mkLibFn(libname));
-        lib.makeRelTo(targetDir());
+    base::StrBld cm;
+    size_t cnt = 0;
+    size_t index = 0;
+    for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+    {
+        cm.append("#include \"");
+        cm.append(cppNameFn(fi->fname()));
+        cm.append("\"\n");
 
-        cm.appendFmt("    IMPORTED_LOCATION_%s \"%s%s\"\n",
-            cfgu.c_str(),
-            lib.isAbs() ? "" : "${CMAKE_CURRENT_SOURCE_DIR}/",
-            lib.withFwdSlash().c_str());
+        if (++cnt == mUnitySize)
+        {
+            base::Buffer buf;
+            cm.moveToBuffer(buf);
+            (void)plWrite("Unity file", buf, base::Path(targetDir(), unityNameFn(index++)), true);
+            cnt = 0;
+        }
+    }
+    if (cnt > 0)
+    {
+        base::Buffer buf;
+        cm.moveToBuffer(buf);
+        (void)plWrite("Unity file", buf, base::Path(targetDir(), unityNameFn(index)), true);
     }
-    cm.append(")\n");
     return true;
 }
 
 bool PlUnit::moveTemps()
 {
-    for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+    auto movetemps = [this](base::Path src)
     {
-        base::Path src(buildDir(), fi->fname());
         src.modifyExt("ii");
         if (base::existFile(src))
         {
@@ -394,144 +420,332 @@ bool PlUnit::moveTemps()
 #endif
             base::shellCmd(cmd, false);
         }
+    };
+
+    // The temps are named after what was compiled, the unity files if used
+    size_t unitycnt = unityCount();
+    for (size_t i = 0; i < unitycnt; i++)
+    {
+        movetemps(base::Path(buildDir(), unityNameFn(i)));
+    }
+    if (unitycnt == 0)
+    {
+        for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+        {
+            movetemps(base::Path(buildDir(), fi->fname()));
+        }
     }
     return false;
 }
 
-bool PlUnit::getCmakeLibs(PlUnit* depunit, std::string& addlib, std::string& libnames)
+void PlUnit::getExtLibs(PlUnit* unit, BuildConfig bldcfg, std::vector<base::Path>& libs, std::vector<base::Path>* incdirs)
 {
-    base::StrBld cm;
-
-    // Add the unit itself
-    libnames += "\n    ";
-    libnames += depunit->mName;
-    makeCmakeLibStr(depunit, cm, L_TARGETDIR, depunit->mName.c_str(), depunit->mName.c_str(), depunit->targetDir());
-
-    // Go through ext projects
-    if (depunit->mMeta[L_UNITEXT].isArray())
+    if (!unit->mMeta[L_UNITEXT].isArray())
+    {
+        return;
+    }
+    for (auto const& i : unit->mMeta[L_UNITEXT])
     {
-        for (auto const& i : depunit->mMeta[L_UNITEXT])
+        if (i.isObject())
         {
-            if (i.isObject())
-            {
-                const char* projkey = i.getKey(0);
-                base::Variant proj = i[projkey];
-
-                libnames += "\n    ";
-                libnames += proj[L_UNITEXTLIB].toString();
+            const char* projkey = i.getKey(0);
+            base::Variant proj = i[projkey];
 
-                base::Path eincdir = base::Path(depunit->mPath,
-                    PlConfig::fixPath(proj[L_UNITEXTINCPATH].toString()));
+            // Where the ext project's own build puts its lib
+            base::Path lib(unit->mPath, PlConfig::fixPath(proj[L_UNITEXTPATH].toString()));
+            lib.add(L_BUILDDIR);
+            lib.add(L_LIBDIR);
+            lib.add(sBuildConfigMap.toString(bldcfg));
+            lib.add(mkLibFn(proj[L_UNITEXTLIB].toString()));
+            libs.push_back(lib);
 
-                makeCmakeLibStr(depunit, cm, projkey, projkey, proj[L_UNITEXTLIB].toString().c_str(), eincdir);
+            if (incdirs)
+            {
+                incdirs->push_back(base::Path(unit->mPath,
+                    PlConfig::fixPath(proj[L_UNITEXTINCPATH].toString())));
             }
         }
     }
-    cm.copyToStr(addlib);
-    return true;
 }
 
-
-bool PlUnit::writeCmake(bool& cmakeupdated)
+void PlUnit::getLinkLibs(BuildConfig bldcfg, std::vector<base::Path>& libs, std::vector<base::Path>* incdirs)
 {
-    // TODO: Implement list of sources file in the unit meta file (this
-    // scheme only works if meta has list of source files)
-    // TODO: Need to also account for unit.yaml changing etc
-    cmakeupdated = false;
-    if (!newerFile(metaFn(), cmakeFn()))
+    // Ext projects used by this unit, then for each dependant unit its lib
+    // followed by those of its ext projects
+    getExtLibs(this, bldcfg, libs, incdirs);
+
+    for (base::Iter<PlFileState> fi; mCompState.mDepUnits.forEach(fi); )
     {
-        return true;
+        PlUnit* du = fi->containingUnit();
+        libs.push_back(du->target(bldcfg));
+        if (incdirs)
+        {
+            incdirs->push_back(du->targetDir());
+        }
+        getExtLibs(du, bldcfg, libs, incdirs);
     }
+}
 
-    // Read the cmake template file into a buffer (not null terminated)
-    base::Buffer cmakebuf;
-    if (!plRead("CMake template", cmakebuf, base::Path(sConfig.getPath(Config::templatedir),
-        sConfig.getStr(Config::cmaketemplate)), false))
+static const char* cfgFlags(BuildConfig bldcfg)
+{
+    // Same as CMake's defaults for each config
+    switch (bldcfg)
     {
-        return false;
+        case BuildConfig::Release:
+            return "-O3 -DNDEBUG";
+        case BuildConfig::RelWithDebInfo:
+            return "-O2 -g -DNDEBUG";
+        default:
+            return "-g";
     }
+}
 
-    base::StrBld cm;
-    cmakeupdated = true;
-    cm.append((const char*)cmakebuf.cptr(), cmakebuf.size());
+bool PlUnit::writeNinja(bool& ninjaupdated)
+{
+    // The unit and its deps are already known here, so the build file is
+    // written directly, and there is no configure step ahead of ninja
+    ninjaupdated = false;
 
-    if (mType == UnitType::exe)
+    base::Path cwd;
+    base::currentDirectory(cwd);
+    auto abspath = [&cwd](const base::Path& p)
+    {
+        return p.isAbs() ? p : base::Path(cwd, p);
+    };
+    base::Path blddir = abspath(buildDir());
+
+    // Paths are relative to the build dir, where ninja runs.  Escaped for a
+    // build line, or quoted for use in a command.
+    auto npath = [&](const base::Path& p, bool arg)
+    {
+        base::Path rp = abspath(p);
+        rp.makeRelTo(blddir);
+        std::string s = rp.withFwdSlash();
+        std::string esc;
+        if (arg)
+        {
+            esc += '\"';
+        }
+        for (char c : s)
+        {
+            if (c == '$' || (!arg && (c == ' ' || c == ':')))
+            {
+                esc += '$';
+            }
+            esc += c;
+        }
+        if (arg)
+        {
+            esc += '\"';
+        }
+        return esc;
+    };
+
+    // Libs to link for each config, and the include dirs that go with them
+    std::vector<base::Path> incdirs;
+    std::vector<std::vector<base::Path>> cfglibs(sBuildConfigMap.count());
+    for (size_t bc = 0; bc < sBuildConfigMap.count(); bc++)
     {
-        cm.append("add_executable(");
+        getLinkLibs((BuildConfig)bc, cfglibs[bc], (bc == 0) ? &incdirs : nullptr);
     }
-    else
+
+    base::StrBld nj;
+    nj.appendFmt("# Generated for unit '%s', do not edit\n", mName.c_str());
+    nj.append("ninja_required_version = 1.3\n\n");
+    nj.appendFmt("cxx = \"%s\"\n", sConfig.getStr(Config::cxx).c_str());
+    nj.appendFmt("ar = \"%s\"\n", sConfig.getStr(Config::ar).c_str());
+    nj.append("cflags = -std=c++20 -fno-exceptions -fno-rtti -DPRIMALC");
+    if (sConfig.isLinux())
+    {
+        nj.append(" -pthread");
+    }
+    for (auto& d : incdirs)
+    {
+        nj.appendFmt(" -I%s", npath(d, true).c_str());
+    }
+    if (mBldTempFiles)
     {
-        cm.append("add_library(");
+        nj.append(" -save-temps");
     }
-    // Target name
-    cm.append(mName);
+    nj.append("\n");
 
-    // Source files
-    for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+    // The runtime starts threads of its own, such as the async logger
+    nj.appendFmt("ldflags =%s\n", sConfig.isLinux() ? " -pthread" : "");
+    for (size_t bc = 0; bc < sBuildConfigMap.count(); bc++)
     {
-        cm.append("\n    ");
-        cm.append(cppNameFn(fi->fname()));
+        nj.appendFmt("cflags_%s = %s\n", sBuildConfigMap.toStringI(bc), cfgFlags((BuildConfig)bc));
     }
-    cm.append("\n)\n");
 
-    // Header files for ext projects used by this unit
-    if (!mCompState.mExtIncDirs.empty())
+    nj.append("\nrule cxx\n"
+        "  command = $cxx $cflags $cfgflags $pchflags -MD -MF $out.d -c $in -o $out\n"
+        "  depfile = $out.d\n"
+        "  deps = gcc\n"
+        "  description = Compiling $in\n"
+        "\nrule pch\n"
+        "  command = $cxx $cflags $cfgflags -x c++-header -MD -MF $out.d -c $in -o $out\n"
+        "  depfile = $out.d\n"
+        "  deps = gcc\n"
+        "  description = Precompiling $in\n"
+        "\nrule link\n"
+        "  command = $cxx $ldflags $in -o $out $libs\n"
+        "  description = Linking $out\n"
+        "\nrule ar\n");
+    if (sConfig.isLinux())
     {
-        cm.append("include_directories(\n");
+        nj.append("  command = rm -f $out && $ar rcs $out $in\n");
+    }
+    else
+    {
+        nj.append("  command = $ar rcs $out $in\n");
+    }
+    nj.append("  description = Archiving $out\n");
 
-        // Ext projects inc dirs for this unit
-        for (base::Iter<base::Path> p; mCompState.mExtIncDirs.forEach(p); )
+    // Sources compiled, the unity files if used
+    std::vector<base::Path> srcs;
+    size_t unitycnt = unityCount();
+    for (size_t i = 0; i < unitycnt; i++)
+    {
+        srcs.push_back(unityNameFn(i));
+    }
+    if (unitycnt == 0)
+    {
+        for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
         {
-            base::Path einc(*p);
-            einc.makeRelTo(targetDir());
-
-            cm.appendFmt("    %s\n", einc.withFwdSlash().c_str());
+            srcs.push_back(cppNameFn(fi->fname()));
         }
-        cm.append(")\n");
     }
 
-    // Libs and header files (including unit lib and ext project(s) used by
-    // the unit) for each dependant unit
-    if (!mCompState.mDepUnits.empty())
+    for (size_t bc = 0; bc < sBuildConfigMap.count(); bc++)
     {
-        std::string tglnk;
-        for (base::Iter<PlFileState> fi; mCompState.mDepUnits.forEach(fi); )
+        BuildConfig bldcfg = (BuildConfig)bc;
+        const char* cfg = sBuildConfigMap.toStringI(bc);
+        base::Path objdir(objDir(), cfg);
+        nj.appendFmt("\n# %s\n", cfg);
+
+        // The header is compiled next to the objects, and found in place of
+        // the header itself through -include
+        std::string gch;
+        std::string pchinc;
+        if (mPch)
+        {
+            base::Path pchfn(objdir, pchHdrFn().namePart());
+            gch = npath(pchfn, false) + ".gch";
+            pchinc = npath(pchfn, true);
+            nj.appendFmt("build %s: pch %s\n  cfgflags = $cflags_%s\n",
+                gch.c_str(), npath(pchHdrFn(), false).c_str(), cfg);
+        }
+
+        std::string objs;
+        for (auto& src : srcs)
         {
-            PlUnit* du = fi->containingUnit();
-            std::string libstr;
-            std::string namestr;
-            getCmakeLibs(du, libstr, namestr);
-            tglnk += namestr;
+            base::Path obj(objdir, src);
+            obj.modifyExt(sConfig.isLinux() ? "o" : "obj");
+            std::string objstr = npath(obj, false);
+            objs += " ";
+            objs += objstr;
+
+            nj.appendFmt("build %s: cxx %s", objstr.c_str(), npath(base::Path(targetDir(), src), false).c_str());
+            if (mPch)
+            {
+                nj.appendFmt(" | %s", gch.c_str());
+            }
+            nj.appendFmt("\n  cfgflags = $cflags_%s\n", cfg);
+            if (mPch)
+            {
+                nj.appendFmt("  pchflags = -include %s\n", pchinc.c_str());
+            }
+        }
 
-            cm.append(libstr);
+        std::string targ = npath(target(bldcfg), false);
+        if (mType == UnitType::exe)
+        {
+            std::string libdeps;
+            std::string libargs;
+            for (auto& lib : cfglibs[bc])
+            {
+                libdeps += " ";
+                libdeps += npath(lib, false);
+                libargs += " ";
+                libargs += npath(lib, true);
+            }
+            nj.appendFmt("build %s: link%s%s%s\n  libs =%s\n",
+                targ.c_str(), objs.c_str(), libdeps.empty() ? "" : " |", libdeps.c_str(), libargs.c_str());
+        }
+        else
+        {
+            nj.appendFmt("build %s: ar%s\n", targ.c_str(), objs.c_str());
         }
-        cm.appendFmt("target_link_libraries(%s%s\n)\n\n", mName.c_str(), tglnk.c_str());
+        nj.appendFmt("build %s: phony %s\n", cfg, targ.c_str());
     }
+    nj.appendFmt("\ndefault %s\n", sBuildConfigMap.toString(BuildConfig::Debug));
 
-    // Ask CPP compiler to save temp files
-    if (mBldTempFiles)
+    // Write out the file... only if has changed, so ninja sees no change
+    base::Buffer buf;
+    nj.moveToBuffer(buf);
+    ninjaupdated = plWrite("Ninja file", buf, ninjaFn(), true);
+    if (ninjaupdated && isFlagSet(base::sBaseGFlags, base::GFLAG_VERBOSE_FILESYS))
+    {
+        dbglog("Ninja file updated\n");
+    }
+    return true;
+}
+
+bool PlUnit::isCurrent(BuildConfig bldcfg)
+{
+    // Lets a no-op build skip spawning ninja.  The target must be newer than
+    // the build file and every input known here.  Ext headers seen only in
+    // ninja's depfiles are covered by the ext libs they are built into.
+    time_t targt;
+    if (!base::modTimeFile(target(bldcfg), targt))
     {
-        cm.appendFmt("set_target_properties(%s PROPERTIES COMPILE_FLAGS \"-save-temps\")", mName.c_str());
+        return false;
     }
 
-    // Write out the file
-    base::Buffer cmlistbuf;
-    cm.moveToBuffer(cmlistbuf);
-    bool ret = plWrite("CMake file", cmlistbuf, cmakeFn(), true);
-    if (!ret)
+    std::vector<base::Path> inputs;
+    inputs.push_back(ninjaFn());
+    inputs.push_back(unitWideFn());
+    if (mPch)
+    {
+        inputs.push_back(pchHdrFn());
+    }
+    size_t unitycnt = unityCount();
+    for (size_t i = 0; i < unitycnt; i++)
+    {
+        inputs.push_back(base::Path(targetDir(), unityNameFn(i)));
+    }
+    for (base::Iter<PlFileState> fi; mCompState.mSrcFiles.forEach(fi); )
+    {
+        inputs.push_back(cppFn(fi->fname()));
+        inputs.push_back(privHdrFn(fi->fname()));
+    }
+    for (base::Iter<PlFileState> fi; mCompState.mDepUnits.forEach(fi); )
     {
-        cmakeupdated = false;
+        inputs.push_back(fi->containingUnit()->pubHdrFn());
     }
-    if (cmakeupdated)
+    getLinkLibs(bldcfg, inputs, nullptr);
+
+    for (auto& fn : inputs)
     {
-        if (isFlagSet(base::sBaseGFlags, base::GFLAG_VERBOSE_FILESYS))
+        time_t t;
+        if (!base::modTimeFile(fn, t) || t > targt)
         {
-            dbglog("CMake file updated\n");
+            return false;
         }
     }
     return true;
 }
 
+bool PlUnit::runNinja(BuildConfig bldcfg)
+{
+    // Full command lines only when verbose, otherwise ninja's progress lines
+    PlCmd cmd = {{sConfig.getStr(Config::ninja), sBuildConfigMap.toString(bldcfg)}, buildDir()};
+    if (sVerbose)
+    {
+        cmd.args.insert(cmd.args.begin() + 1, "-v");
+    }
+    return plLogRun({cmd}, mLog, mErrLog);
+}
+
 bool PlUnit::findUnitPath(std::string name, base::Path& path)
 {
     // TODO: implement full config search path
@@ -563,6 +777,8 @@ bool PlUnit::buildExt(BuildConfig bldcfg)
 
     if (mMeta[L_UNITEXT].isArray())
     {
+        std::vector<PlCmd> configs;
+        std::vector<PlCmd> builds;
         for (auto const& i : mMeta[L_UNITEXT])
         {
             if (!i.isObject())
@@ -578,17 +794,24 @@ bool PlUnit::buildExt(BuildConfig bldcfg)
             base::Path edir = base::Path(mPath, erelpath);
 
             //dbglog("Ext project '%s'\n", projkey);
-            if (!existNinjaFiles(edir))
+            if (!existExtBuild(edir))
             {
-                writeNinjaFiles(edir);
+                configs.push_back(configExtCmd(edir));
             }
+            builds.push_back(buildExtCmd(edir, bldcfg));
+        }
 
-            buildNinja(edir, bldcfg);
-
-            // Add inc file to ext projs inc list
-            base::Path eincdir = base::Path(mPath,
-                PlConfig::fixPath(proj[L_UNITEXTINCPATH].toString()));
-            mCompState.mExtIncDirs.addBack(eincdir);
+        // The projects don't depend on each other, so they're all configured
+        // at once, and then all built at once
+        if (!configs.empty())
+        {
+            PlProfScope ps(ProfPhase::configure, this);
+            plLogRun(configs, mLog, mErrLog);
+        }
+        if (!builds.empty())
+        {
+            PlProfScope ps(ProfPhase::build, this);
+            plLogRun(builds, mLog, mErrLog);
         }
     }
 
@@ -608,7 +831,9 @@ bool PlUnit::clean(bool hard)
     }
     else
     {
-        bool ret = cleanNinja(buildDir());
+        // Objects and libs, leaving the build file and ASTs
+        base::removeDirectory(objDir());
+        base::removeDirectory(base::Path(buildDir(), L_LIBDIR));
         base::removeDirectory(diagDir());
         base::removeDirectory(astDir());
         base::removeDirectory(outDir());
@@ -626,7 +851,7 @@ bool PlUnit::clean(bool hard)
             }
         }
 
-        return ret;
+        return true;
     }
 }
 
@@ -653,7 +878,7 @@ bool PlUnit::cleanExt(bool hard)
             }
             else
             {
-                cleanNinja(edir);
+                cleanExtDir(edir);
             }
         }
     }
@@ -877,6 +1102,11 @@ bool PlBuilder::buildUnit(base::Path unitpath, BldOptions opts)
 {
     base::List<PlUnit> depunits;
 
+    if (opts.profile)
+    {
+        sProfiler.enable();
+    }
+
     PlUnit* primary = getUnitDeps(depunits, unitpath);
     bool blderr = false;
 
@@ -922,6 +1152,15 @@ bool PlBuilder::buildUnit(base::Path unitpath, BldOptions opts)
         }
     }
 
+    if (opts.profile)
+    {
+        sProfiler.report();
+        if (primary)
+        {
+            (void)sProfiler.writeTrace(base::Path(primary->diagDir(), L_PROFILEFN));
+        }
+    }
+
     return !blderr;
 }
 
@@ -2,6 +2,8 @@
 
 #include "util.h"
 #include "sys.h"
+#include <deque>
+#include <unordered_map>
 
 namespace base
 {
@@ -243,4 +245,262 @@ protected:
 };
 
 
+
+// Compact persistence for versioned file formats.  Integers are varints
+// (zigzag for signed), strings are indices into a table written ahead of the
+// body, and per-field type tags are only written by debug builds.  The
+// signature is followed by PACK_MAGIC, which never starts a PersistWr file,
+// so readers can tell the two apart and fall back to PersistRd.
+constDef PACK_MAGIC = (byte)0xF0;
+#ifdef _DEBUG
+constDef PACK_TAGGED = true;
+#else
+constDef PACK_TAGGED = false;
+#endif
+
+class PackWr
+{
+public:
+    PackWr() = delete;
+    PackWr(const char* sig, uint32 version, bool tagged = PACK_TAGGED) :
+        mSig(sig),
+        mVersion(version),
+        mTagged(tagged),
+        mLen(0)
+    {
+        mBuf.alloc(256);
+    }
+    NOCOPY(PackWr)
+
+    size_t length() const
+    {
+        return mLen;
+    }
+    // Write
+    void wrUInt(uint64 x)
+    {
+        wrTag(PersistType::d_uint64);
+        wrVar(x);
+    }
+    void wrInt(int64 x)
+    {
+        wrTag(PersistType::d_int64);
+        wrVar(((uint64)x << 1) ^ (uint64)(x >> 63));
+    }
+    void wrBool(bool x)
+    {
+        wrTag(PersistType::d_bool);
+        wrVar(x ? 1 : 0);
+    }
+    void wrStr(strparam str)
+    {
+        wrStrId(addStr(str));
+    }
+    // Callers that already have their strings interned can map their ids to
+    // table ids once and write those directly
+    uint32 addStr(strparam str);
+    void wrStrId(uint32 id)
+    {
+        wrTag(PersistType::d_str);
+        wrVar(id);
+    }
+    // Fixed width slot that can be patched once the value is known, such as
+    // the offset of data written later.  Returns the slot's position.
+    size_t wrFixed32(uint32 x)
+    {
+        wrTag(PersistType::d_uint32);
+        char* buf = ensureAlloc(mLen + sizeof(uint32));
+        size_t pos = mLen;
+        memcpy(buf + pos, &x, sizeof(uint32));
+        mLen += sizeof(uint32);
+        return pos;
+    }
+    void patchFixed32(size_t pos, uint32 x)
+    {
+        assert(pos + sizeof(uint32) <= mLen);
+        memcpy((char*)mBuf.ptr() + pos, &x, sizeof(uint32));
+    }
+
+    bool save(const base::Path& fn);
+    void moveToBuffer(base::Buffer& buf);
+
+private:
+    void wrTag(PersistType dt)
+    {
+        if (mTagged)
+        {
+            char* buf = ensureAlloc(mLen + 1);
+            buf[mLen++] = (char)dt;
+        }
+    }
+    void wrVar(uint64 x)
+    {
+        char* buf = ensureAlloc(mLen + 10);
+        while (x >= 0x80)
+        {
+            buf[mLen++] = (char)(x | 0x80);
+            x >>= 7;
+        }
+        buf[mLen++] = (char)x;
+    }
+    char* ensureAlloc(size_t neededsize);
+    void finish(base::Buffer& out);
+
+    std::string mSig;
+    uint32 mVersion;
+    bool mTagged;
+    base::Buffer mBuf;
+    size_t mLen;
+    std::deque<std::string> mStrs;
+    std::unordered_map<strparam, uint32> mStrIds;
+};
+
+class PackRd
+{
+public:
+    PackRd() = delete;
+    PackRd(const char* sig, uint32 version) :
+        mSig(sig),
+        mVersion(version),
+        mTagged(false),
+        mLegacy(false),
+        mErr(false),
+        mPos(0),
+        mBodyPos(0)
+    {
+    }
+    NOCOPY(PackRd)
+
+    // Takes the file contents, or the buffer's memory
+    bool load(const base::Path& fn);
+    bool load(base::Buffer& buf);
+
+    // True when load() failed because the data is a PersistWr file
+    bool isLegacy() const
+    {
+        return mLegacy;
+    }
+    bool inErr() const
+    {
+        return mErr;
+    }
+    void setErr(const char* msg)
+    {
+        dbgerr("Pack read error: %s\n", msg);
+        mErr = true;
+    }
+    bool atEnd() const
+    {
+        return mPos >= mBuf.size();
+    }
+    // Positions are relative to the start of the body, matching
+    // PackWr::length() at the time the data was written
+    size_t tell() const
+    {
+        return mPos - mBodyPos;
+    }
+    bool seek(size_t pos)
+    {
+        if (mErr || pos > mBuf.size() - mBodyPos)
+        {
+            setErr("Seek out of bounds");
+            return false;
+        }
+        mPos = mBodyPos + pos;
+        return true;
+    }
+
+    uint64 rdUInt()
+    {
+        return rdTag(PersistType::d_uint64) ? rdVar() : 0;
+    }
+    int64 rdInt()
+    {
+        uint64 x = rdTag(PersistType::d_int64) ? rdVar() : 0;
+        return (int64)(x >> 1) ^ -(int64)(x & 1);
+    }
+    bool rdBool()
+    {
+        return rdTag(PersistType::d_bool) ? rdVar() != 0 : false;
+    }
+    uint32 rdFixed32()
+    {
+        uint32 x = 0;
+        if (rdTag(PersistType::d_uint32))
+        {
+            if (mPos + sizeof(uint32) > mBuf.size())
+            {
+                setErr("Invalid fixed data");
+                return 0;
+            }
+            memcpy(&x, (const byte*)mBuf.cptr() + mPos, sizeof(uint32));
+            mPos += sizeof(uint32);
+        }
+        return x;
+    }
+    // Strings stay in the loaded buffer, the returned views are valid for
+    // the life of the reader
+    uint32 rdStrId();
+    strparam rdStr()
+    {
+        return str(rdStrId());
+    }
+    strparam str(uint32 id) const
+    {
+        return id < mStrs.size() ? mStrs[id] : strparam();
+    }
+    size_t strCount() const
+    {
+        return mStrs.size();
+    }
+
+private:
+    bool parse();
+    bool rdTag(PersistType dt)
+    {
+        if (mTagged && !mErr)
+        {
+            const byte* buf = (const byte*)mBuf.cptr();
+            if (mPos >= mBuf.size() || (PersistType)buf[mPos] != dt)
+            {
+                setErr("Specified type doesn't match data");
+                return false;
+            }
+            mPos++;
+        }
+        return !mErr;
+    }
+    uint64 rdVar()
+    {
+        const byte* buf = (const byte*)mBuf.cptr();
+        uint64 x = 0;
+        for (uint shift = 0; shift < 64; shift += 7)
+        {
+            if (mPos >= mBuf.size())
+            {
+                break;
+            }
+            byte b = buf[mPos++];
+            x |= (uint64)(b & 0x7F) << shift;
+            if (!(b & 0x80))
+            {
+                return x;
+            }
+        }
+        setErr("Invalid varint");
+        return 0;
+    }
+
+    std::string mSig;
+    uint32 mVersion;
+    bool mTagged;
+    bool mLegacy;
+    bool mErr;
+    base::Buffer mBuf;
+    size_t mPos;
+    size_t mBodyPos;
+    std::vector<strparam> mStrs;
+};
+
+
 } // base
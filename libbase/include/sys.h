@@ -72,6 +72,66 @@ int shellCmd(const std::string& cmd, bool output, const base::Path* outfile = nu
 uint getPid();
 base::Path getProcPath(uint pid);
 
+// Process class runs a program directly, without a shell.  Its stdout and
+// stderr are read through pipes while it runs, and kept in memory.  Each line
+// is also handed to an optional callback as it arrives.  Several processes
+// can be started and then waited on together with waitProcesses().
+class Process
+{
+public:
+    // Called with each line of output, without the line end
+    typedef void (*LineFunc)(void* ctx, const char* line, size_t len);
+
+    Process();
+    Process(const Process&) = delete;
+    ~Process();
+    Process& operator=(const Process&) = delete;
+
+    // Starts args[0], searched for on the PATH when it has no directory.  The
+    // process runs in dir when one is given.
+    bool start(const std::vector<std::string>& args, const base::Path* dir = nullptr);
+    void setLineFunc(LineFunc func, void* ctx)
+    {
+        mLineFunc = func;
+        mLineCtx = ctx;
+    }
+    bool started() const
+    {
+        return mPid != -1;
+    }
+    // Exit code once waited on, or -1 if it didn't start
+    int exitCode() const
+    {
+        return mExitCode;
+    }
+    // Everything written to stdout and stderr, a line at a time
+    StrBld& output()
+    {
+        return mOut;
+    }
+
+private:
+friend bool waitProcesses(Process** procs, size_t count);
+
+    intptr_t mPid;
+    intptr_t mPipe[2];
+    int mExitCode;
+    LineFunc mLineFunc;
+    void* mLineCtx;
+    StrBld mOut;
+    std::string mPartial[2];
+
+    bool readPipe(int stream);
+    void closePipe(int stream);
+    void addOutput(int stream, const char* data, size_t len);
+    void addLine(const char* line, size_t len);
+    void reap();
+};
+
+// Reads the output of the started processes until all of them have exited.
+// Returns true if they all exited with 0.
+bool waitProcesses(Process** procs, size_t count);
+
 // Unicode and UTF8
 uint32_t makeUnicode(const char* s, int maxlen, int* lenused = NULL);
 std::string makeUTF8(uint32_t charcode);
@@ -34,6 +34,7 @@
 #include <cstdint>
 #include <string>
 #include <string_view>
+#include <vector>
 
 // const helpers
 #define constMemb static constexpr auto
@@ -590,6 +591,112 @@ protected:
     size_t mLen;
 };
 
+// StrRope builds a string as a list of segments rather than one growing
+// buffer.  Copied text is packed into fixed size blocks that never move, and
+// text that outlives the rope (literals, interned strings) can be added by
+// reference.  writeFile() hands the segments to writev, so the text is never
+// flattened on its way out.
+class StrRope
+{
+public:
+    constMemb_(size_t) BLOCKSIZE = 16 * 1024;
+    // References shorter than this are cheaper to copy than to track
+    constMemb_(size_t) MINREF = 32;
+
+    StrRope() :
+        mCur(nullptr),
+        mCurFree(0),
+        mLen(0),
+        mLast('\0')
+    {
+    }
+    ~StrRope()
+    {
+        clear();
+    }
+    NOCOPY(StrRope)
+
+    void appendc(char c)
+    {
+        append(&c, 1);
+    }
+    void append(size_t count, char c);
+    void append(const char* s, size_t l)
+    {
+        // Most appends are short and extend the segment being filled
+        if (l > 0 && l <= mCurFree && !mSegs.empty() && mSegs.back().mPtr + mSegs.back().mLen == mCur)
+        {
+            memcpy(mCur, s, l);
+            mSegs.back().mLen += l;
+            mCur += l;
+            mCurFree -= l;
+            mLen += l;
+            mLast = s[l - 1];
+        }
+        else
+        {
+            appendBlocks(s, l);
+        }
+    }
+    void append(const char* s)
+    {
+        append(s, strlen(s));
+    }
+    void append(std::string_view s)
+    {
+        append(s.data(), s.length());
+    }
+    // The text must stay valid, and unchanged, for the life of the rope
+    void appendRef(std::string_view s);
+    // Moves the segments and blocks of src to the end of this rope, leaving
+    // src empty
+    void splice(StrRope& src);
+    bool appendVFmt(const char* fmt, va_list varg);
+    bool appendFmt(const char* fmt, ...);
+
+    void eraseLast();
+    char last() const
+    {
+        return mLast;
+    }
+    size_t length() const
+    {
+        return mLen;
+    }
+    bool empty() const
+    {
+        return mLen == 0;
+    }
+    size_t segCount() const
+    {
+        return mSegs.size();
+    }
+    void clear();
+
+    std::string toString() const;
+    void copyToBuffer(base::Buffer& buf) const;
+    void moveToBuffer(base::Buffer& buf);
+    bool equalsFile(const std::string& filename) const;
+    bool writeFile(const std::string& filename) const;
+
+private:
+    struct Seg
+    {
+        const char* mPtr;
+        size_t mLen;
+    };
+
+    char* newBlock(size_t size);
+    void appendBlocks(const char* s, size_t l);
+
+    std::vector<Seg> mSegs;
+    std::vector<char*> mBlocks;
+    char* mCur;
+    size_t mCurFree;
+    size_t mLen;
+    char mLast;
+};
+
 // Parser class implements a text parser which follows simple rules to build tokens.
 
 constexpr auto PUNC_CHARS = "&!|/:;=+*-.$@^%?`,\\";
@@ -1269,6 +1376,114 @@ private:
     }
 };
 
+// Same interface as EnumStringMap, but fromString() is one hashed probe and a
+// length-checked compare.  The slot table and a collision-free seed are found
+// at compile time, so the string array must be constexpr.
+template<typename T, uint N>
+class EnumStringHashMap
+{
+public:
+    constexpr EnumStringHashMap(const char* const (&arr)[N], uint skipchars) :
+        mStrArr(arr),
+        mSkip(skipchars)
+    {
+        for (uint i = 0; i < N; i++)
+        {
+            const char* s = arr[i] + skipchars;
+            uint len = 0;
+            while (s[len])
+            {
+                len++;
+            }
+            mLens[i] = len;
+        }
+        // Expected to succeed within a handful of seeds at 4x load
+        for (mSeed = 0; !place(); mSeed++)
+        {
+        }
+    }
+    bool exists(strparam str) const
+    {
+        return fromString(str, nullptr);
+    }
+    uint count() const
+    {
+        return N;
+    }
+    bool fromString(strparam str, T* ret) const
+    {
+        uint slot = mSlots[hash(str.data(), (uint)str.length(), mSeed) & (TABSIZE - 1)];
+        if (slot == 0)
+        {
+            return false;
+        }
+        uint i = slot - 1;
+        if (mLens[i] != str.length() || memcmp(str.data(), mStrArr[i] + mSkip, mLens[i]) != 0)
+        {
+            return false;
+        }
+        if (ret)
+        {
+            *ret = (T)i;
+        }
+        return true;
+    }
+    const char* toString(T v) const
+    {
+        return toStringI((uint)v);
+    }
+    const char* toStringI(uint index) const
+    {
+        return index < N ? mStrArr[index] + mSkip : nullptr;
+    }
+
+private:
+    static constexpr uint tabSize(uint n)
+    {
+        uint sz = 8;
+        while (sz < n)
+        {
+            sz <<= 1;
+        }
+        return sz;
+    }
+    constMemb_(uint) TABSIZE = tabSize(N * 4);
+
+    const char* const* mStrArr;
+    uint mSkip;
+    uint32 mSeed = 0;
+    uint mLens[N] = {};
+    uint16 mSlots[TABSIZE] = {};
+
+    static constexpr uint32 hash(const char* s, uint len, uint32 seed)
+    {
+        // FNV-1a with the seed folded into the basis
+        uint32 h = 2166136261u ^ (seed * 0x9E3779B9u);
+        for (uint i = 0; i < len; i++)
+        {
+            h = (h ^ (uint8)s[i]) * 16777619u;
+        }
+        return h ^ (h >> 15);
+    }
+    constexpr bool place()
+    {
+        for (uint j = 0; j < TABSIZE; j++)
+        {
+            mSlots[j] = 0;
+        }
+        for (uint i = 0; i < N; i++)
+        {
+            uint j = hash(mStrArr[i] + mSkip, mLens[i], mSeed) & (TABSIZE - 1);
+            if (mSlots[j] != 0)
+            {
+                return false;
+            }
+            mSlots[j] = (uint16)(i + 1);
+        }
+        return true;
+    }
+};
+
 #define ENUM_ENTRY(name) name,
 #define ENUM_STRENTRY(name) #name,
 
@@ -1286,6 +1501,21 @@ private:
 #define strmapdef(strarray, mapname) \
     constexpr base::EnumStringMap<uint> mapname(countof(strarray), strarray, 0)
 
+// Hashed variants, for maps consulted on hot paths
+#define enumhashmapdef(enumlist, enumtype, mapname, skip) \
+    enum class enumtype : uint32 \
+    { \
+        enumlist(ENUM_ENTRY) \
+    }; \
+    inline constexpr const char* enumtype##Strings[] = \
+    { \
+        enumlist(ENUM_STRENTRY) \
+    }; \
+    constexpr base::EnumStringHashMap<enumtype, countof(enumtype##Strings)> mapname(enumtype##Strings, skip)
+
+#define strhashmapdef(strarray, mapname) \
+    constexpr base::EnumStringHashMap<uint, countof(strarray)> mapname(strarray, 0)
+
 // Flags
 
 #define FLAGS32_ENTRY(flagname, bitno) flagname = 1ul << bitno,
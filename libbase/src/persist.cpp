@@ -158,4 +158,176 @@ bool PersistRd::rdData(void* p, size_t l, PersistType checkdt)
 }    
 
 
+// PackWr::
+
+uint32 PackWr::addStr(strparam str)
+{
+    auto it = mStrIds.find(str);
+    if (it != mStrIds.end())
+    {
+        return it->second;
+    }
+
+    // The deque never relocates its elements, so the key views stay valid
+    uint32 id = (uint32)mStrs.size();
+    const std::string& s = mStrs.emplace_back(str);
+    mStrIds.emplace(strparam(s), id);
+    return id;
+}
+
+char* PackWr::ensureAlloc(size_t neededsize)
+{
+    if (neededsize > mBuf.size())
+    {
+        mBuf.dblOr(neededsize);
+    }
+    return (char*)mBuf.ptr();
+}
+
+static void packVar(byte*& p, uint64 x)
+{
+    while (x >= 0x80)
+    {
+        *p++ = (byte)(x | 0x80);
+        x >>= 7;
+    }
+    *p++ = (byte)x;
+}
+
+void PackWr::finish(base::Buffer& out)
+{
+    // Layout: sig, magic, version, flags, string table, body
+    size_t maxlen = mSig.length() + 1 + 30 + mLen;
+    for (auto& s : mStrs)
+    {
+        maxlen += 10 + s.length();
+    }
+    out.alloc(maxlen);
+
+    byte* start = (byte*)out.ptr();
+    byte* p = start;
+    memcpy(p, mSig.data(), mSig.length());
+    p += mSig.length();
+    *p++ = PACK_MAGIC;
+    packVar(p, mVersion);
+    packVar(p, mTagged ? 1 : 0);
+    packVar(p, mStrs.size());
+    for (auto& s : mStrs)
+    {
+        packVar(p, s.length());
+        memcpy(p, s.data(), s.length());
+        p += s.length();
+    }
+    memcpy(p, mBuf.cptr(), mLen);
+    p += mLen;
+    out.reAlloc(p - start);
+}
+
+bool PackWr::save(const base::Path& fn)
+{
+    if (isFlagSet(base::sBaseGFlags, base::GFLAG_VERBOSE_FILESYS))
+    {
+        dbglog("Persisting to file %s\n", fn.c_str());
+    }
+    base::Buffer buf;
+    finish(buf);
+    return buf.writeFile(fn);
+}
+
+void PackWr::moveToBuffer(base::Buffer& buf)
+{
+    finish(buf);
+    mLen = 0;
+    mStrs.clear();
+    mStrIds.clear();
+}
+
+
+// PackRd::
+
+bool PackRd::load(const base::Path& fn)
+{
+    if (!mBuf.readFile(fn, false))
+    {
+        dbgerr("Can't load %s\n", fn.c_str());
+        return false;
+    }
+    bool ret = parse();
+    if (!ret && !mLegacy)
+    {
+        dbgerr("Can't load %s or is invalid\n", fn.c_str());
+    }
+    return ret;
+}
+
+bool PackRd::load(base::Buffer& buf)
+{
+    mBuf.moveFrom(buf);
+    return parse();
+}
+
+bool PackRd::parse()
+{
+    mPos = 0;
+    mErr = false;
+    mLegacy = false;
+    mBodyPos = 0;
+    mStrs.clear();
+
+    const byte* buf = (const byte*)mBuf.cptr();
+    if (mBuf.size() <= mSig.length() || memcmp(buf, mSig.data(), mSig.length()) != 0)
+    {
+        mErr = true;
+        return false;
+    }
+    mPos = mSig.length();
+    if (buf[mPos] != PACK_MAGIC)
+    {
+        mLegacy = (buf[mPos] == (byte)PersistType::d_begfile);
+        mErr = true;
+        return false;
+    }
+    mPos++;
+
+    uint64 ver = rdVar();
+    if (ver != mVersion)
+    {
+        dbgerr("Unsupported file version %llu, expected %u\n", ver, mVersion);
+        mErr = true;
+        return false;
+    }
+    mTagged = rdVar() & 1;
+
+    uint64 cnt = rdVar();
+    for (uint64 i = 0; i < cnt && !mErr; i++)
+    {
+        uint64 len = rdVar();
+        if (mErr || len > mBuf.size() - mPos)
+        {
+            setErr("Invalid string table");
+            break;
+        }
+        mStrs.emplace_back((const char*)buf + mPos, len);
+        mPos += len;
+    }
+    mBodyPos = mPos;
+    return !mErr;
+}
+
+uint32 PackRd::rdStrId()
+{
+    if (!rdTag(PersistType::d_str))
+    {
+        return 0;
+    }
+    uint64 id = rdVar();
+    if (id >= mStrs.size())
+    {
+        setErr("Invalid string index");
+        return 0;
+    }
+    return (uint32)id;
+}
+
+
 } // base
\ No newline at end of file
@@ -8,6 +8,12 @@
 #else
 #include <dirent.h>
 #include <sys/stat.h>
+#include <sys/wait.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <spawn.h>
+
+extern char** environ;
 #endif
 
 #ifdef _WIN32
@@ -465,6 +471,420 @@ int shellCmd(const std::string& cmd, bool output, const base::Path* outfile)
     return exitcode;
 }
 
+// Process::
+
+Process::Process() :
+    mPid(-1),
+    mPipe{-1, -1},
+    mExitCode(-1),
+    mLineFunc(nullptr),
+    mLineCtx(nullptr)
+{
+}
+
+Process::~Process()
+{
+    closePipe(0);
+    closePipe(1);
+    reap();
+}
+
+#ifdef _WIN32
+// Quotes an argument the way the C runtime splits a command line
+static void quoteArg(std::string& cmdline, const std::string& arg)
+{
+    if (!cmdline.empty())
+    {
+        cmdline.push_back(' ');
+    }
+    if (!arg.empty() && arg.find_first_of(" \t\"") == std::string::npos)
+    {
+        cmdline.append(arg);
+        return;
+    }
+    cmdline.push_back('"');
+    size_t slashes = 0;
+    for (char c : arg)
+    {
+        if (c == '\\')
+        {
+            slashes++;
+        }
+        else
+        {
+            // Backslashes are only special before a quote
+            if (c == '"')
+            {
+                cmdline.append(slashes + 1, '\\');
+            }
+            slashes = 0;
+        }
+        cmdline.push_back(c);
+    }
+    cmdline.append(slashes, '\\');
+    cmdline.push_back('"');
+}
+#endif
+
+bool Process::start(const std::vector<std::string>& args, const base::Path* dir)
+{
+    if (args.empty() || started())
+    {
+        return false;
+    }
+    if (isFlagSet(sBaseGFlags, GFLAG_VERBOSE_SHELL))
+    {
+        printf("Run [");
+        for (size_t i = 0; i < args.size(); i++)
+        {
+            printf(i ? " %s" : "%s", args[i].c_str());
+        }
+        printf("]\n");
+    }
+
+#ifdef _WIN32
+    std::string cmdline;
+    for (auto& a : args)
+    {
+        quoteArg(cmdline, a);
+    }
+
+    SECURITY_ATTRIBUTES sa = {sizeof(sa), NULL, TRUE};
+    HANDLE rd[2] = {NULL, NULL};
+    HANDLE wr[2] = {NULL, NULL};
+    for (int i = 0; i < 2; i++)
+    {
+        // Only the write ends are inherited
+        if (!CreatePipe(&rd[i], &wr[i], &sa, 0) || !SetHandleInformation(rd[i], HANDLE_FLAG_INHERIT, 0))
+        {
+            dbgerr("Failed to create pipe, err=%lu\n", GetLastError());
+            for (int j = 0; j <= i; j++)
+            {
+                CloseHandle(rd[j]);
+                CloseHandle(wr[j]);
+            }
+            return false;
+        }
+    }
+
+    STARTUPINFOA si = {sizeof(si)};
+    si.dwFlags = STARTF_USESTDHANDLES;
+    si.hStdInput = INVALID_HANDLE_VALUE;
+    si.hStdOutput = wr[0];
+    si.hStdError = wr[1];
+    PROCESS_INFORMATION pi;
+    BOOL ok = CreateProcessA(NULL, (LPSTR)cmdline.c_str(), NULL, NULL, TRUE, 0, NULL,
+        dir ? dir->c_str() : NULL, &si, &pi);
+    CloseHandle(wr[0]);
+    CloseHandle(wr[1]);
+    if (!ok)
+    {
+        dbgerr("Failed to run '%s', err=%lu\n", args[0].c_str(), GetLastError());
+        CloseHandle(rd[0]);
+        CloseHandle(rd[1]);
+        return false;
+    }
+    CloseHandle(pi.hThread);
+    mPid = (intptr_t)pi.hProcess;
+    mPipe[0] = (intptr_t)rd[0];
+    mPipe[1] = (intptr_t)rd[1];
+#else
+    std::vector<char*> argv;
+    for (auto& a : args)
+    {
+        argv.push_back((char*)a.c_str());
+    }
+    argv.push_back(nullptr);
+
+    // Close on exec, so other children started meanwhile don't hold them
+    // open.  The copies made onto stdout and stderr stay open.
+    int fds[2][2] = {{-1, -1}, {-1, -1}};
+    for (int i = 0; i < 2; i++)
+    {
+        if (pipe(fds[i]) != 0)
+        {
+            dbgerr("Failed to create pipe, errno=%d\n", errno);
+            for (int j = 0; j < i; j++)
+            {
+                close(fds[j][0]);
+                close(fds[j][1]);
+            }
+            return false;
+        }
+        fcntl(fds[i][0], F_SETFD, FD_CLOEXEC);
+        fcntl(fds[i][1], F_SETFD, FD_CLOEXEC);
+    }
+
+    posix_spawn_file_actions_t fa;
+    posix_spawn_file_actions_init(&fa);
+    posix_spawn_file_actions_addopen(&fa, 0, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&fa, fds[0][1], 1);
+    posix_spawn_file_actions_adddup2(&fa, fds[1][1], 2);
+
+    // The child changes directory itself where that's supported, otherwise
+    // this process does around the spawn
+    base::Path prevdir;
+    bool chdirself = false;
+    if (dir)
+    {
+#if (defined(__GLIBC__) && (__GLIBC__ > 2 || __GLIBC_MINOR__ >= 29)) || defined(__APPLE__)
+        posix_spawn_file_actions_addchdir_np(&fa, dir->c_str());
+#else
+        chdirself = currentDirectory(prevdir) && changeDirectory(*dir);
+#endif
+    }
+
+    pid_t pid;
+    int ret = posix_spawnp(&pid, args[0].c_str(), &fa, nullptr, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&fa);
+    if (chdirself)
+    {
+        changeDirectory(prevdir);
+    }
+
+    close(fds[0][1]);
+    close(fds[1][1]);
+    if (ret != 0)
+    {
+        dbgerr("Failed to run '%s', errno=%d\n", args[0].c_str(), ret);
+        close(fds[0][0]);
+        close(fds[1][0]);
+        return false;
+    }
+    mPid = pid;
+    mPipe[0] = fds[0][0];
+    mPipe[1] = fds[1][0];
+#endif
+    return true;
+}
+
+// Reads what's available from the pipe, returns false once it is closed
+bool Process::readPipe(int stream)
+{
+    char buf[16384];
+#ifdef _WIN32
+    HANDLE han = (HANDLE)mPipe[stream];
+    DWORD avail = 0;
+    if (!PeekNamedPipe(han, NULL, 0, NULL, &avail, NULL))
+    {
+        closePipe(stream);
+        return false;
+    }
+    DWORD got = 0;
+    if (avail > 0 && ReadFile(han, buf, (avail < sizeof(buf)) ? avail : sizeof(buf), &got, NULL))
+    {
+        addOutput(stream, buf, got);
+    }
+    return true;
+#else
+    ssize_t got = read((int)mPipe[stream], buf, sizeof(buf));
+    if (got > 0)
+    {
+        addOutput(stream, buf, (size_t)got);
+        return true;
+    }
+    if (got < 0 && (errno == EINTR || errno == EAGAIN))
+    {
+        return true;
+    }
+    closePipe(stream);
+    return false;
+#endif
+}
+
+void Process::closePipe(int stream)
+{
+    if (mPipe[stream] != -1)
+    {
+#ifdef _WIN32
+        CloseHandle((HANDLE)mPipe[stream]);
+#else
+        close((int)mPipe[stream]);
+#endif
+        mPipe[stream] = -1;
+
+        // A last line without a line end
+        std::string& part = mPartial[stream];
+        if (!part.empty())
+        {
+            addLine(part.c_str(), part.length());
+            part.clear();
+        }
+    }
+}
+
+void Process::addOutput(int stream, const char* data, size_t len)
+{
+    // Whole lines are passed on, the rest waits for more output.  Lines from
+    // stdout and stderr stay whole, but can be in a different order than
+    // the process wrote them.
+    std::string& part = mPartial[stream];
+    const char* end = data + len;
+    while (data < end)
+    {
+        const char* nl = (const char*)memchr(data, '\n', end - data);
+        if (!nl)
+        {
+            part.append(data, end - data);
+            break;
+        }
+        if (part.empty())
+        {
+            addLine(data, nl - data);
+        }
+        else
+        {
+            part.append(data, nl - data);
+            addLine(part.c_str(), part.length());
+            part.clear();
+        }
+        data = nl + 1;
+    }
+}
+
+void Process::addLine(const char* line, size_t len)
+{
+    if (len > 0 && line[len - 1] == '\r')
+    {
+        len--;
+    }
+    mOut.append(line, len);
+    mOut.appendc('\n');
+    if (mLineFunc)
+    {
+        mLineFunc(mLineCtx, line, len);
+    }
+}
+
+void Process::reap()
+{
+    if (mPid == -1)
+    {
+        return;
+    }
+#ifdef _WIN32
+    HANDLE han = (HANDLE)mPid;
+    DWORD code = (DWORD)-1;
+    WaitForSingleObject(han, INFINITE);
+    GetExitCodeProcess(han, &code);
+    CloseHandle(han);
+    mExitCode = (int)code;
+#else
+    int status = 0;
+    while (waitpid((pid_t)mPid, &status, 0) < 0)
+    {
+        if (errno != EINTR)
+        {
+            status = -1;
+            break;
+        }
+    }
+    if (status == -1)
+    {
+        mExitCode = -1;
+    }
+    else if (WIFEXITED(status))
+    {
+        mExitCode = WEXITSTATUS(status);
+    }
+    else
+    {
+        // Killed by a signal, reported the way shells do
+        mExitCode = 128 + WTERMSIG(status);
+    }
+#endif
+    mPid = -1;
+}
+
+bool waitProcesses(Process** procs, size_t count)
+{
+#ifdef _WIN32
+    // Anonymous pipes can't be waited on, so they are polled
+    for (;;)
+    {
+        bool open = false;
+        size_t total = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int s = 0; s < 2; s++)
+            {
+                if (procs[i]->mPipe[s] != -1)
+                {
+                    size_t before = procs[i]->mOut.length() + procs[i]->mPartial[s].length();
+                    if (procs[i]->readPipe(s))
+                    {
+                        open = true;
+                        total += procs[i]->mOut.length() + procs[i]->mPartial[s].length() - before;
+                    }
+                }
+            }
+        }
+        if (!open)
+        {
+            break;
+        }
+        if (total == 0)
+        {
+            Sleep(1);
+        }
+    }
+#else
+    std::vector<struct pollfd> fds;
+    std::vector<std::pair<Process*, int>> owners;
+    for (;;)
+    {
+        fds.clear();
+        owners.clear();
+        for (size_t i = 0; i < count; i++)
+        {
+            for (int s = 0; s < 2; s++)
+            {
+                if (procs[i]->mPipe[s] != -1)
+                {
+                    fds.push_back({(int)procs[i]->mPipe[s], POLLIN, 0});
+                    owners.push_back({procs[i], s});
+                }
+            }
+        }
+        if (fds.empty())
+        {
+            break;
+        }
+        if (poll(fds.data(), fds.size(), -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            dbgerr("poll failed, errno=%d\n", errno);
+            for (auto& o : owners)
+            {
+                o.first->closePipe(o.second);
+            }
+            break;
+        }
+        for (size_t i = 0; i < fds.size(); i++)
+        {
+            if (fds[i].revents & (POLLIN | POLLHUP | POLLERR | POLLNVAL))
+            {
+                owners[i].first->readPipe(owners[i].second);
+            }
+        }
+    }
+#endif
+
+    bool ret = true;
+    for (size_t i = 0; i < count; i++)
+    {
+        procs[i]->reap();
+        if (procs[i]->mExitCode != 0)
+        {
+            ret = false;
+        }
+    }
+    return ret;
+}
+
 bool listDirectory(const base::Path& dir, std::vector<base::Path>* filenames, std::vector<base::Path>* dirnames)
 {
 #ifdef _WIN32
@@ -1,11 +1,15 @@
 #include "util.h"
 #include "sys.h"
 #include <sys/stat.h>
+#include <time.h>
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
 #else
 #include <dirent.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
 #endif
 
 using namespace std;
@@ -297,6 +301,295 @@ void StrBld::stripQuotes(bool allowsingle)
     }
 }
 
+// StrRope::
+char* StrRope::newBlock(size_t size)
+{
+    char* blk = (char*)::malloc(size);
+    if (blk == NULL)
+    {
+        dbgerr("failed to allocate %zu bytes\n", size);
+        return NULL;
+    }
+    mBlocks.push_back(blk);
+    return blk;
+}
+
+void StrRope::appendBlocks(const char* s, size_t l)
+{
+    while (l > 0)
+    {
+        if (mCurFree == 0)
+        {
+            mCur = newBlock(BLOCKSIZE);
+            if (mCur == NULL)
+            {
+                return;
+            }
+            mCurFree = BLOCKSIZE;
+        }
+
+        // Grow the last segment when it ends where the block is filling from
+        size_t n = (l < mCurFree) ? l : mCurFree;
+        memcpy(mCur, s, n);
+        if (!mSegs.empty() && mSegs.back().mPtr + mSegs.back().mLen == mCur)
+        {
+            mSegs.back().mLen += n;
+        }
+        else
+        {
+            mSegs.push_back({ mCur, n });
+        }
+        mCur += n;
+        mCurFree -= n;
+        mLen += n;
+        mLast = s[n - 1];
+        s += n;
+        l -= n;
+    }
+}
+
+void StrRope::append(size_t count, char c)
+{
+    char buf[64];
+    while (count > 0)
+    {
+        size_t n = (count < sizeof(buf)) ? count : sizeof(buf);
+        memset(buf, c, n);
+        append(buf, n);
+        count -= n;
+    }
+}
+
+void StrRope::appendRef(std::string_view s)
+{
+    if (s.length() < MINREF)
+    {
+        append(s);
+        return;
+    }
+    mSegs.push_back({ s.data(), s.length() });
+    mLen += s.length();
+    mLast = s.back();
+}
+
+void StrRope::splice(StrRope& src)
+{
+    if (src.mLen == 0)
+    {
+        return;
+    }
+
+    // Our partly filled block stays current, src's blocks only hold what
+    // they already have
+    mSegs.insert(mSegs.end(), src.mSegs.begin(), src.mSegs.end());
+    mBlocks.insert(mBlocks.end(), src.mBlocks.begin(), src.mBlocks.end());
+    mLen += src.mLen;
+    mLast = src.mLast;
+
+    src.mBlocks.clear();
+    src.clear();
+}
+
+bool StrRope::appendFmt(const char* fmt, ...)
+{
+    va_list va;
+    va_start(va, fmt);
+    bool ret = appendVFmt(fmt, va);
+    va_end(va);
+    return ret;
+}
+
+bool StrRope::appendVFmt(const char* fmt, va_list varg)
+{
+    const int stackbufsize = 256;
+    char stackbuf[stackbufsize];
+    va_list orgvarg;
+
+    va_copy(orgvarg, varg);
+    int count = vsnprintf(stackbuf, stackbufsize, fmt, varg);
+    if (count < 0)
+    {
+        return false;
+    }
+
+    if (count < stackbufsize)
+    {
+        append(stackbuf, count);
+    }
+    else
+    {
+        std::string str(count, '\0');
+        if (vsnprintf(str.data(), count + 1, fmt, orgvarg) < 0)
+        {
+            return false;
+        }
+        append(str);
+    }
+    return true;
+}
+
+void StrRope::eraseLast()
+{
+    if (mSegs.empty())
+    {
+        return;
+    }
+
+    // Give the byte back to the block if it was the last one copied in
+    Seg& seg = mSegs.back();
+    if (seg.mPtr + seg.mLen == mCur)
+    {
+        mCur--;
+        mCurFree++;
+    }
+    seg.mLen--;
+    mLen--;
+    if (seg.mLen == 0)
+    {
+        mSegs.pop_back();
+    }
+    mLast = mSegs.empty() ? '\0' : mSegs.back().mPtr[mSegs.back().mLen - 1];
+}
+
+void StrRope::clear()
+{
+    for (char* blk : mBlocks)
+    {
+        ::free(blk);
+    }
+    mBlocks.clear();
+    mSegs.clear();
+    mCur = nullptr;
+    mCurFree = 0;
+    mLen = 0;
+    mLast = '\0';
+}
+
+std::string StrRope::toString() const
+{
+    std::string str;
+    str.reserve(mLen);
+    for (auto& seg : mSegs)
+    {
+        str.append(seg.mPtr, seg.mLen);
+    }
+    return str;
+}
+
+void StrRope::copyToBuffer(base::Buffer& buf) const
+{
+    if (mLen == 0)
+    {
+        buf.free();
+        return;
+    }
+    buf.alloc(mLen);
+    char* p = (char*)buf.ptr();
+    for (auto& seg : mSegs)
+    {
+        memcpy(p, seg.mPtr, seg.mLen);
+        p += seg.mLen;
+    }
+}
+
+void StrRope::moveToBuffer(base::Buffer& buf)
+{
+    copyToBuffer(buf);
+    clear();
+}
+
+bool StrRope::equalsFile(const std::string& filename) const
+{
+    struct stat st;
+    if (stat(filename.c_str(), &st) != 0 || (size_t)st.st_size != mLen)
+    {
+        return false;
+    }
+    base::Buffer fbuf;
+    if (mLen > 0 && !fbuf.readFile(filename, false))
+    {
+        return false;
+    }
+    const char* p = (const char*)fbuf.cptr();
+    for (auto& seg : mSegs)
+    {
+        if (memcmp(p, seg.mPtr, seg.mLen) != 0)
+        {
+            return false;
+        }
+        p += seg.mLen;
+    }
+    return true;
+}
+
+bool StrRope::writeFile(const std::string& filename) const
+{
+    bool ret = false;
+#ifdef _WIN32
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (f != NULL)
+    {
+        ret = true;
+        for (auto& seg : mSegs)
+        {
+            if (fwrite(seg.mPtr, 1, seg.mLen, f) != seg.mLen)
+            {
+                ret = false;
+                break;
+            }
+        }
+        fclose(f);
+    }
+#else
+    int fd = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+    if (fd >= 0)
+    {
+        // Hand the segments over IOV_MAX at a time, picking up after any
+        // short write
+        const size_t maxiov = IOV_MAX;
+        struct iovec iov[maxiov];
+        size_t segi = 0;
+        size_t segoff = 0;
+        ret = true;
+        while (ret && segi < mSegs.size())
+        {
+            size_t cnt = 0;
+            for (size_t i = segi; i < mSegs.size() && cnt < maxiov; i++, cnt++)
+            {
+                size_t off = (i == segi) ? segoff : 0;
+                iov[cnt].iov_base = (void*)(mSegs[i].mPtr + off);
+                iov[cnt].iov_len = mSegs[i].mLen - off;
+            }
+            ssize_t wr = ::writev(fd, iov, (int)cnt);
+            if (wr < 0)
+            {
+                ret = (errno == EINTR);
+                continue;
+            }
+            size_t left = (size_t)wr;
+            while (segi < mSegs.size() && left >= mSegs[segi].mLen - segoff)
+            {
+                left -= mSegs[segi].mLen - segoff;
+                segi++;
+                segoff = 0;
+            }
+            segoff += left;
+        }
+        if (::close(fd) != 0)
+        {
+            ret = false;
+        }
+    }
+#endif
+    if (!ret)
+    {
+        perror("");
+        dbgerr("Failed to write rope to '%s'\n", filename.c_str());
+    }
+    return ret;
+}
+
+
 // Parser::
 
 void Parser::initParser(const char* txt, size_t len)
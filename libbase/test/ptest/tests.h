@@ -17,7 +17,9 @@
     TS(testClocks) \
     TS(testFlags) \
     TS(testPersist) \
-    TS(testLoops)
+    TS(testStrRope) \
+    TS(testLoops) \
+    TS(testProcess)
 
 DECLTESTS()
 
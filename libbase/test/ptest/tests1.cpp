@@ -209,6 +209,7 @@ enummapdef(Keyword_Enum, Keyword, KeywordMap, 3);
                                                         _en_(p_bool)
 
 enummapdef(Primitive_Enum, Primitive, sPrimitiveMap, 2);
+enumhashmapdef(Primitive_Enum, HPrimitive, sHPrimitiveMap, 2);
 
 void testEnum()
 {
@@ -246,6 +247,34 @@ void testEnum()
     {
         printf("%d - %s\n", i, sPrimitiveMap.toStringI(i));
     }
+
+    bool same = sHPrimitiveMap.count() == sPrimitiveMap.count();
+    for (uint i = 0; i < sHPrimitiveMap.count(); i++)
+    {
+        HPrimitive hp;
+        same = same && sHPrimitiveMap.fromString(sPrimitiveMap.toStringI(i), &hp) && (uint)hp == i;
+    }
+    TESTEXP("Hashed map finds all", same);
+    TESTEXP("Hashed map misses", !sHPrimitiveMap.exists("int128") && !sHPrimitiveMap.exists("int321") &&
+        !sHPrimitiveMap.exists("") && !sHPrimitiveMap.exists("p_int8"));
+    TESTEXP("Hashed map toString", base::streql(sHPrimitiveMap.toString(HPrimitive::p_bool), "bool") &&
+        sHPrimitiveMap.toStringI(100) == nullptr);
+
+    const char* probes[] = { "int8", "bool", "sizet", "uint", "foo", "int32" };
+    size_t hits = 0, hhits = 0;
+    TIME("EnumStringMap 1M lookups")
+    for (int i = 0; i < 1000000; i++)
+    {
+        hits += sPrimitiveMap.exists(probes[i % countof(probes)]);
+    }
+    TIMEEND()
+    TIME("EnumStringHashMap 1M lookups")
+    for (int i = 0; i < 1000000; i++)
+    {
+        hhits += sHPrimitiveMap.exists(probes[i % countof(probes)]);
+    }
+    TIMEEND()
+    TESTEXP("Lookup hits", hits == hhits && hits == 1000000 - 166666);
 }
 
 void testSplitter()
@@ -397,6 +397,97 @@ void testPersist()
 }
 
 
+// Stand in for the compiler's codegen, the same text goes into either builder
+static void emitKw(base::StrBld& out, std::string_view kw)
+{
+    out.append(kw);
+}
+
+static void emitKw(base::StrRope& out, std::string_view kw)
+{
+    out.appendRef(kw);
+}
+
+template <class T>
+static void genCode(T& out, int stmts)
+{
+    constDef Comment = "// Generated by the primal compiler, do not edit this file by hand\n";
+    for (int i = 0; i < stmts; i++)
+    {
+        if ((i % 64) == 0)
+        {
+            emitKw(out, Comment);
+            out.append("void func");
+            out.appendFmt("%d", i);
+            out.append("(int32_t arg)\n{\n");
+        }
+        out.append(4, ' ');
+        emitKw(out, "auto ");
+        out.appendFmt("var%d = arg * %d + ", i, i % 7);
+        out.appendc(' ');
+        out.eraseLast();
+        out.eraseLast();
+        out.eraseLast();
+        out.append(";\n");
+        if ((i % 64) == 63)
+        {
+            out.append("}\n\n");
+        }
+    }
+}
+
+void testStrRope()
+{
+    constDef BigLit = "A literal long enough for the rope to keep a reference to it";
+
+    base::StrRope rope;
+    rope.append("abc");
+    rope.appendRef(BigLit);
+    rope.appendc('!');
+    TESTEXP("Rope appends", rope.toString() == std::string("abc") + BigLit + "!" && rope.last() == '!');
+    TESTEXP("Rope keeps long refs", rope.segCount() == 3);
+
+    rope.eraseLast();
+    rope.eraseLast();
+    TESTEXP("Rope eraseLast into a ref", rope.last() == BigLit[strlen(BigLit) - 2] &&
+        rope.length() == strlen(BigLit) + 2);
+
+    base::StrRope tail;
+    tail.append(base::StrRope::BLOCKSIZE + 10, 'x');
+    size_t len = rope.length() + tail.length();
+    rope.splice(tail);
+    TESTEXP("Rope splice", tail.empty() && rope.length() == len && rope.last() == 'x');
+
+    // Throughput against StrBld for a large generated file
+    const int stmts = 400000;
+    base::StrBld bld;
+    base::StrRope gen;
+    TIME("StrBld codegen + write")
+    genCode(bld, stmts);
+    base::Buffer buf;
+    bld.moveToBuffer(buf);
+    buf.writeFile("teststrbld.cpp");
+    TIMEEND()
+
+    TIME("StrRope codegen + writev")
+    genCode(gen, stmts);
+    gen.writeFile("teststrrope.cpp");
+    TIMEEND()
+
+    base::Buffer bldout;
+    base::Buffer ropeout;
+    bool loaded = bldout.readFile("teststrbld.cpp", false) && ropeout.readFile("teststrrope.cpp", false);
+    TESTEXP("StrRope output matches StrBld", loaded && bldout.size() == ropeout.size() &&
+        memcmp(bldout.cptr(), ropeout.cptr(), bldout.size()) == 0);
+    TESTEXP("StrRope equalsFile", gen.equalsFile("teststrbld.cpp"));
+    gen.appendc(' ');
+    TESTEXP("StrRope equalsFile differs", !gen.equalsFile("teststrbld.cpp"));
+    dbglog("%zu bytes in %zu segments\n", gen.length(), gen.segCount());
+
+    base::deleteFile("teststrbld.cpp");
+    base::deleteFile("teststrrope.cpp");
+}
+
 void testPath()
 {
     base::Path p("D:\\src\\playg\\base\\test1\\test2");
@@ -409,3 +500,71 @@ void testPath()
     np.makeAbs();
     dbglog("abspath: %s\n", np.c_str());
 }
+
+static void countLine(void* ctx, const char*, size_t)
+{
+    (*(int*)ctx)++;
+}
+
+void testProcess()
+{
+#ifdef _WIN32
+    std::vector<std::string> shell = {"cmd", "/c"};
+    const char* script = "echo out1& echo err1 1>&2& echo out2& exit 3";
+#else
+    std::vector<std::string> shell = {"sh", "-c"};
+    const char* script = "echo out1; echo err1 1>&2; echo out2; exit 3";
+#endif
+
+    TEST("Process output and exit code")
+        base::Process proc;
+        int lines = 0;
+        proc.setLineFunc(countLine, &lines);
+        std::vector<std::string> args = shell;
+        args.push_back(script);
+        RES = proc.start(args);
+        base::Process* procs[] = {&proc};
+        RES = RES && !base::waitProcesses(procs, 1);
+        const char* out = proc.output().c_str();
+        // stderr lines can land anywhere among the stdout ones
+        const char* out1 = strstr(out, "out1\n");
+        const char* out2 = strstr(out, "out2\n");
+        RES = RES && proc.exitCode() == 3 && lines == 3 &&
+            out1 && out2 && out1 < out2 && strstr(out, "err1\n");
+    TESTEND()
+
+    TEST("Processes run together")
+        // Each sleeps, together they take about as long as one.  The time is
+        // only logged, as a loaded machine can take much longer.
+        constexpr int COUNT = 4;
+        base::Process procs[COUNT];
+        base::Process* ptrs[COUNT];
+        uint64 start = getTickMS();
+        for (int i = 0; i < COUNT; i++)
+        {
+            std::vector<std::string> args = shell;
+#ifdef _WIN32
+            args.push_back(base::formatr("ping -n 2 127.0.0.1 > nul& echo done %d", i));
+#else
+            args.push_back(base::formatr("sleep 0.5; echo done %d", i));
+#endif
+            RES = RES && procs[i].start(args);
+            ptrs[i] = &procs[i];
+        }
+        RES = RES && base::waitProcesses(ptrs, COUNT);
+        uint64 elapsed = getTickMS() - start;
+        dbglog("%d processes in %llu ms\n", COUNT, elapsed);
+        for (int i = 0; i < COUNT; i++)
+        {
+            RES = RES && procs[i].exitCode() == 0 &&
+                procs[i].output().equals(base::formatr("done %d\n", i).c_str());
+        }
+    TESTEND()
+
+    TEST("Process that doesn't exist")
+        base::Process proc;
+        RES = !proc.start({"pc_no_such_program"});
+        base::Process* procs[] = {&proc};
+        RES = RES && !base::waitProcesses(procs, 1) && proc.exitCode() == -1;
+    TESTEND()
+}
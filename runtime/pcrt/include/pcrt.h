@@ -4,4 +4,8 @@
 #include "plmem.h"
 #include "plobj.h"
 #include "plarr.h"
+#include "pltask.h"
+#include "plsync.h"
+#include "plchan.h"
+#include "plmap.h"
 
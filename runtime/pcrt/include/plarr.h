@@ -218,6 +218,86 @@ template <class T>
 class PlVector : public PlObject
 {
 public:
+    // Range-based for over the elements by index, as follows:
+    //    for (auto i : vec->indexFwd())
+    //    {
+    //        i->foo();
+    //    }
+    // The length is read once when the loop starts.  Each step borrows its
+    // element, a plain pointer read from the array as it is then, so the
+    // loop body can append to the vector, which may move the array.  A loop
+    // stops early at the end of a vector that shrinks under it.  The range
+    // holds a ref on the vector for the length of the loop, but not on the
+    // element, so an element removed by the body isn't used after that.
+    template <bool REV>
+    class IndexRange
+    {
+    public:
+        class Pos
+        {
+        public:
+            Pos(ObjArray<PlRef<T>>* arr, usize pos) :
+                mArr(arr),
+                mPos(pos)
+            {
+            }
+            T* operator*()
+            {
+                PlRef<T>& ref = *(PlRef<T>*)mArr->MemArray::get(REV ? mPos - 1 : mPos);
+                return ref.operator->();
+            }
+            Pos& operator++()
+            {
+                if constexpr (REV)
+                {
+                    mPos--;
+                    if (mPos > mArr->length())
+                    {
+                        mPos = mArr->length();
+                    }
+                }
+                else
+                {
+                    mPos++;
+                }
+                return *this;
+            }
+            bool operator!=(const Pos& that) const
+            {
+                if constexpr (REV)
+                {
+                    return mPos != that.mPos;
+                }
+                else
+                {
+                    return mPos != that.mPos && mPos < mArr->length();
+                }
+            }
+
+        private:
+            ObjArray<PlRef<T>>* mArr;
+            usize mPos;
+        };
+
+        IndexRange(PlVector* vec) :
+            mVec(vec),
+            mLen(vec->length())
+        {
+        }
+        Pos begin()
+        {
+            return Pos(&mVec->mArr, REV ? mLen : 0);
+        }
+        Pos end()
+        {
+            return Pos(&mVec->mArr, REV ? 0 : mLen);
+        }
+
+    private:
+        PlRef<PlVector> mVec;
+        usize mLen;
+    };
+
     PlVector() :
         mPool(_NEWOB(PlPoolAlloc<T>))
     {
@@ -264,7 +344,11 @@ public:
 
     bool remove(usize pos)
     {
-
+        if (pos >= mArr.length())
+        {
+            return false;
+        }
+        return mArr.remove(pos);
     }
 
     void tune()
@@ -286,6 +370,16 @@ public:
         return false;
     }
 
+    // Index ranges, used for 'iter' loops
+    IndexRange<false> indexFwd()
+    {
+        return IndexRange<false>(this);
+    }
+    IndexRange<true> indexRev()
+    {
+        return IndexRange<true>(this);
+    }
+
     // Reverse iterator
     Iter<PlRef<T>> iterRev()
     {
@@ -14,6 +14,13 @@
 #include <stdint.h>
 #include <initializer_list>
 
+// SSE2, on every x64 CPU.  Included before malloc and free are disallowed
+// below, as its headers use them.
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define PL_SSE2
+#include <emmintrin.h>
+#endif
+
 // Basic types
 
 using int8 = int8_t;
@@ -70,12 +77,38 @@ extern "C" long _InterlockedDecrement(long volatile*);
 extern "C" __int64 _InterlockedIncrement64(__int64 volatile*);
 extern "C" __int64 _InterlockedDecrement64(__int64 volatile*);
 #endif
+extern "C" long _InterlockedExchange(long volatile*, long);
+extern "C" long _InterlockedOr(long volatile*, long);
+extern "C" long _InterlockedCompareExchange(long volatile*, long, long);
+extern "C" long _InterlockedExchangeAdd(long volatile*, long);
+extern "C" __int64 _InterlockedExchange64(__int64 volatile*, __int64);
+extern "C" __int64 _InterlockedOr64(__int64 volatile*, __int64);
+extern "C" __int64 _InterlockedCompareExchange64(__int64 volatile*, __int64, __int64);
+extern "C" __int64 _InterlockedExchangeAdd64(__int64 volatile*, __int64);
+extern "C" void* _InterlockedExchangePointer(void* volatile*, void*);
+extern "C" void* _InterlockedCompareExchangePointer(void* volatile*, void*, void*);
 #pragma intrinsic(_InterlockedIncrement)
 #pragma intrinsic(_InterlockedDecrement)
+#pragma intrinsic(_InterlockedExchange)
+#pragma intrinsic(_InterlockedOr)
+#pragma intrinsic(_InterlockedCompareExchange)
+#pragma intrinsic(_InterlockedExchangeAdd)
+#pragma intrinsic(_InterlockedExchange64)
+#pragma intrinsic(_InterlockedOr64)
+#pragma intrinsic(_InterlockedCompareExchange64)
+#pragma intrinsic(_InterlockedExchangeAdd64)
+#pragma intrinsic(_InterlockedExchangePointer)
+#pragma intrinsic(_InterlockedCompareExchangePointer)
 #ifdef __x86_64__
 #pragma intrinsic(_InterlockedIncrement64)
 #pragma intrinsic(_InterlockedDecrement64)
 #endif
+#if defined(_M_X64) || defined(_M_IX86)
+extern "C" void _mm_pause(void);
+#pragma intrinsic(_mm_pause)
+#endif
+extern "C" unsigned char _BitScanForward(unsigned long*, unsigned long);
+#pragma intrinsic(_BitScanForward)
 #endif
 
 #ifndef ALLOW_CRT_MALLOC
@@ -125,10 +158,273 @@ inline int64 atomicDecrement(volatile int64* v)
 #endif
 }
 
-// Basic OS output
-void osPrint(const char* str, usize len);
+inline int32 atomicLoad(volatile int32* v)
+{
+#ifdef _MSC_VER
+    return _InterlockedOr((long volatile*)v, 0);
+#else
+    return __atomic_load_n(v, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline void atomicStore(volatile int32* v, int32 val)
+{
+#ifdef _MSC_VER
+    _InterlockedExchange((long volatile*)v, val);
+#else
+    __atomic_store_n(v, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+inline int32 atomicExchange(volatile int32* v, int32 val)
+{
+#ifdef _MSC_VER
+    return _InterlockedExchange((long volatile*)v, val);
+#else
+    return __atomic_exchange_n(v, val, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Stores desired if *v holds expected, returns true if it did
+inline bool atomicCompareExchange(volatile int32* v, int32 expected, int32 desired)
+{
+#ifdef _MSC_VER
+    return _InterlockedCompareExchange((long volatile*)v, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(v, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Returns the new value
+inline int32 atomicAdd(volatile int32* v, int32 val)
+{
+#ifdef _MSC_VER
+    return _InterlockedExchangeAdd((long volatile*)v, val) + val;
+#else
+    return __sync_add_and_fetch(v, val);
+#endif
+}
+
+template <typename T>
+inline T* atomicExchangePtr(T* volatile* p, T* val)
+{
+#ifdef _MSC_VER
+    return (T*)_InterlockedExchangePointer((void* volatile*)p, val);
+#else
+    return __atomic_exchange_n(p, val, __ATOMIC_ACQ_REL);
+#endif
+}
+
+template <typename T>
+inline T* atomicLoadPtr(T* volatile* p)
+{
+#ifdef _MSC_VER
+    return (T*)_InterlockedCompareExchangePointer((void* volatile*)p, nullptr, nullptr);
+#else
+    return __atomic_load_n(p, __ATOMIC_ACQUIRE);
+#endif
+}
 
-// Basic OS specific mutex.
+template <typename T>
+inline void atomicStorePtr(T* volatile* p, T* val)
+{
+#ifdef _MSC_VER
+    _InterlockedExchangePointer((void* volatile*)p, val);
+#else
+    __atomic_store_n(p, val, __ATOMIC_RELEASE);
+#endif
+}
+
+// Returns the new value
+inline int64 atomicAdd(volatile int64* v, int64 val)
+{
+#ifdef _MSC_VER
+    return _InterlockedExchangeAdd64((__int64 volatile*)v, val) + val;
+#else
+    return __sync_add_and_fetch(v, val);
+#endif
+}
+
+// No ordering, only a whole value, for caches any thread can fill in
+inline uint64 atomicLoadRelaxed(const volatile uint64* v)
+{
+#ifdef _MSC_VER
+    return (uint64)__iso_volatile_load64((const volatile __int64*)v);
+#else
+    return __atomic_load_n(v, __ATOMIC_RELAXED);
+#endif
+}
+
+inline void atomicStoreRelaxed(volatile uint64* v, uint64 val)
+{
+#ifdef _MSC_VER
+    __iso_volatile_store64((volatile __int64*)v, (__int64)val);
+#else
+    __atomic_store_n(v, val, __ATOMIC_RELAXED);
+#endif
+}
+
+inline int64 atomicLoadAcq(volatile int64* v)
+{
+#ifdef _MSC_VER
+    return _InterlockedOr64((__int64 volatile*)v, 0);
+#else
+    return __atomic_load_n(v, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void atomicStoreRel(volatile int64* v, int64 val)
+{
+#ifdef _MSC_VER
+    _InterlockedExchange64((__int64 volatile*)v, val);
+#else
+    __atomic_store_n(v, val, __ATOMIC_RELEASE);
+#endif
+}
+
+// Stores desired if *v holds expected, returns true if it did
+inline bool atomicCompareExchange(volatile int64* v, int64 expected, int64 desired)
+{
+#ifdef _MSC_VER
+    return _InterlockedCompareExchange64((__int64 volatile*)v, desired, expected) == expected;
+#else
+    return __atomic_compare_exchange_n(v, &expected, desired, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Full memory barrier
+inline void atomicFence()
+{
+#ifdef _MSC_VER
+    static volatile long sFence;
+    _InterlockedOr(&sFence, 0);
+#else
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+#endif
+}
+
+// Tells the CPU this is a spin wait loop
+inline void cpuPause()
+{
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+    _mm_pause();
+#elif defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    __asm__ __volatile__("yield");
+#endif
+}
+
+// Index of the lowest set bit, v must not be 0
+inline uint32 bitScanFwd(uint32 v)
+{
+#ifdef _MSC_VER
+    unsigned long i;
+    _BitScanForward(&i, v);
+    return (uint32)i;
+#else
+    return (uint32)__builtin_ctz(v);
+#endif
+}
+
+// Hashes for hash tables, not for security.  hashInt mixes all the bits of
+// an integer into the low ones, hashBytes reads 8 bytes at a time.
+inline uint64 hashInt(uint64 v)
+{
+    v ^= v >> 33;
+    v *= 0xff51afd7ed558ccdULL;
+    v ^= v >> 33;
+    v *= 0xc4ceb9fe1a85ec53ULL;
+    v ^= v >> 33;
+    return v;
+}
+uint64 hashBytes(const void* data, usize len);
+
+// Intrusive multi producer, single consumer queue.  Any number of threads
+// push without locking, and one thread pops.  T must have a 'T* volatile mNext'.
+template <typename T>
+class MpscQueue
+{
+public:
+    MpscQueue() :
+        mHead(&mStub),
+        mTail(&mStub)
+    {
+        mStub.mNext = nullptr;
+    }
+    MpscQueue(const MpscQueue&) = delete;
+    MpscQueue& operator=(const MpscQueue&) = delete;
+
+    void push(T* node)
+    {
+        node->mNext = nullptr;
+        T* prev = atomicExchangePtr(&mHead, node);
+        atomicStorePtr(&prev->mNext, node);
+    }
+
+    // Returns nullptr when empty, or when the next node is still being
+    // linked in by a push
+    T* pop()
+    {
+        T* tail = mTail;
+        T* next = atomicLoadPtr(&tail->mNext);
+        if (tail == &mStub)
+        {
+            if (next == nullptr)
+            {
+                return nullptr;
+            }
+            mTail = next;
+            tail = next;
+            next = atomicLoadPtr(&next->mNext);
+        }
+        if (next)
+        {
+            mTail = next;
+            return tail;
+        }
+        if (tail != atomicLoadPtr(&mHead))
+        {
+            return nullptr;
+        }
+        push(&mStub);
+        next = atomicLoadPtr(&tail->mNext);
+        if (next)
+        {
+            mTail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+private:
+    T* volatile mHead;
+    T* mTail;
+    T mStub;
+};
+
+// Basic OS output.  Each thread gathers its output in a buffer, and a line
+// is written with a single write.  When stdout isn't a terminal, the buffer
+// is written when full, when a line ends 100ms or more after the last write,
+// and on abort.  In async mode, lines are queued to a logger thread instead,
+// which batches them into one writev.
+void osPrint(const char* str, usize len);
+void osPrintBegin(usize len);
+void osPrintAppend(const char* str, usize len);
+void osPrintEnd();
+void osPrintFlush();
+void osPrintAsync(bool async);
+
+// Gives up the rest of this thread's time slice, or sleeps for a millisecond
+void osYield(bool sleep);
+
+// Sleeps while *addr holds val, or until woken.  It can return early, so the
+// caller checks again.  Wake wakes one or all of the threads waiting on addr.
+void osFutexWait(volatile int32* addr, int32 val);
+void osFutexWake(volatile int32* addr, bool all);
+
+// Basic OS specific mutex.  It is recursive, see FastMutex for the faster
+// non-recursive one.
 class Mutex
 {
 public:
@@ -156,10 +452,140 @@ private:
     uint64 mMutData[OS_MUTEX_SIZE_64];
 };
 
+// Mutex on a futex.  It spins for a little while when the lock is taken,
+// then sleeps, and unlock only goes to the OS when there are sleepers.  It
+// isn't recursive, a thread locking it twice deadlocks.
+class FastMutex
+{
+public:
+    FastMutex() :
+        mState(0)
+    {
+    }
+    FastMutex(const FastMutex&) = delete;
+    FastMutex& operator=(const FastMutex&) = delete;
+
+    void lock()
+    {
+        if (!atomicCompareExchange(&mState, 0, 1))
+        {
+            lockSlow();
+        }
+    }
+    bool tryLock()
+    {
+        return atomicCompareExchange(&mState, 0, 1);
+    }
+    void unlock()
+    {
+        if (atomicExchange(&mState, 0) == 2)
+        {
+            osFutexWake(&mState, false);
+        }
+    }
+
+private:
+    void lockSlow();
+
+    // 0 unlocked, 1 locked, 2 locked and there may be sleepers
+    volatile int32 mState;
+};
+
+// Reader-writer lock.  Any number of readers, or one writer.  A waiting
+// writer stops new readers from getting in, so writers aren't starved.
+class RwMutex
+{
+public:
+    RwMutex() :
+        mState(0),
+        mSeq(0),
+        mSleepers(0)
+    {
+    }
+    RwMutex(const RwMutex&) = delete;
+    RwMutex& operator=(const RwMutex&) = delete;
+
+    void lockRead()
+    {
+        int32 st = atomicLoad(&mState);
+        if ((st & WRITER) != 0 || !atomicCompareExchange(&mState, st, st + 1))
+        {
+            lockReadSlow();
+        }
+    }
+    void unlockRead()
+    {
+        // The last reader out lets a waiting writer in
+        if (atomicAdd(&mState, -1) == WRITER)
+        {
+            wake();
+        }
+    }
+    void lock();
+    void unlock();
+
+private:
+    void lockReadSlow();
+    void wake();
+    void sleep(bool writer);
+
+    // Set while a writer holds the lock or waits for the readers to leave
+    static constexpr int32 WRITER = 1 << 30;
+
+    // Reader count, plus WRITER
+    volatile int32 mState;
+    // Bumped to wake sleepers
+    volatile int32 mSeq;
+    volatile int32 mSleepers;
+    // Lets one writer in at a time
+    FastMutex mWriteMut;
+};
+
+// Runs a function once, however many threads call it.  Calls made while it
+// runs wait for it to finish.
+class OnceFlag
+{
+public:
+    OnceFlag() :
+        mState(0)
+    {
+    }
+    OnceFlag(const OnceFlag&) = delete;
+    OnceFlag& operator=(const OnceFlag&) = delete;
+
+    template <class FuncType>
+    void call(FuncType&& fn)
+    {
+        if (atomicLoad(&mState) != DONE && begin())
+        {
+            fn();
+            end();
+        }
+    }
+    bool done()
+    {
+        return atomicLoad(&mState) == DONE;
+    }
+
+private:
+    // Returns true if this thread is to run it
+    bool begin();
+    void end();
+
+    static constexpr int32 RUNNING = 1;
+    static constexpr int32 SLEEPERS = 2;
+    static constexpr int32 DONE = 3;
+
+    volatile int32 mState;
+};
+
+// Holds a lock for a scope.  Works with Mutex, FastMutex, or the write side
+// of RwMutex.
+template <class LockType>
 class AutoLock
 {
 public:
-    explicit AutoLock(Mutex& mutex) :
+    explicit AutoLock(LockType& mutex) :
         mMut(mutex)
     {
         mMut.lock();
@@ -169,7 +595,23 @@ public:
         mMut.unlock();
     }
 private:
-    Mutex& mMut;
+    LockType& mMut;
+};
+
+class AutoReadLock
+{
+public:
+    explicit AutoReadLock(RwMutex& mutex) :
+        mMut(mutex)
+    {
+        mMut.lockRead();
+    }
+    ~AutoReadLock()
+    {
+        mMut.unlockRead();
+    }
+private:
+    RwMutex& mMut;
 };
 
 // Variable argument type
@@ -0,0 +1,324 @@
+#pragma once
+
+#include "plbase.h"
+#include "plobj.h"
+#include <type_traits>
+
+namespace primal
+{
+
+// Bounded channel between any number of senders and receivers.  It is a
+// ring of cells, each with a sequence number saying whose turn it is, so a
+// send or receive only races for its position with one CAS and never locks.
+// When full or empty the blocking calls spin for a little while, then sleep
+// on a futex until the other side makes room or sends.  A task blocked on a
+// channel holds on to its worker, so the other side has to be running on
+// another thread, or what is sent has to fit in the capacity.
+//
+// T is either an object, held as a reference, or a value type.  An object's
+// reference is counted once on send and handed over as is on receive.
+template <class T>
+class PlChannel : public PlObject
+{
+public:
+    static constexpr bool ISOBJ = std::is_base_of_v<PlObject, T>;
+    using Item = std::conditional_t<ISOBJ, PlRef<T>, T>;
+
+    PlChannel() :
+        PlChannel(DEFAULTCAPACITY)
+    {
+    }
+    explicit PlChannel(usize capacity) :
+        mCells(nullptr),
+        mMask(0),
+        mSendPos(0),
+        mRecvPos(0),
+        mSendSeq(0),
+        mRecvSeq(0),
+        mSendSleepers(0),
+        mRecvSleepers(0)
+    {
+        allocCells(capacity);
+    }
+    ~PlChannel()
+    {
+        freeCells();
+    }
+
+    // Only while no other thread is using it.  Anything queued is dropped.
+    void setCapacity(usize capacity)
+    {
+        freeCells();
+        allocCells(capacity);
+    }
+    usize capacity()
+    {
+        return mMask + 1;
+    }
+    // Only a snapshot while others are sending or receiving
+    usize length()
+    {
+        int64 n = atomicLoadAcq(&mSendPos) - atomicLoadAcq(&mRecvPos);
+        return n > 0 ? (usize)n : 0;
+    }
+
+    bool trySend(Item& item)
+    {
+        if constexpr (ISOBJ)
+        {
+            T* obj = item.operator->();
+            PlRef<T>::incRef(obj);
+            if (push(obj))
+            {
+                return true;
+            }
+            PlRef<T>::decRef(obj);
+            return false;
+        }
+        else
+        {
+            return push(item);
+        }
+    }
+    bool trySend(Item&& item)
+    {
+        if constexpr (ISOBJ)
+        {
+            if (push(item.operator->()))
+            {
+                item.release();
+                return true;
+            }
+            return false;
+        }
+        else
+        {
+            return push(item);
+        }
+    }
+    void send(Item& item)
+    {
+        while (!trySend(item))
+        {
+            waitSpace();
+        }
+    }
+    void send(Item&& item)
+    {
+        while (!trySend((Item&&)item))
+        {
+            waitSpace();
+        }
+    }
+
+    bool tryRecv(Item& item)
+    {
+        Slot data;
+        if (!pop(data))
+        {
+            return false;
+        }
+        if constexpr (ISOBJ)
+        {
+            item.adopt(data);
+        }
+        else
+        {
+            item = data;
+        }
+        return true;
+    }
+    Item recv()
+    {
+        Item item;
+        while (!tryRecv(item))
+        {
+            waitItem();
+        }
+        return item;
+    }
+
+private:
+    using Slot = std::conditional_t<ISOBJ, T*, T>;
+
+    struct Cell
+    {
+        volatile int64 mSeq;
+        Slot mData;
+    };
+
+    static constexpr usize DEFAULTCAPACITY = 256;
+    static constexpr int SPINS = 64;
+    static constexpr usize CACHELINE = 64;
+
+    void allocCells(usize capacity)
+    {
+        usize cap = 2;
+        while (cap < capacity)
+        {
+            cap *= 2;
+        }
+        mCells = (Cell*)sDefaultMemAlloc->_malloc(sizeof(Cell) * cap);
+        for (usize i = 0; i < cap; i++)
+        {
+            new(&mCells[i]) Cell();
+            mCells[i].mSeq = (int64)i;
+        }
+        mMask = cap - 1;
+        mSendPos = 0;
+        mRecvPos = 0;
+    }
+    void freeCells()
+    {
+        Slot data;
+        while (pop(data))
+        {
+            if constexpr (ISOBJ)
+            {
+                PlRef<T>::decRef(data);
+            }
+        }
+        for (usize i = 0; i <= mMask; i++)
+        {
+            mCells[i].~Cell();
+        }
+        sDefaultMemAlloc->_free(mCells);
+        mCells = nullptr;
+    }
+
+    // A cell is free to send into at position pos when its sequence is pos,
+    // and holds an item to receive when it is pos + 1.  Receiving moves the
+    // sequence on to the cell's position in the next lap.
+    bool push(Slot data)
+    {
+        int64 pos = atomicLoadAcq(&mSendPos);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &mCells[pos & mMask];
+            int64 dif = atomicLoadAcq(&cell->mSeq) - pos;
+            if (dif == 0)
+            {
+                if (atomicCompareExchange(&mSendPos, pos, pos + 1))
+                {
+                    break;
+                }
+            }
+            else if (dif < 0)
+            {
+                return false;
+            }
+            pos = atomicLoadAcq(&mSendPos);
+        }
+        cell->mData = data;
+        atomicStoreRel(&cell->mSeq, pos + 1);
+        wake(&mSendSeq, &mRecvSleepers);
+        return true;
+    }
+    bool pop(Slot& data)
+    {
+        int64 pos = atomicLoadAcq(&mRecvPos);
+        Cell* cell;
+        for (;;)
+        {
+            cell = &mCells[pos & mMask];
+            int64 dif = atomicLoadAcq(&cell->mSeq) - (pos + 1);
+            if (dif == 0)
+            {
+                if (atomicCompareExchange(&mRecvPos, pos, pos + 1))
+                {
+                    break;
+                }
+            }
+            else if (dif < 0)
+            {
+                return false;
+            }
+            pos = atomicLoadAcq(&mRecvPos);
+        }
+        data = cell->mData;
+        atomicStoreRel(&cell->mSeq, pos + (int64)mMask + 1);
+        wake(&mRecvSeq, &mSendSleepers);
+        return true;
+    }
+
+    // A sleeper is counted before it looks again, and the other side checks
+    // the count after its change, so either the sleeper sees the change, or
+    // the futex value has moved on when it goes to sleep
+    static void wake(volatile int32* seq, volatile int32* sleepers)
+    {
+        atomicFence();
+        if (atomicLoad(sleepers) > 0)
+        {
+            atomicIncrement(seq);
+            osFutexWake(seq, false);
+        }
+    }
+    bool full()
+    {
+        int64 pos = atomicLoadAcq(&mSendPos);
+        return atomicLoadAcq(&mCells[pos & mMask].mSeq) - pos < 0;
+    }
+    bool empty()
+    {
+        int64 pos = atomicLoadAcq(&mRecvPos);
+        return atomicLoadAcq(&mCells[pos & mMask].mSeq) - (pos + 1) < 0;
+    }
+    void waitSpace()
+    {
+        for (int i = 0; i < SPINS; i++)
+        {
+            if (!full())
+            {
+                return;
+            }
+            cpuPause();
+        }
+        atomicIncrement(&mSendSleepers);
+        int32 seq = atomicLoad(&mRecvSeq);
+        if (full())
+        {
+            osFutexWait(&mRecvSeq, seq);
+        }
+        atomicDecrement(&mSendSleepers);
+    }
+    void waitItem()
+    {
+        for (int i = 0; i < SPINS; i++)
+        {
+            if (!empty())
+            {
+                return;
+            }
+            cpuPause();
+        }
+        atomicIncrement(&mRecvSleepers);
+        int32 seq = atomicLoad(&mSendSeq);
+        if (empty())
+        {
+            osFutexWait(&mSendSeq, seq);
+        }
+        atomicDecrement(&mRecvSleepers);
+    }
+
+    Cell* mCells;
+    usize mMask;
+
+    // Senders and receivers each on their own cache line.  Objects come from
+    // an allocator that only aligns to 16, so each group is padded a whole
+    // line away from the next rather than aligned.
+    char mPad0[CACHELINE - sizeof(usize)];
+    volatile int64 mSendPos;
+    char mPad1[CACHELINE - sizeof(int64)];
+    volatile int64 mRecvPos;
+    char mPad2[CACHELINE - sizeof(int64)];
+
+    // Bumped by a send when receivers sleep, and by a receive when senders do
+    volatile int32 mSendSeq;
+    volatile int32 mRecvSeq;
+    volatile int32 mSendSleepers;
+    volatile int32 mRecvSleepers;
+    char mPad3[CACHELINE - 4 * sizeof(int32)];
+};
+
+} // namespace primal
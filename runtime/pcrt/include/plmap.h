@@ -0,0 +1,554 @@
+#pragma once
+
+#include "plbase.h"
+#include "plobj.h"
+#include "plstr.h"
+#include <type_traits>
+#include <utility>
+
+namespace primal
+{
+
+// Hashes a map's keys.  Integers are mixed, strings keep their hash, and
+// objects hash their address, so two refs are the same key when they are
+// the same object.
+template <class T, class Enable = void>
+struct PlHash
+{
+};
+
+template <class T>
+struct PlHash<T, std::enable_if_t<std::is_integral_v<T> || std::is_enum_v<T>>>
+{
+    static uint64 hash(T v)
+    {
+        return hashInt((uint64)v);
+    }
+};
+
+template <class T>
+struct PlHash<T, std::enable_if_t<std::is_floating_point_v<T>>>
+{
+    static uint64 hash(T v)
+    {
+        // -0 and 0 are equal keys
+        if (v == 0)
+        {
+            v = 0;
+        }
+        return hashBytes(&v, sizeof(v));
+    }
+};
+
+template <>
+struct PlHash<string>
+{
+    static uint64 hash(const string& s)
+    {
+        return s.hash();
+    }
+};
+
+template <class T>
+struct PlHash<PlRef<T>>
+{
+    static uint64 hash(const PlRef<T>& r)
+    {
+        return hashInt((uint64)(usize)r.operator->());
+    }
+};
+
+// Primal boxes the value types in template arguments, a map holds the value
+template <class T>
+struct PlUnbox
+{
+    using Type = T;
+};
+
+template <class T>
+struct PlUnbox<PlBoxObj<T>>
+{
+    using Type = T;
+};
+
+// The control bytes of 16 slots, loaded at once.  A byte is EMPTY, DELETED,
+// or for a full slot the low 7 bits of its key's hash.  Each match returns
+// a bit per slot.  Without SSE2 the bytes are matched 8 at a time in a
+// uint64, where match(h2) can report a slot just above a real match.  That
+// only costs a key compare.
+class PlMapGroup
+{
+public:
+    static constexpr usize WIDTH = 16;
+    static constexpr int8 EMPTY = -128;
+    static constexpr int8 DELETED = -2;
+
+    explicit PlMapGroup(const int8* ctrl)
+    {
+#ifdef PL_SSE2
+        mCtrl = _mm_loadu_si128((const __m128i*)ctrl);
+#else
+        memcpy(mCtrl, ctrl, WIDTH);
+#endif
+    }
+
+#ifdef PL_SSE2
+    uint32 match(int8 h2) const
+    {
+        return (uint32)_mm_movemask_epi8(_mm_cmpeq_epi8(_mm_set1_epi8(h2), mCtrl));
+    }
+    uint32 matchEmpty() const
+    {
+        return match(EMPTY);
+    }
+    // Empty or deleted, the bytes with the sign bit set
+    uint32 matchFree() const
+    {
+        return (uint32)_mm_movemask_epi8(mCtrl);
+    }
+
+private:
+    __m128i mCtrl;
+#else
+    uint32 match(int8 h2) const
+    {
+        uint64 pat = LSBS * (uint8)h2;
+        return bits(zeroBytes(mCtrl[0] ^ pat)) | (bits(zeroBytes(mCtrl[1] ^ pat)) << 8);
+    }
+    // EMPTY is the only one with the sign bit set and bit 6 clear
+    uint32 matchEmpty() const
+    {
+        return bits(mCtrl[0] & ~(mCtrl[0] << 1) & MSBS) | (bits(mCtrl[1] & ~(mCtrl[1] << 1) & MSBS) << 8);
+    }
+    uint32 matchFree() const
+    {
+        return bits(mCtrl[0] & MSBS) | (bits(mCtrl[1] & MSBS) << 8);
+    }
+
+private:
+    static constexpr uint64 LSBS = 0x0101010101010101ULL;
+    static constexpr uint64 MSBS = 0x8080808080808080ULL;
+
+    static uint64 zeroBytes(uint64 v)
+    {
+        return (v - LSBS) & ~v & MSBS;
+    }
+    // The top bit of each byte, gathered into 8 bits
+    static uint32 bits(uint64 m)
+    {
+        return (uint32)(((m >> 7) * 0x0102040810204080ULL) >> 56);
+    }
+
+    uint64 mCtrl[2];
+#endif
+
+public:
+    // Lookups in a map with no slots read these, and find nothing
+    static inline const int8 sEmpty[WIDTH] = {
+        EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY,
+        EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY, EMPTY
+    };
+};
+
+// Hash map with open addressing, after Google's SwissTable.  The slots have
+// a control byte each, in an array of their own, and a lookup compares 16 of
+// them at a time with the 7 bits of the hash not used for the position, so
+// the keys are only read for likely matches.  A lookup stops at the first
+// group with an empty slot.  Removed keys leave a DELETED byte until the next
+// rehash, which doubles the slots or, when many were deleted, only cleans up.
+// The table is kept at most 7/8 full.
+//
+// The slot count is a power of 2.  Probing goes from the hash's position by
+// 16, 32, 48 slots and so on, which reaches every group.  The control bytes
+// have 16 more at the end mirroring the first 16, so a group can be loaded
+// from any slot.
+//
+// K and V are objects, held as references, or value types.  Object keys are
+// compared by identity.  Not safe to use from more than one thread at once.
+template <class K, class V>
+class PlMap : public PlObject
+{
+public:
+    using KeyType = typename PlUnbox<K>::Type;
+    using ValType = typename PlUnbox<V>::Type;
+    static constexpr bool KEYOBJ = std::is_base_of_v<PlObject, KeyType>;
+    static constexpr bool VALOBJ = std::is_base_of_v<PlObject, ValType>;
+    using Key = std::conditional_t<KEYOBJ, PlRef<KeyType>, KeyType>;
+    using Val = std::conditional_t<VALOBJ, PlRef<ValType>, ValType>;
+
+    // A key and its value.  The key is mData, the field of a box, so an iter
+    // for in Primal reads value type keys as it reads a vector's elements.
+    struct Entry
+    {
+        Key mData;
+        Val mVal;
+    };
+
+    // Range-based for over the entries, in slot order, as follows:
+    //    for (auto& e : map->indexFwd())
+    //    {
+    //        foo(e->mData, e->mVal);
+    //    }
+    // With object keys each item is the key's ref instead.  The map must not
+    // be changed during the loop, the range holds a ref on it.
+    template <bool REV>
+    class IndexRange
+    {
+    public:
+        class Pos
+        {
+        public:
+            Pos(PlMap* map, usize pos) :
+                mMap(map),
+                mPos(pos),
+                mEntry(nullptr)
+            {
+                skip();
+            }
+            decltype(auto) operator*()
+            {
+                mEntry = &mMap->mEntries[REV ? mPos - 1 : mPos];
+                if constexpr (KEYOBJ)
+                {
+                    return (mEntry->mData);
+                }
+                else
+                {
+                    return (mEntry);
+                }
+            }
+            Pos& operator++()
+            {
+                if constexpr (REV)
+                {
+                    mPos--;
+                }
+                else
+                {
+                    mPos++;
+                }
+                skip();
+                return *this;
+            }
+            bool operator!=(const Pos& that) const
+            {
+                return mPos != that.mPos;
+            }
+
+        private:
+            // On to the next full slot, or the end
+            void skip()
+            {
+                if constexpr (REV)
+                {
+                    while (mPos > 0 && mMap->mCtrl[mPos - 1] < 0)
+                    {
+                        mPos--;
+                    }
+                }
+                else
+                {
+                    while (mPos < mMap->mCap && mMap->mCtrl[mPos] < 0)
+                    {
+                        mPos++;
+                    }
+                }
+            }
+
+            PlMap* mMap;
+            usize mPos;
+            Entry* mEntry;
+        };
+
+        IndexRange(PlMap* map) :
+            mMap(map)
+        {
+        }
+        Pos begin()
+        {
+            return Pos(mMap.operator->(), REV ? mMap->mCap : 0);
+        }
+        Pos end()
+        {
+            return Pos(mMap.operator->(), REV ? 0 : mMap->mCap);
+        }
+
+    private:
+        PlRef<PlMap> mMap;
+    };
+
+    PlMap() :
+        mCtrl(const_cast<int8*>(PlMapGroup::sEmpty)),
+        mEntries(nullptr),
+        mCap(0),
+        mCount(0),
+        mGrowth(0)
+    {
+    }
+    ~PlMap()
+    {
+        clear();
+    }
+
+    usize length()
+    {
+        return mCount;
+    }
+    usize capacity()
+    {
+        return mCap;
+    }
+
+    // Adds the key or replaces its value, true when the key is new
+    bool set(const Key& key, const Val& val)
+    {
+        bool added;
+        Entry* e = findOrAdd(key, added);
+        e->mVal = const_cast<Val&>(val);
+        return added;
+    }
+    // The value for the key, or nil or 0 when it isn't in the map
+    Val get(const Key& key)
+    {
+        Entry* e = findEntry(key, PlHash<Key>::hash(key));
+        return e ? e->mVal : Val();
+    }
+    bool has(const Key& key)
+    {
+        return findEntry(key, PlHash<Key>::hash(key)) != nullptr;
+    }
+    Val* find(const Key& key)
+    {
+        Entry* e = findEntry(key, PlHash<Key>::hash(key));
+        return e ? &e->mVal : nullptr;
+    }
+    // The value for the key, added as nil or 0 if the key is new
+    Val& at(const Key& key)
+    {
+        bool added;
+        return findOrAdd(key, added)->mVal;
+    }
+    bool remove(const Key& key)
+    {
+        Entry* e = findEntry(key, PlHash<Key>::hash(key));
+        if (e == nullptr)
+        {
+            return false;
+        }
+        setCtrl((usize)(e - mEntries), PlMapGroup::DELETED);
+        e->~Entry();
+        mCount--;
+        return true;
+    }
+    void clear()
+    {
+        if (mCap == 0)
+        {
+            return;
+        }
+        for (usize i = 0; i < mCap; i++)
+        {
+            if (mCtrl[i] >= 0)
+            {
+                mEntries[i].~Entry();
+            }
+        }
+        sDefaultMemAlloc->_free(mCtrl);
+        sDefaultMemAlloc->_free(mEntries);
+        mCtrl = const_cast<int8*>(PlMapGroup::sEmpty);
+        mEntries = nullptr;
+        mCap = 0;
+        mCount = 0;
+        mGrowth = 0;
+    }
+    // Makes room for count keys without a rehash
+    void reserve(usize count)
+    {
+        if (count > mCount + mGrowth)
+        {
+            rehash(slotsFor(count));
+        }
+    }
+
+    // Index ranges, used for 'iter' loops
+    IndexRange<false> indexFwd()
+    {
+        return IndexRange<false>(this);
+    }
+    IndexRange<true> indexRev()
+    {
+        return IndexRange<true>(this);
+    }
+
+private:
+    static constexpr usize WIDTH = PlMapGroup::WIDTH;
+
+    static int8 h2(uint64 hash)
+    {
+        return (int8)(hash & 0x7f);
+    }
+    static usize maxLoad(usize cap)
+    {
+        return cap - cap / 8;
+    }
+    static usize slotsFor(usize count)
+    {
+        usize cap = WIDTH;
+        while (maxLoad(cap) < count)
+        {
+            cap *= 2;
+        }
+        return cap;
+    }
+
+    // The mirrored bytes at the end are kept in step with the first 16
+    void setCtrl(usize i, int8 c)
+    {
+        mCtrl[i] = c;
+        if (i < WIDTH)
+        {
+            mCtrl[mCap + i] = c;
+        }
+    }
+
+    Entry* findEntry(const Key& key, uint64 hash)
+    {
+        // With no slots, the one group of sEmpty
+        usize mask = mCap > 0 ? mCap - 1 : 0;
+        usize pos = (usize)(hash >> 7) & mask;
+        usize step = 0;
+        for (;;)
+        {
+            PlMapGroup g(mCtrl + pos);
+            for (uint32 m = g.match(h2(hash)); m != 0; m &= m - 1)
+            {
+                usize i = (pos + bitScanFwd(m)) & mask;
+                if (mEntries[i].mData == key)
+                {
+                    return &mEntries[i];
+                }
+            }
+            if (g.matchEmpty() != 0)
+            {
+                return nullptr;
+            }
+            step += WIDTH;
+            pos = (pos + step) & mask;
+        }
+    }
+    // The first empty or deleted slot on the key's probe
+    usize findFree(uint64 hash)
+    {
+        usize mask = mCap - 1;
+        usize pos = (usize)(hash >> 7) & mask;
+        usize step = 0;
+        for (;;)
+        {
+            uint32 m = PlMapGroup(mCtrl + pos).matchFree();
+            if (m != 0)
+            {
+                return (pos + bitScanFwd(m)) & mask;
+            }
+            step += WIDTH;
+            pos = (pos + step) & mask;
+        }
+    }
+
+    Entry* findOrAdd(const Key& key, bool& added)
+    {
+        uint64 hash = PlHash<Key>::hash(key);
+        Entry* e = findEntry(key, hash);
+        if (e)
+        {
+            added = false;
+            return e;
+        }
+        if (mGrowth == 0)
+        {
+            // Only clean up the deleted slots when that frees half
+            rehash(mCount < maxLoad(mCap) / 2 ? mCap : slotsFor(mCount + 1));
+        }
+        usize i = findFree(hash);
+        if (mCtrl[i] == PlMapGroup::EMPTY)
+        {
+            mGrowth--;
+        }
+        setCtrl(i, h2(hash));
+        e = &mEntries[i];
+        // A ref only copies from a non-const one, it is counted all the same
+        new (&e->mData) Key(const_cast<Key&>(key));
+        new (&e->mVal) Val();
+        mCount++;
+        added = true;
+        return e;
+    }
+
+    // Moves the entries into newcap slots, without the deleted ones
+    void rehash(usize newcap)
+    {
+        if (newcap < WIDTH)
+        {
+            newcap = WIDTH;
+        }
+        int8* oldctrl = mCtrl;
+        Entry* oldentries = mEntries;
+        usize oldcap = mCap;
+
+        mCtrl = (int8*)sDefaultMemAlloc->_malloc(newcap + WIDTH);
+        memset(mCtrl, PlMapGroup::EMPTY, newcap + WIDTH);
+        mEntries = (Entry*)sDefaultMemAlloc->_malloc(sizeof(Entry) * newcap);
+        mCap = newcap;
+        mGrowth = maxLoad(newcap) - mCount;
+
+        for (usize i = 0; i < oldcap; i++)
+        {
+            if (oldctrl[i] >= 0)
+            {
+                Entry& from = oldentries[i];
+                uint64 hash = PlHash<Key>::hash(from.mData);
+                usize to = findFree(hash);
+                setCtrl(to, h2(hash));
+                relocate(mEntries[to], from);
+            }
+        }
+        if (oldcap > 0)
+        {
+            sDefaultMemAlloc->_free(oldctrl);
+            sDefaultMemAlloc->_free(oldentries);
+        }
+    }
+    // Refs are handed over without counting, and strings moved, as the
+    // small ones point into themselves
+    template <class T>
+    static void relocate(T& to, T& from)
+    {
+        if constexpr (std::is_same_v<T, Entry>)
+        {
+            relocate(to.mData, from.mData);
+            relocate(to.mVal, from.mVal);
+        }
+        else if constexpr (std::is_trivially_copyable_v<T>)
+        {
+            memcpy((void*)&to, (const void*)&from, sizeof(T));
+        }
+        else if constexpr (std::is_same_v<T, string>)
+        {
+            new (&to) T(std::move(from));
+            from.~T();
+        }
+        else
+        {
+            new (&to) T();
+            to.adopt(from.release());
+        }
+    }
+
+    int8* mCtrl;
+    Entry* mEntries;
+    usize mCap;
+    usize mCount;
+    // Keys that can go into empty slots before the next rehash
+    usize mGrowth;
+};
+
+} // namespace primal
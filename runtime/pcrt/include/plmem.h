@@ -4,12 +4,16 @@
 #include "pldef.h"
 
 // Placement new
+#ifdef _MSC_VER
 inline void* operator new(usize size, void* where) noexcept
 {
     (void)size;
     return where;
 }
 #define __PLACEMENT_NEW_INLINE
+#else
+#include <new>
+#endif
 
 #include <utility>
 
@@ -47,6 +47,10 @@ template <class ObjType>
 class PlRef
 {
 public:
+    PlRef() :
+        mObj(nullptr)
+    {
+    }
     PlRef(ObjType* obj) :
         mObj(obj)
     {
@@ -88,11 +92,33 @@ public:
         mObj = right.mObj;
         return *this;
     }
+    // For a new object, as returned by createObject
+    PlRef& operator=(ObjType* obj)
+    {
+        incRef(obj);
+        decRef(mObj);
+        mObj = obj;
+        return *this;
+    }
     operator bool()
     {
         return mObj != nullptr;
     }
 
+    // Takes over a reference that is already counted for obj
+    void adopt(ObjType* obj)
+    {
+        decRef(mObj);
+        mObj = obj;
+    }
+    // Gives up the reference without releasing it, the count goes with obj
+    ObjType* release()
+    {
+        ObjType* obj = mObj;
+        mObj = nullptr;
+        return obj;
+    }
+
     static ObjType* createObject(IMemAlloc* memalloc = nullptr)
     {
         //dbgfnc();
@@ -269,6 +295,12 @@ public:
         PlRef<ObjType>::incRef(mObj);
         mIntf = intf;
     }
+    PlInterfRef(PlInterfRef& orig) :
+        mObj(orig.mObj),
+        mIntf(orig.mIntf)
+    {
+        PlRef<ObjType>::incRef(mObj);
+    }
     // PlInterfRef(PlRef<ObjType>& orig)
     // {
     //     mObj = orig.mObj;
@@ -289,6 +321,18 @@ public:
     {
         return mIntf;
     }
+    PlInterfRef& operator=(PlInterfRef& right)
+    {
+        if (this == &right)
+        {
+            return *this;
+        }
+        PlRef<ObjType>::incRef(right.mObj);
+        PlRef<ObjType>::decRef(mObj);
+        mObj = right.mObj;
+        mIntf = right.mIntf;
+        return *this;
+    }
     // PlInterfRef& operator=(PlRef<ObjType>& right)
     // {
     //     PlRef<ObjType>::decRef(mObj);
@@ -6,14 +6,245 @@
 namespace primal
 {
 
+class string;
+
+// A slice of a string, or of any bytes, that doesn't own them.  Taking one,
+// and all its methods but toString, never allocate.  A slice must not be
+// kept past a change to the string it points into, or past its end.
+class strview
+{
+public:
+    strview() :
+        mPtr(""),
+        mLen(0)
+    {
+    }
+    strview(czstr str) :
+        mPtr(str ? str : ""),
+        mLen(str ? strlen(str) : 0)
+    {
+    }
+    strview(czstr str, usize len) :
+        mPtr(str),
+        mLen(len)
+    {
+    }
+    strview(const string& s);
+
+    // The bytes, not null terminated
+    czstr data() const
+    {
+        return mPtr;
+    }
+    usize length() const
+    {
+        return mLen;
+    }
+    bool empty() const
+    {
+        return mLen == 0;
+    }
+    char at(usize i) const
+    {
+        return i < mLen ? mPtr[i] : '\0';
+    }
+    char first() const
+    {
+        return at(0);
+    }
+    char last() const
+    {
+        return mLen > 0 ? mPtr[mLen - 1] : '\0';
+    }
+
+    // Both are cut to the end of the slice
+    strview slice(usize pos, usize len) const
+    {
+        if (pos > mLen)
+        {
+            pos = mLen;
+        }
+        return strview(mPtr + pos, len < mLen - pos ? len : mLen - pos);
+    }
+    strview tail(usize pos) const
+    {
+        return slice(pos, mLen);
+    }
+
+    // Positions from the start of the slice, length() when not found
+    usize find(char c, usize from) const
+    {
+        if (from >= mLen)
+        {
+            return mLen;
+        }
+        czstr p = (czstr)memchr(mPtr + from, c, mLen - from);
+        return p ? (usize)(p - mPtr) : mLen;
+    }
+    usize find(strview s, usize from) const
+    {
+        if (s.mLen == 0)
+        {
+            return from < mLen ? from : mLen;
+        }
+        while (from + s.mLen <= mLen)
+        {
+            usize i = find(s.mPtr[0], from);
+            if (i + s.mLen > mLen)
+            {
+                break;
+            }
+            if (memcmp(mPtr + i, s.mPtr, s.mLen) == 0)
+            {
+                return i;
+            }
+            from = i + 1;
+        }
+        return mLen;
+    }
+    usize findLast(char c) const
+    {
+        for (usize i = mLen; i > 0; i--)
+        {
+            if (mPtr[i - 1] == c)
+            {
+                return i - 1;
+            }
+        }
+        return mLen;
+    }
+    bool startsWith(strview s) const
+    {
+        return s.mLen <= mLen && (s.mLen == 0 || memcmp(mPtr, s.mPtr, s.mLen) == 0);
+    }
+    bool endsWith(strview s) const
+    {
+        return s.mLen <= mLen && (s.mLen == 0 || memcmp(mPtr + mLen - s.mLen, s.mPtr, s.mLen) == 0);
+    }
+
+    // Without the spaces, tabs and line ends at either end
+    strview trimLeft() const
+    {
+        usize i = 0;
+        while (i < mLen && isSpace(mPtr[i]))
+        {
+            i++;
+        }
+        return strview(mPtr + i, mLen - i);
+    }
+    strview trimRight() const
+    {
+        usize n = mLen;
+        while (n > 0 && isSpace(mPtr[n - 1]))
+        {
+            n--;
+        }
+        return strview(mPtr, n);
+    }
+    strview trim() const
+    {
+        return trimLeft().trimRight();
+    }
+
+    // Takes the field up to the next sep off the front, into tok.  Every
+    // field is returned, empty ones too, so "a,,b," has 4.  After the last
+    // one the slice is done, and split returns false.
+    bool split(char sep, strview& tok)
+    {
+        if (mPtr == nullptr)
+        {
+            return false;
+        }
+        usize i = find(sep, 0);
+        tok = strview(mPtr, i);
+        if (i < mLen)
+        {
+            mPtr += i + 1;
+            mLen -= i + 1;
+        }
+        else
+        {
+            mPtr = nullptr;
+            mLen = 0;
+        }
+        return true;
+    }
+    // Takes the next run of bytes that aren't in seps off the front, into
+    // tok, skipping the separators before it.  False when none are left.
+    bool token(strview seps, strview& tok)
+    {
+        usize i = 0;
+        while (i < mLen && seps.find(mPtr[i], 0) < seps.mLen)
+        {
+            i++;
+        }
+        usize end = i;
+        while (end < mLen && seps.find(mPtr[end], 0) == seps.mLen)
+        {
+            end++;
+        }
+        tok = strview(mPtr + i, end - i);
+        mPtr += end;
+        mLen -= end;
+        return end > i;
+    }
+
+    bool equals(strview s) const
+    {
+        return mLen == s.mLen && (mLen == 0 || memcmp(mPtr, s.mPtr, mLen) == 0);
+    }
+    int32 compare(strview s) const
+    {
+        usize n = mLen < s.mLen ? mLen : s.mLen;
+        int c = n > 0 ? memcmp(mPtr, s.mPtr, n) : 0;
+        if (c != 0)
+        {
+            return c;
+        }
+        return mLen < s.mLen ? -1 : (mLen > s.mLen ? 1 : 0);
+    }
+    bool operator==(strview s) const
+    {
+        return equals(s);
+    }
+    bool operator!=(strview s) const
+    {
+        return !equals(s);
+    }
+    uint64 hash() const
+    {
+        return hashBytes(mPtr, mLen);
+    }
+
+    // A string with a copy of the bytes
+    string toString() const;
+
+private:
+    czstr mPtr;
+    usize mLen;
+
+    static bool isSpace(char c)
+    {
+        return c == ' ' || (c >= '\t' && c <= '\r');
+    }
+};
+
+// A string is its own buffer, up to 32 bytes, or a heap buffer, or it points at
+// memory it doesn't own, like a literal, until it is written.  The bytes are
+// only null terminated when cz() asks for it, which for a pointed string means
+// a copy, so comparing and hashing work from data() and the length instead.
+// The hash is worked out the first time it is asked for, and kept until the
+// string changes.
 class string
 {
 public:
     string() :
-        mLen(0)
+        mLen(0),
+        mHash(0)
     {
     }
-    string(czstr str)
+    string(czstr str) :
+        mHash(0)
     {
         if (str)
         {
@@ -25,7 +256,8 @@ public:
             clear();
         }
     }
-    explicit string(czstr str, usize len)
+    explicit string(czstr str, usize len) :
+        mHash(0)
     {
         // Point
         if (str)
@@ -40,13 +272,22 @@ public:
     }
     string(const string& that) :
         mBuf(that.mBuf),
-        mLen(that.mLen)
+        mLen(that.mLen),
+        mHash(that.cachedHash())
     {
         // Copy
     }
+    // Copies the bytes, a slice doesn't keep them alive
+    string(const strview& v) :
+        mLen(0),
+        mHash(0)
+    {
+        assign(v.data(), v.length());
+    }
     string(string&& that) :
         mBuf(std::move(that.mBuf)),
-        mLen(that.mLen)
+        mLen(that.mLen),
+        mHash(that.cachedHash())
     {
         // Move
     }
@@ -76,7 +317,7 @@ public:
     }
     void append(const string& sb)
     {
-        append(sb.cz(), sb.length());
+        append(sb.data(), sb.length());
     }
     void replaceLast(char c)
     {
@@ -91,6 +332,7 @@ public:
         if (mLen > 0)
         {
             mLen--;
+            mHash = 0;
         }
     }
     char last()
@@ -105,15 +347,28 @@ public:
     }
     czstr cz() const
     {
-        zstr buf = const_cast<string*>(this)->ensureAlloc(mLen + 1);
+        zstr buf = (zstr)const_cast<string*>(this)->mBuf.ensure(mLen + 1);
         // Lazy null termination
         buf[mLen] = '\0';
         return buf;
     }
+    // The bytes, which aren't null terminated unless cz() was called
+    czstr data() const
+    {
+        return (czstr)mBuf.cptr();
+    }
     usize length() const
     {
         return mLen;
     }
+    strview view() const
+    {
+        return strview(data(), mLen);
+    }
+    strview slice(usize pos, usize len) const
+    {
+        return view().slice(pos, len);
+    }
     bool empty()
     {
         return mLen == 0;
@@ -133,23 +388,42 @@ public:
 
     int compare(czstr s) const
     {
-        czstr cp = cz();
-        if (cp)
-        {
-            return strcmp(cp, s);
-        }
-        else
+        return compare(s, s ? strlen(s) : 0);
+    }
+    int compare(const string& s) const
+    {
+        return compare(s.data(), s.mLen);
+    }
+    // Byte order as with strcmp, a string that is the start of another is less
+    int compare(czstr s, usize len) const
+    {
+        usize n = mLen < len ? mLen : len;
+        int c = n > 0 ? memcmp(data(), s, n) : 0;
+        if (c != 0)
         {
-            return cp != s;
+            return c;
         }
+        return mLen < len ? -1 : (mLen > len ? 1 : 0);
     }
-    int compare(const string& s) const
+    bool equals(czstr s) const
     {
-        return compare(s.cz());
+        usize len = s ? strlen(s) : 0;
+        return mLen == len && (len == 0 || memcmp(data(), s, len) == 0);
     }
-    bool equals(czstr s)
+    // Different lengths, or hashes when both are known, tell them apart first
+    bool equals(const string& s) const
     {
-        return compare(s) == 0;
+        if (mLen != s.mLen)
+        {
+            return false;
+        }
+        uint64 h = cachedHash();
+        uint64 sh = s.cachedHash();
+        if (h != 0 && sh != 0 && h != sh)
+        {
+            return false;
+        }
+        return memcmp(data(), s.data(), mLen) == 0;
     }
     bool equals(char c)
     {
@@ -163,7 +437,7 @@ public:
     }
     bool exist(char c)
     {
-        return (strchr(cz(), c) != NULL);
+        return mLen > 0 && memchr(data(), c, mLen) != nullptr;
     }
     void assign(czstr str)
     {
@@ -180,6 +454,7 @@ public:
     {
         mBuf.clear();
         mLen = 0;
+        mHash = 0;
     }
     bool empty() const
     {
@@ -192,6 +467,7 @@ public:
         {
             mBuf.copy(that.mBuf);
             mLen = that.mLen;
+            mHash = that.cachedHash();
         }
         return *this;
     }
@@ -213,27 +489,189 @@ public:
     }
     bool operator==(const string& that) const
     {
-        return compare(that) == 0;
+        return equals(that);
     }
     bool operator!=(const string& that) const
     {
-        return compare(that) != 0;
+        return !equals(that);
+    }
+
+    // Never 0, which marks it as not worked out yet.  A shared string can be
+    // hashed by several threads at once, they all store the same value, so
+    // the cache only needs relaxed atomics.
+    uint64 hash() const
+    {
+        uint64 h = cachedHash();
+        if (h == 0)
+        {
+            h = hashBytes(data(), mLen);
+            h = h != 0 ? h : 1;
+            atomicStoreRelaxed(&mHash, h);
+        }
+        return h;
     }
 
     static string uint64Str(uint64 num, int8 base, bool minus = false);
     static string int64Str(int64 num);
     static string float64Str(float64 num);
+    static string float32Str(float32 num);
 
 private:
+    friend class StrBuilder;
+
     SsoBuffer<32> mBuf;
     usize mLen;
+    mutable volatile uint64 mHash;
 
+    uint64 cachedHash() const
+    {
+        return atomicLoadRelaxed(&mHash);
+    }
+
+    // Anything that can write the bytes goes through here, so the hash is
+    // dropped, except for cz() which only adds the terminator
     zstr ensureAlloc(usize neededsize)
     {
+        mHash = 0;
         return (zstr)mBuf.ensure(neededsize);
     }
 };
 
+// Builds a string out of many pieces.  The bytes go into a list of chunks
+// that are never grown or moved, so an append only copies the new piece,
+// and toString copies it all once into a string of the exact length.
+// reserve hints at how much more is coming, so one chunk can hold it.
+class StrBuilder
+{
+public:
+    StrBuilder() :
+        mHead(nullptr),
+        mTail(nullptr),
+        mLen(0)
+    {
+    }
+    StrBuilder(const StrBuilder& that) :
+        StrBuilder()
+    {
+        append(that);
+    }
+    StrBuilder(StrBuilder&& that) :
+        mHead(that.mHead),
+        mTail(that.mTail),
+        mLen(that.mLen)
+    {
+        that.mHead = nullptr;
+        that.mTail = nullptr;
+        that.mLen = 0;
+    }
+    ~StrBuilder()
+    {
+        clear();
+    }
+    StrBuilder& operator=(const StrBuilder& that)
+    {
+        if (this != &that)
+        {
+            clear();
+            append(that);
+        }
+        return *this;
+    }
+    StrBuilder& operator=(StrBuilder&& that)
+    {
+        if (this != &that)
+        {
+            clear();
+            mHead = that.mHead;
+            mTail = that.mTail;
+            mLen = that.mLen;
+            that.mHead = nullptr;
+            that.mTail = nullptr;
+            that.mLen = 0;
+        }
+        return *this;
+    }
+
+    void append(strview s)
+    {
+        czstr p = s.data();
+        usize n = s.length();
+        mLen += n;
+        while (n > 0)
+        {
+            if (mTail == nullptr || mTail->mUsed == mTail->mSize)
+            {
+                addChunk(n);
+            }
+            usize k = mTail->mSize - mTail->mUsed;
+            k = k < n ? k : n;
+            memcpy(mTail->bytes() + mTail->mUsed, p, k);
+            mTail->mUsed += k;
+            p += k;
+            n -= k;
+        }
+    }
+    void append(char c)
+    {
+        if (mTail == nullptr || mTail->mUsed == mTail->mSize)
+        {
+            addChunk(1);
+        }
+        mTail->bytes()[mTail->mUsed++] = c;
+        mLen++;
+    }
+    void append(const StrBuilder& that);
+    void reserve(usize n)
+    {
+        if (mTail == nullptr || mTail->mSize - mTail->mUsed < n)
+        {
+            addChunk(n);
+        }
+    }
+    usize length() const
+    {
+        return mLen;
+    }
+    void clear();
+    string toString() const;
+
+    // The pieces joined in one go, into a string allocated once at the sum
+    // of their lengths.  Chains of + on strings are compiled to this.
+    static string concat(vararg(strview) list);
+
+private:
+    struct Chunk
+    {
+        Chunk* mNext;
+        usize mSize;
+        usize mUsed;
+
+        char* bytes()
+        {
+            return (char*)(this + 1);
+        }
+    };
+
+    static constexpr usize MINCHUNK = 64;
+    static constexpr usize MAXCHUNK = 64 * 1024;
+
+    Chunk* mHead;
+    Chunk* mTail;
+    usize mLen;
+
+    void addChunk(usize needed);
+};
+
+inline strview::strview(const string& s) :
+    mPtr(s.data()),
+    mLen(s.length())
+{
+}
+inline string strview::toString() const
+{
+    return string(*this);
+}
+
 inline primal::string Fmt(uint64 num, usize base = 10)
 {
     return string::uint64Str(num, base);
@@ -272,16 +710,24 @@ inline primal::string Fmt(float64 num)
 }
 inline primal::string Fmt(float32 num)
 {
-    return string::float64Str(num);
+    return string::float32Str(num);
 }
 inline primal::string Fmt(primal::string s)
 {
     return s;
 }
+inline primal::string Fmt(czstr s)
+{
+    return primal::string(s);
+}
+inline primal::string Fmt(primal::strview v)
+{
+    return v.toString();
+}
 
 } // namespace primal
 
-void printva_(vararg(primal::string) list);
+void printva_(vararg(primal::strview) list);
 #define printv(...)  printva_({__VA_ARGS__})
 
 void prints(const char* str);
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "plbase.h"
+#include "plobj.h"
+
+namespace primal
+{
+
+// Locks for Primal, each is an object so it can be shared between tasks
+
+class PlLock : public PlObject
+{
+public:
+    void lock()
+    {
+        mMut.lock();
+    }
+    bool tryLock()
+    {
+        return mMut.tryLock();
+    }
+    void unlock()
+    {
+        mMut.unlock();
+    }
+
+private:
+    FastMutex mMut;
+};
+
+class PlRwLock : public PlObject
+{
+public:
+    void lock()
+    {
+        mMut.lock();
+    }
+    void unlock()
+    {
+        mMut.unlock();
+    }
+    void lockRead()
+    {
+        mMut.lockRead();
+    }
+    void unlockRead()
+    {
+        mMut.unlockRead();
+    }
+
+private:
+    RwMutex mMut;
+};
+
+// Runs a task's run() the first time call is made, RefType is a strong or
+// interface reference
+class PlOnce : public PlObject
+{
+public:
+    template <class RefType>
+    void call(RefType& task)
+    {
+        mFlag.call([&task]()
+        {
+            task->run();
+        });
+    }
+    bool done()
+    {
+        return mFlag.done();
+    }
+
+private:
+    OnceFlag mFlag;
+};
+
+} // namespace primal
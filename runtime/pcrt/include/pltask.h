@@ -0,0 +1,231 @@
+#pragma once
+
+#include "plbase.h"
+#include "plobj.h"
+
+namespace primal
+{
+
+// PlTaskBase is a unit of work for the task pool.  The pool doesn't own tasks,
+// whoever submits one keeps it alive until it is done, so a task waited on in
+// the same function can live on the stack.
+class PlTaskBase
+{
+public:
+    PlTaskBase() :
+        mNext(nullptr),
+        mDone(0)
+    {
+    }
+    PlTaskBase(const PlTaskBase&) = delete;
+    PlTaskBase& operator=(const PlTaskBase&) = delete;
+    virtual ~PlTaskBase() = default;
+
+    bool done()
+    {
+        return atomicLoad(&mDone) != 0;
+    }
+
+protected:
+    virtual void execute() = 0;
+
+    // Called by the pool once execute returns.  The task can be released
+    // as soon as it is marked done, so it must not be touched after that.
+    virtual void finish()
+    {
+        atomicStore(&mDone, 1);
+    }
+
+private:
+friend class TaskPool;
+
+    PlTaskBase* mNext;
+    volatile int32 mDone;
+};
+
+// Task pool.  Each worker thread has its own deque of tasks, it pushes and pops
+// its own tasks at one end, and idle workers steal from the other end of the
+// others.  The main thread takes part as worker 0.  The pool is started by the
+// first submit, and has one worker per CPU unless a count is set before that.
+void taskSubmit(PlTaskBase* task);
+
+// Runs other tasks while waiting for the task to be done
+void taskWait(PlTaskBase* task);
+
+usize taskWorkerCount();
+
+// Only takes effect when the pool isn't running, 0 means one per CPU
+void taskSetWorkerCount(usize count);
+
+// Runs what's left in the deques and stops the workers.  The pool starts
+// again on the next submit.
+void taskShutdown();
+
+// Marks the calling thread as worker 0, called from main()
+void taskMainThread();
+
+
+// Splits [beg, end) in halves until a range is no longer than grain, each
+// split's second half is submitted as a task, and the first runs in place.
+// body is called as body(beg, end) for each range, from any of the workers.
+template <class BodyType>
+class PlRangeTask : public PlTaskBase
+{
+public:
+    PlRangeTask(usize beg, usize end, usize grain, BodyType& body) :
+        mBeg(beg),
+        mEnd(end),
+        mGrain(grain),
+        mBody(body)
+    {
+    }
+
+    static void run(usize beg, usize end, usize grain, BodyType& body)
+    {
+        if (end - beg <= grain)
+        {
+            body(beg, end);
+            return;
+        }
+        usize mid = beg + (end - beg) / 2;
+        PlRangeTask right(mid, end, grain, body);
+        taskSubmit(&right);
+        run(beg, mid, grain, body);
+        taskWait(&right);
+    }
+
+protected:
+    void execute() override
+    {
+        run(mBeg, mEnd, mGrain, mBody);
+    }
+
+private:
+    usize mBeg;
+    usize mEnd;
+    usize mGrain;
+    BodyType& mBody;
+};
+
+template <class BodyType>
+void taskParallelFor(usize beg, usize end, usize grain, BodyType& body)
+{
+    if (end > beg)
+    {
+        PlRangeTask<BodyType>::run(beg, end, grain > 0 ? grain : 1, body);
+    }
+}
+
+// The grain gives each worker about 8 ranges, so a slow range can be balanced
+template <class BodyType>
+void taskParallelFor(usize beg, usize end, BodyType& body)
+{
+    if (end > beg)
+    {
+        taskParallelFor(beg, end, (end - beg) / (taskWorkerCount() * 8), body);
+    }
+}
+
+// Runs a parallel for over [beg, end) of the loop variable's type.  body is
+// called as body(from, to) with parts of the range.
+template <class BegType, class EndType, class BodyType>
+void taskParallelRange(BegType beg, EndType end, BodyType& body)
+{
+    if (end > beg)
+    {
+        auto part = [beg, &body](usize b, usize e)
+        {
+            body((BegType)(beg + b), (BegType)(beg + e));
+        };
+        taskParallelFor(0, (usize)(end - beg), part);
+    }
+}
+
+// Adds a part's sum to a parallel for's sum variable
+FastMutex& taskReduceLock();
+
+template <class T>
+void taskReduceAdd(T* var, T part)
+{
+    AutoLock al(taskReduceLock());
+    *var += part;
+}
+
+
+// PlTask is a task spawned from Primal.  It is an object, the handle returned
+// by spawn keeps it alive, and the pool holds another reference until it has run.
+class PlTask : public PlObject, public PlTaskBase
+{
+public:
+    void join()
+    {
+        taskWait(this);
+    }
+
+protected:
+    void finish() override
+    {
+        PlTaskBase::finish();
+        PlRef<PlTask>::decRef(this);
+    }
+};
+
+// Runs the object's run() method, RefType is a strong or interface reference
+template <class RefType>
+class PlTaskOf : public PlTask
+{
+public:
+    explicit PlTaskOf(RefType& ref) :
+        mRef(ref)
+    {
+    }
+
+protected:
+    void execute() override
+    {
+        mRef->run();
+    }
+
+private:
+    RefType mRef;
+};
+
+} // namespace primal
+
+// Functions mapped in the base unit
+template <class RefType>
+primal::PlRef<primal::PlTask> spawn_(RefType& task)
+{
+    using TaskType = primal::PlTaskOf<RefType>;
+    TaskType* obj = (TaskType*)primal::sDefaultMemAlloc->_malloc(sizeof(TaskType));
+    new(obj) TaskType(task);
+
+    primal::PlTask* t = obj;
+    primal::PlRef<primal::PlTask> handle(t);
+    primal::PlRef<primal::PlTask>::incRef(t);
+    primal::taskSubmit(t);
+    return handle;
+}
+
+inline void join_(primal::PlRef<primal::PlTask>& handle)
+{
+    if (handle)
+    {
+        handle->join();
+    }
+}
+
+template <class RefType>
+void parallelFor_(usize beg, usize end, RefType& body)
+{
+    auto fn = [&body](usize b, usize e)
+    {
+        body->run(b, e);
+    };
+    primal::taskParallelFor(beg, end, fn);
+}
+
+inline usize workerCount_()
+{
+    return primal::taskWorkerCount();
+}
@@ -1,10 +1,26 @@
 #include "plmem.h"
+#include "pldef.h"
+#include "plstr.h"
+#include "pltask.h"
 #include <stdio.h>
+#include <signal.h>
 #ifdef _WIN32
 #define WIN32_LEAN_AND_MEAN
 #include <Windows.h>
+#ifdef _MSC_VER
+#pragma comment(lib, "Synchronization.lib")
+#endif
 #else
 #include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/uio.h>
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#endif
 #endif
 
 void printeno(int eno, const char* func)
@@ -69,27 +85,538 @@ void Mutex::unlock()
 #endif
 }
 
-void osPrint(const char* str, usize len)
+// Futex
+void osFutexWait(volatile int32* addr, int32 val)
 {
-    if (str)
+#ifdef _WIN32
+    WaitOnAddress((volatile VOID*)addr, &val, sizeof(val), INFINITE);
+#elif defined(__linux__)
+    syscall(SYS_futex, (int32*)addr, FUTEX_WAIT_PRIVATE, val, nullptr, nullptr, 0);
+#else
+    // No futex, so poll
+    if (atomicLoad(addr) == val)
     {
+        osYield(true);
+    }
+#endif
+}
+
+void osFutexWake(volatile int32* addr, bool all)
+{
 #ifdef _WIN32
-        if (len == 0)
+    if (all)
+    {
+        WakeByAddressAll((PVOID)addr);
+    }
+    else
+    {
+        WakeByAddressSingle((PVOID)addr);
+    }
+#elif defined(__linux__)
+    syscall(SYS_futex, (int32*)addr, FUTEX_WAKE_PRIVATE, all ? INT32_MAX : 1, nullptr, nullptr, 0);
+#else
+    (void)addr;
+    (void)all;
+#endif
+}
+
+// Times a lock is tried before sleeping.  Long enough to cover a short
+// critical section on another core.
+constDef LOCKSPINS = 100;
+
+// FastMutex::
+void FastMutex::lockSlow()
+{
+    for (int i = 0; i < LOCKSPINS; i++)
+    {
+        if (atomicLoad(&mState) == 0 && atomicCompareExchange(&mState, 0, 1))
         {
-            len = strlen(str);
+            return;
+        }
+        cpuPause();
+    }
+
+    // Marked as having sleepers, so unlock wakes one.  Whoever gets it this
+    // way leaves it marked, as there may be others.
+    while (atomicExchange(&mState, 2) != 0)
+    {
+        osFutexWait(&mState, 2);
+    }
+}
+
+// RwMutex::
+void RwMutex::lockReadSlow()
+{
+    for (int i = 0; ; i++)
+    {
+        int32 st = atomicLoad(&mState);
+        if ((st & WRITER) == 0)
+        {
+            if (atomicCompareExchange(&mState, st, st + 1))
+            {
+                return;
+            }
+        }
+        else if (i < LOCKSPINS)
+        {
+            cpuPause();
+        }
+        else
+        {
+            sleep(false);
+        }
+    }
+}
+
+void RwMutex::lock()
+{
+    mWriteMut.lock();
+
+    // New readers stay out, wait for the ones in to leave
+    int32 st = atomicAdd(&mState, WRITER);
+    for (int i = 0; st != WRITER; i++)
+    {
+        if (i < LOCKSPINS)
+        {
+            cpuPause();
+        }
+        else
+        {
+            sleep(true);
+        }
+        st = atomicLoad(&mState);
+    }
+}
+
+void RwMutex::unlock()
+{
+    atomicAdd(&mState, -WRITER);
+    wake();
+    mWriteMut.unlock();
+}
+
+// The sleeper is counted before it checks the state, so a wake either
+// sees it and bumps mSeq, or changed the state before the check
+void RwMutex::sleep(bool writer)
+{
+    atomicIncrement(&mSleepers);
+    int32 seq = atomicLoad(&mSeq);
+    int32 st = atomicLoad(&mState);
+    if (writer ? st != WRITER : (st & WRITER) != 0)
+    {
+        osFutexWait(&mSeq, seq);
+    }
+    atomicDecrement(&mSleepers);
+}
+
+void RwMutex::wake()
+{
+    if (atomicLoad(&mSleepers) > 0)
+    {
+        atomicIncrement(&mSeq);
+        osFutexWake(&mSeq, true);
+    }
+}
+
+// OnceFlag::
+bool OnceFlag::begin()
+{
+    for (;;)
+    {
+        int32 st = atomicLoad(&mState);
+        if (st == DONE)
+        {
+            return false;
+        }
+        if (st == 0)
+        {
+            if (atomicCompareExchange(&mState, 0, RUNNING))
+            {
+                return true;
+            }
+            continue;
+        }
+        if (st == RUNNING && !atomicCompareExchange(&mState, RUNNING, SLEEPERS))
+        {
+            continue;
+        }
+        osFutexWait(&mState, SLEEPERS);
+    }
+}
+
+void OnceFlag::end()
+{
+    if (atomicExchange(&mState, DONE) == SLEEPERS)
+    {
+        osFutexWake(&mState, true);
+    }
+}
+
+// Output
+
+#ifdef _WIN32
+struct OsIov
+{
+    void* iov_base;
+    usize iov_len;
+};
+#else
+typedef struct iovec OsIov;
+#endif
+
+// Writes all of it, continuing after short writes
+static void osWriteOut(OsIov* iov, int cnt)
+{
+#ifdef _WIN32
+    static HANDLE han = GetStdHandle(STD_OUTPUT_HANDLE);
+    for (int i = 0; i < cnt; i++)
+    {
+        WriteFile(han, iov[i].iov_base, (DWORD)iov[i].iov_len, NULL, NULL);
+    }
+#else
+    while (cnt > 0)
+    {
+        ssize_t n = writev(STDOUT_FILENO, iov, cnt);
+        if (n < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return;
+        }
+        while (cnt > 0 && (usize)n >= iov->iov_len)
+        {
+            n -= iov->iov_len;
+            iov++;
+            cnt--;
+        }
+        if (cnt > 0)
+        {
+            iov->iov_base = (char*)iov->iov_base + n;
+            iov->iov_len -= n;
+        }
+    }
+#endif
+}
+
+static bool osIsTerminal()
+{
+#ifdef _WIN32
+    static const bool tty = GetFileType(GetStdHandle(STD_OUTPUT_HANDLE)) == FILE_TYPE_CHAR;
+#else
+    static const bool tty = isatty(STDOUT_FILENO) != 0;
+#endif
+    return tty;
+}
+
+// Coarse monotonic milliseconds, only used to pace output
+static uint64 osTickMs()
+{
+#ifdef _WIN32
+    return GetTickCount64();
+#else
+    struct timespec ts;
+#ifdef CLOCK_MONOTONIC_COARSE
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+#else
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+#endif
+    return (uint64)ts.tv_sec * 1000 + (uint64)ts.tv_nsec / 1000000;
+#endif
+}
+
+void osYield(bool sleep)
+{
+#ifdef _WIN32
+    Sleep(sleep ? 1 : 0);
+#else
+    if (sleep)
+    {
+        struct timespec ts = {0, 1000000};
+        nanosleep(&ts, nullptr);
+    }
+    else
+    {
+        sched_yield();
+    }
+#endif
+}
+
+// A line queued for the logger thread
+struct PrintNode
+{
+    PrintNode* volatile mNext;
+    usize mLen;
+    char mData[1];
+};
+
+static MpscQueue<PrintNode> sPrintQueue;
+static volatile int32 sPrintAsync = 0;
+static volatile int32 sPrintPushing = 0;
+static volatile int32 sLoggerStop = 0;
+static Mutex sLoggerMut;
+#ifdef _WIN32
+static HANDLE sLoggerThread;
+#else
+static pthread_t sLoggerThread;
+#endif
+
+// Output gathered by one thread
+class PrintBuf
+{
+public:
+    PrintBuf() :
+        mLen(0),
+        mFlushed(0)
+    {
+    }
+    ~PrintBuf()
+    {
+        flush();
+    }
+
+    void begin(usize len)
+    {
+        // Keeps the line in one write, unless it is longer than the buffer
+        if (mLen + len > sizeof(mBuf))
+        {
+            flush();
+        }
+    }
+    void append(const char* str, usize len)
+    {
+        if (mLen + len <= sizeof(mBuf))
+        {
+            memcpy(mBuf + mLen, str, len);
+            mLen += len;
+            return;
+        }
+        if (!queue(str, len))
+        {
+            OsIov iov[2] = {{mBuf, mLen}, {(void*)str, len}};
+            osWriteOut(iov, 2);
+        }
+        mLen = 0;
+    }
+    void end()
+    {
+        if (queue(nullptr, 0))
+        {
+            return;
+        }
+        // Piped output is batched, but a finished line doesn't wait longer
+        // than FLUSHMS behind the ones written before it
+        if (osIsTerminal() || mLen == sizeof(mBuf) ||
+            (mLen > 0 && mBuf[mLen - 1] == '\n' && osTickMs() - mFlushed >= FLUSHMS))
+        {
+            flush();
+        }
+    }
+    void flush()
+    {
+        if (mLen > 0)
+        {
+            OsIov iov = {mBuf, mLen};
+            osWriteOut(&iov, 1);
+            mLen = 0;
+            mFlushed = osTickMs();
+        }
+    }
+
+private:
+    // In async mode, moves what's gathered plus str to the logger's queue.
+    // Pushes are counted, so switching modes can wait for them to finish.
+    bool queue(const char* str, usize len)
+    {
+        atomicIncrement(&sPrintPushing);
+        bool async = atomicLoad(&sPrintAsync) != 0;
+        if (async && (mLen + len) > 0)
+        {
+            PrintNode* node = (PrintNode*)primal::sDefaultMemAlloc->_malloc(sizeof(PrintNode) + mLen + len);
+            memcpy(node->mData, mBuf, mLen);
+            if (len > 0)
+            {
+                memcpy(node->mData + mLen, str, len);
+            }
+            node->mLen = mLen + len;
+            sPrintQueue.push(node);
+            mLen = 0;
+        }
+        atomicDecrement(&sPrintPushing);
+        return async;
+    }
+
+    constMemb BUFSIZE = 8192;
+    constMemb FLUSHMS = 100;
+    usize mLen;
+    uint64 mFlushed;
+    char mBuf[BUFSIZE];
+};
+
+static thread_local PrintBuf sPrintBuf;
+
+// A failed assert or an abort skips the destructors, so what the aborting
+// thread has gathered is written out before the default action runs
+static void onAbort(int sig)
+{
+    sPrintBuf.flush();
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+// Writes out queued lines, up to a batch at a time in one writev
+static usize loggerDrain()
+{
+    constDef MAXBATCH = 64;
+    OsIov iov[MAXBATCH];
+    PrintNode* nodes[MAXBATCH];
+    usize total = 0;
+    for (;;)
+    {
+        int cnt = 0;
+        PrintNode* node;
+        while (cnt < MAXBATCH && (node = sPrintQueue.pop()) != nullptr)
+        {
+            nodes[cnt] = node;
+            iov[cnt].iov_base = node->mData;
+            iov[cnt].iov_len = node->mLen;
+            cnt++;
+        }
+        if (cnt == 0)
+        {
+            return total;
+        }
+        osWriteOut(iov, cnt);
+        for (int i = 0; i < cnt; i++)
+        {
+            primal::sDefaultMemAlloc->_free(nodes[i]);
+        }
+        total += cnt;
+    }
+}
+
+static void loggerRun()
+{
+    // Spins briefly when idle before sleeping between polls
+    constDef SPINS = 64;
+    int idle = 0;
+    for (;;)
+    {
+        if (loggerDrain() > 0)
+        {
+            idle = 0;
+        }
+        else if (atomicLoad(&sLoggerStop))
+        {
+            // Pushes have all finished, so one more pass gets everything
+            loggerDrain();
+            break;
+        }
+        else
+        {
+            osYield(++idle > SPINS);
+        }
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI loggerThread(LPVOID)
+{
+    loggerRun();
+    return 0;
+}
+#else
+static void* loggerThread(void*)
+{
+    loggerRun();
+    return nullptr;
+}
+#endif
+
+void osPrintAsync(bool async)
+{
+    AutoLock al(sLoggerMut);
+    if (async == (atomicLoad(&sPrintAsync) != 0))
+    {
+        return;
+    }
+
+    if (async)
+    {
+        // What this thread has gathered goes out ahead of the queue
+        sPrintBuf.flush();
+        atomicStore(&sLoggerStop, 0);
+#ifdef _WIN32
+        sLoggerThread = CreateThread(NULL, 0, loggerThread, NULL, 0, NULL);
+        if (sLoggerThread == NULL)
+        {
+            return;
+        }
+#else
+        int ret = pthread_create(&sLoggerThread, nullptr, loggerThread, nullptr);
+        if (ret != 0)
+        {
+            dbgeno(ret);
+            return;
         }
-        static HANDLE han = INVALID_HANDLE_VALUE;
-        if (han == INVALID_HANDLE_VALUE)
+#endif
+        atomicStore(&sPrintAsync, 1);
+    }
+    else
+    {
+        // New lines are written directly from here on, and once the pushes
+        // in flight finish, the logger drains the queue and exits.  Lines
+        // printed by other threads while switching can come out of order.
+        atomicStore(&sPrintAsync, 0);
+        while (atomicLoad(&sPrintPushing) != 0)
         {
-            han = GetStdHandle(STD_OUTPUT_HANDLE);
+            osYield(false);
         }
-        WriteFile(han, str, (DWORD)len, NULL, NULL);
+        atomicStore(&sLoggerStop, 1);
+#ifdef _WIN32
+        WaitForSingleObject(sLoggerThread, INFINITE);
+        CloseHandle(sLoggerThread);
 #else
-        fputs(str, stdout);
+        pthread_join(sLoggerThread, nullptr);
 #endif
     }
 }
 
+void osPrintBegin(usize len)
+{
+    sPrintBuf.begin(len);
+}
+
+void osPrintAppend(const char* str, usize len)
+{
+    sPrintBuf.append(str, len);
+}
+
+void osPrintEnd()
+{
+    sPrintBuf.end();
+}
+
+void osPrintFlush()
+{
+    sPrintBuf.flush();
+}
+
+void osPrint(const char* str, usize len)
+{
+    if (str)
+    {
+        if (len == 0)
+        {
+            len = strlen(str);
+        }
+        sPrintBuf.begin(len);
+        sPrintBuf.append(str, len);
+        sPrintBuf.end();
+    }
+}
+
 int sProcArgc;
 char** sProcArgv;
 
@@ -102,10 +629,21 @@ int main(int argc, char** argv)
     sProcArgv = argv;
 
     primal::initDefaultMemAlloc();
+    signal(SIGABRT, onAbort);
+
+    // The task pool starts with the first task, this thread is its worker 0
+    primal::taskMainThread();
 
     // Call main entry point
     pcrtmain();
 
+    // Runs tasks that weren't joined and stops the workers
+    primal::taskShutdown();
+
+    // Drain the logger, and write out what the main thread has gathered
+    osPrintAsync(false);
+    osPrintFlush();
+
     return ret;
 }
 
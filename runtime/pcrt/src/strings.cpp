@@ -1,17 +1,24 @@
 #include "plstr.h"
 #include "plmem.h"
-#include <math.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 
-Mutex sPrintMut;
-
-void printva_(vararg(primal::string) list)
+void printva_(vararg(primal::strview) list)
 {
-    AutoLock al(sPrintMut);
+    // Gathered in this thread's buffer, the whole line goes out in one write
+    usize len = 1;
+    for (auto& s : list)
+    {
+        len += s.length();
+    }
+    osPrintBegin(len);
     for (auto& s : list)
     {
-        osPrint(s.cz(), s.length());
+        osPrintAppend(s.data(), s.length());
     }
-    osPrint("\n", 1);
+    osPrintAppend("\n", 1);
+    osPrintEnd();
 }
 
 usize argcount_()
@@ -33,159 +40,702 @@ void prints(const char* str)
     osPrint(str, 0);
 }
 
+// Murmur style, each 8 bytes are mixed on their own and folded in
+uint64 hashBytes(const void* data, usize len)
+{
+    constexpr uint64 MUL = 0xc6a4a7935bd1e995ULL;
+    const uint8* p = (const uint8*)data;
+    uint64 h = 0x9e3779b97f4a7c15ULL ^ (len * MUL);
+    while (len >= 8)
+    {
+        uint64 w;
+        memcpy(&w, p, 8);
+        w *= MUL;
+        w ^= w >> 47;
+        w *= MUL;
+        h = (h ^ w) * MUL;
+        p += 8;
+        len -= 8;
+    }
+    if (len > 0)
+    {
+        uint64 w = 0;
+        memcpy(&w, p, len);
+        h = (h ^ w) * MUL;
+    }
+    return hashInt(h);
+}
+
 namespace primal
 {
 
-string string::float64Str(float64 num)
+// Integer formatting
+
+// Digit pairs, so each division produces two digits
+static const char sDecPairs[201] =
+    "0001020304050607080910111213141516171819"
+    "2021222324252627282930313233343536373839"
+    "4041424344454647484950515253545556575859"
+    "6061626364656667686970717273747576777879"
+    "8081828384858687888990919293949596979899";
+
+static const char sHexPairs[513] =
+    "000102030405060708090A0B0C0D0E0F101112131415161718191A1B1C1D1E1F"
+    "202122232425262728292A2B2C2D2E2F303132333435363738393A3B3C3D3E3F"
+    "404142434445464748494A4B4C4D4E4F505152535455565758595A5B5C5D5E5F"
+    "606162636465666768696A6B6C6D6E6F707172737475767778797A7B7C7D7E7F"
+    "808182838485868788898A8B8C8D8E8F909192939495969798999A9B9C9D9E9F"
+    "A0A1A2A3A4A5A6A7A8A9AAABACADAEAFB0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+    "C0C1C2C3C4C5C6C7C8C9CACBCCCDCECFD0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+    "E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEFF0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+// Writes the digits of num backward, ending at end, and returns where they
+// start.  Base 10 and 16 are specialized, other bases are passed in.
+template <int BASE>
+static char* uintDigits(char* end, uint64 num, uint64 base = BASE)
 {
-    // Adapted from https://stackoverflow.com/a/7097567/2473607
-    constDef PRECISION = 0.00000000000001;
-    string sobj;
-    zstr s = sobj.ensureAlloc(32);
+    if constexpr (BASE == 10)
+    {
+        while (num >= 100)
+        {
+            uint64 r = num % 100;
+            num /= 100;
+            end -= 2;
+            memcpy(end, sDecPairs + r * 2, 2);
+        }
+        if (num >= 10)
+        {
+            end -= 2;
+            memcpy(end, sDecPairs + num * 2, 2);
+        }
+        else
+        {
+            *--end = (char)('0' + num);
+        }
+    }
+    else if constexpr (BASE == 16)
+    {
+        while (num >= 0x100)
+        {
+            end -= 2;
+            memcpy(end, sHexPairs + (num & 0xFF) * 2, 2);
+            num >>= 8;
+        }
+        if (num >= 0x10)
+        {
+            end -= 2;
+            memcpy(end, sHexPairs + num * 2, 2);
+        }
+        else
+        {
+            *--end = sHexPairs[num * 2 + 1];
+        }
+    }
+    else
+    {
+        do
+        {
+            char digit = (char)(num % base);
+            *--end = digit + ((digit < 0xA) ? '0' : ('A' - 0xA));
+            num /= base;
+        } while (num);
+    }
+    return end;
+}
 
-    // handle special cases
-    if (isnan(num))
+string string::uint64Str(uint64 num, int8 base, bool minus)
+{
+    // Enough for 64 binary digits and the sign
+    char buf[66];
+    char* end = buf + sizeof(buf);
+    char* p;
+    switch (base)
     {
-        sobj.append("nan");
+        case 10:
+            p = uintDigits<10>(end, num);
+            break;
+        case 16:
+            p = uintDigits<16>(end, num);
+            break;
+        default:
+            p = uintDigits<0>(end, num, (uint64)base);
+            break;
     }
-    else if (isinf(num))
+    if (minus)
     {
-        sobj.append("inf");
+        *--p = '-';
     }
-    else if (num == 0.0)
+
+    string sobj;
+    sobj.assign(p, end - p);
+    return sobj;
+}
+
+string string::int64Str(int64 num)
+{
+    if (num < 0)
     {
-        sobj.append("0");
+        // Negated unsigned, so the smallest int64 doesn't overflow
+        return uint64Str(0 - (uint64)num, 10, true);
     }
     else
     {
-        char* c = s;
-        int neg = (num < 0);
-        if (neg)
+        return uint64Str(num, 10);
+    }
+}
+
+
+// Float formatting
+//
+// Shortest round-trip conversion, following Ulf Adams' Ryu (PLDI 2018).
+// The digits printed are the fewest that read back as the same value, and
+// the closest of those when there is a choice.  The same steps serve
+// float32 with its own mantissa and exponent sizes.
+
+constDef POW5_INV_BITCOUNT = 125;
+constDef POW5_BITCOUNT = 125;
+constDef POW5_INV_COUNT = 342;
+constDef POW5_COUNT = 326;
+
+// Unsigned integer big enough for 5^341 and then some, only used to build
+// the tables
+class PowBigNum
+{
+public:
+    PowBigNum() :
+        mLimb{1},
+        mUsed(1)
+    {
+    }
+
+    int32 bitLength() const
+    {
+        uint32 top = mLimb[mUsed - 1];
+        int32 len = (mUsed - 1) * 32;
+        while (top)
+        {
+            len++;
+            top >>= 1;
+        }
+        return len;
+    }
+    bool bit(int32 i) const
+    {
+        return i >= 0 && (i >> 5) < mUsed && ((mLimb[i >> 5] >> (i & 31)) & 1);
+    }
+    void setPow2(int32 n)
+    {
+        memset(mLimb, 0, sizeof(mLimb));
+        mLimb[n >> 5] = 1u << (n & 31);
+        mUsed = (n >> 5) + 1;
+    }
+    void mul(uint32 m)
+    {
+        uint64 carry = 0;
+        for (int32 i = 0; i < mUsed; i++)
         {
-            num = -num;
+            carry += (uint64)mLimb[i] * m;
+            mLimb[i] = (uint32)carry;
+            carry >>= 32;
         }
-        // calculate magnitude
-        int m = log10(num);
-        int useexp = (m >= 14 || (neg && m >= 9) || m <= -9);
-        int m1;
-        if (neg)
+        if (carry)
         {
-            *(c++) = '-';
+            mLimb[mUsed++] = (uint32)carry;
         }
-        // set up for scientific notation
-        if (useexp)
+    }
+    bool less(const PowBigNum& that) const
+    {
+        if (mUsed != that.mUsed)
         {
-            if (m < 0)
+            return mUsed < that.mUsed;
+        }
+        for (int32 i = mUsed - 1; i >= 0; i--)
+        {
+            if (mLimb[i] != that.mLimb[i])
             {
-                m -= 1.0;
+                return mLimb[i] < that.mLimb[i];
             }
-            num = num / pow(10.0, m);
-            m1 = m;
-            m = 0;
         }
-        if (m < 1.0)
+        return false;
+    }
+    void sub(const PowBigNum& that)
+    {
+        int64 borrow = 0;
+        for (int32 i = 0; i < mUsed; i++)
+        {
+            int64 d = (int64)mLimb[i] - (i < that.mUsed ? that.mLimb[i] : 0) - borrow;
+            borrow = d < 0;
+            mLimb[i] = (uint32)d;
+        }
+        while (mUsed > 1 && mLimb[mUsed - 1] == 0)
+        {
+            mUsed--;
+        }
+    }
+
+private:
+    uint32 mLimb[28];
+    int32 mUsed;
+};
+
+// Top bits of 5^i, and of the inverses 2^j / 5^i, as low and high halves
+class Pow5Tables
+{
+public:
+    uint64 mPow[POW5_COUNT][2];
+    uint64 mInv[POW5_INV_COUNT][2];
+
+    Pow5Tables()
+    {
+        PowBigNum pow5;
+        for (int32 i = 0; i < POW5_INV_COUNT; i++)
         {
-            m = 0;
+            int32 len = pow5.bitLength();
+            if (i < POW5_COUNT)
+            {
+                // 5^i shifted to exactly POW5_BITCOUNT bits
+                uint64* e = mPow[i];
+                e[0] = e[1] = 0;
+                for (int32 b = 0; b < POW5_BITCOUNT; b++)
+                {
+                    if (pow5.bit(b + len - POW5_BITCOUNT))
+                    {
+                        e[b >> 6] |= 1ull << (b & 63);
+                    }
+                }
+            }
+
+            // floor(2^j / 5^i) + 1, with j = len - 1 + POW5_INV_BITCOUNT.  The
+            // leading len - 1 quotient bits are all zero, so the division
+            // starts at 2^(len-1) and produces the last POW5_INV_BITCOUNT bits.
+            uint64 q0 = 0;
+            uint64 q1 = 0;
+            if (i == 0)
+            {
+                q1 = 1ull << (POW5_INV_BITCOUNT - 64);
+            }
+            else
+            {
+                PowBigNum rem;
+                rem.setPow2(len - 1);
+                for (int32 b = 0; b < POW5_INV_BITCOUNT; b++)
+                {
+                    rem.mul(2);
+                    q1 = (q1 << 1) | (q0 >> 63);
+                    q0 <<= 1;
+                    if (!rem.less(pow5))
+                    {
+                        rem.sub(pow5);
+                        q0 |= 1;
+                    }
+                }
+            }
+            mInv[i][0] = q0 + 1;
+            mInv[i][1] = q1 + (q0 + 1 == 0);
+
+            pow5.mul(5);
         }
-        // convert the number
-        while (num > PRECISION || m >= 0)
+    }
+};
+
+static const Pow5Tables& pow5Tables()
+{
+    // Built on first use, it takes well under a millisecond
+    static const Pow5Tables tables;
+    return tables;
+}
+
+// Number of bits in 5^e, or 1 when e is 0
+inline int32 pow5Bits(int32 e)
+{
+    return (int32)(((uint32)e * 1217359) >> 19) + 1;
+}
+
+// floor(log10(2^e)) and floor(log10(5^e))
+inline uint32 log10Pow2(int32 e)
+{
+    return ((uint32)e * 78913) >> 18;
+}
+
+inline uint32 log10Pow5(int32 e)
+{
+    return ((uint32)e * 732923) >> 20;
+}
+
+inline bool multipleOfPow5(uint64 value, uint32 p)
+{
+    uint32 count = 0;
+    while (value % 5 == 0)
+    {
+        value /= 5;
+        count++;
+    }
+    return count >= p;
+}
+
+inline bool multipleOfPow2(uint64 value, uint32 p)
+{
+    return (value & ((1ull << p) - 1)) == 0;
+}
+
+// (m * mul) >> j, where mul is 128 bits and j is at least 64
+inline uint64 mulShift64(uint64 m, const uint64* mul, int32 j)
+{
+#ifdef __SIZEOF_INT128__
+    unsigned __int128 b0 = (unsigned __int128)m * mul[0];
+    unsigned __int128 b2 = (unsigned __int128)m * mul[1];
+    return (uint64)(((b0 >> 64) + b2) >> (j - 64));
+#else
+    uint64 b0hi;
+    uint64 b2hi;
+    _umul128(m, mul[0], &b0hi);
+    uint64 b2lo = _umul128(m, mul[1], &b2hi);
+    uint64 lo = b0hi + b2lo;
+    uint64 hi = b2hi + (lo < b0hi);
+    int32 dist = j - 128;
+    return (dist >= 0) ? (hi >> dist) : ((hi << -dist) | (lo >> (j - 64)));
+#endif
+}
+
+struct DecFloat
+{
+    uint64 mDigits;
+    int32 mExp;
+};
+
+// Shortest decimal digits and exponent for a finite, nonzero binary float
+static DecFloat floatToDec(uint64 ieeeMantissa, uint32 ieeeExponent, int32 mbits, int32 bias)
+{
+    const Pow5Tables& tables = pow5Tables();
+
+    // The value is m2 * 2^e2, with two extra bits of room for the bounds
+    int32 e2;
+    uint64 m2;
+    if (ieeeExponent == 0)
+    {
+        e2 = 1 - bias - mbits - 2;
+        m2 = ieeeMantissa;
+    }
+    else
+    {
+        e2 = (int32)ieeeExponent - bias - mbits - 2;
+        m2 = (1ull << mbits) | ieeeMantissa;
+    }
+    bool acceptBounds = (m2 & 1) == 0;
+
+    // Midpoints to the neighbouring values, the lower one is closer when
+    // the mantissa wraps to a smaller exponent
+    uint64 mv = 4 * m2;
+    uint32 mmShift = (ieeeMantissa != 0 || ieeeExponent <= 1) ? 1 : 0;
+
+    // Converts the value and its bounds to decimal, vr, vp and vm times
+    // 10^e10, noting if any digits dropped in the conversion were nonzero
+    uint64 vr;
+    uint64 vp;
+    uint64 vm;
+    int32 e10;
+    bool vmTrailingZeros = false;
+    bool vrTrailingZeros = false;
+    if (e2 >= 0)
+    {
+        uint32 q = log10Pow2(e2) - (e2 > 3);
+        e10 = (int32)q;
+        int32 k = POW5_INV_BITCOUNT + pow5Bits(q) - 1;
+        int32 i = -e2 + (int32)q + k;
+        const uint64* mul = tables.mInv[q];
+        vr = mulShift64(4 * m2, mul, i);
+        vp = mulShift64(4 * m2 + 2, mul, i);
+        vm = mulShift64(4 * m2 - 1 - mmShift, mul, i);
+        if (q <= 21)
         {
-            double weight = pow(10.0, m);
-            if (weight > 0 && !isinf(weight))
+            // At most one of mv, mp and mm can be a multiple of 5
+            if (mv % 5 == 0)
             {
-                int digit = floor(num / weight);
-                num -= (digit * weight);
-                *(c++) = '0' + digit;
+                vrTrailingZeros = multipleOfPow5(mv, q);
             }
-            if (m == 0 && num > 0)
+            else if (acceptBounds)
             {
-                *(c++) = '.';
+                vmTrailingZeros = multipleOfPow5(mv - 1 - mmShift, q);
+            }
+            else
+            {
+                vp -= multipleOfPow5(mv + 2, q);
             }
-            m--;
         }
-        if (useexp)
+    }
+    else
+    {
+        uint32 q = log10Pow5(-e2) - (-e2 > 1);
+        e10 = (int32)q + e2;
+        int32 i = -e2 - (int32)q;
+        int32 k = pow5Bits(i) - POW5_BITCOUNT;
+        int32 j = (int32)q - k;
+        const uint64* mul = tables.mPow[i];
+        vr = mulShift64(4 * m2, mul, j);
+        vp = mulShift64(4 * m2 + 2, mul, j);
+        vm = mulShift64(4 * m2 - 1 - mmShift, mul, j);
+        if (q <= 1)
         {
-            // convert the exponent
-            *(c++) = 'e';
-            if (m1 > 0)
+            // mv has at least q trailing zero bits, so vr is exact
+            vrTrailingZeros = true;
+            if (acceptBounds)
             {
-                *(c++) = '+';
+                vmTrailingZeros = mmShift == 1;
             }
             else
             {
-                *(c++) = '-';
-                m1 = -m1;
+                vp--;
             }
-            m = 0;
-            while (m1 > 0)
+        }
+        else if (q < 63)
+        {
+            vrTrailingZeros = multipleOfPow2(mv, q);
+        }
+    }
+
+    // Drops digits while the bounds still differ, then rounds what's left
+    int32 removed = 0;
+    uint64 output;
+    if (vmTrailingZeros || vrTrailingZeros)
+    {
+        // Rare, needs the exact dropped digits for ties and the lower bound
+        uint8 lastRemoved = 0;
+        while (vp / 10 > vm / 10)
+        {
+            vmTrailingZeros &= vm % 10 == 0;
+            vrTrailingZeros &= lastRemoved == 0;
+            lastRemoved = (uint8)(vr % 10);
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        if (vmTrailingZeros)
+        {
+            while (vm % 10 == 0)
             {
-                *(c++) = '0' + m1 % 10;
-                m1 /= 10;
-                m++;
+                vrTrailingZeros &= lastRemoved == 0;
+                lastRemoved = (uint8)(vr % 10);
+                vr /= 10;
+                vp /= 10;
+                vm /= 10;
+                removed++;
             }
-            c -= m;
-            for (int i = 0, j = m - 1; i < j; i++, j--)
+        }
+        if (vrTrailingZeros && lastRemoved == 5 && vr % 2 == 0)
+        {
+            // Exactly halfway, round to even
+            lastRemoved = 4;
+        }
+        output = vr + ((vr == vm && (!acceptBounds || !vmTrailingZeros)) || lastRemoved >= 5);
+    }
+    else
+    {
+        bool roundUp = false;
+        if (vp / 100 > vm / 100)
+        {
+            roundUp = vr % 100 >= 50;
+            vr /= 100;
+            vp /= 100;
+            vm /= 100;
+            removed += 2;
+        }
+        while (vp / 10 > vm / 10)
+        {
+            roundUp = vr % 10 >= 5;
+            vr /= 10;
+            vp /= 10;
+            vm /= 10;
+            removed++;
+        }
+        output = vr + (vr == vm || roundUp);
+    }
+
+    return {output, e10 + removed};
+}
+
+// Formats a float from its sign, mantissa and exponent fields.  Values from
+// 1e-8 up to 1e14 are written out in full, others in scientific notation.
+static string floatStr(bool neg, uint64 mantissa, uint32 exponent, int32 mbits, int32 ebits)
+{
+    string sobj;
+    uint32 maxexp = (1u << ebits) - 1;
+    if (exponent == maxexp)
+    {
+        sobj.assign(mantissa ? "nan" : (neg ? "-inf" : "inf"));
+        return sobj;
+    }
+    if (exponent == 0 && mantissa == 0)
+    {
+        sobj.assign(neg ? "-0" : "0");
+        return sobj;
+    }
+
+    DecFloat dec = floatToDec(mantissa, exponent, mbits, (int32)(maxexp >> 1));
+
+    char digits[20];
+    char* dend = digits + sizeof(digits);
+    char* d = uintDigits<10>(dend, dec.mDigits);
+    int32 olen = (int32)(dend - d);
+
+    // Exponent of the leading digit
+    int32 e = dec.mExp + olen - 1;
+
+    char buf[40];
+    char* c = buf;
+    if (neg)
+    {
+        *c++ = '-';
+    }
+    if (e > -9 && e < 14)
+    {
+        if (e < 0)
+        {
+            *c++ = '0';
+            *c++ = '.';
+            for (int32 i = -1; i > e; i--)
             {
-                // swap
-                c[i] ^= c[j];
-                c[j] ^= c[i];
-                c[i] ^= c[j];
+                *c++ = '0';
             }
-            c += m;
+            memcpy(c, d, olen);
+            c += olen;
+        }
+        else if (olen <= e + 1)
+        {
+            memcpy(c, d, olen);
+            c += olen;
+            for (int32 i = olen; i <= e; i++)
+            {
+                *c++ = '0';
+            }
+        }
+        else
+        {
+            memcpy(c, d, e + 1);
+            c += e + 1;
+            *c++ = '.';
+            memcpy(c, d + e + 1, olen - e - 1);
+            c += olen - e - 1;
+        }
+    }
+    else
+    {
+        *c++ = d[0];
+        if (olen > 1)
+        {
+            *c++ = '.';
+            memcpy(c, d + 1, olen - 1);
+            c += olen - 1;
         }
-        *(c) = '\0';
-        sobj.mLen = strlen(s);
+        *c++ = 'e';
+        *c++ = (e < 0) ? '-' : '+';
+        char ebuf[8];
+        char* eend = ebuf + sizeof(ebuf);
+        char* ep = uintDigits<10>(eend, (uint64)(e < 0 ? -e : e));
+        memcpy(c, ep, eend - ep);
+        c += eend - ep;
     }
 
+    sobj.assign(buf, c - buf);
     return sobj;
 }
 
+string string::float64Str(float64 num)
+{
+    uint64 bits;
+    memcpy(&bits, &num, sizeof(bits));
+    return floatStr((bits >> 63) != 0, bits & ((1ull << 52) - 1), (uint32)(bits >> 52) & 0x7FF, 52, 11);
+}
 
-string string::uint64Str(uint64 num, int8 base, bool minus)
+string string::float32Str(float32 num)
 {
-    string sobj;
-    // For base 10 or higher, use only the fixed internal buffer
-    zstr str = sobj.ensureAlloc(base >= 10 ? 30 : 66);
+    uint32 bits;
+    memcpy(&bits, &num, sizeof(bits));
+    return floatStr((bits >> 31) != 0, bits & ((1u << 23) - 1), (bits >> 23) & 0xFF, 23, 8);
+}
 
-    // Convert to string (but chars will be in reverse order)
-    usize i = 0;
-    do
+void StrBuilder::append(const StrBuilder& that)
+{
+    if (this == &that)
     {
-        char digit = (char)(num % base);
-        digit += (digit < 0xA) ? '0' : ('A' - 0xA);
-        str[i++] = digit;
+        // The chunks would grow while they are read
+        string s = that.toString();
+        append(s);
+        return;
+    }
+    reserve(that.mLen);
+    for (Chunk* c = that.mHead; c; c = c->mNext)
+    {
+        append(strview(c->bytes(), c->mUsed));
+    }
+}
 
-        num /= base;
-    } while (num);
-    if (minus)
+void StrBuilder::clear()
+{
+    Chunk* c = mHead;
+    while (c)
     {
-        str[i++] = '-';
+        Chunk* next = c->mNext;
+        sDefaultMemAlloc->_free(c);
+        c = next;
     }
+    mHead = nullptr;
+    mTail = nullptr;
+    mLen = 0;
+}
 
-    str[i] = '\0';
-    sobj.mLen = i;
+string StrBuilder::toString() const
+{
+    string s;
+    zstr buf = s.ensureAlloc(mLen + 1);
+    for (Chunk* c = mHead; c; c = c->mNext)
+    {
+        memcpy(buf, c->bytes(), c->mUsed);
+        buf += c->mUsed;
+    }
+    s.mLen = mLen;
+    return s;
+}
 
-    // Reverse the string
-    i--;
-    for (usize j = 0; j < i; j++, i--)
+string StrBuilder::concat(vararg(strview) list)
+{
+    usize len = 0;
+    for (auto& v : list)
     {
-        char tmp = str[i];
-        str[i] = str[j];
-        str[j] = tmp;
+        len += v.length();
     }
-    return sobj;
+    string s;
+    zstr buf = s.ensureAlloc(len + 1);
+    for (auto& v : list)
+    {
+        memcpy(buf, v.data(), v.length());
+        buf += v.length();
+    }
+    s.mLen = len;
+    return s;
 }
 
-string string::int64Str(int64 num)
+void StrBuilder::addChunk(usize needed)
 {
-    if (num < 0)
+    // Each chunk as big as all before it, up to MAXCHUNK, so there are few
+    // of them for a short string and none too big for a long one
+    usize size = mLen < MAXCHUNK ? mLen : MAXCHUNK;
+    size = size > MINCHUNK ? size : MINCHUNK;
+    size = size > needed ? size : needed;
+
+    Chunk* c = (Chunk*)sDefaultMemAlloc->_malloc(sizeof(Chunk) + size);
+    c->mNext = nullptr;
+    c->mSize = size;
+    c->mUsed = 0;
+    if (mTail)
     {
-        return uint64Str(-1 * num, 10, true);
+        mTail->mNext = c;
     }
     else
     {
-        return uint64Str(num, 10);
+        mHead = c;
     }
+    mTail = c;
 }
 
 
@@ -0,0 +1,626 @@
+#include "plmem.h"
+#include "plstr.h"
+#include "pltask.h"
+#include "pldef.h"
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h>
+#else
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace primal
+{
+
+// Chase-Lev work stealing deque.  The owner pushes and pops at the bottom,
+// thieves take from the top, and only a race for the last task needs a CAS.
+// The ring doubles when full.  Replaced rings are kept until the deque is
+// destroyed, since a thief can still be reading one.
+class TaskDeque
+{
+public:
+    TaskDeque() :
+        mTop(0),
+        mBottom(0)
+    {
+        mRing = allocRing(INITSIZE, nullptr);
+    }
+    ~TaskDeque()
+    {
+        Ring* ring = mRing;
+        while (ring)
+        {
+            Ring* prev = ring->mPrev;
+            sDefaultMemAlloc->_free(ring);
+            ring = prev;
+        }
+    }
+
+    void push(PlTaskBase* task)
+    {
+        int64 b = mBottom;
+        int64 t = atomicLoadAcq(&mTop);
+        Ring* ring = mRing;
+        if (b - t > ring->mMask)
+        {
+            ring = grow(ring, t, b);
+        }
+        atomicStorePtr(&ring->mSlots[b & ring->mMask], task);
+        atomicStoreRel(&mBottom, b + 1);
+    }
+
+    PlTaskBase* pop()
+    {
+        int64 b = mBottom - 1;
+        Ring* ring = mRing;
+        atomicStoreRel(&mBottom, b);
+        atomicFence();
+        int64 t = atomicLoadAcq(&mTop);
+        if (t > b)
+        {
+            atomicStoreRel(&mBottom, b + 1);
+            return nullptr;
+        }
+        PlTaskBase* task = atomicLoadPtr(&ring->mSlots[b & ring->mMask]);
+        if (t == b)
+        {
+            // Last one, a thief may be after it too
+            if (!atomicCompareExchange(&mTop, t, t + 1))
+            {
+                task = nullptr;
+            }
+            atomicStoreRel(&mBottom, b + 1);
+        }
+        return task;
+    }
+
+    // Returns nullptr when empty or when another thread got there first
+    PlTaskBase* steal()
+    {
+        int64 t = atomicLoadAcq(&mTop);
+        atomicFence();
+        int64 b = atomicLoadAcq(&mBottom);
+        if (t >= b)
+        {
+            return nullptr;
+        }
+        Ring* ring = atomicLoadPtr(&mRing);
+        PlTaskBase* task = atomicLoadPtr(&ring->mSlots[t & ring->mMask]);
+        if (!atomicCompareExchange(&mTop, t, t + 1))
+        {
+            return nullptr;
+        }
+        return task;
+    }
+
+    bool empty()
+    {
+        return atomicLoadAcq(&mBottom) <= atomicLoadAcq(&mTop);
+    }
+
+private:
+    struct Ring
+    {
+        int64 mMask;
+        Ring* mPrev;
+        PlTaskBase* volatile mSlots[1];
+    };
+
+    static Ring* allocRing(int64 size, Ring* prev)
+    {
+        Ring* ring = (Ring*)sDefaultMemAlloc->_malloc(sizeof(Ring) + (size - 1) * sizeof(PlTaskBase*));
+        ring->mMask = size - 1;
+        ring->mPrev = prev;
+        return ring;
+    }
+
+    Ring* grow(Ring* ring, int64 t, int64 b)
+    {
+        Ring* bigger = allocRing((ring->mMask + 1) * 2, ring);
+        for (int64 i = t; i < b; i++)
+        {
+            bigger->mSlots[i & bigger->mMask] = ring->mSlots[i & ring->mMask];
+        }
+        atomicStorePtr(&mRing, bigger);
+        return bigger;
+    }
+
+    constMemb INITSIZE = 256;
+
+    // Thieves write top and the owner writes bottom, kept on separate lines
+    volatile int64 mTop;
+    char mPad0[56];
+    volatile int64 mBottom;
+    Ring* volatile mRing;
+    char mPad1[48];
+};
+
+// Threads waiting for a condition.  wake() only takes the lock when someone
+// is waiting.  A waker changes what ready() tests, then calls atomicFence()
+// and wake(), and a sleeper is counted before it tests ready(), so either the
+// sleeper sees the change or the waker sees the sleeper.
+class SleepQueue
+{
+public:
+    SleepQueue() :
+        mWaiters(0)
+    {
+#ifdef _WIN32
+        InitializeSRWLock(&mLock);
+        InitializeConditionVariable(&mCond);
+#else
+        pthread_mutex_init(&mLock, nullptr);
+        pthread_cond_init(&mCond, nullptr);
+#endif
+    }
+    ~SleepQueue()
+    {
+#ifndef _WIN32
+        pthread_cond_destroy(&mCond);
+        pthread_mutex_destroy(&mLock);
+#endif
+    }
+
+    // Waits for a wake, or up to ms when it isn't 0
+    template <class ReadyFunc>
+    void sleep(ReadyFunc ready, uint32 ms)
+    {
+#ifdef _WIN32
+        AcquireSRWLockExclusive(&mLock);
+        atomicIncrement(&mWaiters);
+        if (!ready())
+        {
+            SleepConditionVariableSRW(&mCond, &mLock, ms ? ms : INFINITE, 0);
+        }
+        atomicDecrement(&mWaiters);
+        ReleaseSRWLockExclusive(&mLock);
+#else
+        pthread_mutex_lock(&mLock);
+        atomicIncrement(&mWaiters);
+        if (!ready())
+        {
+            if (ms)
+            {
+                struct timespec ts;
+                clock_gettime(CLOCK_REALTIME, &ts);
+                ts.tv_nsec += (long)ms * 1000000;
+                ts.tv_sec += ts.tv_nsec / 1000000000;
+                ts.tv_nsec %= 1000000000;
+                pthread_cond_timedwait(&mCond, &mLock, &ts);
+            }
+            else
+            {
+                pthread_cond_wait(&mCond, &mLock);
+            }
+        }
+        atomicDecrement(&mWaiters);
+        pthread_mutex_unlock(&mLock);
+#endif
+    }
+
+    void wake(bool all)
+    {
+        if (atomicLoad(&mWaiters) == 0)
+        {
+            return;
+        }
+#ifdef _WIN32
+        AcquireSRWLockExclusive(&mLock);
+        if (all)
+        {
+            WakeAllConditionVariable(&mCond);
+        }
+        else
+        {
+            WakeConditionVariable(&mCond);
+        }
+        ReleaseSRWLockExclusive(&mLock);
+#else
+        pthread_mutex_lock(&mLock);
+        if (all)
+        {
+            pthread_cond_broadcast(&mCond);
+        }
+        else
+        {
+            pthread_cond_signal(&mCond);
+        }
+        pthread_mutex_unlock(&mLock);
+#endif
+    }
+
+private:
+    volatile int32 mWaiters;
+#ifdef _WIN32
+    SRWLOCK mLock;
+    CONDITION_VARIABLE mCond;
+#else
+    pthread_mutex_t mLock;
+    pthread_cond_t mCond;
+#endif
+};
+
+
+// TaskPool::
+class TaskPool
+{
+public:
+    static void submit(PlTaskBase* task);
+    static void wait(PlTaskBase* task);
+    static void shutdown();
+    static usize workerCount();
+    static void setWorkerCount(usize count);
+
+    static thread_local int32 sSlot;
+
+private:
+    static void start();
+    static bool hasWork();
+    static PlTaskBase* findTask();
+    static void runTask(PlTaskBase* task);
+    static void workerRun(int32 slot);
+#ifdef _WIN32
+    static DWORD WINAPI workerThread(LPVOID arg);
+#else
+    static void* workerThread(void* arg);
+#endif
+
+    // Spins before sleeping when there's nothing to do
+    constMemb SPINS = 64;
+
+    static usize sCount;
+    static usize sSetCount;
+    static TaskDeque* sDeques;
+#ifdef _WIN32
+    static HANDLE* sThreads;
+#else
+    static pthread_t* sThreads;
+#endif
+    static volatile int32 sStarted;
+    static volatile int32 sStop;
+    static Mutex sStartMut;
+
+    // Tasks submitted from threads that aren't workers
+    static FastMutex sInjectMut;
+    static PlTaskBase* sInjectHead;
+    static PlTaskBase* sInjectTail;
+    static volatile int32 sInjectCount;
+
+    static SleepQueue sIdle;
+    static SleepQueue sJoin;
+};
+
+thread_local int32 TaskPool::sSlot = -1;
+usize TaskPool::sCount = 0;
+usize TaskPool::sSetCount = 0;
+TaskDeque* TaskPool::sDeques = nullptr;
+#ifdef _WIN32
+HANDLE* TaskPool::sThreads = nullptr;
+#else
+pthread_t* TaskPool::sThreads = nullptr;
+#endif
+volatile int32 TaskPool::sStarted = 0;
+volatile int32 TaskPool::sStop = 0;
+Mutex TaskPool::sStartMut;
+FastMutex TaskPool::sInjectMut;
+PlTaskBase* TaskPool::sInjectHead = nullptr;
+PlTaskBase* TaskPool::sInjectTail = nullptr;
+volatile int32 TaskPool::sInjectCount = 0;
+SleepQueue TaskPool::sIdle;
+SleepQueue TaskPool::sJoin;
+
+usize TaskPool::workerCount()
+{
+    if (atomicLoad(&sStarted))
+    {
+        return sCount;
+    }
+    if (sSetCount > 0)
+    {
+        return sSetCount;
+    }
+#ifdef _WIN32
+    SYSTEM_INFO si;
+    GetSystemInfo(&si);
+    usize cpus = (usize)si.dwNumberOfProcessors;
+#else
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    usize cpus = n > 0 ? (usize)n : 1;
+#endif
+    return cpus;
+}
+
+void TaskPool::setWorkerCount(usize count)
+{
+    AutoLock al(sStartMut);
+    sSetCount = count;
+}
+
+void TaskPool::start()
+{
+    AutoLock al(sStartMut);
+    if (atomicLoad(&sStarted))
+    {
+        return;
+    }
+
+    sCount = workerCount();
+    sDeques = (TaskDeque*)sDefaultMemAlloc->_malloc(sizeof(TaskDeque) * sCount);
+    for (usize i = 0; i < sCount; i++)
+    {
+        new(&sDeques[i]) TaskDeque();
+    }
+    atomicStore(&sStop, 0);
+
+    // Slot 0 is the main thread's, the others each get a thread
+#ifdef _WIN32
+    sThreads = (HANDLE*)sDefaultMemAlloc->_zalloc(sizeof(HANDLE) * sCount);
+    for (usize i = 1; i < sCount; i++)
+    {
+        sThreads[i] = CreateThread(NULL, 0, workerThread, (LPVOID)i, 0, NULL);
+    }
+#else
+    sThreads = (pthread_t*)sDefaultMemAlloc->_zalloc(sizeof(pthread_t) * sCount);
+    for (usize i = 1; i < sCount; i++)
+    {
+        int ret = pthread_create(&sThreads[i], nullptr, workerThread, (void*)i);
+        dbgeno(ret);
+    }
+#endif
+    atomicStore(&sStarted, 1);
+}
+
+void TaskPool::shutdown()
+{
+    AutoLock al(sStartMut);
+    if (!atomicLoad(&sStarted))
+    {
+        return;
+    }
+
+    // Workers exit once they find nothing left to run
+    PlTaskBase* task;
+    while ((task = findTask()) != nullptr)
+    {
+        runTask(task);
+    }
+    atomicStore(&sStop, 1);
+    sIdle.wake(true);
+    for (usize i = 1; i < sCount; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(sThreads[i], INFINITE);
+        CloseHandle(sThreads[i]);
+#else
+        pthread_join(sThreads[i], nullptr);
+#endif
+    }
+
+    for (usize i = 0; i < sCount; i++)
+    {
+        sDeques[i].~TaskDeque();
+    }
+    sDefaultMemAlloc->_free(sDeques);
+    sDefaultMemAlloc->_free(sThreads);
+    sDeques = nullptr;
+    sThreads = nullptr;
+    atomicStore(&sStarted, 0);
+}
+
+void TaskPool::submit(PlTaskBase* task)
+{
+    if (!atomicLoad(&sStarted))
+    {
+        start();
+    }
+
+    int32 slot = sSlot;
+    if (slot >= 0)
+    {
+        sDeques[slot].push(task);
+    }
+    else
+    {
+        AutoLock al(sInjectMut);
+        task->mNext = nullptr;
+        if (sInjectTail)
+        {
+            sInjectTail->mNext = task;
+        }
+        else
+        {
+            sInjectHead = task;
+        }
+        sInjectTail = task;
+        atomicIncrement(&sInjectCount);
+    }
+    atomicFence();
+    sIdle.wake(false);
+}
+
+bool TaskPool::hasWork()
+{
+    if (atomicLoad(&sInjectCount) > 0)
+    {
+        return true;
+    }
+    for (usize i = 0; i < sCount; i++)
+    {
+        if (!sDeques[i].empty())
+        {
+            return true;
+        }
+    }
+    return false;
+}
+
+PlTaskBase* TaskPool::findTask()
+{
+    int32 slot = sSlot;
+    PlTaskBase* task;
+    if (slot >= 0 && (task = sDeques[slot].pop()) != nullptr)
+    {
+        return task;
+    }
+
+    if (atomicLoad(&sInjectCount) > 0)
+    {
+        AutoLock al(sInjectMut);
+        task = sInjectHead;
+        if (task)
+        {
+            sInjectHead = task->mNext;
+            if (sInjectHead == nullptr)
+            {
+                sInjectTail = nullptr;
+            }
+            atomicDecrement(&sInjectCount);
+            return task;
+        }
+    }
+
+    // Steals from the others, starting after this one so thieves spread out.
+    // A lost race is retried while any deque looks non empty.
+    usize first = slot >= 0 ? (usize)slot + 1 : 0;
+    for (int32 pass = 0; pass < 2; pass++)
+    {
+        bool missed = false;
+        for (usize i = 0; i < sCount; i++)
+        {
+            usize victim = (first + i) % sCount;
+            if ((int32)victim == slot || sDeques[victim].empty())
+            {
+                continue;
+            }
+            task = sDeques[victim].steal();
+            if (task)
+            {
+                return task;
+            }
+            missed = true;
+        }
+        if (!missed)
+        {
+            break;
+        }
+    }
+    return nullptr;
+}
+
+void TaskPool::runTask(PlTaskBase* task)
+{
+    task->execute();
+    task->finish();
+
+    // The task may be gone now, only the waiters are woken
+    atomicFence();
+    sJoin.wake(true);
+}
+
+void TaskPool::wait(PlTaskBase* task)
+{
+    // Helps with other tasks, then sleeps until a task finishes.  A sleeping
+    // waiter isn't woken for new tasks, the timeout has it look again.
+    int32 idle = 0;
+    while (!task->done())
+    {
+        PlTaskBase* other = findTask();
+        if (other)
+        {
+            runTask(other);
+            idle = 0;
+        }
+        else if (++idle < SPINS)
+        {
+            osYield(false);
+        }
+        else
+        {
+            sJoin.sleep([task]() { return task->done(); }, 1);
+        }
+    }
+}
+
+void TaskPool::workerRun(int32 slot)
+{
+    sSlot = slot;
+    int32 idle = 0;
+    for (;;)
+    {
+        PlTaskBase* task = findTask();
+        if (task)
+        {
+            runTask(task);
+            idle = 0;
+        }
+        else if (atomicLoad(&sStop))
+        {
+            break;
+        }
+        else if (++idle < SPINS)
+        {
+            osYield(false);
+        }
+        else
+        {
+            sIdle.sleep([]() { return atomicLoad(&sStop) || hasWork(); }, 0);
+            idle = 0;
+        }
+    }
+    sSlot = -1;
+}
+
+#ifdef _WIN32
+DWORD WINAPI TaskPool::workerThread(LPVOID arg)
+{
+    workerRun((int32)(intptr_t)arg);
+    return 0;
+}
+#else
+void* TaskPool::workerThread(void* arg)
+{
+    workerRun((int32)(intptr_t)arg);
+    return nullptr;
+}
+#endif
+
+
+void taskSubmit(PlTaskBase* task)
+{
+    TaskPool::submit(task);
+}
+
+void taskWait(PlTaskBase* task)
+{
+    TaskPool::wait(task);
+}
+
+usize taskWorkerCount()
+{
+    return TaskPool::workerCount();
+}
+
+void taskSetWorkerCount(usize count)
+{
+    TaskPool::setWorkerCount(count);
+}
+
+void taskShutdown()
+{
+    TaskPool::shutdown();
+}
+
+void taskMainThread()
+{
+    TaskPool::sSlot = 0;
+}
+
+FastMutex& taskReduceLock()
+{
+    static FastMutex sReduceMut;
+    return sReduceMut;
+}
+
+} // namespace primal
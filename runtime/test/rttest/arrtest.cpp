@@ -332,6 +332,136 @@ void testPlVector()
 }
 
 
+class VecItem : public PlObject
+{
+public:
+    int64 mVal = 0;
+};
+
+void testPlVectorIter()
+{
+    // The loops generated for samples/vector, at a larger size
+    constDef COUNT = 1000000;
+    constDef PASSES = 10;
+    _OB(PlVector<VecItem>) arr = _NEWOB(PlVector<VecItem>);
+    for (int64 i = 0; i < COUNT; i++)
+    {
+        arr->appendNew()->mVal = i;
+    }
+
+    TEST("Index range fwd and rev order")
+        int64 n = 0;
+        for (auto i : arr->indexFwd())
+        {
+            RES = RES && (i->mVal == n++);
+        }
+        RES = RES && (n == COUNT);
+        for (auto i : arr->indexRev())
+        {
+            RES = RES && (i->mVal == --n);
+        }
+        RES = RES && (n == 0);
+    TESTEND()
+
+    TEST("Index range holds the vector")
+        _OB(PlVector<VecItem>) small = _NEWOB(PlVector<VecItem>);
+        small->appendNew()->mVal = 7;
+        small->appendNew()->mVal = 8;
+        int64 sum = 0;
+        for (auto i : small->indexFwd())
+        {
+            // Dropping the only other ref doesn't end the loop early
+            small = arr;
+            sum += i->mVal;
+        }
+        RES = (sum == 15);
+    TESTEND()
+
+    TEST("Append and remove inside an index range")
+        _OB(PlVector<VecItem>) grow = _NEWOB(PlVector<VecItem>);
+        for (int64 i = 0; i < 4; i++)
+        {
+            grow->appendNew()->mVal = i;
+        }
+        int64 seen = 0;
+        int64 sum = 0;
+        for (auto i : grow->indexFwd())
+        {
+            // Enough appends to move the array, and the element appended
+            // again, with the loop var still reading the right object
+            for (int k = 0; k < 100; k++)
+            {
+                grow->appendNew()->mVal = 1000;
+            }
+            grow->appendNew()->mVal = i->mVal;
+            sum += i->mVal;
+            i = nullptr;
+            seen++;
+        }
+        RES = (seen == 4 && sum == 6 && grow->length() == 408 && grow->get(104)->mVal == 0 && grow->get(0)->mVal == 0);
+
+        int64 last = -1;
+        seen = 0;
+        for (auto i : grow->indexFwd())
+        {
+            last = i->mVal;
+            grow->remove(grow->length() - 1);
+            seen++;
+        }
+        RES = RES && (seen == 204 && last == 1000 && grow->length() == 204);
+
+        seen = 0;
+        for (auto i : grow->indexRev())
+        {
+            grow->remove(0);
+            grow->remove(0);
+            seen++;
+        }
+        RES = RES && (seen == 102 && grow->length() == 0);
+    TESTEND()
+
+    int64 sum = 0;
+    TIME("Vector iterFwd loop")
+        for (int p = 0; p < PASSES; p++)
+        {
+            for (auto i = arr->iterFwd(); arr->iterFwdLoop(i); )
+            {
+                sum += i->mVal;
+            }
+        }
+    TIMEEND()
+    TIME("Vector indexFwd loop")
+        for (int p = 0; p < PASSES; p++)
+        {
+            for (auto i : arr->indexFwd())
+            {
+                sum += i->mVal;
+            }
+        }
+    TIMEEND()
+    TIME("Range loop, length() each iteration")
+        for (int p = 0; p < PASSES; p++)
+        {
+            for (auto i = 0ULL; i < arr->length(); i++)
+            {
+                sum += arr->get(i)->mVal;
+            }
+        }
+    TIMEEND()
+    TIME("Range loop, hoisted length()")
+        for (int p = 0; p < PASSES; p++)
+        {
+            const auto _for_1_end = arr->length();
+            for (auto i = 0ULL; i < _for_1_end; i++)
+            {
+                sum += arr->get(i)->mVal;
+            }
+        }
+    TIMEEND()
+    TESTEXP("Vector loops summed", sum == (int64)PASSES * 4 * ((int64)COUNT * (COUNT - 1) / 2));
+}
+
+
 constDef CONSTDEF_AUTOSTR = "auto";
 constDef CONSTDEF_AUTOUINT = 25ul;
 constDef_(size_t) CONSTDEF_SIZET = 20;
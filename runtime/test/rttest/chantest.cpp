@@ -0,0 +1,223 @@
+#include "tests.h"
+#include <stdio.h>
+
+using namespace primal;
+
+static volatile int32 sMsgCount = 0;
+
+class Msg : public PlObject
+{
+public:
+    Msg() :
+        mVal(0)
+    {
+        atomicIncrement(&sMsgCount);
+    }
+    ~Msg()
+    {
+        atomicDecrement(&sMsgCount);
+    }
+    int64 mVal;
+};
+
+using MsgChan = PlChannel<Msg>;
+using IntChan = PlChannel<int64>;
+
+// Sends or receives count items on its own thread of the pool.  Values are
+// id * count + i, so each can be checked off once.
+template <class ChanType>
+class ChanTask : public PlTaskBase
+{
+public:
+    ChanTask() :
+        mChan(nullptr),
+        mSend(false),
+        mId(0),
+        mCount(0),
+        mSum(0)
+    {
+    }
+    void init(ChanType* chan, bool send, int64 id, int64 count)
+    {
+        mChan = chan;
+        mSend = send;
+        mId = id;
+        mCount = count;
+    }
+    int64 sum()
+    {
+        return mSum;
+    }
+
+protected:
+    void execute() override
+    {
+        for (int64 i = 0; i < mCount; i++)
+        {
+            if constexpr (ChanType::ISOBJ)
+            {
+                if (mSend)
+                {
+                    PlRef<Msg> m = PlRef<Msg>::createObject();
+                    m->mVal = mId * mCount + i;
+                    mChan->send(m);
+                }
+                else
+                {
+                    mSum += mChan->recv()->mVal;
+                }
+            }
+            else
+            {
+                if (mSend)
+                {
+                    mChan->send(mId * mCount + i);
+                }
+                else
+                {
+                    mSum += mChan->recv();
+                }
+            }
+        }
+    }
+
+private:
+    ChanType* mChan;
+    bool mSend;
+    int64 mId;
+    int64 mCount;
+    int64 mSum;
+};
+
+// Runs senders and receivers at the same time, one worker each, and
+// checks that every value sent was received once
+template <class ChanType>
+static bool runSendRecv(ChanType* chan, int32 senders, int32 receivers, int64 count)
+{
+    constDef MAXTASKS = 16;
+    ChanTask<ChanType> tasks[MAXTASKS];
+    int32 ntasks = senders + receivers;
+    taskShutdown();
+    taskSetWorkerCount(ntasks);
+
+    int64 total = count * senders;
+    for (int32 i = 0; i < senders; i++)
+    {
+        tasks[i].init(chan, true, i, count);
+    }
+    for (int32 i = 0; i < receivers; i++)
+    {
+        tasks[senders + i].init(chan, false, i, total / receivers);
+    }
+    for (int32 i = 0; i < ntasks; i++)
+    {
+        taskSubmit(&tasks[i]);
+    }
+    int64 sum = 0;
+    for (int32 i = 0; i < ntasks; i++)
+    {
+        taskWait(&tasks[i]);
+        sum += tasks[i].sum();
+    }
+    return sum == total * (total - 1) / 2 && chan->length() == 0;
+}
+
+void testChannel()
+{
+    atomicStore(&sMsgCount, 0);
+    {
+        MsgChan chan(4);
+        bool sent = true;
+        for (int i = 0; i < 4; i++)
+        {
+            PlRef<Msg> m = PlRef<Msg>::createObject();
+            m->mVal = i;
+            sent = sent && chan.trySend(m);
+        }
+        PlRef<Msg> extra = PlRef<Msg>::createObject();
+        TESTEXP("Objects sent until full", sent && !chan.trySend(extra) && chan.length() == 4 && atomicLoad(&sMsgCount) == 5);
+
+        bool inorder = true;
+        PlRef<Msg> m;
+        for (int i = 0; i < 4; i++)
+        {
+            inorder = inorder && chan.tryRecv(m) && m->mVal == i;
+        }
+        TESTEXP("Objects received in order", inorder && !chan.tryRecv(m) && chan.length() == 0);
+
+        // Left in the channel, released with it
+        chan.send(extra);
+        chan.send(PlRef<Msg>::createObject());
+    }
+    TESTEXP("Objects released", atomicLoad(&sMsgCount) == 0);
+
+    {
+        IntChan chan(3);
+        TESTEXP("Capacity rounded up", chan.capacity() == 4);
+        int64 v = 0;
+        bool wrapped = true;
+        for (int64 i = 0; i < 10; i++)
+        {
+            chan.send(i);
+            wrapped = wrapped && chan.tryRecv(v) && v == i;
+        }
+        TESTEXP("Values around the ring", wrapped && !chan.tryRecv(v));
+        chan.setCapacity(100);
+        TESTEXP("setCapacity", chan.capacity() == 128 && chan.length() == 0);
+    }
+
+    // A small ring, so senders and receivers both have to wait
+    {
+        IntChan chan(8);
+        TESTEXP("1 sender, 1 receiver", runSendRecv(&chan, 1, 1, 100000));
+        TESTEXP("4 senders, 4 receivers", runSendRecv(&chan, 4, 4, 20000));
+        TESTEXP("1 sender, 3 receivers", runSendRecv(&chan, 1, 3, 30000));
+    }
+    {
+        MsgChan chan(16);
+        TESTEXP("Objects, 3 senders, 2 receivers", runSendRecv(&chan, 3, 2, 20000));
+    }
+    TESTEXP("Objects all released", atomicLoad(&sMsgCount) == 0);
+
+    taskShutdown();
+    taskSetWorkerCount(0);
+}
+
+void testChannelBench()
+{
+    constDef COUNT = 1 << 20;
+    IntChan chan(1024);
+
+    // One thread, a send then a receive
+    int64 v = 0;
+    int64 sum = 0;
+    TIME("Send and receive, one thread")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            chan.trySend(i);
+            chan.tryRecv(v);
+            sum += v;
+        }
+    TIMEEND()
+    TESTEXP("One thread", sum == (int64)COUNT * (COUNT - 1) / 2);
+
+    bool ok = false;
+    TIME("1 sender, 1 receiver")
+        ok = runSendRecv(&chan, 1, 1, COUNT);
+    TIMEEND()
+    TESTEXP("1 sender, 1 receiver", ok);
+
+    TIME("4 senders, 4 receivers")
+        ok = runSendRecv(&chan, 4, 4, COUNT / 4);
+    TIMEEND()
+    TESTEXP("4 senders, 4 receivers", ok);
+
+    MsgChan mchan(1024);
+    TIME("Objects, 2 senders, 2 receivers")
+        ok = runSendRecv(&mchan, 2, 2, COUNT / 4);
+    TIMEEND()
+    TESTEXP("Objects, 2 senders, 2 receivers", ok);
+
+    taskShutdown();
+    taskSetWorkerCount(0);
+}
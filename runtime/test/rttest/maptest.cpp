@@ -0,0 +1,219 @@
+#include "tests.h"
+#include <stdio.h>
+
+using namespace primal;
+
+static volatile int32 sItemCount = 0;
+
+class Item : public PlObject
+{
+public:
+    Item() :
+        mVal(0)
+    {
+        atomicIncrement(&sItemCount);
+    }
+    ~Item()
+    {
+        atomicDecrement(&sItemCount);
+    }
+    int64 mVal;
+};
+
+// As the compiler emits them, value types boxed
+using IntMap = PlMap<PlBoxObj<int64>, PlBoxObj<int64>>;
+using StrMap = PlMap<PlBoxObj<string>, PlBoxObj<int64>>;
+using ItemMap = PlMap<PlBoxObj<int64>, Item>;
+using ObjKeyMap = PlMap<Item, PlBoxObj<int32>>;
+
+static string keyStr(int64 i)
+{
+    string s("key");
+    s.append(Fmt(i));
+    return s;
+}
+
+void testMap()
+{
+    {
+        PlRef<IntMap> map = PlRef<IntMap>::createObject();
+        TESTEXP("Empty map", map->length() == 0 && map->capacity() == 0 && !map->has(5) && map->get(5) == 0);
+
+        bool added = true;
+        for (int64 i = 0; i < 1000; i++)
+        {
+            added = added && map->set(i * 7, i);
+        }
+        TESTEXP("Keys added", added && map->length() == 1000 && !map->set(7, 100) && map->get(7) == 100);
+
+        bool found = true;
+        for (int64 i = 0; i < 1000; i++)
+        {
+            found = found && map->has(i * 7) && !map->has(i * 7 + 1);
+        }
+        TESTEXP("Keys found", found && map->get(14) == 2 && *map->find(21) == 3 && map->find(22) == nullptr);
+
+        // Every other key removed, then found or not
+        bool removed = true;
+        for (int64 i = 0; i < 1000; i += 2)
+        {
+            removed = removed && map->remove(i * 7);
+        }
+        bool left = true;
+        for (int64 i = 0; i < 1000; i++)
+        {
+            left = left && map->has(i * 7) == (i % 2 == 1);
+        }
+        TESTEXP("Keys removed", removed && left && map->length() == 500 && !map->remove(0));
+
+        int64 count = 0;
+        int64 sum = 0;
+        for (auto& e : map->indexFwd())
+        {
+            count++;
+            sum += e->mVal;
+        }
+        int64 rcount = 0;
+        for (auto& e : map->indexRev())
+        {
+            rcount += e->mData % 7 == 0;
+        }
+        TESTEXP("Iterate", count == 500 && rcount == 500 && sum == 250000 - 1 + 100);
+
+        map->at(3) += 5;
+        map->at(3) += 5;
+        TESTEXP("at", map->get(3) == 10 && map->length() == 501);
+
+        map->clear();
+        TESTEXP("clear", map->length() == 0 && !map->has(7));
+    }
+
+    {
+        // Removing and adding keys reuses the slots, with no growth
+        PlRef<IntMap> map = PlRef<IntMap>::createObject();
+        map->reserve(100);
+        usize cap = map->capacity();
+        for (int64 i = 0; i < 100000; i++)
+        {
+            map->set(i, i);
+            if (i >= 50)
+            {
+                map->remove(i - 50);
+            }
+        }
+        TESTEXP("Churn", map->length() == 50 && map->capacity() == cap && map->get(99999) == 99999 && !map->has(99949));
+    }
+
+    {
+        PlRef<StrMap> map = PlRef<StrMap>::createObject();
+        for (int64 i = 0; i < 500; i++)
+        {
+            map->set(keyStr(i), i);
+        }
+        bool found = true;
+        for (int64 i = 0; i < 500; i++)
+        {
+            found = found && map->get(keyStr(i)) == i;
+        }
+        TESTEXP("String keys", found && map->length() == 500 && !map->has("key500") && map->has("key499"));
+    }
+
+    atomicStore(&sItemCount, 0);
+    {
+        PlRef<ItemMap> map = PlRef<ItemMap>::createObject();
+        for (int64 i = 0; i < 100; i++)
+        {
+            PlRef<Item> it = PlRef<Item>::createObject();
+            it->mVal = i * 2;
+            map->set(i, it);
+        }
+        TESTEXP("Object values", map->get(10)->mVal == 20 && !map->get(100) && atomicLoad(&sItemCount) == 100);
+
+        PlRef<Item> it = PlRef<Item>::createObject();
+        map->set(10, it);
+        map->remove(11);
+        TESTEXP("Object values replaced", map->get(10)->mVal == 0 && atomicLoad(&sItemCount) == 99);
+
+        PlRef<ObjKeyMap> keys = PlRef<ObjKeyMap>::createObject();
+        int32 n = 0;
+        for (auto& k : map->indexFwd())
+        {
+            keys->set(k->mVal, n++);
+        }
+        for (auto& k : keys->indexFwd())
+        {
+            n -= k->mVal >= 0;
+        }
+        TESTEXP("Object keys", keys->length() == 99 && keys->has(it) && n == 0);
+    }
+    TESTEXP("Objects released", atomicLoad(&sItemCount) == 0);
+}
+
+void testMapBench()
+{
+    constDef COUNT = 1 << 20;
+
+    PlRef<IntMap> map = PlRef<IntMap>::createObject();
+    TIME("Insert ints")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            map->set(i * 31, i);
+        }
+    TIMEEND()
+
+    int64 sum = 0;
+    TIME("Lookup ints, found")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            sum += map->get(i * 31);
+        }
+    TIMEEND()
+    TESTEXP("Lookup ints, found", sum == (int64)COUNT * (COUNT - 1) / 2);
+
+    int64 misses = 0;
+    TIME("Lookup ints, not found")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            misses += !map->has(i * 31 + 1);
+        }
+    TIMEEND()
+    TESTEXP("Lookup ints, not found", misses == COUNT);
+
+    sum = 0;
+    TIME("Iterate ints")
+        for (auto& e : map->indexFwd())
+        {
+            sum += e->mVal;
+        }
+    TIMEEND()
+    TESTEXP("Iterate ints", sum == (int64)COUNT * (COUNT - 1) / 2);
+
+    constDef STRCOUNT = 1 << 18;
+    PlRef<StrMap> smap = PlRef<StrMap>::createObject();
+    string* keys = (string*)sDefaultMemAlloc->_malloc(sizeof(string) * STRCOUNT);
+    for (int64 i = 0; i < STRCOUNT; i++)
+    {
+        new (&keys[i]) string(keyStr(i));
+    }
+    TIME("Insert strings")
+        for (int64 i = 0; i < STRCOUNT; i++)
+        {
+            smap->set(keys[i], i);
+        }
+    TIMEEND()
+
+    sum = 0;
+    TIME("Lookup strings")
+        for (int64 i = 0; i < STRCOUNT; i++)
+        {
+            sum += smap->get(keys[i]);
+        }
+    TIMEEND()
+    TESTEXP("Lookup strings", sum == (int64)STRCOUNT * (STRCOUNT - 1) / 2);
+
+    for (int64 i = 0; i < STRCOUNT; i++)
+    {
+        keys[i].~string();
+    }
+    sDefaultMemAlloc->_free(keys);
+}
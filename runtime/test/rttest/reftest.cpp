@@ -1,4 +1,6 @@
 #include "tests.h"
+#include <stdio.h>
+#include <stdlib.h>
 
 using namespace primal;
 
@@ -231,6 +233,198 @@ void testFormat()
 }
 
 
+static uint64 sFmtRand = 88172645463325252ull;
+
+static uint64 fmtRand()
+{
+    sFmtRand ^= sFmtRand << 13;
+    sFmtRand ^= sFmtRand >> 7;
+    sFmtRand ^= sFmtRand << 17;
+    return sFmtRand;
+}
+
+// Significant digits in a formatted float, trailing zeros aren't counted
+static int sigDigits(czstr s)
+{
+    czstr end = strchr(s, 'e');
+    if (!end)
+    {
+        end = s + strlen(s);
+    }
+    int n = 0;
+    int zeros = 0;
+    bool lead = true;
+    for (czstr p = s; p < end; p++)
+    {
+        if (*p == '0')
+        {
+            zeros += lead ? 0 : 1;
+        }
+        else if (*p >= '1' && *p <= '9')
+        {
+            lead = false;
+            n += zeros + 1;
+            zeros = 0;
+        }
+    }
+    return n;
+}
+
+// Fewest digits that read back as the same value, found the slow way
+static int shortestDigits(float64 v, bool f32)
+{
+    char buf[64];
+    for (int p = 0; p < 17; p++)
+    {
+        snprintf(buf, sizeof(buf), "%.*e", p, v);
+        if (f32 ? (strtof(buf, nullptr) == (float32)v) : (strtod(buf, nullptr) == v))
+        {
+            return p + 1;
+        }
+    }
+    return 17;
+}
+
+static bool float64RoundTrips(float64 v)
+{
+    string s = string::float64Str(v);
+    float64 back = strtod(s.cz(), nullptr);
+    return memcmp(&back, &v, sizeof(v)) == 0 && (v == 0 || sigDigits(s.cz()) == shortestDigits(v, false));
+}
+
+static bool float32RoundTrips(float32 v)
+{
+    string s = string::float32Str(v);
+    float32 back = strtof(s.cz(), nullptr);
+    return memcmp(&back, &v, sizeof(v)) == 0 && (v == 0 || sigDigits(s.cz()) == shortestDigits(v, true));
+}
+
+static bool intsMatch()
+{
+    char buf[80];
+    for (int i = 0; i < 100000; i++)
+    {
+        // Spread over all lengths
+        uint64 u = fmtRand() >> (fmtRand() % 64);
+        int64 n = (i & 1) ? -(int64)u : (int64)u;
+
+        snprintf(buf, sizeof(buf), "%lld", (long long)n);
+        if (_D(n) != buf)
+        {
+            return false;
+        }
+        snprintf(buf, sizeof(buf), "%llX", (unsigned long long)u);
+        if (_D(u, 16) != buf)
+        {
+            return false;
+        }
+        if (strtoull(_D(u, 2).cz(), nullptr, 2) != u || strtoull(_D(u, 7).cz(), nullptr, 7) != u)
+        {
+            return false;
+        }
+    }
+    return _D((int64)(-9223372036854775807LL - 1)) == "-9223372036854775808" &&
+        _D((uint64)0xFFFFFFFFFFFFFFFFull) == "18446744073709551615" &&
+        _D((uint64)0) == "0" && _D((uint64)0, 16) == "0";
+}
+
+static bool float64Matches()
+{
+    float64 edges[] = {0.1, 0.3, 1.0 / 3, 1e23, 5e-324, 1.7976931348623157e308,
+        2.2250738585072014e-308, 2.225073858507201e-308, 9007199254740991.0,
+        123456.789, 1e14, 1e-9, 4.35, -0.0, 1.0, 2.0, 0.5};
+    for (float64 v : edges)
+    {
+        if (!float64RoundTrips(v))
+        {
+            return false;
+        }
+    }
+    for (int i = 0; i < 50000; i++)
+    {
+        // Any bit pattern, and decimals with few digits
+        uint64 bits = fmtRand();
+        float64 v;
+        memcpy(&v, &bits, sizeof(v));
+        if (i & 1)
+        {
+            v = (float64)(fmtRand() % 1000000) / 1000.0;
+        }
+        if (v - v == 0 && !float64RoundTrips(v))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool float32Matches()
+{
+    for (int i = 0; i < 50000; i++)
+    {
+        uint32 bits = (uint32)fmtRand();
+        float32 v;
+        memcpy(&v, &bits, sizeof(v));
+        if (v - v == 0 && !float32RoundTrips(v))
+        {
+            return false;
+        }
+    }
+    return float32RoundTrips(0.1f) && float32RoundTrips(16777216.0f) && float32RoundTrips(1e-45f);
+}
+
+void testFormatRoundTrip()
+{
+    TESTEXP("Integers match snprintf", intsMatch());
+    TESTEXP("Float64 shortest round trip", float64Matches());
+    TESTEXP("Float32 shortest round trip", float32Matches());
+    TESTEXP("Float forms",
+        _D(0.1) == "0.1" &&
+        _D(0.1f) == "0.1" &&
+        _D(100.0) == "100" &&
+        _D(-2.5e-7) == "-0.00000025" &&
+        _D(1e23) == "1e+23" &&
+        _D(1.5e-10) == "1.5e-10" &&
+        _D(-0.0) == "-0" &&
+        _D(1.0 / 0.0) == "inf" &&
+        _D(-1.0 / 0.0) == "-inf" &&
+        _D(0.0 / 0.0) == "nan");
+}
+
+void testFormatBench()
+{
+    constDef COUNT = 1000000;
+    char buf[64];
+    usize total = 0;
+
+    TIME("Fmt int64")
+        for (int i = 0; i < COUNT; i++)
+        {
+            total += _D((int64)(i * 2654435761ull)).length();
+        }
+    TIMEEND()
+    TIME("snprintf int64")
+        for (int i = 0; i < COUNT; i++)
+        {
+            total += snprintf(buf, sizeof(buf), "%lld", (long long)(i * 2654435761ull));
+        }
+    TIMEEND()
+    TIME("Fmt float64")
+        for (int i = 0; i < COUNT; i++)
+        {
+            total += _D(i * 1.0001 / 7).length();
+        }
+    TIMEEND()
+    TIME("snprintf float64 %.17g")
+        for (int i = 0; i < COUNT; i++)
+        {
+            total += snprintf(buf, sizeof(buf), "%.17g", i * 1.0001 / 7);
+        }
+    TIMEEND()
+    TESTEXP("Formatted something", total > 0);
+}
+
+
 void testLambda()
 {
     int z = 10;
@@ -247,6 +441,232 @@ void testLambda()
 }
 
 
+#ifndef _WIN32
+#include <pthread.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/wait.h>
+
+enum class PrintMode
+{
+    legacy,
+    buffered,
+    async
+};
+
+struct PrintJob
+{
+    PrintMode mode;
+    int id;
+    int lines;
+};
+
+static Mutex sLegacyMut;
+
+// How printva_ used to write, a lock and then a write per piece
+static void legacyPrint(const char* s0, const primal::string& s1, const char* s2, const primal::string& s3)
+{
+    AutoLock al(sLegacyMut);
+    write(STDOUT_FILENO, s0, strlen(s0));
+    write(STDOUT_FILENO, s1.cz(), s1.length());
+    write(STDOUT_FILENO, s2, strlen(s2));
+    write(STDOUT_FILENO, s3.cz(), s3.length());
+    write(STDOUT_FILENO, "\n", 1);
+}
+
+static void* printWorker(void* arg)
+{
+    PrintJob* job = (PrintJob*)arg;
+    for (int i = 0; i < job->lines; i++)
+    {
+        if (job->mode == PrintMode::legacy)
+        {
+            legacyPrint("worker ", _D(job->id), " line ", _D(i));
+        }
+        else
+        {
+            printv("worker ", _D(job->id), " line ", _D(i));
+        }
+    }
+    return nullptr;
+}
+
+static void runPrintThreads(PrintMode mode, int threads, int lines)
+{
+    constDef MAXTHREADS = 16;
+    pthread_t th[MAXTHREADS];
+    PrintJob jobs[MAXTHREADS];
+    if (mode == PrintMode::async)
+    {
+        osPrintAsync(true);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        jobs[i] = {mode, i, lines};
+        pthread_create(&th[i], nullptr, printWorker, &jobs[i]);
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        pthread_join(th[i], nullptr);
+    }
+    if (mode == PrintMode::async)
+    {
+        osPrintAsync(false);
+    }
+}
+
+// Sends stdout to fd until restored, returns the saved one
+static int redirectStdout(int fd)
+{
+    osPrintFlush();
+    int saved = dup(STDOUT_FILENO);
+    dup2(fd, STDOUT_FILENO);
+    return saved;
+}
+
+static void restoreStdout(int saved)
+{
+    osPrintFlush();
+    dup2(saved, STDOUT_FILENO);
+    close(saved);
+}
+
+// Checks that every line is whole, and that each thread's lines are in order
+static bool checkPrintLines(const char* data, usize len, int threads, int lines)
+{
+    int next[16] = {};
+    usize pos = 0;
+    while (pos < len)
+    {
+        int id = -1;
+        int num = -1;
+        if (memcmp(data + pos, "worker ", 7) != 0)
+        {
+            return false;
+        }
+        pos += 7;
+        for (id = 0; pos < len && data[pos] >= '0' && data[pos] <= '9'; pos++)
+        {
+            id = id * 10 + (data[pos] - '0');
+        }
+        if (id >= threads || pos + 6 > len || memcmp(data + pos, " line ", 6) != 0)
+        {
+            return false;
+        }
+        pos += 6;
+        for (num = 0; pos < len && data[pos] >= '0' && data[pos] <= '9'; pos++)
+        {
+            num = num * 10 + (data[pos] - '0');
+        }
+        if (pos >= len || data[pos] != '\n' || num != next[id])
+        {
+            return false;
+        }
+        next[id]++;
+        pos++;
+    }
+    for (int i = 0; i < threads; i++)
+    {
+        if (next[i] != lines)
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+static bool printLinesIntact(PrintMode mode)
+{
+    constDef THREADS = 8;
+    constDef LINES = 5000;
+
+    char fn[] = "/tmp/rttestXXXXXX";
+    int fd = mkstemp(fn);
+    if (fd < 0)
+    {
+        return false;
+    }
+    int saved = redirectStdout(fd);
+    runPrintThreads(mode, THREADS, LINES);
+    restoreStdout(saved);
+
+    bool ret = false;
+    off_t len = lseek(fd, 0, SEEK_END);
+    char* data = (char*)sDefaultMemAlloc->_malloc(len + 1);
+    if (pread(fd, data, len, 0) == len)
+    {
+        ret = checkPrintLines(data, len, THREADS, LINES);
+    }
+    sDefaultMemAlloc->_free(data);
+    close(fd);
+    unlink(fn);
+    return ret;
+}
+
+// A line gathered just before an abort still reaches the file
+static bool printSurvivesAbort()
+{
+    char fn[] = "/tmp/rttestXXXXXX";
+    int fd = mkstemp(fn);
+    if (fd < 0)
+    {
+        return false;
+    }
+    osPrintFlush();
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        dup2(fd, STDOUT_FILENO);
+        printv("first line");
+        printv("before abort");
+        abort();
+    }
+    int status = 0;
+    waitpid(pid, &status, 0);
+
+    const char expect[] = "first line\nbefore abort\n";
+    char data[64];
+    ssize_t len = pread(fd, data, sizeof(data), 0);
+    close(fd);
+    unlink(fn);
+    return WIFSIGNALED(status) && len == (ssize_t)strlen(expect) && memcmp(data, expect, len) == 0;
+}
+
+void testPrint()
+{
+    TESTEXP("Buffered print lines intact", printLinesIntact(PrintMode::buffered));
+    TESTEXP("Async print lines intact", printLinesIntact(PrintMode::async));
+    TESTEXP("Print flushed on abort", printSurvivesAbort());
+
+    // Throughput with many threads printing, the output thrown away
+    constDef THREADS = 8;
+    constDef LINES = 20000;
+    YTimer timers[] = {"legacy print", "buffered print", "async print"};
+
+    int nul = open("/dev/null", O_WRONLY);
+    int saved = redirectStdout(nul);
+    for (int m = 0; m < 3; m++)
+    {
+        timers[m].start();
+        runPrintThreads((PrintMode)m, THREADS, LINES);
+        timers[m].stop();
+    }
+    restoreStdout(saved);
+    close(nul);
+
+    for (auto& ti : timers)
+    {
+        ti.report(ESC_YELLOW);
+    }
+}
+#else
+void testPrint()
+{
+}
+#endif
+
+
 template <typename T>
 class BoxObj : public PlObject
 {
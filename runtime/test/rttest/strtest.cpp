@@ -0,0 +1,317 @@
+#include "tests.h"
+#include <stdio.h>
+
+using namespace primal;
+
+void testStrCompare()
+{
+    // Pointed at a literal, comparing must not copy it to add a terminator
+    czstr lit = "primal strings";
+    string a(lit, 6);
+    string b("primal");
+    TESTEXP("Equal prefix", a == b && a.equals("primal") && a.compare("primal") == 0);
+    TESTEXP("Literal not copied", a.data() == lit);
+
+    TESTEXP("Shorter is less", a.compare("primal strings") < 0 && string(lit).compare(a) > 0);
+    TESTEXP("Byte order", string("abc").compare("abd") < 0 && string("abd").compare("abc") > 0 && string("b").compare("abc") > 0);
+    TESTEXP("Different lengths", a != string(lit) && !a.equals("prima") && !a.equals(""));
+    TESTEXP("Empty", string().equals("") && string() == string("") && string().compare("") == 0 && string("x").compare("") > 0);
+    TESTEXP("exist", a.exist('m') && !a.exist(' ') && a.data() == lit);
+
+    string c("abc\0def", 7);
+    string d("abc\0deg", 7);
+    TESTEXP("Past a null byte", c != d && c.compare(d) < 0 && c.length() == 7);
+
+    // The hash is kept until the string changes
+    uint64 h = a.hash();
+    TESTEXP("Hash", h != 0 && h == b.hash() && h == a.hash() && h != string(lit).hash() && a.data() == lit);
+
+    string e(a);
+    e.append('s');
+    TESTEXP("Hash after append", e.hash() != h && e.hash() == string("primals").hash() && a.hash() == h);
+    e.eraseLast();
+    TESTEXP("Hash after eraseLast", e.hash() == h && e == a);
+    e.assign("other");
+    TESTEXP("Hash after assign", e.hash() == string("other").hash());
+    e = a;
+    TESTEXP("Hash after copy", e.hash() == h);
+    zstr w = e.wrbuf(8);
+    w[0] = 'P';
+    TESTEXP("Hash after wrbuf", e.hash() != h && e.equals("Primal") && a.equals("primal"));
+    e.clear();
+    TESTEXP("Hash after clear", e.hash() == string().hash());
+
+    // Same length, known hashes that differ
+    string f("primaL");
+    (void)f.hash();
+    TESTEXP("Hashes differ", f != a && !f.equals(a));
+}
+
+void testStrCompareBench()
+{
+    constDef COUNT = 1 << 22;
+
+    // Long strings that differ only in length, or only at the end
+    string base;
+    for (int i = 0; i < 200; i++)
+    {
+        base.append('x');
+    }
+    string longer(base);
+    longer.append('x');
+    string last(base);
+    last.replaceLast('y');
+
+    int64 n = 0;
+    TIME("Equals, different lengths")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            n += base == longer;
+        }
+    TIMEEND()
+
+    TIME("Equals, same length")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            n += base == last;
+        }
+    TIMEEND()
+
+    TIME("Compare, same length")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            n += base.compare(last) < 0;
+        }
+    TIMEEND()
+    TESTEXP("Compare results", n == COUNT);
+
+    // A literal compared as it is, without a copy
+    czstr lit = "a literal that is not null terminated here";
+    string pointed(lit, 30);
+    n = 0;
+    TIME("Equals, pointed literal")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            n += pointed.equals("a literal that is not null ter");
+        }
+    TIMEEND()
+    TESTEXP("Pointed literal", n == COUNT && pointed.data() == lit);
+}
+
+void testStrView()
+{
+    string s("  key = value ;  other=2;;last  ");
+    strview v = s;
+    TESTEXP("View", v.data() == s.data() && v.length() == s.length() && v == s.view());
+
+    strview t = v.trim();
+    TESTEXP("trim", t.first() == 'k' && t.last() == 't' && t.data() == s.data() + 2 && v.trimLeft().endsWith("  ") && v.trimRight().startsWith("  key"));
+    TESTEXP("Trim all", strview("  \t\n ").trim().empty() && strview().trim().empty());
+
+    TESTEXP("slice", t.slice(0, 3) == "key" && t.slice(6, 5) == "value" && t.slice(100, 5).empty() && t.slice(24, 100) == "last" && t.tail(24) == "last");
+    TESTEXP("find", t.find('=', 0) == 4 && t.find('=', 5) == 20 && t.find('#', 0) == t.length() && t.find('k', 100) == t.length());
+    TESTEXP("find slice", t.find("other", 0) == 15 && t.find("e", 5) == 10 && t.find("lasts", 0) == t.length() && t.find("", 3) == 3);
+    TESTEXP("findLast", t.findLast(';') == 23 && t.findLast('#') == t.length());
+    TESTEXP("at", t.at(0) == 'k' && t.at(t.length()) == '\0' && strview().first() == '\0' && strview().last() == '\0');
+
+    // Every field, the empty ones too, and all pointing into s
+    strview rest = t;
+    strview field;
+    int count = 0;
+    int empty = 0;
+    bool inside = true;
+    while (rest.split(';', field))
+    {
+        count++;
+        empty += field.empty();
+        inside = inside && field.data() >= s.data() && field.data() + field.length() <= s.data() + s.length();
+    }
+    TESTEXP("split", count == 4 && empty == 1 && inside && field == "last" && !rest.split(';', field));
+
+    rest = "a,";
+    TESTEXP("split trailing", rest.split(',', field) && field == "a" && rest.split(',', field) && field.empty() && !rest.split(',', field));
+    rest = strview();
+    TESTEXP("split empty", rest.split(',', field) && field.empty() && !rest.split(',', field));
+
+    // Runs of separators skipped
+    rest = t;
+    string joined;
+    count = 0;
+    while (rest.token(" =;", field))
+    {
+        joined.append(field.data(), field.length());
+        count++;
+    }
+    TESTEXP("token", count == 5 && joined == "keyvalueother2last" && !rest.token(" ", field) && rest.empty());
+    rest = " ; ";
+    TESTEXP("token none", !rest.token("; ", field) && field.empty());
+
+    TESTEXP("compare", strview("abc").compare("abd") < 0 && strview("ab").compare("abc") < 0 && strview("b").compare("abc") > 0 && strview("abc").compare(s.slice(0, 0)) > 0 && strview().compare("") == 0);
+    TESTEXP("hash", t.slice(0, 3).hash() == strview("key").hash() && t.slice(0, 3).hash() != strview("kez").hash());
+
+    string copy = t.slice(6, 5).toString();
+    s.clear();
+    TESTEXP("toString", copy.equals("value") && copy.length() == 5);
+
+    string from(strview("abcdef").slice(1, 3));
+    TESTEXP("string from slice", from.equals("bcd") && s.slice(0, 10).empty());
+}
+
+void testStrViewBench()
+{
+    constDef COUNT = 1 << 16;
+    constDef FIELDS = 8;
+
+    // A line of fields, split and trimmed by copying each into a string, and
+    // by slicing
+    string line;
+    for (int i = 0; i < FIELDS; i++)
+    {
+        line.append(" field");
+        line.append(Fmt(i));
+        line.append(" ,");
+    }
+
+    usize total = 0;
+    TIME("Split, copied strings")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            string field;
+            czstr p = line.data();
+            czstr end = p + line.length();
+            while (p < end)
+            {
+                czstr q = p;
+                while (q < end && *q != ',')
+                {
+                    q++;
+                }
+                field.assign(p, q - p);
+                string trimmed;
+                for (usize j = 0; j < field.length(); j++)
+                {
+                    if (field.data()[j] != ' ')
+                    {
+                        trimmed.append(field.data()[j]);
+                    }
+                }
+                total += trimmed.length();
+                p = q + 1;
+            }
+        }
+    TIMEEND()
+
+    usize sliced = 0;
+    TIME("Split, slices")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            strview rest = line;
+            strview field;
+            while (rest.split(',', field))
+            {
+                sliced += field.trim().length();
+            }
+        }
+    TIMEEND()
+    TESTEXP("Same fields", total == sliced && sliced == (usize)COUNT * FIELDS * 6);
+}
+
+static string keyStrPiece(int i)
+{
+    string s("piece");
+    s.append(i % 7 + 1, (char)('a' + i % 26));
+    s.append(Fmt((int64)i));
+    return s;
+}
+
+void testStrBuilder()
+{
+    StrBuilder b;
+    TESTEXP("Empty", b.length() == 0 && b.toString().empty());
+
+    // Past a few chunks, with pieces that straddle them
+    string expect;
+    for (int i = 0; i < 1000; i++)
+    {
+        string piece = keyStrPiece(i);
+        b.append(piece);
+        b.append(';');
+        expect.append(piece);
+        expect.append(';');
+    }
+    string built = b.toString();
+    TESTEXP("Appended", b.length() == expect.length() && built == expect && built.length() == expect.length());
+
+    // A reserved chunk takes a big piece whole
+    StrBuilder r;
+    r.append("head ");
+    r.reserve(100000);
+    string big;
+    big.append(100000, 'z');
+    r.append(big);
+    string rs = r.toString();
+    TESTEXP("Reserved", r.length() == 100005 && rs.length() == 100005 && rs.first() == 'h' && rs.last() == 'z' && rs.slice(0, 6) == "head z");
+
+    StrBuilder c(b);
+    c.append(r);
+    TESTEXP("Copy", c.length() == b.length() + r.length() && c.toString().slice(0, expect.length()) == expect.view());
+    c.append(c);
+    TESTEXP("Append itself", c.length() == 2 * (b.length() + r.length()) && c.toString().view().tail(b.length() + r.length()).startsWith(expect.view()));
+
+    StrBuilder m((StrBuilder&&)c);
+    TESTEXP("Move", c.length() == 0 && c.toString().empty() && m.length() == 2 * (b.length() + r.length()));
+    m.clear();
+    m.append(strview("again"));
+    TESTEXP("Clear", m.toString() == string("again"));
+
+    string cat = StrBuilder::concat({ string("a"), strview("bcd").slice(1, 1), string(), string("ef") });
+    TESTEXP("concat", cat == string("acef") && cat.length() == 4);
+    TESTEXP("concat none", StrBuilder::concat({}).empty());
+}
+
+void testStrBuilderBench()
+{
+    constDef COUNT = 1 << 18;
+    string name("somebody");
+    string place("somewhere far away from here");
+
+    // What a + chain compiled to before, a temporary for each +
+    usize len = 0;
+    TIME("Chain of +")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            string s = string("Hello ") + name + string(", welcome to ") + place + string("!");
+            len += s.length();
+        }
+    TIMEEND()
+
+    usize catlen = 0;
+    TIME("concat")
+        for (int64 i = 0; i < COUNT; i++)
+        {
+            string s = StrBuilder::concat({ string("Hello "), name, string(", welcome to "), place, string("!") });
+            catlen += s.length();
+        }
+    TIMEEND()
+    TESTEXP("Same length", len == catlen);
+
+    constDef PIECES = 1 << 20;
+    string grown;
+    TIME("Append to a string")
+        for (int64 i = 0; i < PIECES; i++)
+        {
+            grown.append(name);
+        }
+    TIMEEND()
+
+    StrBuilder b;
+    string built;
+    TIME("Append to a builder")
+        for (int64 i = 0; i < PIECES; i++)
+        {
+            b.append(name);
+        }
+        built = b.toString();
+    TIMEEND()
+    TESTEXP("Same string", built == grown);
+}
@@ -0,0 +1,178 @@
+#include "tests.h"
+#include <stdio.h>
+
+using namespace primal;
+
+// Each index bumps a plain counter under the lock, so a lost update shows
+template <class LockType>
+static bool countUnder(LockType& mut, usize count, usize grain)
+{
+    int64 counter = 0;
+    auto body = [&mut, &counter](usize beg, usize end)
+    {
+        for (usize i = beg; i < end; i++)
+        {
+            AutoLock al(mut);
+            counter++;
+        }
+    };
+    taskParallelFor(0, count, grain, body);
+    return counter == (int64)count;
+}
+
+static volatile int32 sOnceRuns = 0;
+
+class OnceTask : public PlObject
+{
+public:
+    void run()
+    {
+        atomicIncrement(&sOnceRuns);
+    }
+};
+
+void testSyncLocks()
+{
+    taskShutdown();
+    taskSetWorkerCount(4);
+
+    Mutex mut;
+    FastMutex fmut;
+    RwMutex rwmut;
+    TESTEXP("Mutex count", countUnder(mut, 100000, 100));
+    TESTEXP("FastMutex count", countUnder(fmut, 100000, 100));
+    TESTEXP("FastMutex grain 1", countUnder(fmut, 5000, 1));
+    TESTEXP("RwMutex write count", countUnder(rwmut, 100000, 100));
+
+    bool trylock = fmut.tryLock() && !fmut.tryLock();
+    fmut.unlock();
+    TESTEXP("FastMutex tryLock", trylock && fmut.tryLock());
+    fmut.unlock();
+
+    // Writers keep the pair equal, readers must never see them differ
+    int64 a = 0;
+    int64 b = 0;
+    volatile int32 torn = 0;
+    volatile int32 writes = 0;
+    auto rwbody = [&](usize beg, usize end)
+    {
+        for (usize i = beg; i < end; i++)
+        {
+            if (i % 16 == 0)
+            {
+                AutoLock al(rwmut);
+                a++;
+                b++;
+                atomicIncrement(&writes);
+            }
+            else
+            {
+                AutoReadLock al(rwmut);
+                if (a != b)
+                {
+                    atomicIncrement(&torn);
+                }
+            }
+        }
+    };
+    taskParallelFor(0, 200000, 50, rwbody);
+    TESTEXP("RwMutex readers and writers", atomicLoad(&torn) == 0 && a == b && a == atomicLoad(&writes));
+
+    OnceFlag once;
+    volatile int32 runs = 0;
+    auto oncebody = [&](usize beg, usize end)
+    {
+        for (usize i = beg; i < end; i++)
+        {
+            once.call([&runs]()
+            {
+                atomicIncrement(&runs);
+            });
+        }
+    };
+    taskParallelFor(0, 10000, 10, oncebody);
+    TESTEXP("OnceFlag runs once", once.done() && atomicLoad(&runs) == 1);
+
+    // The objects mapped in the base unit
+    atomicStore(&sOnceRuns, 0);
+    PlRef<PlOnce> ponce = PlRef<PlOnce>::createObject();
+    PlRef<OnceTask> task = PlRef<OnceTask>::createObject();
+    ponce->call(task);
+    ponce->call(task);
+    TESTEXP("PlOnce", ponce->done() && atomicLoad(&sOnceRuns) == 1);
+
+    PlRef<PlLock> plock = PlRef<PlLock>::createObject();
+    plock->lock();
+    bool locked = !plock->tryLock();
+    plock->unlock();
+    TESTEXP("PlLock", locked && plock->tryLock());
+    plock->unlock();
+
+    taskShutdown();
+    taskSetWorkerCount(0);
+}
+
+// Lock, bump and unlock, with no other thread, and with twice as many
+// workers as CPUs taking turns on one lock
+template <class LockType>
+static void benchLock(const char* name, LockType& mut)
+{
+    constDef COUNT = 1 << 21;
+    char label[64];
+
+    int64 counter = 0;
+    snprintf(label, sizeof(label), "%s uncontended", name);
+    TIME(label)
+        for (usize i = 0; i < COUNT; i++)
+        {
+            mut.lock();
+            counter++;
+            mut.unlock();
+        }
+    TIMEEND()
+
+    snprintf(label, sizeof(label), "%s contended", name);
+    bool ok = false;
+    TIME(label)
+        ok = countUnder(mut, COUNT, 64);
+    TIMEEND()
+    TESTEXP(name, ok && counter == COUNT);
+}
+
+void testLockBench()
+{
+    taskShutdown();
+    taskSetWorkerCount(0);
+    usize workers = taskWorkerCount() * 2;
+    taskShutdown();
+    taskSetWorkerCount(workers);
+
+    Mutex mut;
+    FastMutex fmut;
+    RwMutex rwmut;
+    benchLock("Mutex", mut);
+    benchLock("FastMutex", fmut);
+    benchLock("RwMutex", rwmut);
+
+    // Readers only, they don't wait for each other
+    constDef COUNT = 1 << 21;
+    volatile int64 total = 0;
+    auto readbody = [&](usize beg, usize end)
+    {
+        int64 n = 0;
+        for (usize i = beg; i < end; i++)
+        {
+            rwmut.lockRead();
+            n++;
+            rwmut.unlockRead();
+        }
+        atomicAdd(&total, n);
+    };
+    TIME("RwMutex readers")
+        taskParallelFor(0, COUNT, 64, readbody);
+    TIMEEND()
+    TESTEXP("RwMutex readers", total == COUNT);
+
+    taskShutdown();
+    taskSetWorkerCount(0);
+}
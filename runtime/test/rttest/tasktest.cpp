@@ -0,0 +1,184 @@
+#include "tests.h"
+#include <stdio.h>
+
+using namespace primal;
+
+static volatile int32 sTaskRuns = 0;
+
+class CountTask : public PlObject
+{
+public:
+    void run()
+    {
+        atomicIncrement(&sTaskRuns);
+    }
+};
+
+class _Runnable_intf
+{
+public:
+    virtual void run() = 0;
+};
+using Runnable = PlInterfRef<_Runnable_intf>;
+
+class CountIntf : public PlObject, public _Runnable_intf
+{
+public:
+    void run()
+    {
+        atomicIncrement(&sTaskRuns);
+    }
+};
+
+// Each call spawns its first half as a task, so the tree is split many ways
+class FibTask : public PlTaskBase
+{
+public:
+    explicit FibTask(int32 n) :
+        mN(n),
+        mResult(0)
+    {
+    }
+    static int64 fib(int32 n)
+    {
+        if (n < 16)
+        {
+            return n < 2 ? n : fib(n - 1) + fib(n - 2);
+        }
+        FibTask t(n - 1);
+        taskSubmit(&t);
+        int64 r = fib(n - 2);
+        taskWait(&t);
+        return r + t.mResult;
+    }
+
+protected:
+    void execute() override
+    {
+        mResult = fib(mN);
+    }
+
+private:
+    int32 mN;
+    int64 mResult;
+};
+
+static int64 fibSeq(int32 n)
+{
+    return n < 2 ? n : fibSeq(n - 1) + fibSeq(n - 2);
+}
+
+static bool sumRange(usize count, usize grain)
+{
+    volatile int64 total = 0;
+    auto body = [&total](usize beg, usize end)
+    {
+        int64 sum = 0;
+        for (usize i = beg; i < end; i++)
+        {
+            sum += (int64)i;
+        }
+        atomicAdd(&total, sum);
+    };
+    taskParallelFor(0, count, grain, body);
+    return total == (int64)(count * (count - 1) / 2);
+}
+
+void testTaskPool()
+{
+    // More workers than CPUs, so stealing is exercised on small machines
+    taskShutdown();
+    taskSetWorkerCount(4);
+
+    constDef SPAWNS = 1000;
+    atomicStore(&sTaskRuns, 0);
+    {
+        ObjArray<PlRef<PlTask>> handles;
+        for (int i = 0; i < SPAWNS; i++)
+        {
+            PlRef<CountTask> obj = PlRef<CountTask>::createObject();
+            new (handles.appendMem()) PlRef<PlTask>(spawn_(obj));
+        }
+        for (usize i = 0; i < handles.length(); i++)
+        {
+            join_(*handles.get(i));
+        }
+    }
+    TESTEXP("Spawned objects all ran", atomicLoad(&sTaskRuns) == SPAWNS);
+
+    atomicStore(&sTaskRuns, 0);
+    {
+        PlRef<CountIntf> obj = PlRef<CountIntf>::createObject();
+        Runnable r = obj;
+        PlRef<PlTask> h = spawn_(r);
+        join_(h);
+        TESTEXP("Spawned through an interface", h->done() && atomicLoad(&sTaskRuns) == 1);
+    }
+
+    TESTEXP("parallelFor sum", sumRange(1000000, 1000));
+    TESTEXP("parallelFor grain 1", sumRange(5000, 1));
+    TESTEXP("parallelFor default grain", sumRange(12345, 0));
+    TESTEXP("parallelFor empty", sumRange(0, 10));
+    TESTEXP("Nested tasks", FibTask::fib(27) == fibSeq(27));
+
+    // Not joined, shutdown runs it
+    atomicStore(&sTaskRuns, 0);
+    {
+        PlRef<CountTask> obj = PlRef<CountTask>::createObject();
+        PlRef<PlTask> h = spawn_(obj);
+        taskShutdown();
+        TESTEXP("Shutdown runs what's left", h->done() && atomicLoad(&sTaskRuns) == 1);
+    }
+
+    TESTEXP("Restarts after shutdown", sumRange(100000, 100));
+
+    taskShutdown();
+    taskSetWorkerCount(0);
+}
+
+// Time for the same kernel with 1 worker up to one per CPU, and twice that
+void testTaskScaling()
+{
+    constDef COUNT = 1 << 24;
+    taskShutdown();
+    taskSetWorkerCount(0);
+    usize cpus = taskWorkerCount();
+
+    bool same = true;
+    int64 expect = 0;
+    for (usize workers = 1; workers <= cpus * 2; workers *= 2)
+    {
+        taskShutdown();
+        taskSetWorkerCount(workers);
+
+        volatile int64 total = 0;
+        auto body = [&total](usize beg, usize end)
+        {
+            uint64 h = 0;
+            for (usize i = beg; i < end; i++)
+            {
+                uint64 x = i * 0x9E3779B97F4A7C15ull;
+                x ^= x >> 29;
+                x *= 0xBF58476D1CE4E5B9ull;
+                h += x ^ (x >> 32);
+            }
+            atomicAdd(&total, (int64)h);
+        };
+
+        char label[32];
+        snprintf(label, sizeof(label), "%zu worker(s)", workers);
+        TIME(label)
+            taskParallelFor(0, COUNT, body);
+        TIMEEND()
+
+        if (workers == 1)
+        {
+            expect = total;
+        }
+        same = same && total == expect;
+    }
+    TESTEXP("Same result for every worker count", same);
+
+    taskShutdown();
+    taskSetWorkerCount(0);
+}
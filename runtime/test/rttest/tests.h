@@ -12,10 +12,28 @@
     TS(testMemPool) \
     TS(testMemPool2) \
     TS(testPlVector) \
+    TS(testPlVectorIter) \
     TS(testAtomic) \
     TS(testMem) \
     TS(testFormat) \
-    TS(testLambda)
+    TS(testFormatRoundTrip) \
+    TS(testFormatBench) \
+    TS(testLambda) \
+    TS(testPrint) \
+    TS(testTaskPool) \
+    TS(testTaskScaling) \
+    TS(testSyncLocks) \
+    TS(testLockBench) \
+    TS(testChannel) \
+    TS(testChannelBench) \
+    TS(testMap) \
+    TS(testMapBench) \
+    TS(testStrCompare) \
+    TS(testStrCompareBench) \
+    TS(testStrView) \
+    TS(testStrViewBench) \
+    TS(testStrBuilder) \
+    TS(testStrBuilderBench)
 
 
 DECLTESTS()